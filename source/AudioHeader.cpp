@@ -0,0 +1,374 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "AudioHeader.h"
+
+#include <string.h>
+
+
+// Kilobits per second, by table and bit rate index
+static const uint16 kMpegBitRates[5][16] = {
+	{0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448, 0},	// MPEG 1 layer 1
+	{0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 0},		// MPEG 1 layer 2
+	{0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0},		// MPEG 1 layer 3
+	{0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256, 0},	// MPEG 2 layer 1
+	{0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0}			// MPEG 2 layer 2/3
+};
+
+static const uint32 kMpegSampleRates[3] = {44100, 48000, 32000};
+
+static const uint32 kAdtsSampleRates[13]
+	= {96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050, 16000, 12000, 11025, 8000, 7350};
+
+// Size of the ADTS header without CRC
+static const size_t kAdtsHeaderSize = 7;
+
+// Size of an Ogg page header without its segment table
+static const size_t kOggHeaderSize = 27;
+
+// Size of the "fLaC" marker, the block header and the STREAMINFO block
+static const size_t kFlacHeaderSize = 42;
+
+
+static inline uint32
+ReadLE32(const uint8* data)
+{
+	return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32)data[3] << 24);
+}
+
+
+status_t
+AudioHeader::Identify(const uint8* data, size_t size, audio_header_info* info)
+{
+	memset(info, 0, sizeof(audio_header_info));
+
+	size_t tagSize = TagSize(data, size);
+	if (tagSize > 0) {
+		if (tagSize >= size)
+			return B_ERROR;
+
+		data += tagSize;
+		size -= tagSize;
+	}
+
+	if (_ParseFlac(data, size, info) == B_OK || _ParseOgg(data, size, info) == B_OK
+		|| _ParseMpeg(data, size, info) == B_OK || _ParseAdts(data, size, info) == B_OK)
+		return B_OK;
+
+	memset(info, 0, sizeof(audio_header_info));
+	return B_ERROR;
+}
+
+
+/**
+ * Returns the size of the ID3v2 tag data starts with, or 0 if there is none.
+ * The size is stored as a 28 bit synchsafe integer.
+ */
+size_t
+AudioHeader::TagSize(const uint8* data, size_t size)
+{
+	if (size < 10 || memcmp(data, "ID3", 3) != 0)
+		return 0;
+
+	size_t tagSize = ((data[6] & 0x7f) << 21) | ((data[7] & 0x7f) << 14)
+		| ((data[8] & 0x7f) << 7) | (data[9] & 0x7f);
+	return tagSize + ((data[5] & 0x10) != 0 ? 20 : 10);
+}
+
+
+size_t
+AudioHeader::FrameHeaderSize(audio_header_codec codec)
+{
+	switch (codec) {
+		case AUDIO_CODEC_MPEG:
+			return 4;
+		case AUDIO_CODEC_AAC:
+			return kAdtsHeaderSize;
+		default:
+			return 0;
+	}
+}
+
+
+/**
+ * Returns the length of the frame starting with header, or 0 if header is not
+ * a valid frame header for codec. FrameHeaderSize() bytes are read from it.
+ */
+size_t
+AudioHeader::FrameLength(audio_header_codec codec, const uint8* header, audio_header_info* info)
+{
+	switch (codec) {
+		case AUDIO_CODEC_MPEG:
+			return _MpegFrame(header, info);
+		case AUDIO_CODEC_AAC:
+			return _AdtsFrame(header, info);
+		default:
+			return 0;
+	}
+}
+
+
+/**
+ * Returns the number of samples per channel a frame of MPEG audio or ADTS
+ * decodes to, or 0 for other codecs.
+ */
+uint32
+AudioHeader::FrameSamples(const audio_header_info& info)
+{
+	switch (info.codec) {
+		case AUDIO_CODEC_MPEG:
+			if (info.mpegLayer == 1)
+				return 384;
+			if (info.mpegLayer == 3 && info.mpegVersion != 1)
+				return 576;
+			return 1152;
+		case AUDIO_CODEC_AAC:
+			return 1024;
+		default:
+			return 0;
+	}
+}
+
+
+/**
+ * Looks for two consecutive MPEG audio frames with the same format, and
+ * averages the bit rate over all frames that follow them in the buffer.
+ */
+status_t
+AudioHeader::_ParseMpeg(const uint8* data, size_t size, audio_header_info* info)
+{
+	for (size_t offset = 0; offset + 4 <= size; offset++) {
+		size_t length = _MpegFrame(data + offset, info);
+		if (length == 0 || offset + length + 4 > size)
+			continue;
+
+		audio_header_info next;
+		if (_MpegFrame(data + offset + length, &next) == 0 || next.mpegVersion != info->mpegVersion
+			|| next.mpegLayer != info->mpegLayer || next.sampleRate != info->sampleRate)
+			continue;
+
+		uint64 bitRates = 0;
+		uint32 frames = 0;
+		size_t position = offset;
+		while (position + 4 <= size && (length = _MpegFrame(data + position, &next)) != 0) {
+			bitRates += next.bitRate;
+			frames++;
+			position += length;
+		}
+
+		info->bitRate = bitRates / frames;
+		return B_OK;
+	}
+
+	return B_ERROR;
+}
+
+
+status_t
+AudioHeader::_ParseAdts(const uint8* data, size_t size, audio_header_info* info)
+{
+	for (size_t offset = 0; offset + kAdtsHeaderSize <= size; offset++) {
+		size_t length = _AdtsFrame(data + offset, info);
+		if (length == 0 || offset + length + kAdtsHeaderSize > size)
+			continue;
+
+		audio_header_info next;
+		if (_AdtsFrame(data + offset + length, &next) == 0 || next.sampleRate != info->sampleRate
+			|| next.channels != info->channels)
+			continue;
+
+		uint64 bitRates = 0;
+		uint32 frames = 0;
+		size_t position = offset;
+		while (position + kAdtsHeaderSize <= size
+			&& (length = _AdtsFrame(data + position, &next)) != 0) {
+			bitRates += next.bitRate;
+			frames++;
+			position += length;
+		}
+
+		info->bitRate = bitRates / frames;
+		return B_OK;
+	}
+
+	return B_ERROR;
+}
+
+
+/**
+ * Walks the Ogg pages looking for a Vorbis or Opus identification header,
+ * which is the first packet of its logical stream.
+ */
+status_t
+AudioHeader::_ParseOgg(const uint8* data, size_t size, audio_header_info* info)
+{
+	size_t offset = 0;
+	while (offset + kOggHeaderSize <= size) {
+		if (memcmp(data + offset, "OggS", 4) != 0 || data[offset + 4] != 0) {
+			offset++;
+			continue;
+		}
+
+		size_t segments = data[offset + 26];
+		if (offset + kOggHeaderSize + segments > size)
+			break;
+
+		const uint8* lacing = data + offset + kOggHeaderSize;
+		size_t pageSize = 0;
+		size_t packetSize = 0;
+		bool packetComplete = false;
+		for (size_t i = 0; i < segments; i++) {
+			pageSize += lacing[i];
+			if (!packetComplete) {
+				packetSize += lacing[i];
+				packetComplete = lacing[i] < 255;
+			}
+		}
+
+		const uint8* packet = lacing + segments;
+		size_t available = data + size - packet;
+		if (packetSize > available)
+			packetSize = available;
+
+		if (packetSize >= 30 && packet[0] == 1 && memcmp(packet + 1, "vorbis", 6) == 0) {
+			info->codec = AUDIO_CODEC_VORBIS;
+			info->channels = packet[11];
+			info->sampleRate = ReadLE32(packet + 12);
+			int32 nominalBitRate = (int32)ReadLE32(packet + 20);
+			info->bitRate = nominalBitRate > 0 ? nominalBitRate : 0;
+			return info->channels != 0 && info->sampleRate != 0 ? B_OK : B_ERROR;
+		}
+
+		if (packetSize >= 19 && memcmp(packet, "OpusHead", 8) == 0) {
+			// Opus is always decoded at 48 kHz, whatever the input rate was
+			info->codec = AUDIO_CODEC_OPUS;
+			info->channels = packet[9];
+			info->sampleRate = 48000;
+			return info->channels != 0 ? B_OK : B_ERROR;
+		}
+
+		offset += kOggHeaderSize + segments + pageSize;
+	}
+
+	return B_ERROR;
+}
+
+
+status_t
+AudioHeader::_ParseFlac(const uint8* data, size_t size, audio_header_info* info)
+{
+	if (size < kFlacHeaderSize || memcmp(data, "fLaC", 4) != 0)
+		return B_ERROR;
+
+	// The first metadata block is always STREAMINFO
+	if ((data[4] & 0x7f) != 0)
+		return B_ERROR;
+
+	const uint8* streamInfo = data + 8;
+	info->codec = AUDIO_CODEC_FLAC;
+	info->sampleRate = (streamInfo[10] << 12) | (streamInfo[11] << 4) | (streamInfo[12] >> 4);
+	info->channels = ((streamInfo[12] >> 1) & 7) + 1;
+
+	return info->sampleRate != 0 ? B_OK : B_ERROR;
+}
+
+
+/**
+ * Decodes an MPEG audio frame header, returning the frame length in bytes or
+ * 0 if header is not a valid one.
+ */
+size_t
+AudioHeader::_MpegFrame(const uint8* header, audio_header_info* info)
+{
+	if (header[0] != 0xff || (header[1] & 0xe0) != 0xe0)
+		return 0;
+
+	// Version 0 is MPEG 2.5, 1 is reserved, 2 is MPEG 2 and 3 is MPEG 1
+	uint32 version = (header[1] >> 3) & 3;
+	uint32 layer = 4 - ((header[1] >> 1) & 3);
+	uint32 bitRateIndex = header[2] >> 4;
+	uint32 sampleRateIndex = (header[2] >> 2) & 3;
+	uint32 padding = (header[2] >> 1) & 1;
+
+	// Free format streams are not supported
+	if (version == 1 || layer == 4 || bitRateIndex == 0 || bitRateIndex == 15
+		|| sampleRateIndex == 3)
+		return 0;
+
+	uint32 table = version == 3 ? layer - 1 : (layer == 1 ? 3 : 4);
+	uint32 bitRate = kMpegBitRates[table][bitRateIndex] * 1000;
+	uint32 sampleRate
+		= kMpegSampleRates[sampleRateIndex] >> (version == 3 ? 0 : (version == 2 ? 1 : 2));
+
+	size_t length;
+	if (layer == 1)
+		length = (12 * bitRate / sampleRate + padding) * 4;
+	else if (layer == 3 && version != 3)
+		length = 72 * bitRate / sampleRate + padding;
+	else
+		length = 144 * bitRate / sampleRate + padding;
+
+	info->codec = AUDIO_CODEC_MPEG;
+	info->mpegVersion = version == 3 ? 1 : (version == 2 ? 2 : 25);
+	info->mpegLayer = layer;
+	info->sampleRate = sampleRate;
+	info->channels = (header[3] >> 6) == 3 ? 1 : 2;
+	info->bitRate = bitRate;
+	info->frameSize = length;
+
+	return length;
+}
+
+
+/**
+ * Decodes an ADTS header, returning the frame length in bytes or 0 if header
+ * is not a valid one.
+ */
+size_t
+AudioHeader::_AdtsFrame(const uint8* header, audio_header_info* info)
+{
+	// Sync word and layer, which is always 0
+	if (header[0] != 0xff || (header[1] & 0xf6) != 0xf0)
+		return 0;
+
+	uint32 sampleRateIndex = (header[2] >> 2) & 0xf;
+	if (sampleRateIndex >= sizeof(kAdtsSampleRates) / sizeof(kAdtsSampleRates[0]))
+		return 0;
+
+	size_t length = ((header[3] & 3) << 11) | (header[4] << 3) | (header[5] >> 5);
+	if (length < kAdtsHeaderSize)
+		return 0;
+
+	// Configuration 0 is defined in the stream, 7 means 7.1
+	uint32 channels = ((header[2] & 1) << 2) | (header[3] >> 6);
+	if (channels == 0)
+		channels = 2;
+	else if (channels == 7)
+		channels = 8;
+
+	uint32 blocks = (header[6] & 3) + 1;
+	uint32 sampleRate = kAdtsSampleRates[sampleRateIndex];
+
+	info->codec = AUDIO_CODEC_AAC;
+	info->sampleRate = sampleRate;
+	info->channels = channels;
+	info->bitRate = (uint64)length * 8 * sampleRate / (1024 * blocks);
+	info->frameSize = length;
+
+	return length;
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef _AUDIO_HEADER_H
+#define _AUDIO_HEADER_H
+
+
+#include <SupportDefs.h>
+
+
+enum audio_header_codec {
+	AUDIO_CODEC_UNKNOWN = 0,
+	AUDIO_CODEC_MPEG,
+	AUDIO_CODEC_AAC,
+	AUDIO_CODEC_VORBIS,
+	AUDIO_CODEC_OPUS,
+	AUDIO_CODEC_FLAC
+};
+
+
+struct audio_header_info {
+	audio_header_codec codec;
+	uint32 sampleRate;
+	uint32 channels;
+	uint32 bitRate;		// bits per second, 0 if unknown
+	size_t frameSize;	// bytes of the first frame, 0 for Ogg and FLAC
+	uint32 mpegVersion; // 1, 2 or 25 for MPEG 2.5
+	uint32 mpegLayer;
+};
+
+
+/**
+ * Identifies compressed audio from the first bytes of a stream, reading
+ * nothing but the frame or stream headers. Streams joined at any point are
+ * supported for MP3 and ADTS; Ogg and FLAC need their stream headers.
+ */
+class AudioHeader {
+public:
+	static status_t Identify(const uint8* data, size_t size, audio_header_info* info);
+	static size_t TagSize(const uint8* data, size_t size);
+
+	// Frame by frame access to MPEG audio and ADTS streams
+	static size_t FrameHeaderSize(audio_header_codec codec);
+	static size_t FrameLength(
+		audio_header_codec codec, const uint8* header, audio_header_info* info);
+	static uint32 FrameSamples(const audio_header_info& info);
+
+private:
+	static status_t _ParseMpeg(const uint8* data, size_t size, audio_header_info* info);
+	static status_t _ParseAdts(const uint8* data, size_t size, audio_header_info* info);
+	static status_t _ParseOgg(const uint8* data, size_t size, audio_header_info* info);
+	static status_t _ParseFlac(const uint8* data, size_t size, audio_header_info* info);
+
+	static size_t _MpegFrame(const uint8* header, audio_header_info* info);
+	static size_t _AdtsFrame(const uint8* header, audio_header_info* info);
+};
+
+
+#endif	// _AUDIO_HEADER_H
@@ -0,0 +1,722 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "AudioMixer.h"
+
+#include <Autolock.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Debug.h"
+#include "LoudnessMeter.h"
+#include "PcmDsp.h"
+#include "Resampler.h"
+
+
+// Rate of the mix, which the output is asked for
+static const float kMixerFrameRate = 44100;
+
+// Frames decoded at once, unless the input format has a buffer size
+static const size_t kInputFrames = 2048;
+
+// Interval at which a full queue is checked for room again
+static const bigtime_t kFeedWait = 10000;
+
+// Loudness stations are normalized to, and how far their level may change
+static const float kTargetLoudness = -18;
+static const float kMinLevel = 0.1f;
+static const float kMaxLevel = 2.0f;
+
+// Audio measured before the loudness is trusted
+static const bigtime_t kMinMeasuredTime = 5000000;
+
+// The level follows the measured loudness by 1 dB a second at most
+static const float kLevelStep = 1.122f;
+
+// Interval at which the mixer checks if the sound player left a list of inputs
+static const bigtime_t kMixWait = 1000;
+
+// Bits of a NaN, for a fade that starts from the gain the input has
+static const int32 kFromCurrentGain = -1;
+
+
+static float
+level_for_loudness(float loudness)
+{
+	float level = powf(10, (kTargetLoudness - loudness) / 20);
+	return max_c(kMinLevel, min_c(level, kMaxLevel));
+}
+
+
+// Floats are passed to the sound player's thread as the bits of an int32
+static int32
+float_bits(float value)
+{
+	int32 bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+
+static float
+bits_float(int32 bits)
+{
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+
+BLocker AudioMixer::sDefaultLock("audio mixer default");
+AudioMixer* AudioMixer::sDefault = NULL;
+
+
+template<typename Sample>
+static void
+convert_to_float(const Sample* input, float* output, size_t frames, uint32 channels,
+	float offset, float scale)
+{
+	for (size_t i = 0; i < frames; i++) {
+		const Sample* frame = input + i * channels;
+		for (uint32 c = 0; c < MIXER_CHANNELS; c++)
+			output[i * MIXER_CHANNELS + c] = (frame[min_c(c, channels - 1)] - offset) * scale;
+	}
+}
+
+
+MixerInput::MixerInput(AudioMixer* mixer, const media_raw_audio_format& format,
+	const char* name, FillFunc fill, void* cookie)
+	: fInitStatus(B_NO_INIT),
+	  fMixer(mixer),
+	  fFormat(format),
+	  fName(name),
+	  fFill(fill),
+	  fCookie(cookie),
+	  fGain(1.0f),
+	  fGainSettled(true),
+	  fGainSequence(0),
+	  fGainFrom(float_bits(1.0f)),
+	  fGainTo(float_bits(1.0f)),
+	  fGainFrames(0),
+	  fAppliedSequence(0),
+	  fFadeFrom(1.0f),
+	  fFadeTo(1.0f),
+	  fFadeLength(0),
+	  fFadePosition(0),
+	  fAppliedGain(1.0f),
+	  fMeter(NULL),
+	  fLevel(1.0f),
+	  fMixLevel(float_bits(1.0f)),
+	  fLevelFrames(0),
+	  fDecoded(NULL),
+	  fConverted(NULL),
+	  fFrames(0),
+	  fResampler(NULL),
+	  fResampled(NULL),
+	  fChunkFrames(0),
+	  fQueue(NULL),
+	  fQueueRead(0),
+	  fQueueWrite(0),
+	  fFeedThread(-1),
+	  fQuit(false)
+{
+	size_t sampleSize = fFormat.format & media_raw_audio_format::B_AUDIO_SIZE_MASK;
+	size_t frameSize = fFormat.channel_count * sampleSize;
+	if (frameSize == 0 || fFormat.frame_rate <= 0) {
+		fInitStatus = B_MEDIA_BAD_FORMAT;
+		return;
+	}
+
+	if (fFormat.buffer_size == 0)
+		fFormat.buffer_size = kInputFrames * frameSize;
+
+	// A chunk must leave room in the queue at the rate of the mix
+	fFrames = fFormat.buffer_size / frameSize;
+	size_t maxFrames = size_t(MIXER_QUEUE_FRAMES / 2 * fFormat.frame_rate / mixer->FrameRate());
+	if (fFrames > maxFrames) {
+		fFrames = maxFrames;
+		fFormat.buffer_size = fFrames * frameSize;
+	}
+	fChunkFrames = fFrames;
+
+	uint32 inputRate = (uint32)roundf(fFormat.frame_rate);
+	uint32 outputRate = (uint32)roundf(mixer->FrameRate());
+	if (inputRate != outputRate) {
+		fResampler = new Resampler(inputRate, outputRate, MIXER_CHANNELS, fFrames);
+		if (fResampler->InitCheck() != B_OK) {
+			fInitStatus = fResampler->InitCheck();
+			return;
+		}
+		fChunkFrames = fResampler->MaxOutputFrames();
+		fResampled = (float*)malloc(fChunkFrames * MIXER_CHANNELS * sizeof(float));
+	}
+
+	fDecoded = (uint8*)malloc(fFormat.buffer_size);
+	fConverted = (float*)malloc(fFrames * MIXER_CHANNELS * sizeof(float));
+	fQueue = (float*)malloc(MIXER_QUEUE_FRAMES * MIXER_CHANNELS * sizeof(float));
+	if (fDecoded == NULL || fConverted == NULL || fQueue == NULL
+		|| (fResampler != NULL && fResampled == NULL)) {
+		fInitStatus = B_NO_MEMORY;
+		return;
+	}
+
+	fInitStatus = B_OK;
+}
+
+
+MixerInput::~MixerInput()
+{
+	Stop();
+
+	delete fMeter;
+	delete fResampler;
+	free(fResampled);
+	free(fDecoded);
+	free(fConverted);
+	free(fQueue);
+}
+
+
+status_t
+MixerInput::Start()
+{
+	if (fInitStatus != B_OK)
+		return fInitStatus;
+
+	if (fFeedThread >= 0)
+		return B_OK;
+
+	fQuit = false;
+	fFeedThread = spawn_thread(
+		&_FeedThreadFunc, fName.String(), B_URGENT_DISPLAY_PRIORITY, this);
+	if (fFeedThread < 0)
+		return fFeedThread;
+
+	return resume_thread(fFeedThread);
+}
+
+
+void
+MixerInput::Stop()
+{
+	if (fFeedThread < 0)
+		return;
+
+	fQuit = true;
+
+	status_t status;
+	wait_for_thread(fFeedThread, &status);
+	fFeedThread = -1;
+}
+
+
+/**
+ * Sets the gain at once, ending a fade.
+ */
+void
+MixerInput::SetGain(float gain)
+{
+	BAutolock lock(fMixer->fLock);
+
+	fGain = gain;
+	fGainSettled = true;
+	_PostGain(float_bits(gain), gain, 0);
+}
+
+
+/**
+ * Changes the gain linearly from where it is now to gain over duration.
+ */
+void
+MixerInput::FadeTo(float gain, bigtime_t duration)
+{
+	BAutolock lock(fMixer->fLock);
+
+	// A gain that was just set may not have reached the mix yet
+	int32 from = fGainSettled ? float_bits(fGain) : kFromCurrentGain;
+	size_t frames = size_t(duration * fMixer->FrameRate() / 1000000);
+
+	fGain = gain;
+	fGainSettled = frames == 0;
+	_PostGain(from, gain, frames);
+}
+
+
+/**
+ * Measures the loudness of the input, and plays it at the level that makes it
+ * as loud as the other normalized inputs. The level starts from the loudness
+ * measured before, if it is not 0, and follows what is measured now slowly.
+ * Must be called before the input is started.
+ */
+void
+MixerInput::SetNormalization(float loudness)
+{
+	if (fMeter == NULL) {
+		// Upmixed mono counts once, as its one channel is measured
+		uint32 channels = fFormat.channel_count == 1 ? 1 : MIXER_CHANNELS;
+		fMeter = new LoudnessMeter(fFormat.frame_rate, channels, MIXER_CHANNELS);
+		if (fMeter->InitCheck() != B_OK) {
+			delete fMeter;
+			fMeter = NULL;
+			return;
+		}
+	}
+
+	fLevel = loudness != 0 ? level_for_loudness(loudness) : 1.0f;
+	atomic_set(&fMixLevel, float_bits(fLevel));
+}
+
+
+/**
+ * Returns the loudness measured so far, or 0 if too little was measured.
+ */
+float
+MixerInput::Loudness() const
+{
+	if (fMeter == NULL || fMeter->MeasuredTime() < kMinMeasuredTime)
+		return 0;
+
+	return fMeter->IntegratedLoudness();
+}
+
+
+float
+MixerInput::_CurrentGain() const
+{
+	if (fFadePosition >= fFadeLength)
+		return fFadeTo;
+
+	return fFadeFrom + (fFadeTo - fFadeFrom) * fFadePosition / fFadeLength;
+}
+
+
+/**
+ * Hands a gain change to the sound player's thread. The sequence is odd while
+ * the change is written, so that the mix never takes half of one. Called with
+ * the mixer locked, which keeps the setters apart.
+ */
+void
+MixerInput::_PostGain(int32 from, float to, size_t frames)
+{
+	atomic_add(&fGainSequence, 1);
+	atomic_set(&fGainFrom, from);
+	atomic_set(&fGainTo, float_bits(to));
+	atomic_set(&fGainFrames, (int32)frames);
+	atomic_add(&fGainSequence, 1);
+}
+
+
+/**
+ * Takes over the last change posted, on the sound player's thread. A change
+ * that is being written is picked up with the next buffer instead.
+ */
+void
+MixerInput::_UpdateGain()
+{
+	int32 sequence = atomic_get(&fGainSequence);
+	if (sequence == fAppliedSequence || (sequence & 1) != 0)
+		return;
+
+	int32 from = atomic_get(&fGainFrom);
+	float to = bits_float(atomic_get(&fGainTo));
+	size_t frames = (uint32)atomic_get(&fGainFrames);
+	if (atomic_get(&fGainSequence) != sequence)
+		return;
+
+	fFadeFrom = from == kFromCurrentGain ? _CurrentGain() : bits_float(from);
+	fFadeTo = to;
+	fFadeLength = frames;
+	fFadePosition = 0;
+	fAppliedSequence = sequence;
+}
+
+
+float
+MixerInput::_Level()
+{
+	return bits_float(atomic_get(&fMixLevel));
+}
+
+
+void
+MixerInput::_Convert(const void* data, size_t frames)
+{
+	uint32 channels = fFormat.channel_count;
+
+	if (channels <= MIXER_CHANNELS && _ConvertFast(data, frames))
+		return;
+
+	switch (fFormat.format) {
+		case media_raw_audio_format::B_AUDIO_FLOAT:
+			convert_to_float((const float*)data, fConverted, frames, channels, 0.0f, 1.0f);
+			break;
+		case media_raw_audio_format::B_AUDIO_INT:
+			convert_to_float(
+				(const int32*)data, fConverted, frames, channels, 0.0f, 1.0f / 2147483648.0f);
+			break;
+		case media_raw_audio_format::B_AUDIO_SHORT:
+			convert_to_float(
+				(const int16*)data, fConverted, frames, channels, 0.0f, 1.0f / 32768.0f);
+			break;
+		case media_raw_audio_format::B_AUDIO_CHAR:
+			convert_to_float((const int8*)data, fConverted, frames, channels, 0.0f, 1.0f / 128.0f);
+			break;
+		case media_raw_audio_format::B_AUDIO_UCHAR:
+			convert_to_float(
+				(const uint8*)data, fConverted, frames, channels, 128.0f, 1.0f / 128.0f);
+			break;
+		default:
+			memset(fConverted, 0, frames * MIXER_CHANNELS * sizeof(float));
+			break;
+	}
+}
+
+
+/**
+ * Converts the mono and stereo formats decoders deliver with the PcmDsp
+ * kernels. Mono is converted into the upper half of the buffer first, which
+ * UpMix() reads ahead of what it writes.
+ */
+bool
+MixerInput::_ConvertFast(const void* data, size_t frames)
+{
+	bool mono = fFormat.channel_count == 1;
+	size_t samples = frames * fFormat.channel_count;
+	float* output = mono ? fConverted + frames : fConverted;
+
+	switch (fFormat.format) {
+		case media_raw_audio_format::B_AUDIO_FLOAT:
+			if (mono) {
+				PcmDsp::UpMix((const float*)data, fConverted, frames);
+				return true;
+			}
+			memcpy(fConverted, data, samples * sizeof(float));
+			return true;
+		case media_raw_audio_format::B_AUDIO_INT:
+			PcmDsp::ConvertToFloat((const int32*)data, output, samples);
+			break;
+		case media_raw_audio_format::B_AUDIO_SHORT:
+			PcmDsp::ConvertToFloat((const int16*)data, output, samples);
+			break;
+		default:
+			return false;
+	}
+
+	if (mono)
+		PcmDsp::UpMix(output, fConverted, frames);
+
+	return true;
+}
+
+
+void
+MixerInput::_Measure(size_t frames)
+{
+	fMeter->Process(fConverted, frames);
+
+	fLevelFrames += frames;
+	if (fLevelFrames < fFormat.frame_rate)
+		return;
+
+	fLevelFrames = 0;
+	float loudness = Loudness();
+	if (loudness == 0)
+		return;
+
+	float level = level_for_loudness(loudness);
+	fLevel = max_c(fLevel / kLevelStep, min_c(level, fLevel * kLevelStep));
+	atomic_set(&fMixLevel, float_bits(fLevel));
+}
+
+
+/**
+ * Queues the converted frames at the rate of the mix. The resampler runs here
+ * on the feed thread, so that the sound player only has to add up the queues.
+ */
+void
+MixerInput::_Resample(size_t frames)
+{
+	const float* data = fConverted;
+	if (fResampler != NULL) {
+		frames = fResampler->Process(fConverted, frames, fResampled);
+		data = fResampled;
+	}
+
+	// The queue wraps around at most once
+	const uint32 mask = MIXER_QUEUE_FRAMES - 1;
+	uint32 write = (uint32)atomic_get(&fQueueWrite);
+	uint32 start = write & mask;
+	uint32 first = min_c(frames, MIXER_QUEUE_FRAMES - start);
+
+	memcpy(fQueue + start * MIXER_CHANNELS, data, first * MIXER_CHANNELS * sizeof(float));
+	memcpy(fQueue, data + first * MIXER_CHANNELS,
+		(frames - first) * MIXER_CHANNELS * sizeof(float));
+
+	atomic_set(&fQueueWrite, (int32)(write + frames));
+}
+
+
+/**
+ * Adds what is queued to output, on the thread of the sound player. An input
+ * that falls behind adds silence rather than being waited for. A changed gain
+ * is ramped to over the buffer, so that it does not click.
+ */
+void
+MixerInput::_MixInto(float* output, size_t frames, uint32 channels)
+{
+	const uint32 mask = MIXER_QUEUE_FRAMES - 1;
+	uint32 read = (uint32)atomic_get(&fQueueRead);
+	uint32 count = min_c(frames, (uint32)atomic_get(&fQueueWrite) - read);
+
+	// A fade goes on while the input falls behind
+	_UpdateGain();
+	fFadePosition = min_c(fFadePosition + frames, fFadeLength);
+	float gain = _CurrentGain() * _Level();
+
+	if (count == 0) {
+		fAppliedGain = gain;
+		return;
+	}
+
+	if (channels != MIXER_CHANNELS) {
+		for (uint32 i = 0; i < count; i++) {
+			const float* queued = fQueue + ((read + i) & mask) * MIXER_CHANNELS;
+			float* frame = output + i * channels;
+			for (uint32 c = 0; c < channels; c++)
+				frame[c] += queued[min_c(c, MIXER_CHANNELS - 1)] * gain;
+		}
+	} else {
+		// The queue wraps around at most once
+		uint32 start = read & mask;
+		uint32 first = min_c(count, MIXER_QUEUE_FRAMES - start);
+		uint32 second = count - first;
+		float* queued = fQueue + start * MIXER_CHANNELS;
+
+		if (gain != fAppliedGain) {
+			// The queued frames belong to this thread until they are released
+			float middle = fAppliedGain + (gain - fAppliedGain) * first / count;
+			PcmDsp::GainRamp(queued, first, MIXER_CHANNELS, fAppliedGain, middle);
+			PcmDsp::GainRamp(fQueue, second, MIXER_CHANNELS, middle, gain);
+			PcmDsp::Mix(queued, output, first * MIXER_CHANNELS, 1.0f);
+			PcmDsp::Mix(fQueue, output + first * MIXER_CHANNELS, second * MIXER_CHANNELS, 1.0f);
+		} else {
+			PcmDsp::Mix(queued, output, first * MIXER_CHANNELS, gain);
+			PcmDsp::Mix(fQueue, output + first * MIXER_CHANNELS, second * MIXER_CHANNELS, gain);
+		}
+	}
+
+	fAppliedGain = gain;
+	atomic_set(&fQueueRead, (int32)(read + count));
+}
+
+
+int32
+MixerInput::_FeedThreadFunc(void* data)
+{
+	MixerInput* _this = (MixerInput*)data;
+
+	while (!_this->fQuit) {
+		uint32 queued
+			= (uint32)atomic_get(&_this->fQueueWrite) - (uint32)atomic_get(&_this->fQueueRead);
+		if (MIXER_QUEUE_FRAMES - queued < _this->fChunkFrames) {
+			snooze(kFeedWait);
+			continue;
+		}
+
+		_this->fFill(_this->fCookie, _this->fDecoded, _this->fFormat.buffer_size, _this->fFormat);
+		_this->_Convert(_this->fDecoded, _this->fFrames);
+		if (_this->fMeter != NULL)
+			_this->_Measure(_this->fFrames);
+		_this->_Resample(_this->fFrames);
+	}
+
+	return B_OK;
+}
+
+
+AudioMixer::AudioMixer()
+	: fLock("audio mixer"),
+	  fInputs(),
+	  fMixInputs(new BObjectList<MixerInput>()),
+	  fMixing(0),
+	  fMixCount(0),
+	  fPlayer(NULL)
+{
+	fFormat = media_raw_audio_format::wildcard;
+	fFormat.frame_rate = kMixerFrameRate;
+	fFormat.channel_count = MIXER_CHANNELS;
+	fFormat.format = media_raw_audio_format::B_AUDIO_FLOAT;
+	fFormat.byte_order = B_MEDIA_HOST_ENDIAN;
+}
+
+
+AudioMixer::~AudioMixer()
+{
+	if (fPlayer != NULL)
+		fPlayer->Stop(true, true);
+
+	delete fPlayer;
+	delete fMixInputs;
+}
+
+
+AudioMixer*
+AudioMixer::Default()
+{
+	BAutolock lock(sDefaultLock);
+
+	if (sDefault == NULL)
+		sDefault = new AudioMixer();
+
+	return sDefault;
+}
+
+
+/**
+ * Adds an input that plays what fill delivers in format, once it is started.
+ * The output is started with the first input.
+ */
+MixerInput*
+AudioMixer::AddInput(const media_raw_audio_format& format, const char* name,
+	MixerInput::FillFunc fill, void* cookie)
+{
+	{
+		BAutolock lock(fLock);
+		if (fPlayer == NULL && _StartPlayer() != B_OK)
+			return NULL;
+	}
+
+	MixerInput* input = new MixerInput(this, format, name, fill, cookie);
+	if (input->InitCheck() != B_OK) {
+		MSG("Could not add %s to the mix - %s\n", name, strerror(input->InitCheck()));
+		delete input;
+		return NULL;
+	}
+
+	BAutolock lock(fLock);
+	fInputs.AddItem(input);
+	_PublishInputs();
+
+	return input;
+}
+
+
+/**
+ * Stops and deletes input. The output is stopped with the last input.
+ */
+void
+AudioMixer::RemoveInput(MixerInput* input)
+{
+	input->Stop();
+
+	BSoundPlayer* player = NULL;
+	{
+		BAutolock lock(fLock);
+		fInputs.RemoveItem(input);
+		_PublishInputs();
+
+		if (fInputs.IsEmpty()) {
+			player = fPlayer;
+			fPlayer = NULL;
+		}
+	}
+
+	delete input;
+
+	if (player != NULL) {
+		player->Stop(true, false);
+		delete player;
+	}
+}
+
+
+/**
+ * Hands a copy of the inputs to the sound player's thread, and deletes the
+ * copy it had once it is done with it. Called with the mixer locked.
+ */
+void
+AudioMixer::_PublishInputs()
+{
+	BObjectList<MixerInput>* previous
+		= atomic_pointer_get_and_set(&fMixInputs, new BObjectList<MixerInput>(fInputs));
+
+	// Waits for a mix that may have taken the previous list to end
+	int32 count = atomic_get(&fMixCount);
+	while (atomic_get(&fMixing) != 0 && atomic_get(&fMixCount) == count)
+		snooze(kMixWait);
+
+	delete previous;
+}
+
+
+status_t
+AudioMixer::_StartPlayer()
+{
+	BSoundPlayer* player = new BSoundPlayer(&fFormat, "StreamRadio", &_MixFunc, NULL, this);
+	status_t status = player->InitCheck();
+	if (status == B_OK) {
+		fFormat = player->Format();
+		status = player->Start();
+	}
+
+	if (status != B_OK) {
+		MSG("Could not start the mixer - %s\n", strerror(status));
+		delete player;
+		return status;
+	}
+
+	player->SetHasData(true);
+	fPlayer = player;
+
+	return B_OK;
+}
+
+
+void
+AudioMixer::_MixFunc(void* cookie, void* buffer, size_t size, const media_raw_audio_format& format)
+{
+	AudioMixer* mixer = (AudioMixer*)cookie;
+
+	memset(buffer, 0, size);
+	if (format.format != media_raw_audio_format::B_AUDIO_FLOAT || format.channel_count == 0)
+		return;
+
+	size_t frames = size / (format.channel_count * sizeof(float));
+
+	// The list is only taken after the mix is marked as running, so that
+	// _PublishInputs() cannot miss it
+	atomic_set(&mixer->fMixing, 1);
+	BObjectList<MixerInput>* inputs = atomic_pointer_get(&mixer->fMixInputs);
+
+	// Stations playing loud at the same time, or raised to the level of the
+	// others, must not wrap around
+	bool clip = inputs->CountItems() > 1;
+	for (int32 i = 0; i < inputs->CountItems(); i++) {
+		MixerInput* input = inputs->ItemAt(i);
+		input->_MixInto((float*)buffer, frames, format.channel_count);
+		clip |= input->_Level() > 1.0f;
+	}
+
+	atomic_add(&mixer->fMixCount, 1);
+	atomic_set(&mixer->fMixing, 0);
+
+	if (clip)
+		PcmDsp::SoftClip((float*)buffer, frames * format.channel_count);
+}
@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef _AUDIO_MIXER_H
+#define _AUDIO_MIXER_H
+
+
+#include <Locker.h>
+#include <MediaDefs.h>
+#include <ObjectList.h>
+#include <SoundPlayer.h>
+#include <String.h>
+
+
+// Frames an input queues at most, about 190 ms at 44.1 kHz
+#define MIXER_QUEUE_FRAMES 8192
+
+// Channels of the queues and the mix
+#define MIXER_CHANNELS 2
+
+
+class AudioMixer;
+class LoudnessMeter;
+class Resampler;
+
+
+/**
+ * A source of the mix. A thread of its own pulls audio from the fill
+ * function, which has the signature of a BSoundPlayer one, converts it to
+ * stereo at the rate of the mix, and queues it for the mixer. The queue has a
+ * single reader and writer, and needs no lock.
+ */
+class MixerInput {
+public:
+	typedef void (*FillFunc)(
+		void* cookie, void* buffer, size_t size, const media_raw_audio_format& format);
+
+	MixerInput(AudioMixer* mixer, const media_raw_audio_format& format, const char* name,
+		FillFunc fill, void* cookie);
+	~MixerInput();
+
+	status_t InitCheck() const { return fInitStatus; }
+	const media_raw_audio_format& Format() const { return fFormat; }
+
+	status_t Start();
+	void Stop();
+
+	void SetGain(float gain);
+	float Gain() const { return fGain; }
+	void FadeTo(float gain, bigtime_t duration);
+
+	// Loudness normalization, measured on the feed thread
+	void SetNormalization(float loudness);
+	float Loudness() const;
+
+private:
+	friend class AudioMixer;
+
+	float _CurrentGain() const;
+	void _PostGain(int32 from, float to, size_t frames);
+	void _UpdateGain();
+	float _Level();
+	void _Convert(const void* data, size_t frames);
+	bool _ConvertFast(const void* data, size_t frames);
+	void _Measure(size_t frames);
+	void _Resample(size_t frames);
+	void _MixInto(float* output, size_t frames, uint32 channels);
+
+	static int32 _FeedThreadFunc(void* data);
+
+private:
+	status_t fInitStatus;
+	AudioMixer* fMixer;
+	media_raw_audio_format fFormat;
+	BString fName;
+	FillFunc fFill;
+	void* fCookie;
+	// The gain, or the one a fade ends with, and if no fade is running
+	float fGain;
+	bool fGainSettled;
+
+	// The last gain change, for the sound player's thread
+	int32 fGainSequence;
+	int32 fGainFrom;
+	int32 fGainTo;
+	int32 fGainFrames;
+
+	// The gain as the sound player's thread applies it
+	int32 fAppliedSequence;
+	float fFadeFrom;
+	float fFadeTo;
+	size_t fFadeLength;
+	size_t fFadePosition;
+	// The gain the last mixed frame had, for ramps
+	float fAppliedGain;
+
+	// Normalizes the input to the same loudness as the others, fMixLevel
+	// passes the level to the sound player's thread
+	LoudnessMeter* fMeter;
+	float fLevel;
+	int32 fMixLevel;
+	size_t fLevelFrames;
+
+	uint8* fDecoded;
+	float* fConverted;
+	size_t fFrames;
+
+	// Converts to the rate of the mix, if the input has another one
+	Resampler* fResampler;
+	float* fResampled;
+	size_t fChunkFrames;
+
+	float* fQueue;
+	int32 fQueueRead;
+	int32 fQueueWrite;
+
+	thread_id fFeedThread;
+	bool fQuit;
+};
+
+
+/**
+ * Plays any number of stations through one sound player, instead of each
+ * station having a media node of its own. The inputs are summed with their
+ * gain on the sound player's thread, which never waits for a station or takes
+ * a lock: inputs and gain changes are handed to it through atomics.
+ */
+class AudioMixer {
+public:
+	static AudioMixer* Default();
+
+	MixerInput* AddInput(const media_raw_audio_format& format, const char* name,
+		MixerInput::FillFunc fill, void* cookie);
+	void RemoveInput(MixerInput* input);
+
+	float FrameRate() const { return fFormat.frame_rate; }
+
+private:
+	friend class MixerInput;
+
+	AudioMixer();
+	~AudioMixer();
+
+	void _PublishInputs();
+	status_t _StartPlayer();
+
+	static void _MixFunc(
+		void* cookie, void* buffer, size_t size, const media_raw_audio_format& format);
+
+private:
+	BLocker fLock;
+	BObjectList<MixerInput> fInputs;
+
+	// What the sound player's thread mixes, replaced as a whole
+	BObjectList<MixerInput>* fMixInputs;
+	int32 fMixing;
+	int32 fMixCount;
+
+	BSoundPlayer* fPlayer;
+	media_raw_audio_format fFormat;
+
+	static BLocker sDefaultLock;
+	static AudioMixer* sDefault;
+};
+
+
+#endif	// _AUDIO_MIXER_H
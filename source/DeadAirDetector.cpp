@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "DeadAirDetector.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "PcmDsp.h"
+
+
+// Windows per second, which are analyzed as a whole
+static const int32 kWindowsPerSecond = 10;
+
+// Windows with no sample louder than this, -50 dBFS, are silent
+static const float kSilencePeak = 0.00316f;
+
+// Silence for this long is dead air
+static const int32 kSilenceWindows = 10 * kWindowsPerSecond;
+
+// Content repeats if the levels of this many windows match those one lag
+// earlier within kLevelTolerance dB, for nearly all of them
+static const int32 kMatchWindows = 10 * kWindowsPerSecond;
+static const int32 kLevelTolerance = 1;
+static const int32 kMatchesNeeded = kMatchWindows * 95 / 100;
+
+// Shortest loop looked for, and how loud its envelope must vary, so that
+// steady noise and tones are not taken for a loop
+static const int32 kMinLag = 3 * kWindowsPerSecond;
+static const int32 kMinLevelRange = 6;
+
+// Repeating for this long is dead air. Music made of loops repeats, too, but
+// hardly ever for minutes without change.
+static const int32 kLoopWindows = 180 * kWindowsPerSecond;
+
+// Samples converted at a time for analysis
+static const size_t kConvertSamples = 256;
+
+
+DeadAirDetector::DeadAirDetector(float frameRate, uint32 channels)
+	: fWindowSamples(size_t(frameRate / kWindowsPerSecond) * channels)
+{
+	Reset();
+}
+
+
+/**
+ * Analyzes a buffer of decoded audio, and returns whether the state changed.
+ * Formats other than float and 16 or 32 bit integers are not analyzed.
+ */
+bool
+DeadAirDetector::Process(const void* buffer, size_t size, const media_raw_audio_format& format)
+{
+	if (fWindowSamples == 0)
+		return false;
+
+	State state = fState;
+
+	switch (format.format) {
+		case media_raw_audio_format::B_AUDIO_FLOAT:
+			_Analyze((const float*)buffer, size / sizeof(float));
+			break;
+
+		case media_raw_audio_format::B_AUDIO_SHORT:
+		case media_raw_audio_format::B_AUDIO_INT:
+		{
+			// Converted in small pieces, so no memory is allocated here
+			bool isShort = format.format == media_raw_audio_format::B_AUDIO_SHORT;
+			size_t count = size / (isShort ? sizeof(int16) : sizeof(int32));
+			float samples[kConvertSamples];
+
+			for (size_t i = 0; i < count; i += kConvertSamples) {
+				size_t piece = min_c(count - i, kConvertSamples);
+				if (isShort)
+					PcmDsp::ConvertToFloat((const int16*)buffer + i, samples, piece);
+				else
+					PcmDsp::ConvertToFloat((const int32*)buffer + i, samples, piece);
+				_Analyze(samples, piece);
+			}
+			break;
+		}
+
+		default:
+			break;
+	}
+
+	return fState != state;
+}
+
+
+void
+DeadAirDetector::Reset()
+{
+	fState = Live;
+	fSamples = 0;
+	fEnergy = 0;
+	fPeak = 0;
+	fSilentWindows = 0;
+	fWindows = 0;
+	fLoopLag = 0;
+	fLoopWindows = 0;
+}
+
+
+void
+DeadAirDetector::_Analyze(const float* samples, size_t count)
+{
+	while (count > 0) {
+		size_t piece = min_c(count, fWindowSamples - fSamples);
+
+		fEnergy += PcmDsp::DotProduct(samples, samples, piece);
+		fPeak = max_c(fPeak, PcmDsp::Peak(samples, piece));
+		fSamples += piece;
+		if (fSamples == fWindowSamples)
+			_EndWindow();
+
+		samples += piece;
+		count -= piece;
+	}
+}
+
+
+/**
+ * Keeps the level of the window that ended, and looks for dead air once a
+ * second.
+ */
+void
+DeadAirDetector::_EndWindow()
+{
+	double level = fEnergy > 0 ? 10 * log10(fEnergy / fSamples) : -100;
+	fLevels[fWindows % DEAD_AIR_HISTORY] = (int8)max_c(level, -100.0);
+	fWindows++;
+
+	if (fPeak < kSilencePeak)
+		fSilentWindows++;
+	else
+		fSilentWindows = 0;
+
+	fSamples = 0;
+	fEnergy = 0;
+	fPeak = 0;
+
+	if (fWindows % kWindowsPerSecond != 0)
+		return;
+
+	if (fSilentWindows >= kSilenceWindows) {
+		fState = Silence;
+		return;
+	}
+
+	// A loop found before must go on, or another one is looked for
+	if (fLoopLag > 0 && _Matches(fLoopLag))
+		fLoopWindows += kWindowsPerSecond;
+	else if (!_FindLoop())
+		fLoopLag = fLoopWindows = 0;
+
+	fState = fLoopWindows >= kLoopWindows ? Loop : Live;
+}
+
+
+bool
+DeadAirDetector::_FindLoop()
+{
+	int32 maxLag = min_c(fWindows, DEAD_AIR_HISTORY) - kMatchWindows;
+
+	int8 lowest = 0;
+	int8 highest = -100;
+	for (int32 i = 0; i < kMatchWindows && i < fWindows; i++) {
+		lowest = min_c(lowest, _Level(i));
+		highest = max_c(highest, _Level(i));
+	}
+	if (highest - lowest < kMinLevelRange)
+		return false;
+
+	for (int32 lag = kMinLag; lag <= maxLag; lag++) {
+		if (_Matches(lag)) {
+			fLoopLag = lag;
+			fLoopWindows = kMatchWindows;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+bool
+DeadAirDetector::_Matches(int32 lag) const
+{
+	int32 misses = 0;
+	for (int32 i = 0; i < kMatchWindows; i++) {
+		if (abs(_Level(i) - _Level(i + lag)) > kLevelTolerance
+			&& ++misses > kMatchWindows - kMatchesNeeded)
+			return false;
+	}
+
+	return true;
+}
+
+
+int8
+DeadAirDetector::_Level(int32 windowsAgo) const
+{
+	return fLevels[(fWindows - 1 - windowsAgo) % DEAD_AIR_HISTORY];
+}
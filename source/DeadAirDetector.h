@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef _DEAD_AIR_DETECTOR_H
+#define _DEAD_AIR_DETECTOR_H
+
+
+#include <MediaDefs.h>
+#include <SupportDefs.h>
+
+
+// Windows of 100 ms kept for finding repeated content, two minutes
+#define DEAD_AIR_HISTORY 1200
+
+
+/**
+ * Tells whether a station that plays actually sends something: digital
+ * silence, or the same content over and over, like a looped "stream offline"
+ * announcement, is dead air. Decoded audio is reduced to the peak and level
+ * of windows of 100 ms, and the levels of the last two minutes are compared
+ * for a repeating envelope. That is a few operations per sample, and a search
+ * over the levels once a second.
+ */
+class DeadAirDetector {
+public:
+	enum State {
+		Live = 0,
+		Silence,
+		Loop
+	};
+
+	DeadAirDetector(float frameRate, uint32 channels);
+
+	bool Process(const void* buffer, size_t size, const media_raw_audio_format& format);
+	void Reset();
+
+	inline State GetState() const { return fState; }
+
+private:
+	void _Analyze(const float* samples, size_t count);
+	void _EndWindow();
+	bool _FindLoop();
+	bool _Matches(int32 lag) const;
+	inline int8 _Level(int32 windowsAgo) const;
+
+private:
+	State fState;
+	size_t fWindowSamples;
+
+	// The window being analyzed
+	size_t fSamples;
+	double fEnergy;
+	float fPeak;
+
+	int32 fSilentWindows;
+
+	// Levels in dB of the last windows, the latest at fWindows - 1
+	int8 fLevels[DEAD_AIR_HISTORY];
+	int32 fWindows;
+
+	// The distance in windows at which the content repeats, and how long
+	int32 fLoopLag;
+	int32 fLoopWindows;
+};
+
+
+#endif	// _DEAD_AIR_DETECTOR_H
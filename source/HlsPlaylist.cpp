@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "HlsPlaylist.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <DataIO.h>
+
+#include "HttpUtils.h"
+#include "Playlist.h"
+
+
+// Assumed if a media playlist does not tell how long its segments are
+static const bigtime_t kDefaultTargetDuration = 10000000;
+
+
+HlsPlaylist::HlsPlaylist()
+	: fMediaSequence(0),
+	  fTargetDuration(kDefaultTargetDuration),
+	  fEnded(false)
+{
+}
+
+
+/**
+ * Reads a master or media playlist, url is the one it was loaded from. Streams
+ * with encrypted segments are not supported.
+ */
+status_t
+HlsPlaylist::Parse(const char* body, const BUrl& url)
+{
+	fUrl = url;
+	fVariants.MakeEmpty();
+	fBandwidths.clear();
+	fSegments.MakeEmpty();
+	fMediaSequence = 0;
+	fTargetDuration = kDefaultTargetDuration;
+	fEnded = false;
+
+	BString line;
+	body = Playlist::NextLine(body, &line);
+	if (line.StartsWith("\xef\xbb\xbf"))
+		line.Remove(0, 3);
+
+	if (body == NULL || !line.StartsWith("#EXTM3U"))
+		return B_BAD_DATA;
+
+	BString streamInfo;
+	bool isVariant = false;
+	while ((body = Playlist::NextLine(body, &line)) != NULL) {
+		if (line.StartsWith("#EXT-X-STREAM-INF:")) {
+			streamInfo.SetTo(line.String() + 18);
+			isVariant = true;
+		} else if (line.StartsWith("#EXT-X-TARGETDURATION:"))
+			fTargetDuration = bigtime_t(strtod(line.String() + 22, NULL) * 1000000);
+		else if (line.StartsWith("#EXT-X-MEDIA-SEQUENCE:"))
+			fMediaSequence = strtoll(line.String() + 22, NULL, 10);
+		else if (line == "#EXT-X-ENDLIST")
+			fEnded = true;
+		else if (line.StartsWith("#EXT-X-KEY:")) {
+			if (_Attribute(line.String() + 11, "METHOD") != "NONE")
+				return B_NOT_SUPPORTED;
+		} else if (!line.IsEmpty() && !line.StartsWith("#")) {
+			BUrl entry(url, line);
+			if (!entry.IsValid())
+				isVariant = false;
+			else if (isVariant) {
+				fVariants.Add(entry.UrlString());
+				fBandwidths.push_back(
+					strtoul(_Attribute(streamInfo.String(), "BANDWIDTH").String(), NULL, 10));
+				isVariant = false;
+			} else
+				fSegments.Add(entry.UrlString());
+		}
+	}
+
+	if (fTargetDuration <= 0)
+		fTargetDuration = kDefaultTargetDuration;
+
+	return fVariants.IsEmpty() && fSegments.IsEmpty() ? B_BAD_DATA : B_OK;
+}
+
+
+/**
+ * Loads the media playlist at url. For a master playlist, the media playlist
+ * of the variant picked by SelectVariant() is loaded.
+ */
+status_t
+HlsPlaylist::Load(const BUrl& url, bigtime_t timeout)
+{
+	status_t status = _Fetch(url, timeout);
+	if (status == B_OK && IsMaster())
+		status = _Fetch(SelectVariant(), timeout);
+
+	if (status == B_OK && IsMaster())
+		return B_BAD_DATA;
+
+	return status;
+}
+
+
+/**
+ * Returns the variant with the highest bandwidth up to maxBandwidth, or the one
+ * with the lowest bandwidth if all of them need more.
+ */
+BUrl
+HlsPlaylist::SelectVariant(uint32 maxBandwidth) const
+{
+	int32 best = -1;
+	int32 lowest = -1;
+	for (int32 i = 0; i < fVariants.CountStrings(); i++) {
+		uint32 bandwidth = fBandwidths[i];
+		if (lowest < 0 || bandwidth < fBandwidths[lowest])
+			lowest = i;
+
+		if (bandwidth <= maxBandwidth && (best < 0 || bandwidth > fBandwidths[best]))
+			best = i;
+	}
+
+	if (best < 0)
+		best = lowest;
+
+	if (best < 0)
+		return BUrl();
+
+	return BUrl(fVariants.StringAt(best));
+}
+
+
+/**
+ * Tells whether body is an HLS playlist rather than a plain M3U playlist.
+ */
+bool
+HlsPlaylist::IsHls(const char* body)
+{
+	return strstr(body, "#EXTM3U") != NULL
+		&& (strstr(body, "#EXT-X-TARGETDURATION") != NULL
+			|| strstr(body, "#EXT-X-STREAM-INF") != NULL);
+}
+
+
+bool
+HlsPlaylist::IsHlsUrl(const BUrl& url)
+{
+	return url.Path().IEndsWith(".m3u8");
+}
+
+
+status_t
+HlsPlaylist::_Fetch(const BUrl& url, bigtime_t timeout)
+{
+	BString contentType;
+	BMallocIO* data = HttpUtils::GetAll(url, NULL, timeout, &contentType, HLS_MAX_PLAYLIST_SIZE);
+	if (data == NULL)
+		return B_ERROR;
+
+	data->Write("", 1);
+	status_t status = Parse((const char*)data->Buffer(), url);
+	delete data;
+
+	return status;
+}
+
+
+/**
+ * Returns the value of the attribute name from an attribute list like
+ * BANDWIDTH=128000,CODECS="mp4a.40.2". Quoted values may contain commas.
+ */
+BString
+HlsPlaylist::_Attribute(const char* attributes, const char* name)
+{
+	size_t nameLength = strlen(name);
+	const char* attribute = attributes;
+	while (*attribute != '\0') {
+		const char* equals = strchr(attribute, '=');
+		if (equals == NULL)
+			break;
+
+		const char* value = equals + 1;
+		const char* end;
+		const char* next;
+		if (*value == '"') {
+			value++;
+			end = value + strcspn(value, "\"");
+			next = *end != '\0' ? end + 1 : end;
+		} else {
+			end = value + strcspn(value, ",");
+			next = end;
+		}
+
+		if (size_t(equals - attribute) == nameLength
+			&& strncasecmp(attribute, name, nameLength) == 0)
+			return BString(value, end - value);
+
+		attribute = next + strspn(next, ", ");
+	}
+
+	return BString();
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef _HLS_PLAYLIST_H
+#define _HLS_PLAYLIST_H
+
+
+#include <String.h>
+#include <StringList.h>
+#include <Url.h>
+
+#include <vector>
+
+
+// Playlists larger than this are not read
+#define HLS_MAX_PLAYLIST_SIZE 0x40000
+
+// Bits per second of the variant picked at most, if there is a choice
+#define HLS_MAX_BANDWIDTH 320000
+
+
+/**
+ * A master or media playlist of an HTTP Live Streaming stream. A master
+ * playlist lists variants of the stream in different bit rates, a media
+ * playlist the segments of one of them that are currently available.
+ */
+class HlsPlaylist {
+public:
+	HlsPlaylist();
+
+	status_t Parse(const char* body, const BUrl& url);
+	status_t Load(const BUrl& url, bigtime_t timeout);
+
+	inline const BUrl& Url() const { return fUrl; }
+
+	inline bool IsMaster() const { return !fVariants.IsEmpty(); }
+	BUrl SelectVariant(uint32 maxBandwidth = HLS_MAX_BANDWIDTH) const;
+
+	inline int64 MediaSequence() const { return fMediaSequence; }
+	inline bigtime_t TargetDuration() const { return fTargetDuration; }
+	inline bool IsEnded() const { return fEnded; }
+
+	inline int32 CountSegments() const { return fSegments.CountStrings(); }
+	inline BUrl SegmentAt(int32 index) const { return BUrl(fSegments.StringAt(index)); }
+
+	static bool IsHls(const char* body);
+	static bool IsHlsUrl(const BUrl& url);
+
+private:
+	status_t _Fetch(const BUrl& url, bigtime_t timeout);
+
+	static BString _Attribute(const char* attributes, const char* name);
+
+private:
+	BUrl fUrl;
+	BStringList fVariants;
+	std::vector<uint32> fBandwidths;
+	BStringList fSegments;
+	int64 fMediaSequence;
+	bigtime_t fTargetDuration;
+	bool fEnded;
+};
+
+
+#endif	// _HLS_PLAYLIST_H
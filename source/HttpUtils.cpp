@@ -20,6 +20,9 @@
 #include <DataIO.h>
 #include <NetworkAddressResolver.h>
 
+#include <algorithm>
+#include <vector>
+
 #include "Debug.h"
 #include "HttpUtils.h"
 #include "Utils.h"
@@ -107,6 +110,116 @@ HttpUtils::CheckPort(BUrl url, BUrl* newUrl, uint32 flags)
 }
 
 
+/**
+ * Returns the time it takes to resolve the host of url and connect to it, or
+ * an error if that does not succeed within timeout.
+ */
+bigtime_t
+HttpUtils::ConnectLatency(const BUrl& url, bigtime_t timeout)
+{
+	uint16 port;
+	if (url.HasPort())
+		port = url.Port();
+	else
+		port = url.Protocol() == "https" ? 443 : 80;
+
+	bigtime_t start = system_time();
+	BReference<const BNetworkAddressResolver> resolver
+		= BNetworkAddressResolver::Resolve(url.Host(), port);
+	if (resolver.Get() == NULL)
+		return B_NO_MEMORY;
+	status_t status = resolver->InitCheck();
+	if (status != B_OK)
+		return status;
+
+	BNetworkAddress address;
+	uint32 cookie = 0;
+	status = resolver->GetNextAddress(&cookie, address);
+	if (status != B_OK)
+		return status;
+
+	bigtime_t remaining = timeout - (system_time() - start);
+	if (remaining <= 0)
+		return B_TIMED_OUT;
+
+	BSocket socket;
+	status = socket.Connect(address, remaining);
+	if (status != B_OK)
+		return status;
+
+	return system_time() - start;
+}
+
+
+class LatencyProbe {
+public:
+	BUrl fUrl;
+	bigtime_t fTimeout;
+	bigtime_t fLatency;
+	int32 fIndex;
+
+	static int32 _MeasureThreadFunc(void* data)
+	{
+		LatencyProbe* probe = (LatencyProbe*)data;
+		probe->fLatency = HttpUtils::ConnectLatency(probe->fUrl, probe->fTimeout);
+		return B_OK;
+	}
+
+	bool operator<(const LatencyProbe& other) const
+	{
+		// Unreachable ones go last, in their original order
+		if ((fLatency < 0) != (other.fLatency < 0))
+			return fLatency >= 0;
+		if (fLatency < 0)
+			return fIndex < other.fIndex;
+		return fLatency < other.fLatency;
+	}
+};
+
+
+/**
+ * Orders urls by the time it takes to connect to them, measured for all of
+ * them at the same time. Those that cannot be reached within timeout go last.
+ */
+void
+HttpUtils::SortByLatency(BStringList* urls, bigtime_t timeout)
+{
+	int32 count = urls->CountStrings();
+	if (count < 2)
+		return;
+
+	std::vector<LatencyProbe> probes(count);
+	std::vector<thread_id> threads(count);
+	for (int32 i = 0; i < count; i++) {
+		probes[i].fUrl.SetUrlString(urls->StringAt(i));
+		probes[i].fTimeout = timeout;
+		probes[i].fLatency = B_ERROR;
+		probes[i].fIndex = i;
+
+		threads[i] = spawn_thread(
+			&LatencyProbe::_MeasureThreadFunc, "latency probe", B_LOW_PRIORITY, &probes[i]);
+		if (threads[i] >= 0)
+			resume_thread(threads[i]);
+	}
+
+	for (int32 i = 0; i < count; i++) {
+		if (threads[i] >= 0) {
+			status_t status;
+			wait_for_thread(threads[i], &status);
+		}
+
+		TRACE("Mirror %s: %" B_PRIdBIGTIME " us\n", urls->StringAt(i).String(),
+			probes[i].fLatency);
+	}
+
+	std::sort(probes.begin(), probes.end());
+
+	urls->MakeEmpty();
+	for (int32 i = 0; i < count; i++)
+		urls->Add(probes[i].fUrl.UrlString());
+}
+
+
 /**
  * Helper to make Http request and return body
  * @param url           Url to request
@@ -30,6 +30,8 @@ using namespace BPrivate::Network;
 class HttpUtils {
 public:
 	static status_t CheckPort(BUrl url, BUrl* newUrl, uint32 flags = 0);
+	static bigtime_t ConnectLatency(const BUrl& url, bigtime_t timeout);
+	static void SortByLatency(BStringList* urls, bigtime_t timeout);
 
 	static BMallocIO* GetAll(BUrl url, BHttpHeaders* returnHeaders = NULL, bigtime_t timeOut = 3000,
 		BString* contentType = NULL, size_t sizeLimit = 0);
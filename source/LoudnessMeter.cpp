@@ -0,0 +1,251 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "LoudnessMeter.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "PcmDsp.h"
+
+
+// Blocks are measured every 100 ms, each over the last 400 ms
+static const size_t kStepsPerBlock = 4;
+static const double kStepsPerSecond = 10;
+
+// Gated at this much below the mean of the blocks above the absolute gate
+static const double kRelativeGate = -10;
+
+static const uint32 kBinCount = (LOUDNESS_MAX - LOUDNESS_GATE) * LOUDNESS_BINS_PER_LU;
+
+
+static inline double
+energy_to_loudness(double energy)
+{
+	return -0.691 + 10 * log10(energy);
+}
+
+
+static inline double
+loudness_to_energy(double loudness)
+{
+	return pow(10, (loudness + 0.691) / 10);
+}
+
+
+static inline double
+bin_loudness(uint32 bin)
+{
+	return LOUDNESS_GATE + (bin + 0.5) / LOUDNESS_BINS_PER_LU;
+}
+
+
+LoudnessMeter::LoudnessMeter(float frameRate, uint32 channels, uint32 frameSamples)
+	: fInitStatus(B_NO_INIT),
+	  fChannels(channels),
+	  fFrameSamples(frameSamples != 0 ? frameSamples : channels),
+	  fStepFrames(0),
+	  fState(NULL),
+	  fFiltered(NULL),
+	  fStep(0),
+	  fStepFilled(0),
+	  fBlocks(0)
+{
+	if (frameRate <= 0 || channels == 0 || fFrameSamples < channels) {
+		fInitStatus = B_BAD_VALUE;
+		return;
+	}
+
+	fStepFrames = size_t(frameRate / kStepsPerSecond + 0.5);
+
+	// The K-weighting filters of BS.1770, for any sample rate
+	double k = tan(M_PI * 1681.974450955533 / frameRate);
+	double q = 0.7071752369554196;
+	double vh = pow(10, 3.999843853973347 / 20);
+	double vb = pow(vh, 0.4996667741545416);
+	double a0 = 1 + k / q + k * k;
+	fShelf.b0 = (vh + vb * k / q + k * k) / a0;
+	fShelf.b1 = 2 * (k * k - vh) / a0;
+	fShelf.b2 = (vh - vb * k / q + k * k) / a0;
+	fShelf.a1 = 2 * (k * k - 1) / a0;
+	fShelf.a2 = (1 - k / q + k * k) / a0;
+
+	k = tan(M_PI * 38.13547087602444 / frameRate);
+	q = 0.5003270373238773;
+	a0 = 1 + k / q + k * k;
+	fHighPass.b0 = 1;
+	fHighPass.b1 = -2;
+	fHighPass.b2 = 1;
+	fHighPass.a1 = 2 * (k * k - 1) / a0;
+	fHighPass.a2 = (1 - k / q + k * k) / a0;
+
+	fState = (double*)malloc(channels * 4 * sizeof(double));
+	fFiltered = (float*)malloc(fStepFrames * sizeof(float));
+	if (fState == NULL || fFiltered == NULL) {
+		fInitStatus = B_NO_MEMORY;
+		return;
+	}
+
+	Reset();
+	fInitStatus = B_OK;
+}
+
+
+LoudnessMeter::~LoudnessMeter()
+{
+	free(fState);
+	free(fFiltered);
+}
+
+
+/**
+ * Measures frames of input, which are filtered channel by channel a step at
+ * most at a time.
+ */
+void
+LoudnessMeter::Process(const float* input, size_t frames)
+{
+	while (frames > 0) {
+		size_t count = min_c(frames, fStepFrames - fStepFilled);
+
+		double energy = 0;
+		for (uint32 c = 0; c < fChannels; c++) {
+			double* state = fState + c * 4;
+			_Filter(fShelf, state, input + c, fFrameSamples, fFiltered, count);
+			_Filter(fHighPass, state + 2, fFiltered, 1, fFiltered, count);
+			energy += PcmDsp::DotProduct(fFiltered, fFiltered, count);
+		}
+
+		fStepEnergy[fStep % kStepsPerBlock] += energy;
+		fStepFilled += count;
+		if (fStepFilled == fStepFrames)
+			_AddBlock();
+
+		input += count * fFrameSamples;
+		frames -= count;
+	}
+}
+
+
+void
+LoudnessMeter::Reset()
+{
+	memset(fState, 0, fChannels * 4 * sizeof(double));
+	memset(fStepEnergy, 0, sizeof(fStepEnergy));
+	memset(fHistogram, 0, sizeof(fHistogram));
+	fStep = 0;
+	fStepFilled = 0;
+	fBlocks = 0;
+}
+
+
+/**
+ * Returns the gated loudness of what was measured so far, or 0 if nothing was
+ * above the absolute gate.
+ */
+float
+LoudnessMeter::IntegratedLoudness() const
+{
+	if (fBlocks == 0)
+		return 0;
+
+	double sum = 0;
+	for (uint32 i = 0; i < kBinCount; i++) {
+		if (fHistogram[i] > 0)
+			sum += fHistogram[i] * loudness_to_energy(bin_loudness(i));
+	}
+
+	double gate = energy_to_loudness(sum / fBlocks) + kRelativeGate;
+
+	sum = 0;
+	uint32 count = 0;
+	for (uint32 i = 0; i < kBinCount; i++) {
+		if (fHistogram[i] > 0 && bin_loudness(i) > gate) {
+			sum += fHistogram[i] * loudness_to_energy(bin_loudness(i));
+			count += fHistogram[i];
+		}
+	}
+
+	if (count == 0)
+		return 0;
+
+	return energy_to_loudness(sum / count);
+}
+
+
+/**
+ * Returns how much of the audio was loud enough to be measured.
+ */
+bigtime_t
+LoudnessMeter::MeasuredTime() const
+{
+	return bigtime_t(fBlocks * 1000000 / kStepsPerSecond);
+}
+
+
+/**
+ * Filters every stride sample of input into output, in transposed direct form
+ * with the state kept in double precision. Output may be input.
+ */
+void
+LoudnessMeter::_Filter(const Biquad& filter, double* state, const float* input, size_t stride,
+	float* output, size_t frames)
+{
+	double z1 = state[0];
+	double z2 = state[1];
+
+	for (size_t i = 0; i < frames; i++) {
+		double x = input[i * stride];
+		double y = filter.b0 * x + z1;
+		z1 = filter.b1 * x - filter.a1 * y + z2;
+		z2 = filter.b2 * x - filter.a2 * y;
+		output[i] = y;
+	}
+
+	state[0] = z1;
+	state[1] = z2;
+}
+
+
+/**
+ * Ends a step, and counts the block ending with it once there are enough
+ * steps for one.
+ */
+void
+LoudnessMeter::_AddBlock()
+{
+	fStep++;
+	fStepFilled = 0;
+
+	if (fStep >= kStepsPerBlock) {
+		double energy = 0;
+		for (size_t i = 0; i < kStepsPerBlock; i++)
+			energy += fStepEnergy[i];
+		energy /= fStepFrames * kStepsPerBlock;
+
+		double loudness = energy > 0 ? energy_to_loudness(energy) : LOUDNESS_GATE;
+		if (loudness > LOUDNESS_GATE) {
+			uint32 bin = uint32((loudness - LOUDNESS_GATE) * LOUDNESS_BINS_PER_LU);
+			fHistogram[min_c(bin, kBinCount - 1)]++;
+			fBlocks++;
+		}
+	}
+
+	fStepEnergy[fStep % kStepsPerBlock] = 0;
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef _LOUDNESS_METER_H
+#define _LOUDNESS_METER_H
+
+
+#include <SupportDefs.h>
+
+
+// Block loudness is kept in a histogram of this resolution, from the absolute
+// gate up to the loudest level a block can have.
+#define LOUDNESS_BINS_PER_LU 10
+#define LOUDNESS_GATE -70
+#define LOUDNESS_MAX 5
+
+
+/**
+ * Measures the integrated loudness of interleaved float audio in LUFS, as EBU
+ * R128 and ITU-R BS.1770 define it: K-weighted mean square over blocks of
+ * 400 ms overlapping by 75%, gated at -70 LUFS and 10 LU below the ungated
+ * mean. Blocks are counted in a histogram, so a meter takes the same memory
+ * however long it runs.
+ * The input may have more channels interleaved than are measured, as a mono
+ * source upmixed to stereo has: only the first channels of every frameSamples
+ * samples count, so that the source is not measured 3 LU louder.
+ */
+class LoudnessMeter {
+public:
+	LoudnessMeter(float frameRate, uint32 channels, uint32 frameSamples = 0);
+	~LoudnessMeter();
+
+	status_t InitCheck() const { return fInitStatus; }
+
+	void Process(const float* input, size_t frames);
+	void Reset();
+
+	float IntegratedLoudness() const;
+	bigtime_t MeasuredTime() const;
+
+private:
+	struct Biquad {
+		double b0, b1, b2, a1, a2;
+	};
+
+	void _Filter(const Biquad& filter, double* state, const float* input, size_t stride,
+		float* output, size_t frames);
+	void _AddBlock();
+
+private:
+	status_t fInitStatus;
+	uint32 fChannels;
+	uint32 fFrameSamples;
+	size_t fStepFrames;
+
+	// High shelf and high pass of the K-weighting, and their state per channel
+	Biquad fShelf;
+	Biquad fHighPass;
+	double* fState;
+
+	// One channel of filtered audio, up to a step
+	float* fFiltered;
+
+	// Weighted energy of the last four steps, which make up a block
+	double fStepEnergy[4];
+	size_t fStep;
+	size_t fStepFilled;
+
+	uint32 fHistogram[(LOUDNESS_MAX - LOUDNESS_GATE) * LOUDNESS_BINS_PER_LU];
+	uint32 fBlocks;
+};
+
+
+#endif	// _LOUDNESS_METER_H
@@ -32,10 +32,14 @@
 #include <LayoutBuilder.h>
 #include <MenuBar.h>
 #include <MenuItem.h>
+#include <MessageRunner.h>
 #include <ScrollView.h>
 #include <Url.h>
 #include <View.h>
 
+#include <string.h>
+
+#include "DeadAirDetector.h"
 #include "Debug.h"
 #include "RadioApp.h"
 
@@ -44,6 +48,22 @@
 #define B_TRANSLATION_CONTEXT "MainWindow"
 
 
+// Number of recently played stations kept on standby
+const int32 kMaxRecentStations = 2;
+
+// Time rewound at a time
+const bigtime_t kRewindStep = 30000000;
+
+
+static void
+AddCandidate(BObjectList<Station>* candidates, StationListViewItem* item)
+{
+	// Playing stations need no standby
+	if (item != NULL && item->Player() == NULL && !candidates->HasItem(item->GetStation()))
+		candidates->AddItem(item->GetStation());
+}
+
+
 MainWindow::MainWindow()
 	: BWindow(BRect(0, 0, 400, 200), B_TRANSLATE_SYSTEM_NAME("StreamRadio"), B_DOCUMENT_WINDOW,
 		B_AUTO_UPDATE_SIZE_LIMITS),
@@ -56,10 +76,48 @@ MainWindow::MainWindow()
 		B_TRANSLATE("Allow parallel playback"), new BMessage(MSG_PARALLEL_PLAYBACK));
 	fMenuParallelPlayback->SetMarked(fAllowParallelPlayback);
 
+	fPreconnect = fSettings->GetPreconnect();
+	fMenuPreconnect = new BMenuItem(
+		B_TRANSLATE("Pre-connect likely stations"), new BMessage(MSG_PRECONNECT));
+	fMenuPreconnect->SetMarked(fPreconnect);
+
+	fTimeShift = fSettings->GetTimeShift();
+	fMenuTimeShift = new BMenuItem(
+		B_TRANSLATE("Keep stations for rewinding"), new BMessage(MSG_TIME_SHIFT));
+	fMenuTimeShift->SetMarked(fTimeShift);
+
+	fCrossfade = fSettings->GetCrossfade();
+	fMenuCrossfade = new BMenuItem(
+		B_TRANSLATE("Crossfade between stations"), new BMessage(MSG_CROSSFADE));
+	fMenuCrossfade->SetMarked(fCrossfade);
+	fIncomingPlayer = NULL;
+	fOutgoingPlayer = NULL;
+	fCrossfadeSerial = 0;
+
+	fNormalizeLoudness = fSettings->GetNormalizeLoudness();
+	fMenuNormalize = new BMenuItem(
+		B_TRANSLATE("Play stations equally loud"), new BMessage(MSG_NORMALIZE));
+	fMenuNormalize->SetMarked(fNormalizeLoudness);
+
+	fDeadAirFailover = fSettings->GetDeadAirFailover();
+	fMenuDeadAirFailover = new BMenuItem(
+		B_TRANSLATE("Reconnect stations on dead air"), new BMessage(MSG_DEAD_AIR_FAILOVER));
+	fMenuDeadAirFailover->SetMarked(fDeadAirFailover);
+
+	_UpdateOutput();
+
+	fMenuPause = new BMenuItem(B_TRANSLATE("Pause"), new BMessage(MSG_PAUSE), 'P');
+	fMenuRewind = new BMenuItem(B_TRANSLATE("Rewind 30 seconds"), new BMessage(MSG_REWIND));
+	fMenuTrackStart
+		= new BMenuItem(B_TRANSLATE("Back to start of title"), new BMessage(MSG_TRACK_START));
+	fMenuLive = new BMenuItem(B_TRANSLATE("Back to live"), new BMessage(MSG_GO_LIVE));
+	fMenuRecord = new BMenuItem(B_TRANSLATE("Record"), new BMessage(MSG_RECORD));
+
 	fMainMenu = new BMenuBar(Bounds(), "MainMenu");
 	BLayoutBuilder::Menu<>(fMainMenu)
 		.AddMenu(B_TRANSLATE("App"))
 		.AddItem(fMenuParallelPlayback)
+		.AddItem(fMenuPreconnect)
 		.AddItem(B_TRANSLATE("Help" B_UTF8_ELLIPSIS), MSG_HELP)
 		.AddItem(B_TRANSLATE("About"), B_ABOUT_REQUESTED)
 		.AddSeparator()
@@ -68,8 +126,22 @@ MainWindow::MainWindow()
 		.AddMenu(B_TRANSLATE("Station"))
 		.AddItem(B_TRANSLATE("Paste Shoutcast URL"), MSG_PASTE_URL, 'V')
 		.AddItem(B_TRANSLATE("Check station"), MSG_CHECK)
+		.AddItem(B_TRANSLATE("Check all stations"), MSG_CHECK_ALL)
 		.AddItem(B_TRANSLATE("Remove station"), MSG_REMOVE, 'R')
 		.End()
+		.AddMenu(B_TRANSLATE("Playback"))
+		.AddItem(fMenuPause)
+		.AddItem(fMenuRewind)
+		.AddItem(fMenuTrackStart)
+		.AddItem(fMenuLive)
+		.AddSeparator()
+		.AddItem(fMenuRecord)
+		.AddSeparator()
+		.AddItem(fMenuTimeShift)
+		.AddItem(fMenuCrossfade)
+		.AddItem(fMenuNormalize)
+		.AddItem(fMenuDeadAirFailover)
+		.End()
 		.AddMenu(B_TRANSLATE("Search"))
 		.AddItem(B_TRANSLATE("Find stations" B_UTF8_ELLIPSIS), MSG_SEARCH, 'S')
 		.End()
@@ -82,6 +154,9 @@ MainWindow::MainWindow()
 
 	fStatusBar = new BStringView("status", B_EMPTY_STRING);
 
+	fStationChecker = new StationChecker(BMessenger(this));
+	fStandby = new PlayerStandby();
+
 	BLayoutBuilder::Group<>(this, B_VERTICAL)
 		.Add(fMainMenu)
 		.AddGroup(B_VERTICAL)
@@ -110,6 +185,9 @@ MainWindow::MainWindow()
 
 MainWindow::~MainWindow()
 {
+	delete fStationChecker;
+	delete fStandby;
+
 	for (int32 i = 0; i < fStationList->CountItems(); i++) {
 		StationListViewItem* stationItem = fStationList->ItemAt(i);
 		StreamPlayer* player = stationItem->Player();
@@ -196,23 +274,68 @@ MainWindow::MessageReceived(BMessage* message)
 		{
 			StationListViewItem* stationItem
 				= fStationList->ItemAt(fStationList->CurrentSelection(0));
+			if (stationItem != NULL)
+				fStationChecker->Check(stationItem->GetStation());
+
+			break;
+		}
+
+		case MSG_CHECK_ALL:
+		{
+			if (fStationChecker->Check(fSettings->Stations) == B_OK)
+				fStatusBar->SetText(B_TRANSLATE("Checking stations" B_UTF8_ELLIPSIS));
+
+			break;
+		}
+
+		case MSG_STATION_CHECKED:
+		{
+			Station* station = NULL;
+			BMessage result;
+			if (message->FindPointer("station", (void**)&station) != B_OK
+				|| !fSettings->Stations->HasItem(station)
+				|| message->FindMessage("result", &result) != B_OK)
+				break;
+
+			station->ApplyProbeResult(&result);
+
+			int32 total = message->GetInt32("total", 1);
+			BString statusText;
+			if (total > 1) {
+				statusText = B_TRANSLATE("Checked %done% of %total% stations");
+				statusText.ReplaceFirst("%done%", BString() << message->GetInt32("done", 0));
+				statusText.ReplaceFirst("%total%", BString() << total);
+			} else if (message->GetInt32("status", B_ERROR) == B_OK)
+				statusText = B_TRANSLATE("Probing station %station% successful");
+			else
+				statusText = B_TRANSLATE("Probing station %station% failed");
+
+			statusText.ReplaceFirst("%station%", station->Name()->String());
+			fStatusBar->SetText(statusText);
+
+			StationListViewItem* stationItem = fStationList->Item(station);
 			if (stationItem != NULL) {
-				Station* station = stationItem->GetStation();
-				status_t stationStatus = station->Probe();
+				int32 index = fStationList->IndexOf(stationItem);
+				fStationList->InvalidateItem(index);
+				if (index == fStationList->CurrentSelection())
+					fStationPanel->SetStation(stationItem);
+			}
 
-				BString statusText;
-				if (stationStatus == B_OK) {
-					statusText = B_TRANSLATE("Probing station %station% successful");
-				} else {
-					statusText = B_TRANSLATE("Probing station %station% failed");
-				}
+			break;
+		}
 
-				statusText.ReplaceFirst("%station%", station->Name()->String());
+		case MSG_STATION_CHECK_DONE:
+		{
+			int32 total = message->GetInt32("total", 0);
+			if (total > 1) {
+				BString statusText(
+					B_TRANSLATE("Checked %total% stations, %failed% did not respond"));
+				statusText.ReplaceFirst("%total%", BString() << total);
+				statusText.ReplaceFirst("%failed%", BString() << message->GetInt32("failed", 0));
 				fStatusBar->SetText(statusText);
-				fStationList->Invalidate();
-				fStationPanel->SetStation(stationItem);
 			}
 
+			fSettings->Stations->Save();
 			break;
 		}
 
@@ -220,9 +343,11 @@ MainWindow::MessageReceived(BMessage* message)
 		{
 			Station* station = fStationList->StationAt(fStationList->CurrentSelection(0));
 			if (station != NULL) {
+				fRecentStations.RemoveItem(station);
 				fSettings->Stations->RemoveItem(station);
 				fStationList->Sync(fSettings->Stations);
 				fSettings->Stations->Save();
+				_UpdateStandby();
 			}
 
 			break;
@@ -230,9 +355,15 @@ MainWindow::MessageReceived(BMessage* message)
 
 		case MSG_ADD_STATION:
 		{
+			// The finder hands over ownership of the station, with no lookups
+			// running on it anymore
 			Station* station = NULL;
 			if (message->FindPointer("station", (void**)&station) == B_OK) {
-				fSettings->Stations->AddItem(station);
+				if (!fSettings->Stations->AddItem(station)) {
+					delete station;
+					break;
+				}
+
 				fStationList->Sync(fSettings->Stations);
 				fSettings->Stations->Save();
 			}
@@ -253,6 +384,8 @@ MainWindow::MessageReceived(BMessage* message)
 				fStationPanel->UnlockLooper();
 			}
 
+			_UpdateStandby();
+
 			break;
 		}
 
@@ -273,12 +406,42 @@ MainWindow::MessageReceived(BMessage* message)
 				StreamPlayer::PlayState state;
 				status = message->FindInt32("state", (int32*)&state);
 
+				// A crossfade starts once the new station plays, and is given
+				// up if it fails
+				if (player == fIncomingPlayer && player->State() != StreamPlayer::Buffering) {
+					if (player->State() == StreamPlayer::Playing
+						&& _ActiveItem(fOutgoingPlayer) != NULL) {
+						bigtime_t duration = fSettings->GetCrossfadeMilliseconds() * 1000LL;
+						fOutgoingPlayer->FadeTo(0.0f, duration);
+
+						BMessage done(MSG_CROSSFADE_DONE);
+						done.AddInt32("serial", fCrossfadeSerial);
+						BMessageRunner::StartSending(BMessenger(this), &done, duration, 1);
+					}
+					fIncomingPlayer = fOutgoingPlayer = NULL;
+				}
+
 				int stationIndex = fStationList->StationIndex(player->GetStation());
 				if (stationIndex >= 0) {
 					StationListViewItem* stationItem = fStationList->ItemAt(stationIndex);
 					stationItem->StateChanged(player->State());
 
 					if (player->State() == StreamPlayer::Stopped) {
+						if (player == fOutgoingPlayer)
+							fOutgoingPlayer = NULL;
+						fActiveStations.RemoveItem(stationItem);
+
+						// Averaged with what was measured before, as programs
+						// differ in loudness
+						float loudness = player->Loudness();
+						if (loudness != 0) {
+							Station* station = stationItem->GetStation();
+							if (station->Loudness() != 0)
+								loudness = (loudness + station->Loudness()) / 2;
+							station->SetLoudness(loudness);
+							station->Save();
+						}
+
 						delete player;
 						stationItem->SetPlayer(NULL);
 					}
@@ -308,6 +471,32 @@ MainWindow::MessageReceived(BMessage* message)
 			break;
 		}
 
+		case MSG_PLAYER_DEAD_AIR:
+		{
+			// The player may have been stopped since the message was sent
+			StreamPlayer* player = NULL;
+			message->FindPointer("player", (void**)&player);
+			StationListViewItem* item = _ActiveItem(player);
+			int32 state = message->GetInt32("state", DeadAirDetector::Live);
+			if (item == NULL || state == DeadAirDetector::Live)
+				break;
+
+			bool failover = fDeadAirFailover && player->Failover() == B_OK;
+
+			BString statusText;
+			if (state == DeadAirDetector::Silence && failover)
+				statusText = B_TRANSLATE("%station% sends silence, reconnecting");
+			else if (state == DeadAirDetector::Silence)
+				statusText = B_TRANSLATE("%station% sends silence");
+			else if (failover)
+				statusText = B_TRANSLATE("%station% repeats the same content, reconnecting");
+			else
+				statusText = B_TRANSLATE("%station% repeats the same content");
+			statusText.ReplaceFirst("%station%", player->GetStation()->Name()->String());
+			fStatusBar->SetText(statusText.String());
+			break;
+		}
+
 		case MSG_META_CHANGE:
 		{
 			BString meta = B_TRANSLATE("%station% now plays %title%");
@@ -336,6 +525,9 @@ MainWindow::MessageReceived(BMessage* message)
 			fSettings->SetAllowParallelPlayback(fAllowParallelPlayback);
 			fMenuParallelPlayback->SetMarked(fAllowParallelPlayback);
 
+			// Stations playing keep their output until they are played again
+			_UpdateOutput();
+
 			if (!fAllowParallelPlayback) {
 				while (fActiveStations.CountItems() > 1)
 					_TogglePlay(fActiveStations.LastItem());
@@ -343,6 +535,127 @@ MainWindow::MessageReceived(BMessage* message)
 			break;
 		}
 
+		case MSG_PRECONNECT:
+		{
+			fPreconnect = !fPreconnect;
+			fSettings->SetPreconnect(fPreconnect);
+			fMenuPreconnect->SetMarked(fPreconnect);
+
+			if (fPreconnect)
+				_UpdateStandby();
+			else
+				fStandby->Clear();
+			break;
+		}
+
+		case MSG_TIME_SHIFT:
+		{
+			// Takes effect for stations started from now on
+			fTimeShift = !fTimeShift;
+			fSettings->SetTimeShift(fTimeShift);
+			fMenuTimeShift->SetMarked(fTimeShift);
+			break;
+		}
+
+		case MSG_CROSSFADE:
+		{
+			// Stations playing can only be faded once they are played again
+			fCrossfade = !fCrossfade;
+			fSettings->SetCrossfade(fCrossfade);
+			fMenuCrossfade->SetMarked(fCrossfade);
+			_UpdateOutput();
+			break;
+		}
+
+		case MSG_NORMALIZE:
+		{
+			// Takes effect for stations started from now on
+			fNormalizeLoudness = !fNormalizeLoudness;
+			fSettings->SetNormalizeLoudness(fNormalizeLoudness);
+			fMenuNormalize->SetMarked(fNormalizeLoudness);
+			_UpdateOutput();
+			break;
+		}
+
+		case MSG_DEAD_AIR_FAILOVER:
+		{
+			fDeadAirFailover = !fDeadAirFailover;
+			fSettings->SetDeadAirFailover(fDeadAirFailover);
+			fMenuDeadAirFailover->SetMarked(fDeadAirFailover);
+			break;
+		}
+
+		case MSG_CROSSFADE_DONE:
+		{
+			// The stations faded out are stopped, unless another switch
+			// started in the meantime
+			if (message->GetInt32("serial", -1) != fCrossfadeSerial || fAllowParallelPlayback)
+				break;
+
+			while (fActiveStations.CountItems() > 1)
+				_TogglePlay(fActiveStations.FirstItem());
+			break;
+		}
+
+		case MSG_PAUSE:
+		{
+			StreamPlayer* player = _CurrentPlayer();
+			if (player != NULL)
+				player->SetPaused(!player->IsPaused());
+			break;
+		}
+
+		case MSG_REWIND:
+		{
+			StreamPlayer* player = _CurrentPlayer();
+			if (player != NULL)
+				player->Rewind(kRewindStep);
+			break;
+		}
+
+		case MSG_TRACK_START:
+		{
+			StreamPlayer* player = _CurrentPlayer();
+			if (player != NULL)
+				player->RewindToTrackStart();
+			break;
+		}
+
+		case MSG_GO_LIVE:
+		{
+			StreamPlayer* player = _CurrentPlayer();
+			if (player != NULL)
+				player->GoLive();
+			break;
+		}
+
+		case MSG_RECORD:
+		{
+			StreamPlayer* player = _CurrentPlayer();
+			if (player == NULL)
+				break;
+
+			BString statusText;
+			if (player->IsRecording()) {
+				player->StopRecording();
+				statusText = B_TRANSLATE("Stopped recording %station%");
+			} else {
+				BPath directory = fSettings->GetRecordingDirectory();
+				status_t status = player->StartRecording(directory);
+				if (status == B_OK) {
+					statusText = B_TRANSLATE("Recording %station% to %directory%");
+					statusText.ReplaceFirst("%directory%", directory.Path());
+				} else {
+					statusText = B_TRANSLATE("Recording %station% failed: %error%");
+					statusText.ReplaceFirst("%error%", strerror(status));
+				}
+			}
+
+			statusText.ReplaceFirst("%station%", player->GetStation()->Name()->String());
+			fStatusBar->SetText(statusText);
+			break;
+		}
+
 		case B_ABOUT_REQUESTED:
 			be_app->AboutRequested();
 			break;
@@ -364,6 +677,24 @@ MainWindow::QuitRequested()
 }
 
 
+void
+MainWindow::MenusBeginning()
+{
+	StreamPlayer* player = _CurrentPlayer();
+	bool canTimeShift = player != NULL && player->CanTimeShift();
+
+	fMenuPause->SetEnabled(canTimeShift);
+	fMenuPause->SetMarked(canTimeShift && player->IsPaused());
+	fMenuRewind->SetEnabled(canTimeShift);
+	fMenuTrackStart->SetEnabled(canTimeShift);
+	fMenuLive->SetEnabled(canTimeShift && player->Delay() > 0);
+	fMenuRecord->SetEnabled(player != NULL);
+	fMenuRecord->SetMarked(player != NULL && player->IsRecording());
+
+	BWindow::MenusBeginning();
+}
+
+
 void
 MainWindow::SetVisible(bool visible)
 {
@@ -379,6 +710,9 @@ MainWindow::_Invoke(StationListViewItem* stationItem)
 {
 	if (stationItem == NULL)
 		return;
+	if (!fAllowParallelPlayback && fCrossfade && _Crossfade(stationItem))
+		return;
+
 	bool wasActive = false;
 	if (!fAllowParallelPlayback) {
 		while (!fActiveStations.IsEmpty()) {
@@ -393,8 +727,49 @@ MainWindow::_Invoke(StationListViewItem* stationItem)
 }
 
 
+/**
+ * Switches from the station playing to stationItem without a gap: the old
+ * station goes on until the new one plays, then fades out while the new one
+ * fades in. Returns false if the stations cannot be faded.
+ */
+bool
+MainWindow::_Crossfade(StationListViewItem* stationItem)
+{
+	// A switch still waiting for its new station is given up
+	StationListViewItem* incoming = _ActiveItem(fIncomingPlayer);
+	fIncomingPlayer = fOutgoingPlayer = NULL;
+	if (incoming != NULL) {
+		_TogglePlay(incoming);
+		if (incoming == stationItem)
+			return true;
+	}
+
+	if (fActiveStations.HasItem(stationItem) || stationItem->Player() != NULL)
+		return false;
+
+	// Of stations still fading, only the one faded in last is kept
+	while (fActiveStations.CountItems() > 1)
+		_TogglePlay(fActiveStations.FirstItem());
+
+	StationListViewItem* outgoing = fActiveStations.LastItem();
+	StreamPlayer* player = outgoing != NULL ? outgoing->Player() : NULL;
+	if (player == NULL || !player->CanFade() || player->State() != StreamPlayer::Playing)
+		return false;
+
+	fCrossfadeSerial++;
+	_TogglePlay(stationItem, fSettings->GetCrossfadeMilliseconds() * 1000LL);
+
+	if (stationItem->Player() != NULL) {
+		fIncomingPlayer = stationItem->Player();
+		fOutgoingPlayer = player;
+	}
+
+	return true;
+}
+
+
 void
-MainWindow::_TogglePlay(StationListViewItem* stationItem)
+MainWindow::_TogglePlay(StationListViewItem* stationItem, bigtime_t fadeIn)
 {
 	switch (stationItem->State()) {
 		case StreamPlayer::Stopped:
@@ -402,8 +777,13 @@ MainWindow::_TogglePlay(StationListViewItem* stationItem)
 			status_t status = B_ERROR;
 
 			StreamPlayer* player = stationItem->Player();
+			if (player == NULL)
+				player = fStandby->Take(stationItem->GetStation(), this);
 			if (player == NULL)
 				player = new StreamPlayer(stationItem->GetStation(), this);
+			if (fTimeShift)
+				player->SetTimeShift(fSettings->GetTimeShiftMinutes() * 60000000LL);
+			player->SetFadeIn(fadeIn);
 			status = player->InitCheck();
 			if (status == B_OK) {
 				status = player->Play();
@@ -420,6 +800,12 @@ MainWindow::_TogglePlay(StationListViewItem* stationItem)
 				fStatusBar->SetText(success);
 				fStatusBar->Invalidate();
 				fActiveStations.AddItem(stationItem);
+
+				Station* station = stationItem->GetStation();
+				fRecentStations.RemoveItem(station);
+				fRecentStations.AddItem(station, 0);
+				if (fRecentStations.CountItems() > kMaxRecentStations)
+					fRecentStations.RemoveItemAt(kMaxRecentStations);
 			} else {
 				delete player;
 				player = NULL;
@@ -452,4 +838,76 @@ MainWindow::_TogglePlay(StationListViewItem* stationItem)
 		default:
 			break;
 	}
+
+	_UpdateStandby();
+}
+
+
+StationListViewItem*
+MainWindow::_ActiveItem(StreamPlayer* player)
+{
+	if (player == NULL)
+		return NULL;
+
+	for (int32 i = 0; i < fActiveStations.CountItems(); i++) {
+		if (fActiveStations.ItemAt(i)->Player() == player)
+			return fActiveStations.ItemAt(i);
+	}
+
+	return NULL;
+}
+
+
+/**
+ * Mixing, fading and normalizing all need the stations to share one output.
+ */
+void
+MainWindow::_UpdateOutput()
+{
+	StreamPlayer::SetUseMixer(fAllowParallelPlayback || fCrossfade || fNormalizeLoudness);
+	StreamPlayer::SetNormalizeLoudness(fNormalizeLoudness);
+}
+
+
+/**
+ * Keeps the stations most likely to be played next connected: the selected
+ * one and its neighbors, then the ones played last.
+ */
+void
+MainWindow::_UpdateStandby()
+{
+	if (!fPreconnect)
+		return;
+
+	BObjectList<Station> candidates;
+	int32 selection = fStationList->CurrentSelection();
+	if (selection >= 0) {
+		AddCandidate(&candidates, fStationList->ItemAt(selection));
+		AddCandidate(&candidates, fStationList->ItemAt(selection + 1));
+		AddCandidate(&candidates, fStationList->ItemAt(selection - 1));
+	}
+
+	for (int32 i = 0; i < fRecentStations.CountItems(); i++)
+		AddCandidate(&candidates, fStationList->Item(fRecentStations.ItemAt(i)));
+
+	fStandby->SetCandidates(&candidates);
+}
+
+
+/**
+ * Returns the player of the selected station if it plays, or else the one of
+ * the station started last.
+ */
+StreamPlayer*
+MainWindow::_CurrentPlayer()
+{
+	StationListViewItem* item = fStationList->ItemAt(fStationList->CurrentSelection());
+	if (item == NULL || item->Player() == NULL)
+		item = fActiveStations.LastItem();
+
+	if (item == NULL || item->Player() == NULL
+		|| item->Player()->State() != StreamPlayer::Playing)
+		return NULL;
+
+	return item->Player();
 }
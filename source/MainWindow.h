@@ -28,7 +28,9 @@
 #include <StringView.h>
 #include <Window.h>
 
+#include "PlayerStandby.h"
 #include "RadioSettings.h"
+#include "StationChecker.h"
 #include "StationFinder.h"
 #include "StationListView.h"
 #include "StationPanel.h"
@@ -39,10 +41,22 @@
 #define MSG_PASTE_URL 'PURL'
 #define MSG_SEARCH 'mSRC'
 #define MSG_CHECK 'mCKS'
+#define MSG_CHECK_ALL 'mCKA'
 #define MSG_REMOVE 'mRMS'
 #define MSG_INVOKE_STATION 'mIST'
 #define MSG_HELP 'HELP'
 #define MSG_PARALLEL_PLAYBACK 'mPAR'
+#define MSG_PRECONNECT 'mPRC'
+#define MSG_TIME_SHIFT 'mTSH'
+#define MSG_PAUSE 'mPAU'
+#define MSG_REWIND 'mRWD'
+#define MSG_TRACK_START 'mTRS'
+#define MSG_GO_LIVE 'mLIV'
+#define MSG_RECORD 'mREC'
+#define MSG_CROSSFADE 'mCFS'
+#define MSG_CROSSFADE_DONE 'mCFD'
+#define MSG_NORMALIZE 'mNRM'
+#define MSG_DEAD_AIR_FAILOVER 'mDAF'
 
 
 class MainWindow : public BWindow {
@@ -53,11 +67,18 @@ public:
 	virtual void MessageReceived(BMessage* message);
 	virtual bool QuitRequested();
 
+	virtual void MenusBeginning();
+
 	virtual void SetVisible(bool visible);
 
 private:
 	void _Invoke(StationListViewItem* stationItem);
-	void _TogglePlay(StationListViewItem* stationItem);
+	bool _Crossfade(StationListViewItem* stationItem);
+	void _TogglePlay(StationListViewItem* stationItem, bigtime_t fadeIn = 0);
+	StationListViewItem* _ActiveItem(StreamPlayer* player);
+	void _UpdateOutput();
+	void _UpdateStandby();
+	StreamPlayer* _CurrentPlayer();
 
 private:
 	RadioSettings* fSettings;
@@ -65,10 +86,33 @@ private:
 	StationListView* fStationList;
 	StationFinderWindow* fStationFinder;
 	StationPanel* fStationPanel;
+	StationChecker* fStationChecker;
 	BStringView* fStatusBar;
 	BObjectList<StationListViewItem> fActiveStations;
 	bool fAllowParallelPlayback;
 	BMenuItem* fMenuParallelPlayback;
+	PlayerStandby* fStandby;
+	BObjectList<Station> fRecentStations;
+	bool fPreconnect;
+	BMenuItem* fMenuPreconnect;
+	bool fTimeShift;
+	BMenuItem* fMenuTimeShift;
+	BMenuItem* fMenuPause;
+	BMenuItem* fMenuRewind;
+	BMenuItem* fMenuTrackStart;
+	BMenuItem* fMenuLive;
+	BMenuItem* fMenuRecord;
+	bool fCrossfade;
+	BMenuItem* fMenuCrossfade;
+	bool fNormalizeLoudness;
+	BMenuItem* fMenuNormalize;
+	bool fDeadAirFailover;
+	BMenuItem* fMenuDeadAirFailover;
+
+	// A crossfade waiting for its new station to play
+	StreamPlayer* fIncomingPlayer;
+	StreamPlayer* fOutgoingPlayer;
+	int32 fCrossfadeSerial;
 };
 
 
@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "Markup.h"
+
+#include <ctype.h>
+#include <string.h>
+#include <strings.h>
+
+
+/**
+ * Returns the start of the next opening tag called name, or NULL if there is
+ * none.
+ */
+const char*
+Markup::FindTag(const char* text, const char* name)
+{
+	size_t length = strlen(name);
+
+	while ((text = strchr(text, '<')) != NULL) {
+		text++;
+		if (strncasecmp(text, name, length) == 0
+			&& (text[length] == '>' || text[length] == '/' || isspace(text[length])))
+			return text - 1;
+	}
+
+	return NULL;
+}
+
+
+/**
+ * Returns the content of the first element called name, without the
+ * surrounding white space. If end is given, it is set to the text after the
+ * element, or to NULL if there is none.
+ */
+BString
+Markup::Element(const char* text, const char* name, const char** end)
+{
+	const char* start = FindTag(text, name);
+	const char* content = start != NULL ? strchr(start, '>') : NULL;
+
+	BString close("</");
+	close << name;
+
+	const char* closing = content != NULL ? strcasestr(content, close.String()) : NULL;
+	if (closing == NULL) {
+		if (end != NULL)
+			*end = NULL;
+		return BString();
+	}
+
+	if (end != NULL) {
+		const char* after = strchr(closing, '>');
+		*end = after != NULL ? after + 1 : closing + close.Length();
+	}
+
+	BString value(content + 1, closing - content - 1);
+	return value.Trim();
+}
+
+
+/**
+ * Collects the cells of the next table row in text into cells, up to maxCells.
+ * Returns the text after the row, or NULL if there are no more rows.
+ */
+const char*
+Markup::NextRow(const char* text, BString* cells, int32 maxCells, int32* count)
+{
+	const char* row = FindTag(text, "tr");
+	const char* rowEnd = row != NULL ? strcasestr(row, "</tr>") : NULL;
+	if (rowEnd == NULL)
+		return NULL;
+
+	BString rowText(row, rowEnd - row);
+	const char* cell = rowText.String();
+	for (*count = 0; *count < maxCells; (*count)++) {
+		cells[*count] = Element(cell, "td", &cell);
+		if (cell == NULL)
+			break;
+	}
+
+	return rowEnd + 5;
+}
+
+
+/**
+ * Returns the value of the attribute called name of the tag starting at tag,
+ * or an empty string if the tag does not have it.
+ */
+BString
+Markup::Attribute(const char* tag, const char* name)
+{
+	size_t length = strlen(name);
+	const char* position = tag + 1;
+
+	while (*position != '\0' && *position != '>') {
+		// Skip the tag name or the previous attribute
+		while (*position != '\0' && *position != '>' && !isspace(*position)) {
+			if (*position == '"' || *position == '\'') {
+				const char* quoteEnd = strchr(position + 1, *position);
+				if (quoteEnd == NULL)
+					return BString();
+				position = quoteEnd;
+			}
+			position++;
+		}
+		while (isspace(*position))
+			position++;
+
+		if (strncasecmp(position, name, length) != 0)
+			continue;
+
+		const char* value = position + length;
+		while (isspace(*value))
+			value++;
+		if (*value != '=')
+			continue;
+
+		value++;
+		while (isspace(*value))
+			value++;
+
+		if (*value == '"' || *value == '\'') {
+			const char* valueEnd = strchr(value + 1, *value);
+			if (valueEnd == NULL)
+				return BString();
+			return Decode(BString(value + 1, valueEnd - value - 1));
+		}
+
+		size_t valueLength = strcspn(value, " \t\r\n>");
+		return Decode(BString(value, valueLength));
+	}
+
+	return BString();
+}
+
+
+BString
+Markup::Decode(BString text)
+{
+	if (text.FindFirst('&') < 0)
+		return text;
+
+	text.ReplaceAll("&lt;", "<")
+		.ReplaceAll("&gt;", ">")
+		.ReplaceAll("&quot;", "\"")
+		.ReplaceAll("&apos;", "'")
+		.ReplaceAll("&#39;", "'")
+		.ReplaceAll("&nbsp;", " ")
+		.ReplaceAll("&amp;", "&");
+
+	return text;
+}
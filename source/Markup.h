@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef _MARKUP_H
+#define _MARKUP_H
+
+
+#include <String.h>
+
+
+/**
+ * Finds elements and attributes in HTML and XML documents. Every lookup scans
+ * the text once from the given position, without building a document tree and
+ * without backtracking. Names are matched case insensitively.
+ */
+class Markup {
+public:
+	static const char* FindTag(const char* text, const char* name);
+	static BString Element(const char* text, const char* name, const char** end = NULL);
+	static BString Attribute(const char* tag, const char* name);
+	static const char* NextRow(const char* text, BString* cells, int32 maxCells, int32* count);
+	static BString Decode(BString text);
+};
+
+
+#endif	// _MARKUP_H
@@ -0,0 +1,611 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "PcmDsp.h"
+
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PCM_DSP_AVX2
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define PCM_DSP_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define PCM_DSP_NEON
+#endif
+
+// The scalar loops handle the samples the vector kernels leave over, and must
+// round the same: multiplies and adds are not fused, as in the kernels.
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+
+// Full scale is the same both ways, so that integers survive a round trip
+static const float kInt16Scale = 1.0f / 32768.0f;
+static const float kInt32Scale = 1.0f / 2147483648.0f;
+
+// Largest floats that still convert to the integer types
+static const float kInt16Max = 32767.0f;
+static const float kInt32Max = 2147483520.0f;
+
+// Samples below the knee pass soft clipping unchanged, louder ones are bent
+// towards full scale, which is reached at kSoftClipLimit past the knee.
+static const float kSoftClipKnee = 0.75f;
+static const float kSoftClipRange = 1.0f - kSoftClipKnee;
+static const float kSoftClipScale = 1.0f / kSoftClipRange;
+static const float kSoftClipLimit = 3.0f;
+
+
+// The comparisons are those of the SSE min and max instructions, so that the
+// vector kernels give the same results.
+static inline float
+clamp_sample(float value, float low, float high)
+{
+	value = value < high ? value : high;
+	return value > low ? value : low;
+}
+
+
+#ifdef PCM_DSP_AVX2
+static bool
+has_avx2()
+{
+	static bool hasAvx2 = __builtin_cpu_supports("avx2");
+	return hasAvx2;
+}
+
+
+__attribute__((target("avx2"))) static size_t
+convert_int16_avx2(const int16* input, float* output, size_t samples)
+{
+	const __m256 scale = _mm256_set1_ps(kInt16Scale);
+
+	size_t i = 0;
+	for (; i + 8 <= samples; i += 8) {
+		__m256i value = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(input + i)));
+		_mm256_storeu_ps(output + i, _mm256_mul_ps(_mm256_cvtepi32_ps(value), scale));
+	}
+
+	return i;
+}
+
+
+__attribute__((target("avx2"))) static size_t
+gain_avx2(float* samples, size_t count, float gain)
+{
+	const __m256 factor = _mm256_set1_ps(gain);
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+		_mm256_storeu_ps(samples + i, _mm256_mul_ps(_mm256_loadu_ps(samples + i), factor));
+
+	return i;
+}
+
+
+__attribute__((target("avx2"))) static size_t
+gain_ramp_avx2(float* samples, size_t frames, uint32 channels, float fromGain, float step)
+{
+	// Frames of 8 samples, counted as the plain loop does
+	const __m256i advance = _mm256_set1_epi32(8 / channels);
+	const __m256 from = _mm256_set1_ps(fromGain);
+	const __m256 steps = _mm256_set1_ps(step);
+	__m256i frame = channels == 1 ? _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)
+		: _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+
+	size_t i = 0;
+	for (; i + 8 / channels <= frames; i += 8 / channels) {
+		__m256 gain = _mm256_add_ps(from, _mm256_mul_ps(steps, _mm256_cvtepi32_ps(frame)));
+		float* sample = samples + i * channels;
+		_mm256_storeu_ps(sample, _mm256_mul_ps(_mm256_loadu_ps(sample), gain));
+		frame = _mm256_add_epi32(frame, advance);
+	}
+
+	return i;
+}
+
+
+__attribute__((target("avx2"))) static size_t
+mix_avx2(const float* input, float* output, size_t samples, float gain)
+{
+	const __m256 factor = _mm256_set1_ps(gain);
+
+	size_t i = 0;
+	for (; i + 8 <= samples; i += 8) {
+		__m256 value = _mm256_mul_ps(_mm256_loadu_ps(input + i), factor);
+		_mm256_storeu_ps(output + i, _mm256_add_ps(_mm256_loadu_ps(output + i), value));
+	}
+
+	return i;
+}
+
+
+__attribute__((target("avx2"))) static float
+dot_product_avx2(const float* first, const float* second, size_t count, size_t* done)
+{
+	__m256 sum = _mm256_setzero_ps();
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256 product = _mm256_mul_ps(_mm256_loadu_ps(first + i), _mm256_loadu_ps(second + i));
+		sum = _mm256_add_ps(sum, product);
+	}
+
+	__m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+	half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+	half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+
+	*done = i;
+	return _mm_cvtss_f32(half);
+}
+
+
+__attribute__((target("avx2"))) static size_t
+soft_clip_avx2(float* samples, size_t count)
+{
+	const __m256 sign = _mm256_set1_ps(-0.0f);
+	const __m256 knee = _mm256_set1_ps(kSoftClipKnee);
+	const __m256 range = _mm256_set1_ps(kSoftClipRange);
+	const __m256 scale = _mm256_set1_ps(kSoftClipScale);
+	const __m256 limit = _mm256_set1_ps(kSoftClipLimit);
+	const __m256 a = _mm256_set1_ps(27.0f);
+	const __m256 b = _mm256_set1_ps(9.0f);
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256 x = _mm256_loadu_ps(samples + i);
+		__m256 magnitude = _mm256_andnot_ps(sign, x);
+		__m256 u = _mm256_mul_ps(_mm256_sub_ps(magnitude, knee), scale);
+		u = _mm256_min_ps(u, limit);
+		__m256 square = _mm256_mul_ps(u, u);
+		__m256 numerator = _mm256_mul_ps(u, _mm256_add_ps(a, square));
+		__m256 denominator = _mm256_add_ps(a, _mm256_mul_ps(b, square));
+		__m256 bent = _mm256_add_ps(
+			knee, _mm256_mul_ps(range, _mm256_div_ps(numerator, denominator)));
+		bent = _mm256_or_ps(bent, _mm256_and_ps(sign, x));
+		__m256 over = _mm256_cmp_ps(magnitude, knee, _CMP_GT_OQ);
+		_mm256_storeu_ps(samples + i, _mm256_blendv_ps(x, bent, over));
+	}
+
+	return i;
+}
+#endif	// PCM_DSP_AVX2
+
+
+void
+PcmDsp::ConvertToFloat(const int16* input, float* output, size_t samples)
+{
+	size_t i = 0;
+
+#ifdef PCM_DSP_AVX2
+	if (has_avx2())
+		i = convert_int16_avx2(input, output, samples);
+#endif
+#if defined(PCM_DSP_SSE2)
+	const __m128 scale = _mm_set1_ps(kInt16Scale);
+	for (; i + 8 <= samples; i += 8) {
+		__m128i value = _mm_loadu_si128((const __m128i*)(input + i));
+		__m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(value, value), 16);
+		__m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(value, value), 16);
+		_mm_storeu_ps(output + i, _mm_mul_ps(_mm_cvtepi32_ps(low), scale));
+		_mm_storeu_ps(output + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), scale));
+	}
+#elif defined(PCM_DSP_NEON)
+	for (; i + 4 <= samples; i += 4) {
+		int32x4_t value = vmovl_s16(vld1_s16(input + i));
+		vst1q_f32(output + i, vmulq_n_f32(vcvtq_f32_s32(value), kInt16Scale));
+	}
+#endif
+
+	for (; i < samples; i++)
+		output[i] = input[i] * kInt16Scale;
+}
+
+
+void
+PcmDsp::ConvertToFloat(const int32* input, float* output, size_t samples)
+{
+	size_t i = 0;
+
+#if defined(PCM_DSP_SSE2)
+	const __m128 scale = _mm_set1_ps(kInt32Scale);
+	for (; i + 4 <= samples; i += 4) {
+		__m128i value = _mm_loadu_si128((const __m128i*)(input + i));
+		_mm_storeu_ps(output + i, _mm_mul_ps(_mm_cvtepi32_ps(value), scale));
+	}
+#elif defined(PCM_DSP_NEON)
+	for (; i + 4 <= samples; i += 4)
+		vst1q_f32(output + i, vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(input + i)), kInt32Scale));
+#endif
+
+	for (; i < samples; i++)
+		output[i] = (float)input[i] * kInt32Scale;
+}
+
+
+/**
+ * Converts to int16, clipping and rounding to the nearest value.
+ */
+void
+PcmDsp::ConvertFromFloat(const float* input, int16* output, size_t samples)
+{
+	size_t i = 0;
+
+#if defined(PCM_DSP_SSE2)
+	const __m128 scale = _mm_set1_ps(32768.0f);
+	const __m128 low = _mm_set1_ps(-32768.0f);
+	const __m128 high = _mm_set1_ps(kInt16Max);
+	for (; i + 8 <= samples; i += 8) {
+		__m128 first = _mm_mul_ps(_mm_loadu_ps(input + i), scale);
+		__m128 second = _mm_mul_ps(_mm_loadu_ps(input + i + 4), scale);
+		first = _mm_max_ps(_mm_min_ps(first, high), low);
+		second = _mm_max_ps(_mm_min_ps(second, high), low);
+		_mm_storeu_si128((__m128i*)(output + i),
+			_mm_packs_epi32(_mm_cvtps_epi32(first), _mm_cvtps_epi32(second)));
+	}
+#elif defined(PCM_DSP_NEON)
+	const float32x4_t low = vdupq_n_f32(-32768.0f);
+	const float32x4_t high = vdupq_n_f32(kInt16Max);
+	for (; i + 4 <= samples; i += 4) {
+		float32x4_t value = vmulq_n_f32(vld1q_f32(input + i), 32768.0f);
+		value = vmaxq_f32(vminq_f32(value, high), low);
+		vst1_s16(output + i, vqmovn_s32(vcvtnq_s32_f32(value)));
+	}
+#endif
+
+	for (; i < samples; i++)
+		output[i] = (int16)lrintf(clamp_sample(input[i] * 32768.0f, -32768.0f, kInt16Max));
+}
+
+
+void
+PcmDsp::ConvertFromFloat(const float* input, int32* output, size_t samples)
+{
+	size_t i = 0;
+
+#if defined(PCM_DSP_SSE2)
+	const __m128 scale = _mm_set1_ps(2147483648.0f);
+	const __m128 low = _mm_set1_ps(-2147483648.0f);
+	const __m128 high = _mm_set1_ps(kInt32Max);
+	for (; i + 4 <= samples; i += 4) {
+		__m128 value = _mm_mul_ps(_mm_loadu_ps(input + i), scale);
+		value = _mm_max_ps(_mm_min_ps(value, high), low);
+		_mm_storeu_si128((__m128i*)(output + i), _mm_cvtps_epi32(value));
+	}
+#elif defined(PCM_DSP_NEON)
+	const float32x4_t low = vdupq_n_f32(-2147483648.0f);
+	const float32x4_t high = vdupq_n_f32(kInt32Max);
+	for (; i + 4 <= samples; i += 4) {
+		float32x4_t value = vmulq_n_f32(vld1q_f32(input + i), 2147483648.0f);
+		value = vmaxq_f32(vminq_f32(value, high), low);
+		vst1q_s32(output + i, vcvtnq_s32_f32(value));
+	}
+#endif
+
+	for (; i < samples; i++) {
+		output[i] = (int32)lrintf(
+			clamp_sample(input[i] * 2147483648.0f, -2147483648.0f, kInt32Max));
+	}
+}
+
+
+void
+PcmDsp::Gain(float* samples, size_t count, float gain)
+{
+	size_t i = 0;
+
+#ifdef PCM_DSP_AVX2
+	if (has_avx2())
+		i = gain_avx2(samples, count, gain);
+#endif
+#if defined(PCM_DSP_SSE2)
+	const __m128 factor = _mm_set1_ps(gain);
+	for (; i + 4 <= count; i += 4)
+		_mm_storeu_ps(samples + i, _mm_mul_ps(_mm_loadu_ps(samples + i), factor));
+#elif defined(PCM_DSP_NEON)
+	for (; i + 4 <= count; i += 4)
+		vst1q_f32(samples + i, vmulq_n_f32(vld1q_f32(samples + i), gain));
+#endif
+
+	for (; i < count; i++)
+		samples[i] *= gain;
+}
+
+
+/**
+ * Changes the gain linearly from fromGain at the first frame towards toGain,
+ * so that changing the volume does not click. Mono and stereo, which is what
+ * the mixer ramps, are vectorized.
+ */
+void
+PcmDsp::GainRamp(float* samples, size_t frames, uint32 channels, float fromGain, float toGain)
+{
+	if (fromGain == toGain) {
+		Gain(samples, frames * channels, toGain);
+		return;
+	}
+
+	float step = (toGain - fromGain) / frames;
+	size_t i = 0;
+
+#ifdef PCM_DSP_AVX2
+	if (has_avx2() && (channels == 1 || channels == 2))
+		i = gain_ramp_avx2(samples, frames, channels, fromGain, step);
+#endif
+#if defined(PCM_DSP_SSE2)
+	if (channels == 1 || channels == 2) {
+		const size_t advance = 4 / channels;
+		const __m128 from = _mm_set1_ps(fromGain);
+		const __m128 steps = _mm_set1_ps(step);
+		__m128i frame = channels == 1 ? _mm_setr_epi32(0, 1, 2, 3) : _mm_setr_epi32(0, 0, 1, 1);
+		frame = _mm_add_epi32(frame, _mm_set1_epi32((int32)i));
+		for (; i + advance <= frames; i += advance) {
+			__m128 gain = _mm_add_ps(from, _mm_mul_ps(steps, _mm_cvtepi32_ps(frame)));
+			float* sample = samples + i * channels;
+			_mm_storeu_ps(sample, _mm_mul_ps(_mm_loadu_ps(sample), gain));
+			frame = _mm_add_epi32(frame, _mm_set1_epi32((int32)advance));
+		}
+	}
+#elif defined(PCM_DSP_NEON)
+	if (channels == 1 || channels == 2) {
+		const size_t advance = 4 / channels;
+		const int32 first[2][4] = {{0, 1, 2, 3}, {0, 0, 1, 1}};
+		int32x4_t frame = vld1q_s32(first[channels - 1]);
+		for (; i + advance <= frames; i += advance) {
+			float32x4_t index = vcvtq_f32_s32(frame);
+			float32x4_t gain = vaddq_f32(vdupq_n_f32(fromGain), vmulq_n_f32(index, step));
+			float* sample = samples + i * channels;
+			vst1q_f32(sample, vmulq_f32(vld1q_f32(sample), gain));
+			frame = vaddq_s32(frame, vdupq_n_s32((int32)advance));
+		}
+	}
+#endif
+
+	for (; i < frames; i++) {
+		float gain = fromGain + step * i;
+		for (uint32 c = 0; c < channels; c++)
+			samples[i * channels + c] *= gain;
+	}
+}
+
+
+/**
+ * Adds input with gain to output.
+ */
+void
+PcmDsp::Mix(const float* input, float* output, size_t samples, float gain)
+{
+	size_t i = 0;
+
+#ifdef PCM_DSP_AVX2
+	if (has_avx2())
+		i = mix_avx2(input, output, samples, gain);
+#endif
+#if defined(PCM_DSP_SSE2)
+	const __m128 factor = _mm_set1_ps(gain);
+	for (; i + 4 <= samples; i += 4) {
+		__m128 value = _mm_mul_ps(_mm_loadu_ps(input + i), factor);
+		_mm_storeu_ps(output + i, _mm_add_ps(_mm_loadu_ps(output + i), value));
+	}
+#elif defined(PCM_DSP_NEON)
+	for (; i + 4 <= samples; i += 4) {
+		float32x4_t value = vmulq_n_f32(vld1q_f32(input + i), gain);
+		vst1q_f32(output + i, vaddq_f32(vld1q_f32(output + i), value));
+	}
+#endif
+
+	for (; i < samples; i++)
+		output[i] += input[i] * gain;
+}
+
+
+/**
+ * Returns the sum of the products of first and second, for FIR filters.
+ */
+float
+PcmDsp::DotProduct(const float* first, const float* second, size_t count)
+{
+	size_t i = 0;
+	float sum = 0.0f;
+
+#ifdef PCM_DSP_AVX2
+	if (has_avx2())
+		sum = dot_product_avx2(first, second, count, &i);
+#endif
+#if defined(PCM_DSP_SSE2)
+	__m128 sums = _mm_setzero_ps();
+	for (; i + 4 <= count; i += 4)
+		sums = _mm_add_ps(sums, _mm_mul_ps(_mm_loadu_ps(first + i), _mm_loadu_ps(second + i)));
+
+	sums = _mm_add_ps(sums, _mm_movehl_ps(sums, sums));
+	sums = _mm_add_ss(sums, _mm_shuffle_ps(sums, sums, 1));
+	sum += _mm_cvtss_f32(sums);
+#elif defined(PCM_DSP_NEON)
+	float32x4_t sums = vdupq_n_f32(0.0f);
+	for (; i + 4 <= count; i += 4)
+		sums = vmlaq_f32(sums, vld1q_f32(first + i), vld1q_f32(second + i));
+
+	sum += vaddvq_f32(sums);
+#endif
+
+	for (; i < count; i++)
+		sum += first[i] * second[i];
+
+	return sum;
+}
+
+
+/**
+ * Returns the largest magnitude of the samples.
+ */
+float
+PcmDsp::Peak(const float* samples, size_t count)
+{
+	size_t i = 0;
+	float peak = 0.0f;
+
+#if defined(PCM_DSP_SSE2)
+	const __m128 sign = _mm_set1_ps(-0.0f);
+	__m128 peaks = _mm_setzero_ps();
+	for (; i + 4 <= count; i += 4)
+		peaks = _mm_max_ps(peaks, _mm_andnot_ps(sign, _mm_loadu_ps(samples + i)));
+
+	peaks = _mm_max_ps(peaks, _mm_movehl_ps(peaks, peaks));
+	peaks = _mm_max_ss(peaks, _mm_shuffle_ps(peaks, peaks, 1));
+	peak = _mm_cvtss_f32(peaks);
+#elif defined(PCM_DSP_NEON)
+	float32x4_t peaks = vdupq_n_f32(0.0f);
+	for (; i + 4 <= count; i += 4)
+		peaks = vmaxq_f32(peaks, vabsq_f32(vld1q_f32(samples + i)));
+
+	peak = vmaxvq_f32(peaks);
+#endif
+
+	for (; i < count; i++) {
+		float magnitude = fabsf(samples[i]);
+		peak = magnitude > peak ? magnitude : peak;
+	}
+
+	return peak;
+}
+
+
+void
+PcmDsp::UpMix(const float* mono, float* stereo, size_t frames)
+{
+	size_t i = 0;
+
+#if defined(PCM_DSP_SSE2)
+	for (; i + 4 <= frames; i += 4) {
+		__m128 value = _mm_loadu_ps(mono + i);
+		_mm_storeu_ps(stereo + i * 2, _mm_unpacklo_ps(value, value));
+		_mm_storeu_ps(stereo + i * 2 + 4, _mm_unpackhi_ps(value, value));
+	}
+#elif defined(PCM_DSP_NEON)
+	for (; i + 4 <= frames; i += 4) {
+		float32x4_t value = vld1q_f32(mono + i);
+		float32x4x2_t pair = {{value, value}};
+		vst2q_f32(stereo + i * 2, pair);
+	}
+#endif
+
+	for (; i < frames; i++)
+		stereo[i * 2] = stereo[i * 2 + 1] = mono[i];
+}
+
+
+void
+PcmDsp::DownMix(const float* stereo, float* mono, size_t frames)
+{
+	size_t i = 0;
+
+#if defined(PCM_DSP_SSE2)
+	const __m128 half = _mm_set1_ps(0.5f);
+	for (; i + 4 <= frames; i += 4) {
+		__m128 first = _mm_loadu_ps(stereo + i * 2);
+		__m128 second = _mm_loadu_ps(stereo + i * 2 + 4);
+		__m128 left = _mm_shuffle_ps(first, second, _MM_SHUFFLE(2, 0, 2, 0));
+		__m128 right = _mm_shuffle_ps(first, second, _MM_SHUFFLE(3, 1, 3, 1));
+		_mm_storeu_ps(mono + i, _mm_mul_ps(_mm_add_ps(left, right), half));
+	}
+#elif defined(PCM_DSP_NEON)
+	for (; i + 4 <= frames; i += 4) {
+		float32x4x2_t pair = vld2q_f32(stereo + i * 2);
+		vst1q_f32(mono + i, vmulq_n_f32(vaddq_f32(pair.val[0], pair.val[1]), 0.5f));
+	}
+#endif
+
+	for (; i < frames; i++)
+		mono[i] = (stereo[i * 2] + stereo[i * 2 + 1]) * 0.5f;
+}
+
+
+/**
+ * Limits samples to [-1, 1] for mixes that add up to more than full scale.
+ * Samples up to the knee are left alone, louder ones are bent along a tanh
+ * like curve that joins the straight line smoothly.
+ */
+void
+PcmDsp::SoftClip(float* samples, size_t count)
+{
+	size_t i = 0;
+
+#ifdef PCM_DSP_AVX2
+	if (has_avx2())
+		i = soft_clip_avx2(samples, count);
+#endif
+#if defined(PCM_DSP_SSE2)
+	const __m128 sign = _mm_set1_ps(-0.0f);
+	const __m128 knee = _mm_set1_ps(kSoftClipKnee);
+	const __m128 range = _mm_set1_ps(kSoftClipRange);
+	const __m128 scale = _mm_set1_ps(kSoftClipScale);
+	const __m128 limit = _mm_set1_ps(kSoftClipLimit);
+	const __m128 a = _mm_set1_ps(27.0f);
+	const __m128 b = _mm_set1_ps(9.0f);
+	for (; i + 4 <= count; i += 4) {
+		__m128 x = _mm_loadu_ps(samples + i);
+		__m128 magnitude = _mm_andnot_ps(sign, x);
+		__m128 u = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(magnitude, knee), scale), limit);
+		__m128 square = _mm_mul_ps(u, u);
+		__m128 numerator = _mm_mul_ps(u, _mm_add_ps(a, square));
+		__m128 denominator = _mm_add_ps(a, _mm_mul_ps(b, square));
+		__m128 bent = _mm_add_ps(knee, _mm_mul_ps(range, _mm_div_ps(numerator, denominator)));
+		bent = _mm_or_ps(bent, _mm_and_ps(sign, x));
+		__m128 over = _mm_cmpgt_ps(magnitude, knee);
+		_mm_storeu_ps(samples + i, _mm_or_ps(_mm_and_ps(over, bent), _mm_andnot_ps(over, x)));
+	}
+#elif defined(PCM_DSP_NEON)
+	const float32x4_t knee = vdupq_n_f32(kSoftClipKnee);
+	const float32x4_t limit = vdupq_n_f32(kSoftClipLimit);
+	const float32x4_t a = vdupq_n_f32(27.0f);
+	const uint32x4_t sign = vdupq_n_u32(0x80000000);
+	for (; i + 4 <= count; i += 4) {
+		float32x4_t x = vld1q_f32(samples + i);
+		float32x4_t magnitude = vabsq_f32(x);
+		float32x4_t u = vmulq_n_f32(vsubq_f32(magnitude, knee), kSoftClipScale);
+		u = vminq_f32(u, limit);
+		float32x4_t square = vmulq_f32(u, u);
+		float32x4_t numerator = vmulq_f32(u, vaddq_f32(a, square));
+		float32x4_t denominator = vaddq_f32(a, vmulq_n_f32(square, 9.0f));
+		float32x4_t bent = vaddq_f32(
+			knee, vmulq_n_f32(vdivq_f32(numerator, denominator), kSoftClipRange));
+		bent = vbslq_f32(sign, x, bent);
+		vst1q_f32(samples + i, vbslq_f32(vcgtq_f32(magnitude, knee), bent, x));
+	}
+#endif
+
+	for (; i < count; i++) {
+		float magnitude = fabsf(samples[i]);
+		if (!(magnitude > kSoftClipKnee))
+			continue;
+
+		float u = (magnitude - kSoftClipKnee) * kSoftClipScale;
+		u = u < kSoftClipLimit ? u : kSoftClipLimit;
+		float square = u * u;
+		float curve = u * (27.0f + square) / (27.0f + 9.0f * square);
+		float bent = kSoftClipKnee + kSoftClipRange * curve;
+		samples[i] = copysignf(bent, samples[i]);
+	}
+}
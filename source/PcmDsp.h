@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef _PCM_DSP_H
+#define _PCM_DSP_H
+
+
+#include <SupportDefs.h>
+
+
+/**
+ * Kernels for the float audio of the output path. They use SSE2 or NEON
+ * where the compiler targets it, AVX2 on x86 processors that have it, and
+ * plain loops otherwise. Apart from DotProduct(), which adds in another
+ * order, all give the same results as the plain loops.
+ */
+class PcmDsp {
+public:
+	static void ConvertToFloat(const int16* input, float* output, size_t samples);
+	static void ConvertToFloat(const int32* input, float* output, size_t samples);
+	static void ConvertFromFloat(const float* input, int16* output, size_t samples);
+	static void ConvertFromFloat(const float* input, int32* output, size_t samples);
+
+	static void Gain(float* samples, size_t count, float gain);
+	static void GainRamp(
+		float* samples, size_t frames, uint32 channels, float fromGain, float toGain);
+	static void Mix(const float* input, float* output, size_t samples, float gain);
+	static float DotProduct(const float* first, const float* second, size_t count);
+	static float Peak(const float* samples, size_t count);
+
+	static void UpMix(const float* mono, float* stereo, size_t frames);
+	static void DownMix(const float* stereo, float* mono, size_t frames);
+
+	static void SoftClip(float* samples, size_t count);
+};
+
+
+#endif	// _PCM_DSP_H
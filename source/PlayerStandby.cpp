@@ -0,0 +1,288 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "PlayerStandby.h"
+
+#include <Autolock.h>
+
+#include "Debug.h"
+
+
+// Interval at which the standby players are looked after
+static const bigtime_t kRefreshInterval = 5000000;
+
+// A stream on standby stops reading once its buffer is full, and servers drop
+// clients that stay behind for long, so it is reconnected after a while.
+static const bigtime_t kMaxAge = 60000000;
+
+// Time to wait before trying again to connect to a station that failed
+static const bigtime_t kRetryDelay = 30000000;
+
+
+class StandbyEntry {
+public:
+	StandbyEntry(Station* station)
+		: fOriginal(station),
+		  fStation(new Station(*station)),
+		  fPlayer(NULL),
+		  fConnected(0),
+		  fBusy(false)
+	{
+	}
+
+	// Takes over a player and the station it was connected with
+	StandbyEntry(StreamPlayer* player, Station* station)
+		: fOriginal(NULL),
+		  fStation(station),
+		  fPlayer(player),
+		  fConnected(0),
+		  fBusy(false)
+	{
+	}
+
+	~StandbyEntry()
+	{
+		delete fPlayer;
+		delete fStation;
+	}
+
+	// Only compared against, the player works on its own copy of the station
+	Station* fOriginal;
+
+	Station* fStation;
+	StreamPlayer* fPlayer;
+	bigtime_t fConnected;
+	bool fBusy;
+};
+
+
+PlayerStandby::PlayerStandby()
+	: fLock("player standby"),
+#if B_HAIKU_VERSION > B_HAIKU_VERSION_1_BETA_5
+	  fEntries(),
+	  fDropped(),
+#else
+	  fEntries(PS_MAX_PLAYERS, true),
+	  fDropped(PS_MAX_PLAYERS, true),
+#endif
+	  fQuit(false)
+{
+	fWakeUp = create_sem(0, "player standby");
+	fThread = spawn_thread(&_StandbyThreadFunc, "player standby", B_LOW_PRIORITY, this);
+	if (fThread >= 0)
+		resume_thread(fThread);
+}
+
+
+PlayerStandby::~PlayerStandby()
+{
+	{
+		BAutolock lock(fLock);
+
+		fQuit = true;
+		while (!fEntries.IsEmpty())
+			_Drop(0);
+	}
+
+	release_sem(fWakeUp);
+	if (fThread >= 0) {
+		status_t status;
+		wait_for_thread(fThread, &status);
+	}
+
+	delete_sem(fWakeUp);
+}
+
+
+/**
+ * Sets the stations to keep connected, most likely to be played first. Only
+ * the first PS_MAX_PLAYERS of them are connected, all others are dropped.
+ */
+void
+PlayerStandby::SetCandidates(BObjectList<Station>* stations)
+{
+	BAutolock lock(fLock);
+
+	for (int32 i = fEntries.CountItems() - 1; i >= 0; i--) {
+		int32 index = stations->IndexOf(fEntries.ItemAt(i)->fOriginal);
+		if (index < 0 || index >= PS_MAX_PLAYERS)
+			_Drop(i);
+	}
+
+	int32 count = min_c(stations->CountItems(), PS_MAX_PLAYERS);
+	for (int32 i = 0; i < count; i++) {
+		Station* station = stations->ItemAt(i);
+
+		int32 index = i;
+		while (index < fEntries.CountItems() && fEntries.ItemAt(index)->fOriginal != station)
+			index++;
+
+		if (index < fEntries.CountItems())
+			fEntries.AddItem(fEntries.RemoveItemAt(index), i);
+		else
+			fEntries.AddItem(new StandbyEntry(station), i);
+	}
+
+	release_sem(fWakeUp);
+}
+
+
+/**
+ * Returns the standby player of station, handed over to station and notify,
+ * or NULL if there is no usable one.
+ */
+StreamPlayer*
+PlayerStandby::Take(Station* station, BLooper* notify)
+{
+	BAutolock lock(fLock);
+
+	for (int32 i = 0; i < fEntries.CountItems(); i++) {
+		StandbyEntry* entry = fEntries.ItemAt(i);
+		if (entry->fOriginal != station)
+			continue;
+
+		if (entry->fBusy || entry->fPlayer == NULL)
+			return NULL;
+
+		if (!entry->fPlayer->IsConnected() || system_time() - entry->fConnected > kMaxAge) {
+			_Drop(i);
+			release_sem(fWakeUp);
+
+			return NULL;
+		}
+
+		// The player keeps the copy of the station it was connected with
+		StreamPlayer* player = entry->fPlayer;
+		entry->fPlayer = NULL;
+		entry->fStation = NULL;
+		delete fEntries.RemoveItemAt(i);
+
+		player->SetStandby(false);
+		player->Attach(station, notify);
+
+		TRACE("Taking standby player for %s\n", station->Name()->String());
+		return player;
+	}
+
+	return NULL;
+}
+
+
+void
+PlayerStandby::Clear()
+{
+	BAutolock lock(fLock);
+
+	while (!fEntries.IsEmpty())
+		_Drop(0);
+
+	release_sem(fWakeUp);
+}
+
+
+/**
+ * Returns the first entry that needs to be connected, marked busy, after
+ * moving a player that went stale from it to the dropped ones.
+ */
+StandbyEntry*
+PlayerStandby::_NextToConnect()
+{
+	bigtime_t now = system_time();
+
+	for (int32 i = 0; i < fEntries.CountItems(); i++) {
+		StandbyEntry* entry = fEntries.ItemAt(i);
+		if (entry->fBusy)
+			continue;
+
+		if (entry->fPlayer != NULL) {
+			bigtime_t age = now - entry->fConnected;
+			if (age < kMaxAge && (entry->fPlayer->IsConnected() || age < kRetryDelay))
+				continue;
+
+			// The stale stream may still use its station, so it gets a new one
+			Station* station = new Station(*entry->fStation);
+			fDropped.AddItem(new StandbyEntry(entry->fPlayer, entry->fStation));
+			entry->fPlayer = NULL;
+			entry->fStation = station;
+		}
+
+		entry->fBusy = true;
+		return entry;
+	}
+
+	return NULL;
+}
+
+
+void
+PlayerStandby::_Drop(int32 index)
+{
+	fDropped.AddItem(fEntries.RemoveItemAt(index));
+}
+
+
+int32
+PlayerStandby::_StandbyThreadFunc(void* data)
+{
+	PlayerStandby* _this = (PlayerStandby*)data;
+
+	while (true) {
+		acquire_sem_etc(_this->fWakeUp, 1, B_RELATIVE_TIMEOUT, kRefreshInterval);
+
+		// Players are only deleted here, as closing a stream waits for its
+		// request to finish.
+		BObjectList<StandbyEntry> dropped;
+		StandbyEntry* entry = NULL;
+		bool quit;
+		{
+			BAutolock lock(_this->fLock);
+
+			while (!_this->fDropped.IsEmpty())
+				dropped.AddItem(_this->fDropped.RemoveItemAt(0));
+
+			quit = _this->fQuit;
+			if (!quit)
+				entry = _this->_NextToConnect();
+		}
+
+		for (int32 i = 0; i < dropped.CountItems(); i++)
+			delete dropped.ItemAt(i);
+
+		if (quit)
+			break;
+
+		if (entry == NULL)
+			continue;
+
+		TRACE("Connecting %s on standby\n", entry->fStation->Name()->String());
+
+		StreamPlayer* player = new StreamPlayer(entry->fStation);
+		if (player->InitCheck() == B_OK)
+			player->SetStandby(true);
+
+		BAutolock lock(_this->fLock);
+		entry->fPlayer = player;
+		entry->fConnected = system_time();
+		entry->fBusy = false;
+
+		// Look for more work right away
+		release_sem(_this->fWakeUp);
+	}
+
+	return B_OK;
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef _PLAYER_STANDBY_H
+#define _PLAYER_STANDBY_H
+
+
+#include <Locker.h>
+#include <ObjectList.h>
+
+#include "Station.h"
+#include "StreamPlayer.h"
+
+
+// Number of stations kept connected at most
+#define PS_MAX_PLAYERS 3
+
+
+class StandbyEntry;
+
+
+/**
+ * Keeps the stations that are likely to be played next connected in the
+ * background, each with a small buffer. Connecting and disconnecting is done
+ * on a thread of its own, as both may block for a while.
+ */
+class PlayerStandby {
+public:
+	PlayerStandby();
+	virtual ~PlayerStandby();
+
+	void SetCandidates(BObjectList<Station>* stations);
+	StreamPlayer* Take(Station* station, BLooper* notify);
+	void Clear();
+
+private:
+	StandbyEntry* _NextToConnect();
+	void _Drop(int32 index);
+
+	static int32 _StandbyThreadFunc(void* data);
+
+private:
+	BLocker fLock;
+#if B_HAIKU_VERSION > B_HAIKU_VERSION_1_BETA_5
+	BObjectList<StandbyEntry, true> fEntries;
+	BObjectList<StandbyEntry, true> fDropped;
+#else
+	BObjectList<StandbyEntry> fEntries;
+	BObjectList<StandbyEntry> fDropped;
+#endif
+	sem_id fWakeUp;
+	thread_id fThread;
+	bool fQuit;
+};
+
+
+#endif	// _PLAYER_STANDBY_H
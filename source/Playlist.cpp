@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "Playlist.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <map>
+
+#include "HlsPlaylist.h"
+#include "Markup.h"
+
+
+status_t
+Playlist::Parse(const char* body, const BUrl& baseUrl, BStringList* urls, BString* title,
+	const char* contentType)
+{
+	urls->MakeEmpty();
+	if (title != NULL)
+		title->Truncate(0);
+
+	BString unusedTitle;
+	if (title == NULL)
+		title = &unusedTitle;
+
+	if (HlsPlaylist::IsHls(body))
+		urls->Add(baseUrl.UrlString());
+	else if (strcasestr(body, "<playlist") != NULL && strcasestr(body, "xspf") != NULL)
+		_ParseXspf(body, baseUrl, urls, title);
+	else if (strcasestr(body, "[playlist]") != NULL || strcasestr(body, "file1=") != NULL)
+		_ParsePls(body, baseUrl, urls, title);
+	else {
+		const char* start = body + strspn(body, " \t\r\n");
+		bool isM3u = IsM3uType(contentType) || strncmp(start, "#EXTM3U", 7) == 0;
+		_ParseM3u(body, baseUrl, urls, isM3u);
+	}
+
+	return urls->IsEmpty() ? B_ERROR : B_OK;
+}
+
+
+/**
+ * Returns whether contentType, which may carry parameters, is one of those
+ * servers send M3U and M3U8 playlists with.
+ */
+bool
+Playlist::IsM3uType(const char* contentType)
+{
+	if (contentType == NULL)
+		return false;
+
+	static const char* kM3uTypes[] = {"audio/x-mpegurl", "audio/mpegurl",
+		"application/vnd.apple.mpegurl", "application/x-mpegurl", NULL};
+
+	contentType += strspn(contentType, " \t");
+	size_t length = strcspn(contentType, "; \t");
+	for (int32 i = 0; kM3uTypes[i] != NULL; i++) {
+		if (strlen(kM3uTypes[i]) == length && strncasecmp(contentType, kM3uTypes[i], length) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+
+/**
+ * Entries are ordered by their number, as some playlists do not list them in
+ * order. The title of the first entry is taken for the playlist.
+ */
+void
+Playlist::_ParsePls(const char* body, const BUrl& baseUrl, BStringList* urls, BString* title)
+{
+	std::map<int32, BString> files;
+	std::map<int32, BString> titles;
+
+	BString line;
+	while ((body = NextLine(body, &line)) != NULL) {
+		int32 separator = line.FindFirst('=');
+		if (separator < 0)
+			continue;
+
+		std::map<int32, BString>* entries;
+		int32 keyLength;
+		if (strncasecmp(line.String(), "file", 4) == 0) {
+			entries = &files;
+			keyLength = 4;
+		} else if (strncasecmp(line.String(), "title", 5) == 0) {
+			entries = &titles;
+			keyLength = 5;
+		} else
+			continue;
+
+		const char* number = line.String() + keyLength;
+		if (!isdigit(*number))
+			continue;
+
+		BString value;
+		line.CopyInto(value, separator + 1, line.Length() - separator - 1);
+		(*entries)[atoi(number)] = value.Trim();
+	}
+
+	for (std::map<int32, BString>::iterator it = files.begin(); it != files.end(); it++)
+		_AddEntry(urls, baseUrl, it->second);
+
+	if (!titles.empty())
+		title->SetTo(titles.begin()->second);
+}
+
+
+/**
+ * Lines that are no comments are entries, if they are URLs or, where
+ * allowRelative is set, look like relative paths.
+ */
+void
+Playlist::_ParseM3u(const char* body, const BUrl& baseUrl, BStringList* urls, bool allowRelative)
+{
+	BString line;
+	while ((body = NextLine(body, &line)) != NULL) {
+		if (line.IsEmpty() || line.StartsWith("#"))
+			continue;
+
+		if (_HasScheme(line) || (allowRelative && _IsRelativePath(line)))
+			_AddEntry(urls, baseUrl, line);
+	}
+}
+
+
+void
+Playlist::_ParseXspf(const char* body, const BUrl& baseUrl, BStringList* urls, BString* title)
+{
+	title->SetTo(Markup::Decode(Markup::Element(body, "title")));
+
+	const char* end = body;
+	while (true) {
+		BString location = Markup::Element(end, "location", &end);
+		if (end == NULL)
+			break;
+
+		_AddEntry(urls, baseUrl, Markup::Decode(location));
+	}
+}
+
+
+void
+Playlist::_AddEntry(BStringList* urls, const BUrl& baseUrl, BString entry)
+{
+	entry.Trim();
+	if (entry.IsEmpty() || urls->CountStrings() >= PLAYLIST_MAX_ENTRIES)
+		return;
+
+	BUrl url(baseUrl, entry);
+	if (url.IsValid() && !urls->HasString(url.UrlString()))
+		urls->Add(url.UrlString());
+}
+
+
+/**
+ * Returns whether entry starts with a URL scheme followed by "://".
+ */
+bool
+Playlist::_HasScheme(const BString& entry)
+{
+	const char* text = entry.String();
+	if (!isalpha(*text))
+		return false;
+
+	while (isalnum(*text) || *text == '+' || *text == '-' || *text == '.')
+		text++;
+
+	return strncmp(text, "://", 3) == 0 && text[3] != '\0' && !isspace(text[3]);
+}
+
+
+/**
+ * Returns whether entry is made of the characters a path can have in a URL,
+ * which leaves out text and markup.
+ */
+bool
+Playlist::_IsRelativePath(const BString& entry)
+{
+	for (const char* text = entry.String(); *text != '\0'; text++) {
+		uint8 c = *text;
+		if (c <= ' ' || c == 0x7f || strchr("<>\"{}|\\^`", c) != NULL)
+			return false;
+	}
+
+	return true;
+}
+
+
+/**
+ * Copies the next line of text into line, without its line break and the
+ * surrounding white space. Returns the text after the line, or NULL at the end
+ * of text.
+ */
+const char*
+Playlist::NextLine(const char* text, BString* line)
+{
+	if (*text == '\0')
+		return NULL;
+
+	size_t length = strcspn(text, "\r\n");
+	line->SetTo(text, length);
+	line->Trim();
+
+	text += length;
+	text += strspn(text, "\r\n");
+
+	return text;
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef _PLAYLIST_H
+#define _PLAYLIST_H
+
+
+#include <String.h>
+#include <StringList.h>
+#include <Url.h>
+
+
+// Entries kept from a playlist at most
+#define PLAYLIST_MAX_ENTRIES 16
+
+
+/**
+ * Reads the entries of PLS, M3U/M3U8 and XSPF playlists. Stations list their
+ * mirrors this way, so all entries are kept in the order of the playlist. An
+ * HLS playlist is the stream itself, so its only entry is its own URL.
+ *
+ * Anything that is no other playlist is read as M3U, which would make every
+ * line of an error page an entry. Entries are therefore only taken if they
+ * are URLs, or paths relative to the playlist if it is known to be an M3U.
+ */
+class Playlist {
+public:
+	static status_t Parse(const char* body, const BUrl& baseUrl, BStringList* urls,
+		BString* title = NULL, const char* contentType = NULL);
+
+	static bool IsM3uType(const char* contentType);
+	static const char* NextLine(const char* text, BString* line);
+
+private:
+	static void _ParsePls(const char* body, const BUrl& baseUrl, BStringList* urls, BString* title);
+	static void _ParseM3u(
+		const char* body, const BUrl& baseUrl, BStringList* urls, bool allowRelative);
+	static void _ParseXspf(
+		const char* body, const BUrl& baseUrl, BStringList* urls, BString* title);
+
+	static void _AddEntry(BStringList* urls, const BUrl& baseUrl, BString entry);
+	static bool _HasScheme(const BString& entry);
+	static bool _IsRelativePath(const BString& entry);
+};
+
+
+#endif	// _PLAYLIST_H
@@ -18,30 +18,90 @@
 
 #include <AboutWindow.h>
 #include <Catalog.h>
+#include <File.h>
+#include <StringList.h>
 
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Playlist.h"
 #include "RadioApp.h"
 #include "StationFinder.h"
 #include "StationFinderListenLive.h"
 #include "StationFinderRadioNetwork.h"
+#include "StreamIO.h"
 
 
 #undef B_TRANSLATION_CONTEXT
 #define B_TRANSLATION_CONTEXT "RadioApp"
 
 
+// Interval at which recording statistics are printed, unless set otherwise
+static const bigtime_t kDefaultStatsInterval = 60000000;
+
+// Size of a recording configuration file at most
+static const off_t kMaxConfigSize = 0x10000;
+
+
+// Released by the signal handler, for the quit thread to ask the application
+// to quit, which is no safe thing to do from a signal handler
+static sem_id sQuitSem = -1;
+
+
+static void
+quit_on_signal(int)
+{
+	release_sem_etc(sQuitSem, 1, B_DO_NOT_RESCHEDULE);
+}
+
+
+static int32
+quit_thread(void*)
+{
+	if (acquire_sem(sQuitSem) == B_OK)
+		be_app->PostMessage(B_QUIT_REQUESTED);
+
+	return B_OK;
+}
+
+
 RadioApp::RadioApp()
 	: BApplication(kAppSignature),
-	  fArgvMessage(NULL)
+	  mainWindow(NULL),
+	  fArgvMessage(NULL),
+	  fService(NULL)
 {
 }
 
 
-RadioApp::~RadioApp() {}
+RadioApp::~RadioApp()
+{
+	// Ends the quit thread if no signal came
+	if (sQuitSem >= 0)
+		delete_sem(sQuitSem);
+}
 
 
 void
 RadioApp::ReadyToRun()
 {
+	// Recording many stations is what the reactor is made for
+	StreamIO::SetUseReactor(fService != NULL || Settings.GetStreamReactor());
+	// Recording takes its limit from the command line
+	if (fService == NULL && Settings.GetBandwidthLimit() > 0)
+		StreamIO::SetGlobalBandwidthLimit(Settings.GetBandwidthLimit() * 125);
+
+	if (fService != NULL) {
+		status_t status = fService->Start();
+		if (status != B_OK) {
+			fprintf(stderr, B_TRANSLATE("Nothing to record: %s\n"), strerror(status));
+			PostMessage(B_QUIT_REQUESTED);
+		}
+		return;
+	}
+
 	mainWindow = new MainWindow();
 	mainWindow->Show();
 	if (fArgvMessage != NULL) {
@@ -68,6 +128,14 @@ RadioApp::RefsReceived(BMessage* message)
 void
 RadioApp::ArgvReceived(int32 argc, char** argv)
 {
+	if (argc > 1 && strcmp(argv[1], "--record") == 0) {
+		if (IsLaunching())
+			_ParseRecording(argc - 2, argv + 2);
+		else
+			fprintf(stderr, B_TRANSLATE("StreamRadio is running already.\n"));
+		return;
+	}
+
 	if (fArgvMessage == NULL)
 		fArgvMessage = new BMessage(B_REFS_RECEIVED);
 
@@ -79,7 +147,13 @@ RadioApp::ArgvReceived(int32 argc, char** argv)
 				B_TRANSLATE("Usage: StreamRadio <filename>\n"
 							"<filename> should be a Shoutcast playlist file.\n"
 							"If the station already exists, it is made to play "
-							"otherwise it is added.\n"));
+							"otherwise it is added.\n\n"
+							"Usage: StreamRadio --record [--directory <directory>] "
+							"[--stats <seconds>] [--stream-rate <kbit/s>] "
+							"[--total-rate <kbit/s>] [--config <file>] <station>...\n"
+							"Records the stations without playing them. A station is "
+							"the name of a saved station, a playlist file or a URL. "
+							"The config file holds one argument per line.\n"));
 			exit(1);
 		}
 
@@ -119,6 +193,142 @@ RadioApp::AboutRequested()
 }
 
 
+bool
+RadioApp::QuitRequested()
+{
+	if (fService != NULL) {
+		thread_id thread = fService->Thread();
+		fService->PostMessage(B_QUIT_REQUESTED);
+
+		status_t status;
+		wait_for_thread(thread, &status);
+		fService = NULL;
+	}
+
+	return BApplication::QuitRequested();
+}
+
+
+/**
+ * Sets up recording the stations given on the command line, instead of
+ * showing the main window. The recording stops on SIGINT or SIGTERM.
+ */
+void
+RadioApp::_ParseRecording(int32 argc, const char* const* argv)
+{
+	BStringList args;
+	for (int32 i = 0; i < argc; i++) {
+		if (strcmp(argv[i], "--config") == 0 && i + 1 < argc)
+			_ReadRecordingConfig(argv[++i], &args);
+		else
+			args.Add(argv[i]);
+	}
+
+	BPath directory = Settings.GetRecordingDirectory();
+	bigtime_t statsInterval = kDefaultStatsInterval;
+	size_t streamRate = 0;
+	BStringList stations;
+	for (int32 i = 0; i < args.CountStrings(); i++) {
+		if (args.StringAt(i) == "--directory" && i + 1 < args.CountStrings())
+			directory.SetTo(args.StringAt(++i));
+		else if (args.StringAt(i) == "--stats" && i + 1 < args.CountStrings())
+			statsInterval = atoll(args.StringAt(++i)) * 1000000;
+		else if (args.StringAt(i) == "--stream-rate" && i + 1 < args.CountStrings())
+			streamRate = atoi(args.StringAt(++i)) * 125;
+		else if (args.StringAt(i) == "--total-rate" && i + 1 < args.CountStrings())
+			StreamIO::SetGlobalBandwidthLimit(atoi(args.StringAt(++i)) * 125);
+		else
+			stations.Add(args.StringAt(i));
+	}
+
+	fService = new RecordingService(directory, statsInterval);
+	fService->SetBandwidthLimit(streamRate);
+	for (int32 i = 0; i < stations.CountStrings(); i++) {
+		Station* station = _LoadStation(stations.StringAt(i));
+		if (station != NULL)
+			fService->AddStation(station);
+		else
+			fprintf(stderr, B_TRANSLATE("Station %s not found\n"), stations.StringAt(i).String());
+	}
+
+	sQuitSem = create_sem(0, "quit signal");
+	if (sQuitSem < 0)
+		return;
+
+	thread_id thread = spawn_thread(&quit_thread, "quit on signal", B_NORMAL_PRIORITY, NULL);
+	if (thread < 0) {
+		delete_sem(sQuitSem);
+		sQuitSem = -1;
+		return;
+	}
+
+	resume_thread(thread);
+	signal(SIGINT, &quit_on_signal);
+	signal(SIGTERM, &quit_on_signal);
+}
+
+
+/**
+ * Reads arguments from a file, one per line. Options and their value share a
+ * line, empty lines and lines starting with '#' are skipped.
+ */
+void
+RadioApp::_ReadRecordingConfig(const char* path, BStringList* args)
+{
+	BFile file(path, B_READ_ONLY);
+	off_t size;
+	if (file.InitCheck() != B_OK || file.GetSize(&size) != B_OK || size > kMaxConfigSize) {
+		fprintf(stderr, B_TRANSLATE("Could not read %s\n"), path);
+		return;
+	}
+
+	BString text;
+	char* buffer = text.LockBuffer(size + 1);
+	ssize_t read = file.Read(buffer, size);
+	text.UnlockBuffer(read > 0 ? read : 0);
+
+	BString line;
+	const char* body = text.String();
+	while ((body = Playlist::NextLine(body, &line)) != NULL) {
+		if (line.IsEmpty() || line.StartsWith("#"))
+			continue;
+
+		int32 space = line.FindFirst(' ');
+		if (line.StartsWith("--") && space > 0) {
+			BString option;
+			line.MoveInto(option, 0, space);
+			args->Add(option);
+			line.Trim();
+		}
+
+		args->Add(line);
+	}
+}
+
+
+/**
+ * Loads a station to record by the name it was saved with, from a playlist
+ * file, or from a URL.
+ */
+Station*
+RadioApp::_LoadStation(const char* name)
+{
+	BString stationName(name);
+	Station* station = Settings.Stations->FindItem(&stationName);
+	if (station != NULL)
+		return new Station(*station);
+
+	BEntry entry(name);
+	if (entry.Exists()) {
+		char leaf[B_FILE_NAME_LENGTH];
+		entry.GetName(leaf);
+		return Station::Load(leaf, &entry);
+	}
+
+	return Station::LoadIndirectUrl(stationName);
+}
+
+
 /**
  * Application entry point
  */
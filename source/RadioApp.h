@@ -20,9 +20,11 @@
 
 #include <Application.h>
 #include <Message.h>
+#include <StringList.h>
 
 #include "MainWindow.h"
 #include "RadioSettings.h"
+#include "RecordingService.h"
 
 
 #define kAppSignature "application/x-vnd.Fishpond-StreamRadio"
@@ -37,13 +39,20 @@ public:
 	virtual void RefsReceived(BMessage* message);
 	virtual void ArgvReceived(int32 argc, char** argv);
 	virtual void AboutRequested();
+	virtual bool QuitRequested();
 
 	MainWindow* mainWindow;
 
 	RadioSettings Settings;
 
+private:
+	void _ParseRecording(int32 argc, const char* const* argv);
+	void _ReadRecordingConfig(const char* path, BStringList* args);
+	Station* _LoadStation(const char* name);
+
 private:
 	BMessage* fArgvMessage;
+	RecordingService* fService;
 };
 
 
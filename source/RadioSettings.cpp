@@ -27,6 +27,15 @@
 
 const char* kSettingsFileName = "StreamRadio.settings";
 
+// Time shift window, unless set otherwise
+const int32 kDefaultTimeShiftMinutes = 30;
+
+// Crossfade between stations, unless set otherwise
+const int32 kDefaultCrossfadeMilliseconds = 3000;
+
+// Where recordings go in the home directory, unless set otherwise
+const char* kDefaultRecordingDirectory = "music/StreamRadio";
+
 
 StationsList::StationsList()
 	: BObjectList<Station>()
@@ -91,8 +100,8 @@ StationsList::Load()
 
 	while ((status = stationsDir->GetNextEntry(&stationEntry)) == B_OK) {
 		Station* station = Station::LoadFromPlsFile(stationEntry.Name());
-		if (station != NULL && FindItem(station->Name()) == NULL)
-			AddItem(station);
+		if (station != NULL && !AddItem(station))
+			delete station;
 	}
 
 	return B_OK;
@@ -124,14 +133,6 @@ RadioSettings::RadioSettings()
 }
 
 
-RadioSettings::RadioSettings(const RadioSettings& orig)
-	: BMessage(orig)
-{
-	Stations = new StationsList();
-	Stations->AddList(orig.Stations);
-}
-
-
 RadioSettings::~RadioSettings()
 {
 	delete Stations;
@@ -173,6 +174,139 @@ RadioSettings::SetAllowParallelPlayback(bool set)
 }
 
 
+bool
+RadioSettings::GetPreconnect()
+{
+	return GetBool("preconnect");
+}
+
+
+void
+RadioSettings::SetPreconnect(bool set)
+{
+	SetBool("preconnect", set);
+}
+
+
+bool
+RadioSettings::GetTimeShift()
+{
+	return GetBool("timeshift");
+}
+
+
+void
+RadioSettings::SetTimeShift(bool set)
+{
+	SetBool("timeshift", set);
+}
+
+
+/**
+ * Returns how much of the playing station is kept for rewinding.
+ */
+int32
+RadioSettings::GetTimeShiftMinutes()
+{
+	return GetInt32("timeshiftMinutes", kDefaultTimeShiftMinutes);
+}
+
+
+bool
+RadioSettings::GetCrossfade()
+{
+	return GetBool("crossfade");
+}
+
+
+void
+RadioSettings::SetCrossfade(bool set)
+{
+	SetBool("crossfade", set);
+}
+
+
+/**
+ * Returns how long switching stations fades from one to the other.
+ */
+int32
+RadioSettings::GetCrossfadeMilliseconds()
+{
+	return GetInt32("crossfadeMilliseconds", kDefaultCrossfadeMilliseconds);
+}
+
+
+bool
+RadioSettings::GetNormalizeLoudness()
+{
+	return GetBool("normalizeLoudness");
+}
+
+
+void
+RadioSettings::SetNormalizeLoudness(bool set)
+{
+	SetBool("normalizeLoudness", set);
+}
+
+
+/**
+ * Returns whether stations found sending silence or a loop are connected to
+ * again, to the next mirror if they have one.
+ */
+bool
+RadioSettings::GetDeadAirFailover()
+{
+	return GetBool("deadAirFailover");
+}
+
+
+void
+RadioSettings::SetDeadAirFailover(bool set)
+{
+	SetBool("deadAirFailover", set);
+}
+
+
+/**
+ * Returns whether streams share the threads of the StreamReactor, instead of
+ * each having its own.
+ */
+bool
+RadioSettings::GetStreamReactor()
+{
+	return GetBool("streamReactor");
+}
+
+
+/**
+ * Returns the kbit/s that all streams together may receive at most, or 0 for
+ * no limit.
+ */
+int32
+RadioSettings::GetBandwidthLimit()
+{
+	return GetInt32("bandwidthLimit", 0);
+}
+
+
+/**
+ * Returns the directory that recorded streams are saved to.
+ */
+BPath
+RadioSettings::GetRecordingDirectory()
+{
+	const char* directory = GetString("recordingDirectory", NULL);
+	if (directory != NULL)
+		return BPath(directory);
+
+	BPath path;
+	find_directory(B_USER_DIRECTORY, &path);
+	path.Append(kDefaultRecordingDirectory);
+	return path;
+}
+
+
 const char*
 RadioSettings::StationFinderName()
 {
@@ -21,6 +21,7 @@
 #include <Entry.h>
 #include <Message.h>
 #include <ObjectList.h>
+#include <Path.h>
 
 #include "Station.h"
 
@@ -42,7 +43,6 @@ public:
 class RadioSettings : private BMessage {
 public:
 	RadioSettings();
-	RadioSettings(const RadioSettings& orig);
 	virtual ~RadioSettings();
 
 	status_t Save();
@@ -53,9 +53,35 @@ public:
 	bool GetAllowParallelPlayback();
 	void SetAllowParallelPlayback(bool set);
 
+	bool GetPreconnect();
+	void SetPreconnect(bool set);
+
+	bool GetTimeShift();
+	void SetTimeShift(bool set);
+	int32 GetTimeShiftMinutes();
+
+	bool GetCrossfade();
+	void SetCrossfade(bool set);
+	int32 GetCrossfadeMilliseconds();
+
+	bool GetNormalizeLoudness();
+	void SetNormalizeLoudness(bool set);
+
+	bool GetDeadAirFailover();
+	void SetDeadAirFailover(bool set);
+
+	BPath GetRecordingDirectory();
+
+	bool GetStreamReactor();
+	int32 GetBandwidthLimit();
+
 	StationsList* Stations;
 
 private:
+	// The stations are owned by their list, so settings cannot be copied
+	RadioSettings(const RadioSettings& orig);
+	RadioSettings& operator=(const RadioSettings& orig);
+
 	status_t _Load();
 };
 
@@ -0,0 +1,317 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "RecordingService.h"
+
+#include <Directory.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "Debug.h"
+#include "StreamIO.h"
+
+
+// Interval at which the streams are looked after
+static const bigtime_t kCheckInterval = 5000000;
+
+// Time to wait before starting a stream again that ended or failed to start
+static const bigtime_t kRestartDelay = 60000000;
+
+
+class RecordedStream {
+public:
+	RecordedStream(Station* station)
+		: fStation(station),
+		  fStream(NULL),
+		  fStarted(0),
+		  fProbed(false),
+		  fRestarts(0),
+		  fLastRecorded(0)
+	{
+	}
+
+	~RecordedStream()
+	{
+		delete fStream;
+		delete fStation;
+	}
+
+	Station* fStation;
+	StreamIO* fStream;
+	bigtime_t fStarted;
+	bool fProbed;
+	int32 fRestarts;
+	off_t fLastRecorded;
+	BString fTitle;
+};
+
+
+RecordingService::RecordingService(const BPath& directory, bigtime_t statsInterval)
+	: BLooper("recording service"),
+	  fDirectory(directory),
+	  fStatsInterval(statsInterval),
+	  fLastStats(0),
+	  fStreamRate(0),
+#if B_HAIKU_VERSION > B_HAIKU_VERSION_1_BETA_5
+	  fStreams(),
+#else
+	  fStreams(20, true),
+#endif
+	  fChecker(NULL),
+	  fCheckRunner(NULL)
+{
+}
+
+
+RecordingService::~RecordingService()
+{
+	delete fCheckRunner;
+	delete fChecker;
+}
+
+
+/**
+ * Adds a station to be recorded, which is owned by the service from now on.
+ */
+void
+RecordingService::AddStation(Station* station)
+{
+	fStreams.AddItem(new RecordedStream(station));
+}
+
+
+/**
+ * Probes all stations at once, each is started as soon as its probe is done.
+ */
+status_t
+RecordingService::Start()
+{
+	if (fStreams.IsEmpty())
+		return B_BAD_VALUE;
+
+	status_t status = create_directory(fDirectory.Path(), 0755);
+	if (status != B_OK)
+		return status;
+
+	BObjectList<Station> stations;
+	for (int32 i = 0; i < fStreams.CountItems(); i++)
+		stations.AddItem(fStreams.ItemAt(i)->fStation);
+
+	fChecker = new StationChecker(BMessenger(this));
+	status = fChecker->Check(&stations);
+	if (status != B_OK)
+		return status;
+
+	BMessage check(MSG_RECORDING_CHECK);
+	fCheckRunner = new BMessageRunner(BMessenger(this), &check, kCheckInterval);
+	fLastStats = system_time();
+
+	Run();
+	return B_OK;
+}
+
+
+void
+RecordingService::MessageReceived(BMessage* message)
+{
+	switch (message->what) {
+		case MSG_STATION_CHECKED:
+		{
+			Station* station = NULL;
+			BMessage result;
+			if (message->FindPointer("station", (void**)&station) != B_OK
+				|| message->FindMessage("result", &result) != B_OK)
+				break;
+
+			RecordedStream* stream = _Find(station);
+			if (stream == NULL)
+				break;
+
+			stream->fProbed = true;
+			if (message->GetInt32("status", B_ERROR) != B_OK) {
+				// Tried again later, a station may just be down for a while
+				printf("%s: probing failed\n", station->Name()->String());
+				stream->fStarted = system_time();
+				break;
+			}
+
+			station->ApplyProbeResult(&result);
+			_Start(stream);
+			break;
+		}
+
+		case MSG_META_CHANGE:
+		{
+			RecordedStream* stream = _Find(message->GetString("station", ""));
+			if (stream == NULL)
+				break;
+
+			stream->fTitle = message->GetString("streamtitle", "");
+			printf("%s: now plays %s\n", stream->fStation->Name()->String(),
+				stream->fTitle.String());
+			break;
+		}
+
+		case MSG_RECORDING_CHECK:
+			_Check();
+			break;
+
+		case MSG_STATION_CHECK_DONE:
+			break;
+
+		default:
+			BLooper::MessageReceived(message);
+			break;
+	}
+}
+
+
+bool
+RecordingService::QuitRequested()
+{
+	delete fCheckRunner;
+	fCheckRunner = NULL;
+
+	if (fChecker != NULL)
+		fChecker->Stop();
+
+	// Closes the streams, which writes out what is left of their recordings
+	_PrintStats();
+	fStreams.MakeEmpty();
+
+	return true;
+}
+
+
+RecordedStream*
+RecordingService::_Find(Station* station)
+{
+	for (int32 i = 0; i < fStreams.CountItems(); i++) {
+		if (fStreams.ItemAt(i)->fStation == station)
+			return fStreams.ItemAt(i);
+	}
+
+	return NULL;
+}
+
+
+RecordedStream*
+RecordingService::_Find(const char* name)
+{
+	for (int32 i = 0; i < fStreams.CountItems(); i++) {
+		if (*fStreams.ItemAt(i)->fStation->Name() == name)
+			return fStreams.ItemAt(i);
+	}
+
+	return NULL;
+}
+
+
+void
+RecordingService::_Start(RecordedStream* stream)
+{
+	delete stream->fStream;
+
+	stream->fStarted = system_time();
+	stream->fLastRecorded = 0;
+	stream->fStream = new StreamIO(stream->fStation, this);
+	stream->fStream->SetRecordOnly(true);
+	stream->fStream->SetBandwidthLimit(fStreamRate);
+
+	status_t status = stream->fStream->StartRecording(fDirectory);
+	if (status == B_OK)
+		status = stream->fStream->Open();
+
+	if (status != B_OK) {
+		printf("%s: could not start recording - %s\n", stream->fStation->Name()->String(),
+			strerror(status));
+		delete stream->fStream;
+		stream->fStream = NULL;
+	}
+}
+
+
+/**
+ * Starts streams again that ended after the stream gave up reconnecting, and
+ * prints the statistics when it is time to.
+ */
+void
+RecordingService::_Check()
+{
+	bigtime_t now = system_time();
+
+	for (int32 i = 0; i < fStreams.CountItems(); i++) {
+		RecordedStream* stream = fStreams.ItemAt(i);
+		if (!stream->fProbed)
+			continue;
+
+		if (stream->fStream != NULL
+			&& (stream->fStream->IsConnected() || stream->fStream->IsReconnecting()))
+			continue;
+
+		if (now - stream->fStarted < kRestartDelay)
+			continue;
+
+		printf("%s: restarting\n", stream->fStation->Name()->String());
+		stream->fRestarts++;
+		_Start(stream);
+	}
+
+	if (fStatsInterval > 0 && now - fLastStats >= fStatsInterval)
+		_PrintStats();
+}
+
+
+/**
+ * Prints a line per stream. It is left untranslated, as it is meant to be
+ * read by scripts as well.
+ */
+void
+RecordingService::_PrintStats()
+{
+	bigtime_t now = system_time();
+	bigtime_t elapsed = max_c(now - fLastStats, 1);
+	fLastStats = now;
+
+	for (int32 i = 0; i < fStreams.CountItems(); i++) {
+		RecordedStream* stream = fStreams.ItemAt(i);
+
+		const char* state = "stopped";
+		off_t recorded = 0;
+		off_t dropped = 0;
+		if (stream->fStream != NULL) {
+			if (stream->fStream->IsReconnecting())
+				state = "reconnecting";
+			else if (stream->fStream->IsConnected())
+				state = "recording";
+
+			stream->fStream->GetRecordingStats(&recorded, &dropped);
+		}
+
+		off_t rate = (recorded - stream->fLastRecorded) * 8000 / elapsed;
+		stream->fLastRecorded = recorded;
+
+		printf("%s: %s, %" B_PRIdOFF " KiB, %" B_PRIdOFF " kbit/s, %" B_PRIdOFF
+			   " KiB dropped, %" B_PRId32 " restarts, \"%s\"\n",
+			stream->fStation->Name()->String(), state, recorded / 1024, rate, dropped / 1024,
+			stream->fRestarts, stream->fTitle.String());
+	}
+
+	fflush(stdout);
+}
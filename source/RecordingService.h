@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef _RECORDING_SERVICE_H
+#define _RECORDING_SERVICE_H
+
+
+#include <Looper.h>
+#include <MessageRunner.h>
+#include <ObjectList.h>
+#include <Path.h>
+
+#include "Station.h"
+#include "StationChecker.h"
+
+
+#define MSG_RECORDING_CHECK 'mRCK'
+
+
+class RecordedStream;
+
+
+/**
+ * Records stations without playing them or showing any window, for running
+ * from the command line. Each station is received by a StreamIO of its own
+ * that only feeds its recorder, and streams that end are started again.
+ * Statistics on every stream are printed at a regular interval.
+ */
+class RecordingService : public BLooper {
+public:
+	RecordingService(const BPath& directory, bigtime_t statsInterval);
+	virtual ~RecordingService();
+
+	void AddStation(Station* station);
+	void SetBandwidthLimit(size_t rate) { fStreamRate = rate; }
+	int32 CountStations() const { return fStreams.CountItems(); }
+	status_t Start();
+
+	virtual void MessageReceived(BMessage* message);
+	virtual bool QuitRequested();
+
+private:
+	RecordedStream* _Find(Station* station);
+	RecordedStream* _Find(const char* name);
+	void _Start(RecordedStream* stream);
+	void _Check();
+	void _PrintStats();
+
+private:
+	BPath fDirectory;
+	bigtime_t fStatsInterval;
+	bigtime_t fLastStats;
+	size_t fStreamRate;
+#if B_HAIKU_VERSION > B_HAIKU_VERSION_1_BETA_5
+	BObjectList<RecordedStream, true> fStreams;
+#else
+	BObjectList<RecordedStream> fStreams;
+#endif
+	StationChecker* fChecker;
+	BMessageRunner* fCheckRunner;
+};
+
+
+#endif	// _RECORDING_SERVICE_H
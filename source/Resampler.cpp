@@ -0,0 +1,216 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "Resampler.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "PcmDsp.h"
+
+
+// The pass band ends this much below the lower Nyquist frequency, leaving
+// room for the transition band.
+static const double kPassBand = 0.9;
+
+
+static uint32
+greatest_common_divisor(uint32 a, uint32 b)
+{
+	while (b != 0) {
+		uint32 rest = a % b;
+		a = b;
+		b = rest;
+	}
+
+	return a;
+}
+
+
+Resampler::Resampler(uint32 inputRate, uint32 outputRate, uint32 channels, size_t maxFrames)
+	: fInitStatus(B_NO_INIT),
+	  fChannels(channels),
+	  fMaxFrames(maxFrames),
+	  fUp(1),
+	  fDown(1),
+	  fPhases(1),
+	  fFilter(NULL),
+	  fHistory(NULL),
+	  fFilled(0),
+	  fPhase(0)
+{
+	if (inputRate == 0 || outputRate == 0 || channels == 0) {
+		fInitStatus = B_BAD_VALUE;
+		return;
+	}
+
+	uint32 divisor = greatest_common_divisor(inputRate, outputRate);
+	fUp = outputRate / divisor;
+	fDown = inputRate / divisor;
+
+	// The filter would skip input frames
+	if (fDown > fUp * (RESAMPLER_TAPS / 2)) {
+		fInitStatus = B_NOT_SUPPORTED;
+		return;
+	}
+	fPhases = min_c(fUp, RESAMPLER_MAX_PHASES);
+
+	// One more phase, for positions rounding up to the next input frame
+	fFilter = (float*)malloc((fPhases + 1) * RESAMPLER_TAPS * sizeof(float));
+	fHistory = (float**)calloc(channels, sizeof(float*));
+	if (fFilter == NULL || fHistory == NULL) {
+		fInitStatus = B_NO_MEMORY;
+		return;
+	}
+
+	for (uint32 c = 0; c < channels; c++) {
+		fHistory[c] = (float*)malloc((RESAMPLER_TAPS + maxFrames) * sizeof(float));
+		if (fHistory[c] == NULL) {
+			fInitStatus = B_NO_MEMORY;
+			return;
+		}
+	}
+
+	_BuildFilter(inputRate, outputRate);
+	Reset();
+
+	fInitStatus = B_OK;
+}
+
+
+Resampler::~Resampler()
+{
+	if (fHistory != NULL) {
+		for (uint32 c = 0; c < fChannels; c++)
+			free(fHistory[c]);
+	}
+
+	free(fHistory);
+	free(fFilter);
+}
+
+
+/**
+ * Returns the most frames Process() produces from fMaxFrames input frames.
+ */
+size_t
+Resampler::MaxOutputFrames() const
+{
+	return (uint64)fMaxFrames * fUp / fDown + 2;
+}
+
+
+/**
+ * Resamples frames of input into output, which must have room for
+ * MaxOutputFrames(), and returns how many frames were written. The output
+ * lags RESAMPLER_TAPS / 2 input frames behind the input. Between equal rates
+ * the input is copied as it is, as the filter would only take off the top of
+ * the band.
+ */
+size_t
+Resampler::Process(const float* input, size_t frames, float* output)
+{
+	frames = min_c(frames, fMaxFrames);
+
+	if (fUp == fDown) {
+		memcpy(output, input, frames * fChannels * sizeof(float));
+		return frames;
+	}
+
+	for (size_t i = 0; i < frames; i++) {
+		for (uint32 c = 0; c < fChannels; c++)
+			fHistory[c][fFilled + i] = input[i * fChannels + c];
+	}
+	fFilled += frames;
+
+	size_t written = 0;
+	size_t start = 0;
+	while (start + RESAMPLER_TAPS <= fFilled) {
+		// The nearest phase, which is exact unless the phases are thinned out
+		uint32 phase = ((uint64)fPhase * fPhases + fUp / 2) / fUp;
+		const float* filter = fFilter + phase * RESAMPLER_TAPS;
+
+		for (uint32 c = 0; c < fChannels; c++) {
+			output[written * fChannels + c]
+				= PcmDsp::DotProduct(fHistory[c] + start, filter, RESAMPLER_TAPS);
+		}
+		written++;
+
+		fPhase += fDown;
+		start += fPhase / fUp;
+		fPhase %= fUp;
+	}
+
+	// Keep the frames the next output frames begin with
+	fFilled -= start;
+	for (uint32 c = 0; c < fChannels; c++)
+		memmove(fHistory[c], fHistory[c] + start, fFilled * sizeof(float));
+
+	return written;
+}
+
+
+/**
+ * Forgets the input so far, as when a stream starts over.
+ */
+void
+Resampler::Reset()
+{
+	// Silence before the first frame, which the first output frame is centred on
+	fFilled = RESAMPLER_TAPS / 2 - 1;
+	fPhase = 0;
+	for (uint32 c = 0; c < fChannels; c++)
+		memset(fHistory[c], 0, fFilled * sizeof(float));
+}
+
+
+/**
+ * Computes a Blackman windowed sinc for each phase. Phase p produces the
+ * output frame p / fPhases input frames after the one at the centre tap, up to
+ * phase fPhases, which is a whole frame after it.
+ * Each phase is normalized to a gain of one, so that the phases do not
+ * modulate the signal.
+ */
+void
+Resampler::_BuildFilter(uint32 inputRate, uint32 outputRate)
+{
+	// Cutoff relative to the input rate, below the lower of both Nyquist rates
+	double cutoff = kPassBand * min_c(1.0, (double)outputRate / inputRate);
+	const double halfWidth = RESAMPLER_TAPS / 2;
+
+	for (uint32 p = 0; p <= fPhases; p++) {
+		float* filter = fFilter + p * RESAMPLER_TAPS;
+		double sum = 0;
+
+		for (uint32 k = 0; k < RESAMPLER_TAPS; k++) {
+			double t = (double)p / fPhases + halfWidth - 1 - k;
+			double x = M_PI * cutoff * t;
+			double sinc = t == 0 ? 1.0 : sin(x) / x;
+			double w = t / halfWidth;
+			double window = fabs(w) >= 1.0 ? 0.0
+				: 0.42 + 0.5 * cos(M_PI * w) + 0.08 * cos(2 * M_PI * w);
+
+			filter[k] = sinc * window;
+			sum += filter[k];
+		}
+
+		for (uint32 k = 0; k < RESAMPLER_TAPS; k++)
+			filter[k] /= sum;
+	}
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef _RESAMPLER_H
+#define _RESAMPLER_H
+
+
+#include <SupportDefs.h>
+
+
+// Filter taps per output sample, half of which are the delay in input frames
+#define RESAMPLER_TAPS 32
+
+// Phases a filter table has at most, finer ones are rounded to these
+#define RESAMPLER_MAX_PHASES 512
+
+
+/**
+ * Converts interleaved float audio between sample rates with a polyphase
+ * windowed sinc filter. The rates are reduced to a ratio of up/down, and one
+ * filter phase is precomputed for each of the up positions between two input
+ * frames. Ratios of the common rates need a few hundred phases at most.
+ */
+class Resampler {
+public:
+	Resampler(uint32 inputRate, uint32 outputRate, uint32 channels, size_t maxFrames);
+	~Resampler();
+
+	status_t InitCheck() const { return fInitStatus; }
+
+	size_t MaxOutputFrames() const;
+	size_t Process(const float* input, size_t frames, float* output);
+	void Reset();
+
+private:
+	void _BuildFilter(uint32 inputRate, uint32 outputRate);
+
+private:
+	status_t fInitStatus;
+	uint32 fChannels;
+	size_t fMaxFrames;
+
+	uint32 fUp;
+	uint32 fDown;
+	uint32 fPhases;
+	float* fFilter;
+
+	// Input frames of each channel, beginning with those still needed
+	float** fHistory;
+	size_t fFilled;
+	uint32 fPhase;
+};
+
+
+#endif	// _RESAMPLER_H
@@ -19,10 +19,11 @@
 
 #include "Station.h"
 
-#include <regex.h>
+#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <exception>
 
 #include <Alert.h>
@@ -35,6 +36,7 @@
 #include <HttpRequest.h>
 #include <HttpResult.h>
 #include <MediaFile.h>
+#include <MediaFormats.h>
 #include <MediaTrack.h>
 #include <Message.h>
 #include <Mime.h>
@@ -46,8 +48,11 @@
 #include <UrlSynchronousRequest.h>
 #include <fs_attr.h>
 
+#include "AudioHeader.h"
 #include "Debug.h"
 #include "HttpUtils.h"
+#include "Markup.h"
+#include "Playlist.h"
 
 
 #undef B_TRANSLATION_CONTEXT
@@ -57,6 +62,9 @@
 const char* kSubDirStations = "Stations";
 const char* kMimePls = "audio/x-scpls";
 
+// Mirrors probed when the fastest one does not respond
+static const int32 kMaxProbedMirrors = 3;
+
 
 Station::Station(BString name, BString uri)
 	: fName(name),
@@ -69,13 +77,15 @@ Station::Station(BString name, BString uri)
 	  fMime(B_EMPTY_STRING),
 	  fEncoding(0),
 	  fLogo(NULL),
+	  fLogoRevision(0),
 	  fRating(0),
 	  fBitRate(0),
 	  fSampleRate(0),
 	  fUniqueIdentifier(B_EMPTY_STRING),
 	  fMetaInterval(0),
 	  fChannels(0),
-	  fFlags(0)
+	  fFlags(0),
+	  fLoudness(0)
 {
 	CheckFlags();
 	if (Flags(STATION_URI_VALID) && !Flags(STATION_HAS_FORMAT))
@@ -91,13 +101,18 @@ Station::Station(const Station& orig)
 	  fCountry(orig.fCountry),
 	  fLanguage(orig.fLanguage),
 	  fSource(B_EMPTY_STRING),
+	  fMirrors(orig.fMirrors),
 	  fEncoding(orig.fEncoding),
+	  fLogoRevision(0),
 	  fRating(orig.fRating),
 	  fBitRate(orig.fBitRate),
 	  fSampleRate(orig.fSampleRate),
 	  fUniqueIdentifier(orig.fUniqueIdentifier),
 	  fMetaInterval(orig.fMetaInterval),
-	  fChannels(orig.fChannels)
+	  fChannels(orig.fChannels),
+	  fFlags(orig.fFlags),
+	  fFrameSize(orig.fFrameSize),
+	  fLoudness(orig.fLoudness)
 {
 	fMime.SetTo(orig.fMime.Type());
 	fLogo = (orig.fLogo) ? new BBitmap(orig.fLogo) : NULL;
@@ -105,6 +120,40 @@ Station::Station(const Station& orig)
 }
 
 
+/**
+ * Takes over the strings collected by builder. The station is not probed, that
+ * is left to whoever decides to keep it.
+ */
+Station::Station(StationBuilder& builder)
+	: fStreamUrl(builder.fStreamUrl),
+	  fStationUrl(builder.fStationUrl),
+	  fSource(builder.fSource),
+	  fMime(B_EMPTY_STRING),
+	  fEncoding(0),
+	  fLogo(NULL),
+	  fLogoRevision(0),
+	  fRating(0),
+	  fBitRate(builder.fBitRate),
+	  fSampleRate(0),
+	  fMetaInterval(0),
+	  fChannels(0),
+	  fFlags(0),
+	  fFrameSize(0),
+	  fLoudness(0),
+	  fUnsaved(true)
+{
+	fName.Adopt(builder.fName);
+	CleanName();
+
+	fGenre = StringPool::Intern(builder.fGenre);
+	fCountry = StringPool::Intern(builder.fCountry);
+	fLanguage = StringPool::Intern(builder.fLanguage);
+	fUniqueIdentifier.Adopt(builder.fUniqueIdentifier);
+
+	CheckFlags();
+}
+
+
 Station::~Station()
 {
 	delete fLogo;
@@ -145,8 +194,14 @@ Station::Save()
 	if (status != B_OK)
 		return status;
 
+	// The mirrors go into the playlist, too, so that other players see them
 	BString content;
-	content << "[playlist]\nNumberOfEntries=1\nFile1=" << fStreamUrl << "\n";
+	if (fMirrors.CountStrings() > 1) {
+		content << "[playlist]\nNumberOfEntries=" << fMirrors.CountStrings() << "\n";
+		for (int32 i = 0; i < fMirrors.CountStrings(); i++)
+			content << "File" << i + 1 << "=" << fMirrors.StringAt(i) << "\n";
+	} else
+		content << "[playlist]\nNumberOfEntries=1\nFile1=" << fStreamUrl << "\n";
 	stationFile.Write(content.LockBuffer(-1), content.CountBytes(0, content.CountChars()));
 	content.UnlockBuffer();
 
@@ -161,6 +216,8 @@ Station::Save()
 	status
 		= stationFile.WriteAttr("META:framesize", B_INT32_TYPE, 0, &fFrameSize, sizeof(fFrameSize));
 	status = stationFile.WriteAttr("META:rating", B_INT32_TYPE, 0, &fRating, sizeof(fRating));
+	status = stationFile.WriteAttr(
+		"META:loudness", B_FLOAT_TYPE, 0, &fLoudness, sizeof(fLoudness));
 	status = stationFile.WriteAttr(
 		"META:interval", B_INT32_TYPE, 0, &fMetaInterval, sizeof(fMetaInterval));
 	status = stationFile.WriteAttrString("META:genre", &fGenre);
@@ -172,6 +229,8 @@ Station::Save()
 	status = stationFile.WriteAttrString("META:mime", &mimeType);
 	status = stationFile.WriteAttr("META:encoding", B_INT32_TYPE, 0, &fEncoding, sizeof(fEncoding));
 	status = stationFile.WriteAttrString("META:uniqueidentifier", &fUniqueIdentifier);
+	BString mirrors = fMirrors.Join("\n");
+	status = stationFile.WriteAttrString("META:mirrors", &mirrors);
 	status = stationFile.Unlock();
 
 	BNodeInfo stationInfo;
@@ -228,7 +287,7 @@ Station::RetrieveStreamUrl()
 
 	BMallocIO* plsData = HttpUtils::GetAll(fSource, NULL, 100000, &contentType, 2000);
 	if (plsData != NULL) {
-		status = ParseUrlReference((const char*)plsData->Buffer(), fSource);
+		status = ParseUrlReference((const char*)plsData->Buffer(), fSource, contentType.String());
 		delete plsData;
 	}
 
@@ -241,18 +300,21 @@ Station::RetrieveStreamUrl()
 }
 
 
-status_t
-Station::Probe()
-{
-	BHttpHeaders headers;
-	BMallocIO* buffer;
-	BString contentType("audio/*");
+// Bytes fetched from a stream to find out about its format
+static const size_t kProbeSize = 4096;
 
-	// If source URL is a playlist, retrieve the actual stream URL
-	// if (fSource.Path().EndsWith(".pls") ||
-	//					fSource.Path().EndsWith(".m3u") ||
-	//					fSource.Path().EndsWith(".m3u8"))
-	RetrieveStreamUrl();
+
+/**
+ * Fetches the first bytes of url. Falls back to connecting to the address
+ * that accepts connections if the plain request finds no server at all.
+ */
+static BMallocIO*
+FetchStart(const BUrl& url, BHttpHeaders* headers, bigtime_t timeout, BString* contentType)
+{
+	contentType->SetTo("*/*");
+	BMallocIO* buffer = HttpUtils::GetAll(url, headers, timeout, contentType, kProbeSize);
+	if (buffer != NULL || headers->CountHeaders() > 0 || url.Protocol() == "https")
+		return buffer;
 
 	// FIXME: UGLY HACK!
 	// Currently Haiku's HttpRequest is not able to check for connection on a
@@ -272,15 +334,139 @@ Station::Probe()
 	// of streams using HTTPS and load balancing between two or more different
 	// IP's should be small, anyway.
 
-	if (fStreamUrl.Protocol() == "https") {
-		buffer = HttpUtils::GetAll(fStreamUrl, &headers, 2 * 1000 * 1000, &contentType, 4096);
-	} else {
-		BUrl resolvedUrl;
-		status_t resolveStatus = HttpUtils::CheckPort(fStreamUrl, &resolvedUrl);
-		if (resolveStatus != B_OK)
-			return B_ERROR;
+	BUrl resolvedUrl;
+	if (HttpUtils::CheckPort(url, &resolvedUrl) != B_OK)
+		return NULL;
+
+	contentType->SetTo("*/*");
+	return HttpUtils::GetAll(resolvedUrl, headers, timeout, contentType, kProbeSize);
+}
+
+
+/**
+ * Tells whether a response is the audio stream itself, rather than a
+ * playlist or web page pointing to it.
+ */
+static bool
+IsStreamResponse(BString contentType, const BHttpHeaders& headers, BMallocIO* buffer)
+{
+	if (headers.HasHeader("Icy-Name") >= 0 || headers.HasHeader("Icy-Br") >= 0
+		|| headers.HasHeader("Icy-metaint") >= 0)
+		return true;
+
+	int32 pos = contentType.FindFirst(';');
+	if (pos >= 0)
+		contentType.Truncate(pos);
+	contentType.Trim().ToLower();
+
+	static const char* kPlaylistTypes[] = {"audio/x-scpls", "audio/scpls", "audio/x-mpegurl",
+		"audio/mpegurl", "application/vnd.apple.mpegurl", "application/x-mpegurl",
+		"application/pls+xml", "application/xspf+xml", NULL};
+	for (int32 i = 0; kPlaylistTypes[i] != NULL; i++) {
+		if (contentType == kPlaylistTypes[i])
+			return false;
+	}
+
+	if (contentType.StartsWith("audio/") || contentType == "application/ogg")
+		return true;
+
+	if (contentType != "application/octet-stream")
+		return false;
+
+	// Servers often do not care about the type of playlists, look at them
+	const char* data = (const char*)buffer->Buffer();
+	size_t size = buffer->BufferLength();
+	size_t start = 0;
+	while (start < size && isspace(data[start]))
+		start++;
+
+	static const char* kPlaylistStarts[]
+		= {"[playlist]", "#EXTM3U", "http://", "https://", "<?xml", NULL};
+	for (int32 i = 0; kPlaylistStarts[i] != NULL; i++) {
+		size_t length = strlen(kPlaylistStarts[i]);
+		if (size - start >= length && strncasecmp(data + start, kPlaylistStarts[i], length) == 0)
+			return false;
+	}
+
+	return true;
+}
+
+
+static inline bool
+is_canceled(int32* cancel)
+{
+	return cancel != NULL && atomic_get(cancel) != 0;
+}
+
 
-		buffer = HttpUtils::GetAll(resolvedUrl, &headers, 2 * 1000 * 1000, &contentType, 4096);
+/**
+ * Finds out about the stream, following the source if it is a playlist. The
+ * first response is only fetched once: if it already is the stream, its
+ * headers and bytes are used to detect the format right away. Setting cancel
+ * makes the probe give up before its next request.
+ */
+status_t
+Station::Probe(bigtime_t timeout, int32* cancel)
+{
+	BHttpHeaders headers;
+	BString contentType;
+
+	BUrl url = fSource.IsValid() ? fSource : fStreamUrl;
+	BMallocIO* buffer = FetchStart(url, &headers, timeout, &contentType);
+
+	if (is_canceled(cancel)) {
+		delete buffer;
+		return B_CANCELED;
+	}
+
+	if (buffer != NULL && IsStreamResponse(contentType, headers, buffer))
+		fStreamUrl = url;
+	else if (buffer != NULL) {
+		buffer->Write("", 1);
+		status_t status
+			= ParseUrlReference((const char*)buffer->Buffer(), url, contentType.String());
+		delete buffer;
+		buffer = NULL;
+
+		// Fall back on the next mirror if the fastest one does not respond
+		if (status == B_OK) {
+			RankMirrors(timeout);
+
+			int32 count = min_c(max_c(fMirrors.CountStrings(), 1), kMaxProbedMirrors);
+			for (int32 i = 0; buffer == NULL && i < count; i++) {
+				if (is_canceled(cancel))
+					return B_CANCELED;
+
+				if (i > 0)
+					fStreamUrl.SetUrlString(fMirrors.StringAt(i));
+
+				headers.Clear();
+				buffer = FetchStart(fStreamUrl, &headers, timeout, &contentType);
+				if (buffer != NULL && i > 0) {
+					BString mirror = fMirrors.StringAt(i);
+					fMirrors.Remove(i);
+					fMirrors.Add(mirror, 0);
+				}
+			}
+		}
+	}
+
+	if (is_canceled(cancel)) {
+		delete buffer;
+		return B_CANCELED;
+	}
+
+	// The headers and format of an HLS stream are those of its segments
+	if (buffer != NULL && IsHls()) {
+		delete buffer;
+		buffer = NULL;
+		headers.Clear();
+
+		HlsPlaylist playlist;
+		if (playlist.Load(fStreamUrl, timeout) == B_OK && playlist.CountSegments() > 0) {
+			buffer = FetchStart(playlist.SegmentAt(playlist.CountSegments() - 1), &headers,
+				timeout, &contentType);
+		}
 	}
 
 #ifdef DEBUGGING
@@ -289,12 +475,12 @@ Station::Probe()
 #endif
 
 	if (buffer == NULL) {
-		fFlags &= !STATION_URI_VALID;
+		fFlags &= ~STATION_URI_VALID;
 		return B_ERROR;
 	}
 
 	if (headers.CountHeaders() == 0) {
-		fFlags &= !STATION_URI_VALID;
+		fFlags &= ~STATION_URI_VALID;
 		delete buffer;
 		return B_TIMED_OUT;
 	}
@@ -311,7 +497,7 @@ Station::Probe()
 		fBitRate = atoi(headers[index].Value()) * 1000;
 
 	if ((index = headers.HasHeader("Icy-Genre")) >= 0)
-		fGenre = headers[index].Value();
+		fGenre = StringPool::Intern(headers[index].Value());
 
 	if ((index = headers.HasHeader("Icy-Url")) >= 0 && strlen(headers[index].Value()) > 0)
 		fStationUrl.SetUrlString(headers[index].Value());
@@ -353,9 +539,87 @@ Station::Probe()
 }
 
 
+/**
+ * Stores what Probe() found out about the stream, so that it can be applied
+ * to another Station object with ApplyProbeResult().
+ */
+void
+Station::ArchiveProbeResult(BMessage* into)
+{
+	into->AddString("streamurl", fStreamUrl.UrlString());
+	into->AddString("mime", fMime.Type());
+	into->AddUInt32("encoding", fEncoding);
+	into->AddUInt32("bitrate", fBitRate);
+	into->AddUInt32("samplerate", fSampleRate);
+	into->AddUInt32("channels", fChannels);
+	into->AddUInt32("interval", fMetaInterval);
+	into->AddUInt64("framesize", fFrameSize);
+	into->AddUInt32("flags", fFlags);
+
+	for (int32 i = 0; i < fMirrors.CountStrings(); i++)
+		into->AddString("mirror", fMirrors.StringAt(i));
+}
+
+
+void
+Station::ApplyProbeResult(const BMessage* from)
+{
+	BString streamUrl;
+	if (from->FindString("streamurl", &streamUrl) == B_OK && !streamUrl.IsEmpty())
+		fStreamUrl.SetUrlString(streamUrl);
+
+	BStringList mirrors;
+	if (from->FindStrings("mirror", &mirrors) == B_OK)
+		fMirrors = mirrors;
+
+	const char* mime;
+	if (from->FindString("mime", &mime) == B_OK && BMimeType::IsValid(mime))
+		fMime.SetTo(mime);
+
+	fEncoding = from->GetUInt32("encoding", fEncoding);
+	fBitRate = from->GetUInt32("bitrate", fBitRate);
+	fSampleRate = from->GetUInt32("samplerate", fSampleRate);
+	fChannels = from->GetUInt32("channels", fChannels);
+	fMetaInterval = from->GetUInt32("interval", fMetaInterval);
+	fFrameSize = from->GetUInt64("framesize", fFrameSize);
+
+	// Keep the outcome of the probe, a dead stream keeps a valid looking URL
+	CheckFlags();
+	if ((from->GetUInt32("flags", fFlags) & STATION_URI_VALID) == 0)
+		fFlags &= ~STATION_URI_VALID;
+
+	fUnsaved = true;
+}
+
+
+/**
+ * Detects the stream format from the start of a stream. The frame headers of
+ * common codecs are parsed directly, the media kit is only asked for others.
+ */
 status_t
 Station::ProbeBuffer(BPositionIO* buffer)
 {
+	uint8 data[kProbeSize];
+	ssize_t size = buffer->ReadAt(0, data, sizeof(data));
+
+	audio_header_info info;
+	if (size > 0 && AudioHeader::Identify(data, size, &info) == B_OK) {
+		fSampleRate = info.sampleRate;
+		fChannels = info.channels;
+		if (info.bitRate != 0)
+			fBitRate = info.bitRate;
+		fFrameSize = info.frameSize;
+
+		// Only MPEG audio has an encoding known without asking a decoder,
+		// the one stored for what the station sent before must not stay
+		fEncoding = 0;
+		if (info.codec == AUDIO_CODEC_MPEG)
+			fEncoding = MpegEncoding(info.mpegVersion, info.mpegLayer);
+
+		CheckFlags();
+		return B_OK;
+	}
+
 	status_t status = B_OK;
 	BMediaFile mediaFile(buffer);
 
@@ -388,31 +652,59 @@ Station::ProbeBuffer(BPositionIO* buffer)
 }
 
 
+/**
+ * Looks up the media kit encoding for an MPEG audio stream.
+ */
+uint32
+Station::MpegEncoding(uint32 version, uint32 layer)
+{
+	media_format_description description;
+	description.family = B_MPEG_FORMAT_FAMILY;
+	if (version == 1)
+		description.u.mpeg.id = B_MPEG_1_AUDIO_LAYER_1 + layer - 1;
+	else if (version == 2)
+		description.u.mpeg.id = B_MPEG_2_AUDIO_LAYER_1 + layer - 1;
+	else
+		description.u.mpeg.id = B_MPEG_2_5_AUDIO_LAYER_1 + layer - 1;
+
+	media_format format;
+	BMediaFormats formats;
+	if (formats.GetFormatFor(description, &format) != B_OK)
+		return 0;
+
+	return format.u.encoded_audio.encoding;
+}
+
+
 status_t
-Station::ParseUrlReference(const char* body, const BUrl& baseUrl)
-{
-	const char* patterns[4] = {"^file[0-9]+=([^\r\n]*)[\r\n$]+",  // ShoutcastUrl
-		"^(http://[^\r\n]*)[\r\n]+$",							  // Mpeg Url;
-		"^([^#]+[^\r\n]*)[\r\n]+$",								  // Mpeg Url;
-		"^title[0-9]+=([^\r\n]*)[\r\n$]+"};						  // Shoutcast alternativ;
-
-	for (int32 i = 0; i < 3; i++) {
-		char* match = RegFind(body, patterns[i]);
-		if (match != NULL) {
-			fStreamUrl = BUrl(baseUrl, match);
-			free(match);
-
-			match = RegFind(body, patterns[3]);
-			if (match != NULL) {
-				SetName(match);
-				free(match);
-			}
+Station::ParseUrlReference(const char* body, const BUrl& baseUrl, const char* contentType)
+{
+	BStringList urls;
+	BString title;
+	if (Playlist::Parse(body, baseUrl, &urls, &title, contentType) != B_OK)
+		return B_ERROR;
 
-			return B_OK;
-		}
-	}
+	fMirrors = urls;
+	fStreamUrl.SetUrlString(fMirrors.StringAt(0));
+	if (!title.IsEmpty())
+		SetName(title);
+
+	return B_OK;
+}
+
+
+/**
+ * Puts the mirror that can be connected to fastest first, and makes it the
+ * stream URL.
+ */
+void
+Station::RankMirrors(bigtime_t timeout)
+{
+	if (fMirrors.CountStrings() < 2)
+		return;
 
-	return B_ERROR;
+	HttpUtils::SortByLatency(&fMirrors, timeout);
+	fStreamUrl.SetUrlString(fMirrors.StringAt(0));
 }
 
 
@@ -437,11 +729,17 @@ Station::Load(BString name, BEntry* entry)
 
 	station->fStreamUrl.SetUrlString(readString);
 
-	status = file.ReadAttrString("META:genre", &station->fGenre);
+	status = file.ReadAttrString("META:genre", &readString);
+	if (status == B_OK)
+		station->fGenre = StringPool::Intern(readString);
 
-	status = file.ReadAttrString("META:country", &station->fCountry);
+	status = file.ReadAttrString("META:country", &readString);
+	if (status == B_OK)
+		station->fCountry = StringPool::Intern(readString);
 
-	status = file.ReadAttrString("META:language", &station->fLanguage);
+	status = file.ReadAttrString("META:language", &readString);
+	if (status == B_OK)
+		station->fLanguage = StringPool::Intern(readString);
 
 	status = file.ReadAttr(
 		"META:bitrate", B_INT32_TYPE, 0, &station->fBitRate, sizeof(station->fBitRate));
@@ -449,6 +747,9 @@ Station::Load(BString name, BEntry* entry)
 	status = file.ReadAttr(
 		"META:rating", B_INT32_TYPE, 0, &station->fRating, sizeof(station->fRating));
 
+	status = file.ReadAttr(
+		"META:loudness", B_FLOAT_TYPE, 0, &station->fLoudness, sizeof(station->fLoudness));
+
 	status = file.ReadAttr(
 		"META:interval", B_INT32_TYPE, 0, &station->fMetaInterval, sizeof(station->fMetaInterval));
 
@@ -476,6 +777,10 @@ Station::Load(BString name, BEntry* entry)
 	status = file.ReadAttrString("META:uniqueidentifier", &readString);
 	station->fUniqueIdentifier.SetTo(readString);
 
+	status = file.ReadAttrString("META:mirrors", &readString);
+	if (status == B_OK)
+		readString.Split("\n", true, station->fMirrors);
+
 	attr_info attrInfo;
 	status = file.GetAttrInfo("logo", &attrInfo);
 	if (status == B_OK) {
@@ -510,9 +815,15 @@ Station::Load(BString name, BEntry* entry)
 		if (size > 10000)
 			return NULL;
 
-		char* buffer = (char*)malloc(size);
-		file.Read(buffer, size);
-		station->ParseUrlReference(buffer, BUrl(BPath(entry)));
+		char* buffer = (char*)malloc(size + 1);
+		ssize_t read = file.Read(buffer, size);
+		buffer[max_c(read, 0)] = '\0';
+
+		// Relative entries are only taken from files typed as M3U
+		char type[B_MIME_TYPE_LENGTH];
+		if (stationInfo.GetType(type) != B_OK)
+			type[0] = '\0';
+		station->ParseUrlReference(buffer, BUrl(BPath(entry)), type);
 		free(buffer);
 	}
 
@@ -530,25 +841,24 @@ Station::Load(BString name, BEntry* entry)
 }
 
 
-char*
-Station::RegFind(const char* text, const char* pattern)
+/**
+ * Returns the site icon linked from an HTML page, preferring the one for
+ * browser tabs.
+ */
+static BString
+FindIcon(const char* body)
 {
-	regex_t patternBuffer;
-	regmatch_t matchBuffer[20];
-	int result;
-	char* match = NULL;
-
-	memset(&patternBuffer, 0, sizeof(patternBuffer));
-	memset(matchBuffer, 0, sizeof(matchBuffer));
-
-	result = regcomp(&patternBuffer, pattern, REG_EXTENDED | REG_NEWLINE | REG_ICASE);
-	result = regexec(&patternBuffer, text, 20, matchBuffer, 0);
-	if (result == 0 && matchBuffer[1].rm_eo > -1) {
-		match = strndup(text + matchBuffer[1].rm_so, matchBuffer[1].rm_eo - matchBuffer[1].rm_so);
+	BString icon;
+	for (const char* tag = Markup::FindTag(body, "link"); tag != NULL;
+		 tag = Markup::FindTag(tag + 1, "link")) {
+		BString rel = Markup::Attribute(tag, "rel");
+		if (rel.ICompare("shortcut icon") == 0)
+			return Markup::Attribute(tag, "href");
+		if (icon.IsEmpty() && rel.ICompare("icon") == 0)
+			icon = Markup::Attribute(tag, "href");
 	}
-	regfree(&patternBuffer);
 
-	return match;
+	return icon;
 }
 
 
@@ -560,9 +870,6 @@ Station::LoadIndirectUrl(BString& shoutCastUrl)
 		return NULL;
 
 	status_t status;
-	const char* patternTitle = "<title[^>]*>(.*?)</title[^>]*>";
-	const char* patternIcon = "<link\\s*rel=\"shortcut icon\"\\s*href=\"([^\"]*?)\".*?";
-
 	BString contentType("*/*");
 
 	BMallocIO* dataIO = HttpUtils::GetAll(url, NULL, 10000, &contentType, 2000);
@@ -582,7 +889,7 @@ Station::LoadIndirectUrl(BString& shoutCastUrl)
 	if (pos >= 0)
 		contentType.Truncate(pos);
 
-	status = station->ParseUrlReference(body, url);
+	status = station->ParseUrlReference(body, url, contentType.String());
 	if (status != B_OK && contentType.StartsWith(("audio/")))
 		station->SetStreamUrl(url);
 
@@ -619,17 +926,13 @@ Station::LoadIndirectUrl(BString& shoutCastUrl)
 	if (dataIO != NULL) {
 		dataIO->Write(&"", 1);
 		body = (char*)dataIO->Buffer();
-		char* title = RegFind(body, patternTitle);
-		if (title != NULL) {
+		BString title = Markup::Decode(Markup::Element(body, "title"));
+		if (!title.IsEmpty())
 			station->fName.SetTo(title);
-			free(title);
-		}
 
-		char* icon = RegFind(body, patternIcon);
-		if (icon != NULL) {
-			finalUrl.SetPath(BString(icon));
-			free(icon);
-		}
+		BString icon = FindIcon(body);
+		if (!icon.IsEmpty())
+			finalUrl.SetPath(icon);
 
 		contentType = "image/*";
 
@@ -655,7 +958,7 @@ Station::SetName(BString name)
 		return;
 
 	BEntry* entry = NULL;
-	if (StationDirectory()->Contains(fName, B_FILE_NODE)) {
+	if (!fName.IsEmpty() && StationDirectory()->Contains(fName, B_FILE_NODE)) {
 		entry = new BEntry();
 		StationDirectory()->FindEntry(fName, entry, false);
 	}
@@ -676,6 +979,43 @@ Station::SetName(BString name)
 }
 
 
+/**
+ * The stream URL is the first mirror: one of the mirrors is moved first, any
+ * other URL takes the place of the first one.
+ */
+void
+Station::SetStreamUrl(const BUrl& uri)
+{
+	fStreamUrl = uri;
+
+	if (!fMirrors.IsEmpty()) {
+		BString url = uri.UrlString();
+		int32 index = fMirrors.IndexOf(url);
+		fMirrors.Remove(index >= 0 ? index : 0);
+		fMirrors.Add(url, 0);
+	}
+
+	CheckFlags();
+	fUnsaved = true;
+}
+
+
+/**
+ * Takes over the mirrors listed by another source of the station, the first
+ * one becoming the stream URL.
+ */
+void
+Station::SetMirrors(const BStringList& mirrors)
+{
+	fMirrors = mirrors;
+	if (!fMirrors.IsEmpty())
+		fStreamUrl.SetUrlString(fMirrors.StringAt(0));
+
+	CheckFlags();
+	fUnsaved = true;
+}
+
+
 void
 Station::CleanName()
 {
@@ -749,3 +1089,98 @@ Station::StationDirectory()
 
 	return sStationsDirectory;
 }
+
+
+StationBuilder::StationBuilder()
+	: fBitRate(0)
+{
+}
+
+
+StationBuilder&
+StationBuilder::SetName(const char* name)
+{
+	fName.SetTo(name);
+	return *this;
+}
+
+
+StationBuilder&
+StationBuilder::SetStreamUrl(const char* url)
+{
+	fStreamUrl.SetTo(url);
+	return *this;
+}
+
+
+StationBuilder&
+StationBuilder::SetStationUrl(const char* url)
+{
+	fStationUrl.SetTo(url);
+	return *this;
+}
+
+
+StationBuilder&
+StationBuilder::SetSource(const char* url)
+{
+	fSource.SetTo(url);
+	return *this;
+}
+
+
+StationBuilder&
+StationBuilder::SetGenre(const char* genre)
+{
+	fGenre.SetTo(genre);
+	return *this;
+}
+
+
+StationBuilder&
+StationBuilder::SetCountry(const char* country)
+{
+	fCountry.SetTo(country);
+	return *this;
+}
+
+
+StationBuilder&
+StationBuilder::SetLanguage(const char* language)
+{
+	fLanguage.SetTo(language);
+	return *this;
+}
+
+
+StationBuilder&
+StationBuilder::SetUniqueIdentifier(const char* uniqueIdentifier)
+{
+	fUniqueIdentifier.SetTo(uniqueIdentifier);
+	return *this;
+}
+
+
+StationBuilder&
+StationBuilder::SetBitRate(uint32 bitRate)
+{
+	fBitRate = bitRate;
+	return *this;
+}
+
+
+Station*
+StationBuilder::Build()
+{
+	Station* station = new Station(*this);
+
+	fStreamUrl.Truncate(0);
+	fStationUrl.Truncate(0);
+	fSource.Truncate(0);
+	fGenre.Truncate(0);
+	fCountry.Truncate(0);
+	fLanguage.Truncate(0);
+	fBitRate = 0;
+
+	return station;
+}
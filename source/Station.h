@@ -25,9 +25,12 @@
 #include <Message.h>
 #include <MimeType.h>
 #include <String.h>
+#include <StringList.h>
 #include <SupportDefs.h>
 
+#include "HlsPlaylist.h"
 #include "HttpUtils.h"
+#include "Utils.h"
 
 
 // Station flags
@@ -40,7 +43,11 @@
 #define STATION_HAS_META 64
 #define STATION_HAS_IDENTIFIER 128
 
+// Default time to wait for a stream to respond when probing
+#define STATION_PROBE_TIMEOUT 2000000
 
+
+class StationBuilder;
 class StreamPlayer;
 
 
@@ -53,36 +60,42 @@ public:
 	status_t InitCheck();
 	status_t Save();
 	status_t RetrieveStreamUrl();
-	status_t Probe();
+	status_t Probe(bigtime_t timeout = STATION_PROBE_TIMEOUT, int32* cancel = NULL);
 	status_t ProbeBuffer(BPositionIO* buffer);
+	void ArchiveProbeResult(BMessage* into);
+	void ApplyProbeResult(const BMessage* from);
 
 	static class Station* LoadFromPlsFile(BString name);
 	static class Station* Load(BString name, BEntry* entry);
 	static class Station* LoadIndirectUrl(BString& shoutCastUrl);
 
 	static BDirectory* StationDirectory();
+	static uint32 MpegEncoding(uint32 version, uint32 layer);
 
 	inline BString* Name() { return &fName; }
 	void SetName(BString name);
 
-	inline BUrl StreamUrl() { return fStreamUrl; }
-	inline void SetStreamUrl(BUrl uri)
-	{
-		fStreamUrl = uri;
-		CheckFlags();
-		fUnsaved = true;
-	}
+	inline const BUrl& StreamUrl() const { return fStreamUrl; }
+	void SetStreamUrl(const BUrl& uri);
 
-	inline BUrl StationUrl() { return fStationUrl; }
-	inline void SetStation(BUrl url)
+	inline const BUrl& StationUrl() const { return fStationUrl; }
+	inline void SetStation(const BUrl& url)
 	{
 		fStationUrl = url;
 		CheckFlags();
 		fUnsaved = true;
 	}
 
-	inline BUrl Source() { return fSource; }
-	inline void SetSource(BUrl source)
+	// All stream URLs listed by the source, fastest first. The first one is
+	// the stream URL, unless there is only one.
+	inline const BStringList& Mirrors() const { return fMirrors; }
+	void SetMirrors(const BStringList& mirrors);
+
+	// HLS streams are read segment by segment, as listed by their playlist
+	inline bool IsHls() const { return HlsPlaylist::IsHlsUrl(fStreamUrl); }
+
+	inline const BUrl& Source() const { return fSource; }
+	inline void SetSource(const BUrl& source)
 	{
 		fSource = source;
 		CheckFlags();
@@ -95,27 +108,34 @@ public:
 		delete fLogo;
 
 		fLogo = logo;
+		fLogoRevision++;
 		fUnsaved = true;
 	}
 
-	inline BString Genre() { return fGenre; }
-	inline void SetGenre(BString genre)
+	// Changes whenever the logo is replaced, so that cached renderings of
+	// it can be recognized as stale.
+	inline uint32 LogoRevision() { return fLogoRevision; }
+
+	// Genre, country and language repeat a lot across stations, so they
+	// share their buffers through the string pool.
+	inline const BString& Genre() const { return fGenre; }
+	inline void SetGenre(const BString& genre)
 	{
-		fGenre.SetTo(genre);
+		fGenre = StringPool::Intern(genre);
 		fUnsaved = true;
 	}
 
-	inline BString Country() { return fCountry; }
-	inline void SetCountry(BString country)
+	inline const BString& Country() const { return fCountry; }
+	inline void SetCountry(const BString& country)
 	{
-		fCountry.SetTo(country);
+		fCountry = StringPool::Intern(country);
 		fUnsaved = true;
 	}
 
-	inline BString Language() { return fLanguage; }
-	inline void SetLanguage(BString language)
+	inline const BString& Language() const { return fLanguage; }
+	inline void SetLanguage(const BString& language)
 	{
-		fLanguage.SetTo(language);
+		fLanguage = StringPool::Intern(language);
 		fUnsaved = true;
 	}
 
@@ -127,13 +147,21 @@ public:
 		fUnsaved = true;
 	}
 
-	inline BString UniqueIdentifier() { return fUniqueIdentifier; }
-	inline void SetUniqueIdentifier(BString uniqueIdentifier)
+	inline const BString& UniqueIdentifier() const { return fUniqueIdentifier; }
+	inline void SetUniqueIdentifier(const BString& uniqueIdentifier)
 	{
 		fUniqueIdentifier.SetTo(uniqueIdentifier);
 		fUnsaved = true;
 	}
 
+	// Integrated loudness in LUFS as measured while playing, or 0 if unknown
+	inline float Loudness() { return fLoudness; }
+	inline void SetLoudness(float loudness)
+	{
+		fLoudness = loudness;
+		fUnsaved = true;
+	}
+
 	inline int32 Channels() { return fChannels; }
 	inline int32 Encoding() { return fEncoding; }
 	inline size_t FrameSize() { return fFrameSize; }
@@ -144,8 +172,9 @@ public:
 
 protected:
 	void CheckFlags();
-	static char* RegFind(const char* text, const char* pattern);
-	status_t ParseUrlReference(const char* body, const BUrl& baseUrl);
+	status_t ParseUrlReference(
+		const char* body, const BUrl& baseUrl, const char* contentType = NULL);
+	void RankMirrors(bigtime_t timeout);
 	void CleanName();
 
 	BString fName;
@@ -155,9 +184,11 @@ protected:
 	BString fCountry;
 	BString fLanguage;
 	BUrl fSource;
+	BStringList fMirrors;
 	BMimeType fMime;
 	uint32 fEncoding;
 	BBitmap* fLogo;
+	uint32 fLogoRevision;
 	uint32 fRating;
 	uint32 fBitRate;
 	uint32 fSampleRate;
@@ -166,12 +197,54 @@ protected:
 	uint32 fChannels;
 	uint32 fFlags;
 	size_t fFrameSize;
+	float fLoudness;
 
 	static BDirectory* sStationsDirectory;
 
 private:
+	friend class StationBuilder;
+
+	Station(StationBuilder& builder);
+
 	bool fUnsaved;
 };
 
 
+/**
+ * Collects the fields of a station found by a station finder, so that the
+ * Station can be constructed in one go. Unlike the setters on Station, this
+ * neither renames files nor recomputes the flags per field; Build() moves the
+ * collected strings into the new station and leaves the builder empty.
+ */
+class StationBuilder {
+public:
+	StationBuilder();
+
+	StationBuilder& SetName(const char* name);
+	StationBuilder& SetStreamUrl(const char* url);
+	StationBuilder& SetStationUrl(const char* url);
+	StationBuilder& SetSource(const char* url);
+	StationBuilder& SetGenre(const char* genre);
+	StationBuilder& SetCountry(const char* country);
+	StationBuilder& SetLanguage(const char* language);
+	StationBuilder& SetUniqueIdentifier(const char* uniqueIdentifier);
+	StationBuilder& SetBitRate(uint32 bitRate);
+
+	Station* Build();
+
+private:
+	friend class Station;
+
+	BString fName;
+	BString fStreamUrl;
+	BString fStationUrl;
+	BString fSource;
+	BString fGenre;
+	BString fCountry;
+	BString fLanguage;
+	BString fUniqueIdentifier;
+	uint32 fBitRate;
+};
+
+
 #endif	// _STATION_H
@@ -0,0 +1,360 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "StationChecker.h"
+
+#include <Autolock.h>
+#include <Locker.h>
+#include <Referenceable.h>
+#include <String.h>
+
+#include <map>
+#include <string.h>
+
+#include "Debug.h"
+
+
+// Stations probed at the same time on one host
+static const int32 kMaxPerHost = 2;
+
+// Bounds for the adaptive probe timeout
+static const bigtime_t kMinTimeout = 500000;
+static const bigtime_t kMaxTimeout = 4000000;
+
+// Time to wait for a busy host before looking for a job again
+static const bigtime_t kHostWait = 50000;
+
+// Time to wait for the target to accept a notification
+static const bigtime_t kSendTimeout = 1000000;
+
+
+class CheckJob {
+public:
+	CheckJob(Station* station)
+		: fStation(station),
+		  fStreamUrl(station->StreamUrl().UrlString()),
+		  fSource(station->Source().UrlString()),
+		  fTimeout(0),
+		  fRetry(false)
+	{
+		fHost = station->Source().IsValid() ? station->Source().Host()
+											: station->StreamUrl().Host();
+	}
+
+	// Only passed back to the target, never touched by the check threads
+	Station* fStation;
+
+	BString fStreamUrl;
+	BString fSource;
+	BString fHost;
+	bigtime_t fTimeout;
+	bool fRetry;
+};
+
+
+/**
+ * The state of one batch, shared by the checker and its workers. The last of
+ * them to let go deletes it, so that the checker does not have to wait for
+ * workers still inside a probe.
+ */
+class CheckRun : public BReferenceable {
+public:
+	CheckRun(BMessenger target);
+
+	CheckJob* NextJob(bool* finished);
+	void JobDone(CheckJob* job, Station* probe, status_t status, bigtime_t elapsed);
+	bigtime_t Timeout();
+
+	static int32 CheckThreadFunc(void* data);
+
+	BMessenger fTarget;
+	BLocker fLock;
+#if B_HAIKU_VERSION > B_HAIKU_VERSION_1_BETA_5
+	BObjectList<CheckJob, true> fJobs;
+#else
+	BObjectList<CheckJob> fJobs;
+#endif
+	std::map<BString, int32> fHostLoad;
+	int32 fRunning;
+	int32 fTotal;
+	int32 fDone;
+	int32 fFailed;
+	bigtime_t fLatency;
+	int32 fQuit;
+};
+
+
+CheckRun::CheckRun(BMessenger target)
+	: fTarget(target),
+	  fLock("station checker"),
+#if B_HAIKU_VERSION > B_HAIKU_VERSION_1_BETA_5
+	  fJobs(),
+#else
+	  fJobs(20, true),
+#endif
+	  fRunning(0),
+	  fTotal(0),
+	  fDone(0),
+	  fFailed(0),
+	  fLatency(0),
+	  fQuit(0)
+{
+}
+
+
+/**
+ * Takes the first pending job whose host is not yet probed kMaxPerHost times.
+ * Sets finished if there are no pending jobs at all.
+ */
+CheckJob*
+CheckRun::NextJob(bool* finished)
+{
+	BAutolock lock(fLock);
+
+	*finished = fJobs.IsEmpty();
+	for (int32 i = 0; i < fJobs.CountItems(); i++) {
+		CheckJob* job = fJobs.ItemAt(i);
+		int32& load = fHostLoad[job->fHost];
+		if (load < kMaxPerHost) {
+			load++;
+			return fJobs.RemoveItemAt(i);
+		}
+	}
+
+	return NULL;
+}
+
+
+void
+CheckRun::JobDone(CheckJob* job, Station* probe, status_t status, bigtime_t elapsed)
+{
+	BMessage notification(MSG_STATION_CHECKED);
+
+	{
+		BAutolock lock(fLock);
+
+		if (--fHostLoad[job->fHost] == 0)
+			fHostLoad.erase(job->fHost);
+
+		// The station may be gone once the checker is stopped
+		if (atomic_get(&fQuit) != 0) {
+			delete job;
+			return;
+		}
+
+		// A probe that ran into a short timeout may just be slow, so it gets a
+		// second chance with the longest one.
+		if (status != B_OK && !job->fRetry && job->fTimeout < kMaxTimeout) {
+			job->fRetry = true;
+			fJobs.AddItem(job);
+			return;
+		}
+
+		if (status == B_OK) {
+			fLatency = fLatency == 0 ? elapsed : (3 * fLatency + elapsed) / 4;
+		} else
+			fFailed++;
+
+		fDone++;
+		notification.AddInt32("done", fDone);
+		notification.AddInt32("total", fTotal);
+	}
+
+	BMessage result;
+	if (status == B_OK)
+		probe->ArchiveProbeResult(&result);
+	else
+		result.AddUInt32("flags", probe->Flags() & ~STATION_URI_VALID);
+
+	notification.AddPointer("station", job->fStation);
+	notification.AddInt32("status", status);
+	notification.AddMessage("result", &result);
+	fTarget.SendMessage(&notification, (BHandler*)NULL, kSendTimeout);
+
+	delete job;
+}
+
+
+/**
+ * Allows a few times the average response time of the stations probed so
+ * far, so that a sweep is not held up by dead stations.
+ */
+bigtime_t
+CheckRun::Timeout()
+{
+	if (fLatency == 0)
+		return STATION_PROBE_TIMEOUT;
+
+	bigtime_t timeout = 4 * fLatency;
+	if (timeout < kMinTimeout)
+		return kMinTimeout;
+	if (timeout > kMaxTimeout)
+		return kMaxTimeout;
+
+	return timeout;
+}
+
+
+int32
+CheckRun::CheckThreadFunc(void* data)
+{
+	CheckRun* run = (CheckRun*)data;
+
+	while (atomic_get(&run->fQuit) == 0) {
+		bool finished;
+		CheckJob* job = run->NextJob(&finished);
+		if (job == NULL) {
+			if (finished)
+				break;
+
+			snooze(kHostWait);
+			continue;
+		}
+
+		job->fTimeout = kMaxTimeout;
+		if (!job->fRetry) {
+			BAutolock lock(run->fLock);
+			job->fTimeout = run->Timeout();
+		}
+
+		// The copy has no name, so probing it can never rename a saved station
+		StationBuilder builder;
+		builder.SetStreamUrl(job->fStreamUrl.String()).SetSource(job->fSource.String());
+		Station* probe = builder.Build();
+
+		bigtime_t start = system_time();
+		status_t status = probe->Probe(job->fTimeout, &run->fQuit);
+		TRACE("Checked %s in %" B_PRIdBIGTIME " us: %s\n", job->fStreamUrl.String(),
+			system_time() - start, strerror(status));
+
+		run->JobDone(job, probe, status, system_time() - start);
+		delete probe;
+	}
+
+	if (atomic_add(&run->fRunning, -1) == 1 && atomic_get(&run->fQuit) == 0) {
+		BMessage notification(MSG_STATION_CHECK_DONE);
+		notification.AddInt32("total", run->fTotal);
+		notification.AddInt32("failed", run->fFailed);
+		run->fTarget.SendMessage(&notification, (BHandler*)NULL, kSendTimeout);
+	}
+
+	run->ReleaseReference();
+	return B_OK;
+}
+
+
+StationChecker::StationChecker(BMessenger target)
+	: fTarget(target),
+	  fRun(NULL)
+{
+}
+
+
+StationChecker::~StationChecker()
+{
+	Stop();
+}
+
+
+/**
+ * Starts probing all stations in the list. Results are sent to the target as
+ * MSG_STATION_CHECKED for each station and MSG_STATION_CHECK_DONE at the end.
+ */
+status_t
+StationChecker::Check(BObjectList<Station>* stations)
+{
+	if (IsRunning())
+		return B_BUSY;
+
+	Stop();
+
+	CheckRun* run = new CheckRun(fTarget);
+	for (int32 i = 0; i < stations->CountItems(); i++)
+		run->fJobs.AddItem(new CheckJob(stations->ItemAt(i)));
+
+	return _Start(run);
+}
+
+
+status_t
+StationChecker::Check(Station* station)
+{
+	if (IsRunning())
+		return B_BUSY;
+
+	Stop();
+
+	CheckRun* run = new CheckRun(fTarget);
+	run->fJobs.AddItem(new CheckJob(station));
+
+	return _Start(run);
+}
+
+
+/**
+ * Tells the workers to quit without waiting for them, so that it does not
+ * hold up the caller for as long as a probe may take.
+ */
+void
+StationChecker::Stop()
+{
+	if (fRun == NULL)
+		return;
+
+	atomic_set(&fRun->fQuit, 1);
+	fRun->ReleaseReference();
+	fRun = NULL;
+}
+
+
+bool
+StationChecker::IsRunning()
+{
+	return fRun != NULL && atomic_get(&fRun->fRunning) > 0;
+}
+
+
+status_t
+StationChecker::_Start(CheckRun* run)
+{
+	fRun = run;
+	fRun->fTotal = fRun->fJobs.CountItems();
+	if (fRun->fTotal == 0)
+		return B_OK;
+
+	status_t status = B_OK;
+	int32 threads = min_c(fRun->fTotal, SC_THREADS);
+	for (int32 i = 0; i < threads; i++) {
+		// Counted before the thread runs, so that it cannot end the run early
+		fRun->AcquireReference();
+		atomic_add(&fRun->fRunning, 1);
+
+		thread_id thread = spawn_thread(
+			&CheckRun::CheckThreadFunc, "station check", B_LOW_PRIORITY, fRun);
+		if (thread < 0) {
+			atomic_add(&fRun->fRunning, -1);
+			fRun->ReleaseReference();
+			status = thread;
+			break;
+		}
+
+		resume_thread(thread);
+	}
+
+	return IsRunning() ? B_OK : status;
+}
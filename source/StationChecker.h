@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef _STATION_CHECKER_H
+#define _STATION_CHECKER_H
+
+
+#include <Messenger.h>
+#include <ObjectList.h>
+
+#include "Station.h"
+
+
+// Notification Messages
+#define MSG_STATION_CHECKED \
+	'mSCD'	// "station" = Station*, "status" = status_t, "done"/"total" = int32,
+			// "result" = BMessage for Station::ApplyProbeResult()
+#define MSG_STATION_CHECK_DONE 'mSCF'  // "total" = int32, "failed" = int32
+
+// Number of stations probed at the same time
+#define SC_THREADS 8
+
+
+class CheckRun;
+
+
+/**
+ * Probes a batch of stations on a small pool of worker threads. Every probe
+ * works on its own copy of the station; the results are sent to the target
+ * and have to be applied to the original station by the receiver. The
+ * workers are never waited for: once stopped, they drop what they probe and
+ * end after their current request.
+ */
+class StationChecker {
+public:
+	StationChecker(BMessenger target);
+	virtual ~StationChecker();
+
+	status_t Check(BObjectList<Station>* stations);
+	status_t Check(Station* station);
+	void Stop();
+
+	bool IsRunning();
+
+private:
+	status_t _Start(CheckRun* run);
+
+private:
+	BMessenger fTarget;
+	// Shared with the workers, which keep it until they end
+	CheckRun* fRun;
+};
+
+
+#endif	// _STATION_CHECKER_H
@@ -10,6 +10,7 @@
 #include "HttpUtils.h"
 #include "RadioApp.h"
 #include "Utils.h"
+#include "VirtualStationListView.h"
 
 
 #undef B_TRANSLATION_CONTEXT
@@ -209,7 +210,7 @@ StationFinderWindow::StationFinderWindow(BWindow* parent)
 
 	fDdSearchBy = new BOptionPopUp("fDdSearchBy", NULL, new BMessage(MSG_SEARCH_BY));
 
-	fResultView = new StationListView();
+	fResultView = new VirtualStationListView();
 	fResultView->SetExplicitAlignment(BAlignment(B_ALIGN_USE_FULL_WIDTH, B_ALIGN_USE_FULL_HEIGHT));
 
 	fBnAdd = new BButton("fBnAdd", B_TRANSLATE("Add"), new BMessage(MSG_ADD_STATION));
@@ -300,22 +301,20 @@ StationFinderWindow::MessageReceived(BMessage* msg)
 		{
 			int32 index = msg->GetInt32("index", -1);
 			if (index < 0)
-				index = fResultView->CurrentSelection(0);
+				index = fResultView->CurrentSelection();
 
 			if (index >= 0) {
 				Station* station = fResultView->StationAt(index);
 
 				status_t probeStatus = station->Probe();
 				if (probeStatus == B_OK) {
+					fCurrentService->ReleaseStation(station);
+
 					BMessage* dispatch = new BMessage(msg->what);
 					dispatch->AddPointer("station", station);
 
-					if (fMessenger->SendMessage(dispatch) == B_OK) {
-						StationListViewItem* item
-							= (StationListViewItem*)fResultView->RemoveItem(index);
-						item->ClearStation();
-						delete item;
-					}
+					if (fMessenger->SendMessage(dispatch) == B_OK)
+						fResultView->RemoveStation(index);
 				} else {
 					BString msg;
 					msg.SetToFormat(B_TRANSLATE("Station %s did not respond correctly and "
@@ -332,9 +331,8 @@ StationFinderWindow::MessageReceived(BMessage* msg)
 		case MSG_UPDATE_STATION:
 		{
 			Station* st = NULL;
-			if (msg->FindPointer("station", (void**)&st) == B_OK) {
-				fResultView->InvalidateItem(fResultView->IndexOf(fResultView->Item(st)));
-			}
+			if (msg->FindPointer("station", (void**)&st) == B_OK)
+				fResultView->InvalidateStation(st);
 
 			break;
 		}
@@ -449,20 +447,20 @@ StationFinderWindow::SelectCapability(int index)
 void
 StationFinderWindow::DoSearch(const char* text)
 {
+	// Lookups in the background must let go of the stations first
+	if (fCurrentService != NULL)
+		fCurrentService->ReleaseStations();
+
 	fResultView->MakeEmpty();
 	if (fCurrentService == NULL)
 		return;
 
 	be_app->SetCursor(new BCursor(B_CURSOR_ID_PROGRESS));
 
+	// The result view only creates rows for the stations in sight, so even
+	// very broad searches are cheap to show.
 	StationList* result = fCurrentService->FindBy(fDdSearchBy->Value(), text, this);
-	if (result != NULL) {
-		for (int32 i = 0; i < result->CountItems(); i++)
-			fResultView->AddItem(new StationListViewItem(result->ItemAt(i)));
-
-		result->MakeEmpty(false);
-		delete result;
-	}
+	fResultView->SetStations(result);
 
 	be_app->SetCursor(B_CURSOR_SYSTEM_DEFAULT);
 }
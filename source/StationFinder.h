@@ -59,6 +59,9 @@ typedef BObjectList<Station> StationList;
 typedef class StationFinderService* (*InstantiateFunc)();
 
 
+class VirtualStationListView;
+
+
 class StationFinderServices {
 public:
 	StationFinderServices(){};
@@ -107,6 +110,12 @@ public:
 		int capabilityIndex, const char* searchFor, BLooper* resultUpdateTarget)
 		= 0;
 
+	// Called before a station found is handed over, after which the service
+	// must no longer touch it, as lookups in the background would
+	virtual void ReleaseStation(Station* station) {}
+	// The same for all stations found, before they are deleted
+	virtual void ReleaseStations() {}
+
 	// Provided by ancestor class
 	const char* Name() const { return serviceName.String(); }
 
@@ -154,7 +163,7 @@ private:
 	BOptionPopUp* fDdServices;
 	BButton* fBnVisit;
 	BOptionPopUp* fDdSearchBy;
-	StationListView* fResultView;
+	VirtualStationListView* fResultView;
 	BButton* fBnAdd;
 
 	BGridLayout* fSearchGrid;
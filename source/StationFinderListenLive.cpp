@@ -18,12 +18,15 @@
 
 #include "StationFinderListenLive.h"
 
-#define __USE_GNU
-#include <regex.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 
+#include <Autolock.h>
 #include <Catalog.h>
 
 #include "Debug.h"
+#include "Markup.h"
 
 
 #undef B_TRANSLATION_CONTEXT
@@ -103,7 +106,9 @@ StationFinderListenLive::StationFinderListenLive()
 	  fCountryKeywordAndPath(),
 	  fGenreKeywordAndPath(),
 	  fLookupThread(-1),
-	  fPlsLookupList()
+	  fLookupLock("pls lookup"),
+	  fPlsLookupList(),
+	  fLookupCurrent(NULL)
 {
 	serviceName.SetTo(B_TRANSLATE("listenlive.eu [experimental]"));
 	serviceHomePage.SetUrlString("http://www.listenlive.eu/");
@@ -146,10 +151,15 @@ StationFinderListenLive::RegisterSelf()
 
 StationFinderListenLive::~StationFinderListenLive()
 {
+	fLookupLock.Lock();
 	fPlsLookupList.MakeEmpty(false);
-	if (fLookupThread >= 0) {
+	fLookupCurrent = NULL;
+	thread_id lookupThread = fLookupThread;
+	fLookupLock.Unlock();
+
+	if (lookupThread >= 0) {
 		status_t dummy;
-		wait_for_thread(fLookupThread, &dummy);
+		wait_for_thread(lookupThread, &dummy);
 	}
 }
 
@@ -158,11 +168,12 @@ StationList*
 StationFinderListenLive::FindBy(
 	int capabilityIndex, const char* searchFor, BLooper* resultUpdateTarget)
 {
-	if (fLookupThread >= 0)
-		suspend_thread(fLookupThread);
+	// The stations of the previous search are deleted with its results
+	ReleaseStations();
 
-	fPlsLookupList.MakeEmpty(false);
+	fLookupLock.Lock();
 	fLookupNotify = resultUpdateTarget;
+	fLookupLock.Unlock();
 
 	StationList* result = NULL;
 
@@ -192,16 +203,48 @@ StationFinderListenLive::FindBy(
 	data->Flush();
 	delete data;
 
-	if (!fPlsLookupList.IsEmpty()) {
-		if (fLookupThread < 0)
-			fLookupThread = spawn_thread(&_PlsLookupFunc, "plslookup", B_NORMAL_PRIORITY, this);
-		resume_thread(fLookupThread);
+	BAutolock lock(fLookupLock);
+	if (!fPlsLookupList.IsEmpty() && fLookupThread < 0) {
+		fLookupThread = spawn_thread(&_PlsLookupFunc, "plslookup", B_NORMAL_PRIORITY, this);
+		if (fLookupThread >= 0)
+			resume_thread(fLookupThread);
+		else
+			fPlsLookupList.MakeEmpty(false);
 	}
 
 	return result;
 }
 
 
+/**
+ * Fills in name, station URL, source and bit rate from the cell with the
+ * station link and the one with the stream links; the first stream is used.
+ * Returns whether the station is only known by a playlist.
+ */
+static bool
+ParseStationCells(StationBuilder& builder, const BString& station, const BString& streams)
+{
+	const char* link = Markup::FindTag(station.String(), "a");
+	if (link != NULL)
+		builder.SetStationUrl(Markup::Attribute(link, "href").String());
+	builder.SetName(Markup::Decode(Markup::Element(station.String(), "b")).String());
+
+	link = Markup::FindTag(streams.String(), "a");
+	BString source = link != NULL ? Markup::Attribute(link, "href") : BString();
+	bool isPlaylist = source.EndsWith(".pls") || source.EndsWith(".m3u");
+	if (isPlaylist)
+		builder.SetSource(source.String());
+	else
+		builder.SetStreamUrl(source.String());
+
+	// Data rates are listed like "128 Kbps"
+	BString rate = Markup::Element(streams.String(), "a");
+	builder.SetBitRate(atof(rate.String()) * 1000);
+
+	return isPlaylist;
+}
+
+
 StationList*
 StationFinderListenLive::ParseCountryReturn(BMallocIO* data, const char* searchFor)
 {
@@ -213,9 +256,6 @@ StationFinderListenLive::ParseCountryReturn(BMallocIO* data, const char* searchF
 	if (result == NULL)
 		return result;
 
-	regmatch_t matches[10];
-	regex_t regex;
-
 	//	<tr>
 	//	<td><a href="http://oe1.orf.at/"><b>ORF Ö-1</b></a></td>
 	//	<td>Vienna</td>
@@ -226,64 +266,39 @@ StationFinderListenLive::ParseCountryReturn(BMallocIO* data, const char* searchF
 	//	<td>Information/Culture</td>
 	//	</tr>
 
-	int res = regcomp(&regex,
-		"<tr>\\s*<td>\\s*<a\\s+href=\"([^\"]*)\"><b>([^<]*)</b>\\s*</a>\\s*</"
-		"td>\\s*"
-		"<td>([^<]*)</td>\\s*"
-		"<td>([^<]|<[^/]|</[^t]|</t[^d])*</td>\\s*"
-		"<td>\\s*<a\\s+href=\"([^\"]*)\">([^<]*)</a>([^<]|<[^/]|</[^t]|</"
-		"t[^d])*</td>\\s*"
-		"<td>([^<]*)</td>\\s*</tr>",
-		RE_ICASE | RE_DOT_NEWLINE | RE_DOT_NOT_NULL | RE_NO_BK_PARENS | RE_NO_BK_VBAR
-			| RE_BACKSLASH_ESCAPE_IN_LISTS);
-
 	char* doc = (char*)data->Buffer();
 	off_t size;
 	data->GetSize(&size);
 	doc[size] = 0;
 
-	while ((res = regexec(&regex, doc, 10, matches, 0)) == 0) {
-		doc[matches[1].rm_eo] = 0;
-		doc[matches[2].rm_eo] = 0;
-		doc[matches[3].rm_eo] = 0;
-		doc[matches[5].rm_eo] = 0;
-		doc[matches[6].rm_eo] = 0;
-		doc[matches[8].rm_eo] = 0;
-		printf("Station %s at %s in %s address %s, data rate=%s, genre=%s\n",
-			doc + matches[2].rm_so, doc + matches[1].rm_so, doc + matches[3].rm_so,
-			doc + matches[5].rm_so, doc + matches[6].rm_so, doc + matches[8].rm_so);
-
-		Station* station = new Station(doc + matches[2].rm_so, NULL);
-		if (station == NULL)
+	StationBuilder builder;
+	BString cells[6];
+	int32 count;
+	const char* next = doc;
+	while ((next = Markup::NextRow(next, cells, 6, &count)) != NULL) {
+		if (count != 5 || Markup::FindTag(cells[0].String(), "b") == NULL)
 			continue;
 
-		result->AddItem(station);
-
-		BString source(doc + matches[5].rm_so);
-		if (source.EndsWith(".pls") || source.EndsWith(".m3u")) {
-			station->SetSource(BUrl(source));
-			fPlsLookupList.AddItem(station);
-		} else
-			station->SetStreamUrl(BUrl(source));
-
-		for (int32 i = matches[6].rm_so; i < matches[6].rm_eo; i++) {
-			if (!strchr("0123456789.", doc[i])) {
-				doc[i] = 0;
-				station->SetBitRate(atof(doc + matches[6].rm_so) * 1000);
-				break;
-			}
-		}
-
-		station->SetStation(doc + matches[1].rm_so);
-		station->SetGenre(doc + matches[8].rm_so);
+		bool isPlaylist = ParseStationCells(builder, cells[0], cells[3]);
+		builder.SetGenre(Markup::Decode(cells[4]).String());
 
 		BString country;
 		country.SetTo(searchFor);
 		country.Append(" - ");
-		country.Append(doc + matches[3].rm_so);
-		station->SetCountry(country);
-
-		doc += matches[0].rm_eo;
+		country.Append(Markup::Decode(cells[1]));
+		builder.SetCountry(country.String());
+
+		Station* station = builder.Build();
+		if (station != NULL) {
+			TRACE("Station %s at %s\n", station->Name()->String(),
+				station->StationUrl().UrlString().String());
+
+			result->AddItem(station);
+			if (isPlaylist) {
+				BAutolock lock(fLookupLock);
+				fPlsLookupList.AddItem(station);
+			}
+		}
 	}
 
 	return result;
@@ -301,19 +316,6 @@ StationFinderListenLive::ParseGenreReturn(BMallocIO* data, const char* searchFor
 	if (result == NULL)
 		return result;
 
-	regmatch_t matches[9];
-	regex_t regex;
-
-	//	<tr>
-	//	<td><a href="http://oe1.orf.at/"><b>ORF Ö-1</b></a></td>
-	//	<td>Vienna</td>
-	//	<td><img src="wma.gif" width="12" height="12" alt="Windows
-	// Media"><br><img src="mp3.gif" width="12" height="12" alt="MP3"></td>
-	//	<td><a href="mms://apasf.apa.at/oe1_live_worldwide">128 Kbps</a><br><a
-	// href="http://mp3stream3.apasf.apa.at:8000/listen.pls">192 Kbps</a></td>
-	//	<td>Information/Culture</td>
-	//	</tr>
-
 	//	<tr>
 	//	<td><a href="http://www.radiostephansdom.at/"><b>Radio
 	// Stephansdom</b></a></td> 	<td>Vienna</td> 	<td>Austria</td> 	<td><img
@@ -323,67 +325,67 @@ StationFinderListenLive::ParseGenreReturn(BMallocIO* data, const char* searchFor
 	// href="http://streaming.lxcluster.at:8000/live128.m3u">128 Kbps</a></td>
 	//	</tr>
 
-	int res = regcomp(&regex,
-		"<tr>\\s*<td>\\s*<a\\s+href=\"([^\"]*)\"><b>([^<]*)</b>\\s*</a>\\s*</"
-		"td>\\s*"
-		"<td>([^<]*)</td>\\s*"
-		"<td>([^<]*)</td>\\s*"
-		"<td>([^<]|<[^/]|</[^t]|</t[^d])*</td>\\s*"
-		"<td>\\s*<a\\s+href=\"([^\"]*)\">([^<]*)</a>([^<]|<[^/]|</[^t]|</"
-		"t[^d])*</td>\\s*"
-		"</tr>",
-		RE_ICASE | RE_DOT_NEWLINE | RE_DOT_NOT_NULL | RE_NO_BK_PARENS | RE_NO_BK_VBAR
-			| RE_BACKSLASH_ESCAPE_IN_LISTS);
-
 	char* doc = (char*)data->Buffer();
 	off_t size;
 	data->GetSize(&size);
 	doc[size] = 0;
 
-	while ((res = regexec(&regex, doc, 9, matches, 0)) == 0) {
-		doc[matches[1].rm_eo] = 0;
-		doc[matches[2].rm_eo] = 0;
-		doc[matches[3].rm_eo] = 0;
-		doc[matches[4].rm_eo] = 0;
-		doc[matches[6].rm_eo] = 0;
-		doc[matches[7].rm_eo] = 0;
-		printf("Station %s at %s in %s - %s address %s, data rate=%s, genre=%s\n",
-			doc + matches[2].rm_so, doc + matches[1].rm_so, doc + matches[3].rm_so,
-			doc + matches[4].rm_so, doc + matches[6].rm_so, doc + matches[7].rm_so, searchFor);
-
-		Station* station = new Station(doc + matches[2].rm_so, NULL);
-		if (station == NULL)
+	StationBuilder builder;
+	BString cells[6];
+	int32 count;
+	const char* next = doc;
+	while ((next = Markup::NextRow(next, cells, 6, &count)) != NULL) {
+		if (count != 5 || Markup::FindTag(cells[0].String(), "b") == NULL)
 			continue;
 
-		result->AddItem(station);
-
-		BString source(doc + matches[6].rm_so);
-		if (source.EndsWith(".pls") || source.EndsWith(".m3u")) {
-			station->SetSource(BUrl(source));
-			fPlsLookupList.AddItem(station);
-		} else
-			station->SetStreamUrl(BUrl(source));
+		bool isPlaylist = ParseStationCells(builder, cells[0], cells[4]);
+		builder.SetGenre(searchFor);
 
-		for (int32 i = matches[7].rm_so; i < matches[7].rm_eo; i++) {
-			if (!strchr("0123456789.", doc[i])) {
-				doc[i] = 0;
-				station->SetBitRate(atof(doc + matches[7].rm_so) * 1000);
-				break;
+		BString country(Markup::Decode(cells[2]));
+		country.Append(" - ");
+		country.Append(Markup::Decode(cells[1]));
+		builder.SetCountry(country.String());
+
+		Station* station = builder.Build();
+		if (station != NULL) {
+			TRACE("Station %s at %s\n", station->Name()->String(),
+				station->StationUrl().UrlString().String());
+
+			result->AddItem(station);
+			if (isPlaylist) {
+				BAutolock lock(fLookupLock);
+				fPlsLookupList.AddItem(station);
 			}
 		}
+	}
 
-		station->SetStation(doc + matches[1].rm_so);
-		station->SetGenre(searchFor);
+	return result;
+}
 
-		BString country(doc + matches[4].rm_so);
-		country.Append(" - ");
-		country.Append(doc + matches[5].rm_so);
-		station->SetCountry(country);
 
-		doc += matches[0].rm_eo;
-	}
+/**
+ * Drops the pending stream URL lookup of a station, and the result of the one
+ * running for it, if any.
+ */
+void
+StationFinderListenLive::ReleaseStation(Station* station)
+{
+	BAutolock lock(fLookupLock);
 
-	return result;
+	if (fLookupCurrent == station)
+		fLookupCurrent = NULL;
+
+	fPlsLookupList.RemoveItem(station, false);
+}
+
+
+void
+StationFinderListenLive::ReleaseStations()
+{
+	BAutolock lock(fLookupLock);
+
+	fPlsLookupList.MakeEmpty(false);
+	fLookupCurrent = NULL;
 }
 
 
@@ -391,25 +393,46 @@ int32
 StationFinderListenLive::_PlsLookupFunc(void* data)
 {
 	StationFinderListenLive* _this = (StationFinderListenLive*)data;
-	while (!_this->fPlsLookupList.IsEmpty()) {
-		Station* station = _this->fPlsLookupList.FirstItem();
-		TRACE("Looking up stream URL for station %s in %s\n", station->Name()->String(),
-			station->Source().UrlString().String());
+	while (true) {
+		_this->fLookupLock.Lock();
+		Station* station = _this->fPlsLookupList.RemoveItemAt(0);
+		if (station == NULL) {
+			_this->fLookupThread = -1;
+			_this->fLookupLock.Unlock();
+			break;
+		}
 
-		Station* plsStation = Station::LoadIndirectUrl((BString&)station->Source().UrlString());
-		if (plsStation != NULL)
-			station->SetStreamUrl(plsStation->StreamUrl());
+		_this->fLookupCurrent = station;
+		BString source(station->Source().UrlString());
+		BLooper* notify = _this->fLookupNotify;
+		_this->fLookupLock.Unlock();
+
+		TRACE("Looking up stream URL in %s\n", source.String());
+		Station* plsStation = Station::LoadIndirectUrl(source);
+
+		// The station may have been released while the playlist was loaded
+		_this->fLookupLock.Lock();
+		station = _this->fLookupCurrent;
+		_this->fLookupCurrent = NULL;
+		if (station != NULL && plsStation != NULL) {
+			if (plsStation->Mirrors().IsEmpty())
+				station->SetStreamUrl(plsStation->StreamUrl());
+			else
+				station->SetMirrors(plsStation->Mirrors());
+		}
+		_this->fLookupLock.Unlock();
+
+		delete plsStation;
+		if (station == NULL)
+			continue;
 
 		BMessage* notification = new BMessage(MSG_UPDATE_STATION);
 		notification->AddPointer("station", station);
-		if (_this->fLookupNotify->LockLooper()) {
-			_this->fLookupNotify->PostMessage(notification);
-			_this->fLookupNotify->UnlockLooper();
+		if (notify->LockLooper()) {
+			notify->PostMessage(notification);
+			notify->UnlockLooper();
 		}
-
-		_this->fPlsLookupList.RemoveItem(station, false);
 	}
 
-	_this->fLookupThread = -1;
 	return B_OK;
 }
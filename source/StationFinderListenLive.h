@@ -18,6 +18,7 @@
 #define _STATION_FINDER_LISTEN_LIVE_H
 
 
+#include <Locker.h>
 #include <ObjectList.h>
 
 #include "StationFinder.h"
@@ -37,6 +38,9 @@ public:
 	StationList* ParseCountryReturn(BMallocIO* data, const char* country);
 	StationList* ParseGenreReturn(BMallocIO* data, const char* genre);
 
+	virtual void ReleaseStation(Station* station);
+	virtual void ReleaseStations();
+
 private:
 	static int32 _PlsLookupFunc(void* data);
 
@@ -46,7 +50,10 @@ private:
 	BStringList fCountryKeywordAndPath;
 	BStringList fGenreKeywordAndPath;
 	thread_id fLookupThread;
+	// Guards the lookups against stations being released meanwhile
+	BLocker fLookupLock;
 	BObjectList<Station> fPlsLookupList;
+	Station* fLookupCurrent;
 
 	BLooper* fLookupNotify;
 };
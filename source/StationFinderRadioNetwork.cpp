@@ -20,6 +20,7 @@
 
 #include "StationFinderRadioNetwork.h"
 
+#include <Autolock.h>
 #include <Catalog.h>
 #include <Country.h>
 
@@ -48,6 +49,8 @@ IconLookup::IconLookup(Station* station, BUrl iconUrl)
 StationFinderRadioNetwork::StationFinderRadioNetwork()
 	: StationFinderService(),
 	  fIconLookupThread(-1),
+	  fIconLookupLock("icon lookup"),
+	  fIconLookupCurrent(NULL),
 #if B_HAIKU_VERSION > B_HAIKU_VERSION_1_BETA_5
 	  fIconLookupList(100)
 #else
@@ -156,55 +159,43 @@ StationFinderRadioNetwork::FindBy(
 		&& BJson::Parse((const char*)data->Buffer(), data->BufferLength(), parsedData) == B_OK) {
 		delete data;
 
+		StationBuilder builder;
 		char* name;
 		uint32 type;
 		int32 count;
 		for (int32 index = 0;
 			 parsedData.GetInfo(B_MESSAGE_TYPE, index, &name, &type, &count) == B_OK; index++) {
 			BMessage stationMessage;
-			if (parsedData.FindMessage(name, &stationMessage) == B_OK) {
-				Station* station = new Station("unknown");
-				if (station == NULL)
-					continue;
-
-				station->SetUniqueIdentifier(
-					stationMessage.GetString("stationuuid", B_EMPTY_STRING));
-
-				station->SetName(stationMessage.GetString("name", "unknown"));
-
-				station->SetSource(stationMessage.GetString("url", B_EMPTY_STRING));
-
-				station->SetStation(stationMessage.GetString("homepage", B_EMPTY_STRING));
-
-				BString iconUrl;
-				if (stationMessage.FindString("favicon", &iconUrl) == B_OK) {
-					if (!iconUrl.IsEmpty()) {
-						fIconLookupList.AddItem(new IconLookup(station, BUrl(iconUrl)));
-					}
-				}
-
-				station->SetGenre(stationMessage.GetString("tags", B_EMPTY_STRING));
-
-				BString countryCode;
-				if (stationMessage.FindString("countrycode", &countryCode) == B_OK) {
-					BCountry* country = new BCountry(countryCode);
-					BString countryName;
-					if (country != NULL && country->GetName(countryName) == B_OK)
-						station->SetCountry(countryName);
-
-					delete country;
-				}
+			if (parsedData.FindMessage(name, &stationMessage) != B_OK)
+				continue;
+
+			builder.SetUniqueIdentifier(stationMessage.GetString("stationuuid", B_EMPTY_STRING))
+				.SetName(stationMessage.GetString("name", "unknown"))
+				.SetSource(stationMessage.GetString("url", B_EMPTY_STRING))
+				.SetStationUrl(stationMessage.GetString("homepage", B_EMPTY_STRING))
+				.SetGenre(stationMessage.GetString("tags", B_EMPTY_STRING))
+				.SetLanguage(stationMessage.GetString("language", B_EMPTY_STRING))
+				.SetBitRate(stationMessage.GetDouble("bitrate", 0) * 1000);
+
+			BString countryCode;
+			if (stationMessage.FindString("countrycode", &countryCode) == B_OK) {
+				BCountry country(countryCode);
+				BString countryName;
+				if (country.GetName(countryName) == B_OK)
+					builder.SetCountry(countryName.String());
+			}
 
-				station->SetLanguage(stationMessage.GetString("language", B_EMPTY_STRING));
+			// The stream URL is left empty, it is resolved from the source
+			// when probing the station.
+			Station* station = builder.Build();
+			if (station == NULL)
+				continue;
 
-				station->SetBitRate(stationMessage.GetDouble("bitrate", 0) * 1000);
+			BString iconUrl;
+			if (stationMessage.FindString("favicon", &iconUrl) == B_OK && !iconUrl.IsEmpty())
+				fIconLookupList.AddItem(new IconLookup(station, BUrl(iconUrl)));
 
-				// Set source URL as stream URL
-				// If the source is a playlist, this setting will be
-				// overridden when probing the station.
-				// station->SetStreamUrl((const BUrl)station->Source());
-				result->AddItem(station);
-			}
+			result->AddItem(station);
 		}
 
 		if (!fIconLookupList.IsEmpty()) {
@@ -221,24 +212,71 @@ StationFinderRadioNetwork::FindBy(
 }
 
 
+/**
+ * Drops the pending icon lookup of a station, and the result of the one
+ * running for it, if any.
+ */
+void
+StationFinderRadioNetwork::ReleaseStation(Station* station)
+{
+	BAutolock lock(fIconLookupLock);
+
+	if (fIconLookupCurrent == station)
+		fIconLookupCurrent = NULL;
+
+	for (int32 i = fIconLookupList.CountItems() - 1; i >= 0; i--) {
+		if (fIconLookupList.ItemAt(i)->fStation == station)
+			delete fIconLookupList.RemoveItemAt(i);
+	}
+}
+
+
+void
+StationFinderRadioNetwork::ReleaseStations()
+{
+	BAutolock lock(fIconLookupLock);
+
+	fIconLookupCurrent = NULL;
+	fIconLookupList.MakeEmpty(true);
+}
+
+
 int32
 StationFinderRadioNetwork::_IconLookupFunc(void* data)
 {
 	StationFinderRadioNetwork* _this = (StationFinderRadioNetwork*)data;
-	while (_this->fIconLookupThread >= 0 && !_this->fIconLookupList.IsEmpty()) {
-		IconLookup* item = _this->fIconLookupList.FirstItem();
+	while (_this->fIconLookupThread >= 0) {
+		_this->fIconLookupLock.Lock();
+		IconLookup* item = _this->fIconLookupList.RemoveItemAt(0);
+		if (item != NULL)
+			_this->fIconLookupCurrent = item->fStation;
+		_this->fIconLookupLock.Unlock();
+
+		if (item == NULL)
+			break;
+
 		BBitmap* logo = _this->RetrieveLogo(item->fIconUrl);
-		if (logo != NULL) {
-			item->fStation->SetLogo(logo);
-
-			BMessage* notification = new BMessage(MSG_UPDATE_STATION);
-			notification->AddPointer("station", item->fStation);
-			if (_this->fIconLookupThread >= 0 && _this->fIconLookupNotify->LockLooper()) {
-				_this->fIconLookupNotify->PostMessage(notification);
-				_this->fIconLookupNotify->UnlockLooper();
-			}
+		delete item;
+
+		// The station may have been released while the logo was retrieved
+		_this->fIconLookupLock.Lock();
+		Station* station = _this->fIconLookupCurrent;
+		_this->fIconLookupCurrent = NULL;
+		if (station != NULL && logo != NULL)
+			station->SetLogo(logo);
+		else
+			delete logo;
+		_this->fIconLookupLock.Unlock();
+
+		if (station == NULL || logo == NULL)
+			continue;
+
+		BMessage* notification = new BMessage(MSG_UPDATE_STATION);
+		notification->AddPointer("station", station);
+		if (_this->fIconLookupThread >= 0 && _this->fIconLookupNotify->LockLooper()) {
+			_this->fIconLookupNotify->PostMessage(notification);
+			_this->fIconLookupNotify->UnlockLooper();
 		}
-		_this->fIconLookupList.RemoveItem(item, true);
 	}
 
 	_this->fIconLookupThread = -1;
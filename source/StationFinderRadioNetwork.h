@@ -19,6 +19,8 @@
 #define _STATION_FINDER_RADIO_NETWORK_H
 
 
+#include <Locker.h>
+
 #include "StationFinder.h"
 
 
@@ -41,6 +43,8 @@ public:
 
 	virtual StationList* FindBy(
 		int capabilityIndex, const char* searchFor, BLooper* resultUpdateTarget);
+	virtual void ReleaseStation(Station* station);
+	virtual void ReleaseStations();
 
 private:
 	static int32 _IconLookupFunc(void* data);
@@ -52,6 +56,9 @@ private:
 	static BString sCachedServerUrl;
 
 	thread_id fIconLookupThread;
+	// Guards the lookups against stations being released meanwhile
+	BLocker fIconLookupLock;
+	Station* fIconLookupCurrent;
 #if B_HAIKU_VERSION > B_HAIKU_VERSION_1_BETA_5
 	BObjectList<IconLookup, true> fIconLookupList;
 #else
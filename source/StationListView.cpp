@@ -19,26 +19,89 @@
 #include "StationListView.h"
 
 #include <Application.h>
+#include <Autolock.h>
+#include <Region.h>
 #include <Resources.h>
 #include <TranslationUtils.h>
 
+#include <math.h>
+
+#include "Debug.h"
 #include "StreamPlayer.h"
 #include "Utils.h"
 
 
 #define SLV_INSET 2
 #define SLV_PADDING 6
-#define SLV_HEIGHT 50
 #define SLV_MAIN_FONT_SIZE 13
 #define SLV_SMALL_FONT_SIZE 10
 #define SLV_BUTTON_SIZE 20
+#define SLV_FILL_BAR_HEIGHT 5
+
+// Buffer levels and play states are collected on the items and repainted
+// together at this interval, however often the players report them.
+#define SLV_REFRESH_INTERVAL 66666
+
+enum {
+	kDirtyFillBar = 0x01,
+	kDirtyItem = 0x02
+};
+
+
+/**
+ * A pending logo rescale. The logo is copied when the request is queued, so
+ * the scaler thread never touches a Station that may be deleted meanwhile.
+ */
+class LogoThumbnailRequest {
+public:
+	LogoThumbnailRequest(StationListViewItem* item, BBitmap* logo, uint32 revision, uint32 serial)
+		: fItem(item),
+		  fLogo(logo),
+		  fRevision(revision),
+		  fSerial(serial)
+	{
+	}
+
+	~LogoThumbnailRequest() { delete fLogo; }
+
+	StationListViewItem* fItem;
+	BBitmap* fLogo;
+	uint32 fRevision;
+	uint32 fSerial;
+};
+
+
+static BRect
+LogoBounds()
+{
+	return BRect(0, 0, SLV_HEIGHT - 3 * SLV_INSET, SLV_HEIGHT - 3 * SLV_INSET);
+}
+
+
+static BRect
+FillBarFrame(BRect itemFrame)
+{
+	BRect frame(itemFrame);
+	frame.bottom -= SLV_INSET;
+	frame.left += SLV_HEIGHT - SLV_INSET + SLV_PADDING;
+	frame.top = frame.bottom - SLV_FILL_BAR_HEIGHT;
+	frame.right -= SLV_PADDING;
+
+	return frame;
+}
 
 
 StationListViewItem::StationListViewItem(Station* station)
 	: BListItem(0, true),
 	  fPlayer(NULL),
 	  fStation(station),
-	  fList(NULL)
+	  fHost(NULL),
+	  fFillRatio(0),
+	  fDirty(0),
+	  fThumbnail(NULL),
+	  fThumbnailRevision(0),
+	  fThumbnailRequest(0),
+	  fThumbnailFailed(false)
 {
 	SetHeight(SLV_HEIGHT);
 }
@@ -50,6 +113,7 @@ StationListViewItem::~StationListViewItem()
 		fPlayer->Stop();
 		delete fPlayer;
 	}
+	delete fThumbnail;
 	delete fStation;
 }
 
@@ -66,13 +130,22 @@ StationListViewItem::State()
 void
 StationListViewItem::DrawItem(BView* owner, BRect frame, bool complete)
 {
-	int index = ((BListView*)owner)->IndexOf(this);
-
 	StationListView* ownerList = (StationListView*)owner;
-	ownerList->SetHighColor(ui_color(
+	DrawStation(owner, frame, ownerList->IndexOf(this), ownerList->CanPlay());
+}
+
+
+/**
+ * Draws the item into any view, so that it can also be used as a row outside
+ * of a BListView. The index only selects the alternating background color.
+ */
+void
+StationListViewItem::DrawStation(BView* owner, BRect frame, int32 index, bool canPlay)
+{
+	owner->SetHighColor(ui_color(
 		IsSelected() ? B_MENU_SELECTION_BACKGROUND_COLOR
 					 : ((index % 2) ? B_MENU_BACKGROUND_COLOR : B_DOCUMENT_BACKGROUND_COLOR)));
-	ownerList->FillRect(frame);
+	owner->FillRect(frame);
 
 	owner->SetHighColor(
 		ui_color(IsSelected() ? B_MENU_SELECTED_ITEM_TEXT_COLOR : B_MENU_ITEM_TEXT_COLOR));
@@ -80,9 +153,14 @@ StationListViewItem::DrawItem(BView* owner, BRect frame, bool complete)
 		IsSelected() ? B_MENU_SELECTION_BACKGROUND_COLOR
 					 : ((index % 2) ? B_MENU_BACKGROUND_COLOR : B_DOCUMENT_BACKGROUND_COLOR)));
 
-	if (fStation->Logo() != NULL) {
-		BRect target(SLV_INSET, SLV_INSET, SLV_HEIGHT - 2 * SLV_INSET, SLV_HEIGHT - 2 * SLV_INSET);
-		target.OffsetBy(frame.LeftTop());
+	BBitmap* thumbnail = _Thumbnail();
+	if (thumbnail != NULL) {
+		owner->SetDrawingMode(B_OP_ALPHA);
+		owner->DrawBitmap(thumbnail, frame.LeftTop() + BPoint(SLV_INSET, SLV_INSET));
+		owner->SetDrawingMode(B_OP_COPY);
+	} else if (fThumbnailFailed && fStation->Logo() != NULL) {
+		BRect target(LogoBounds());
+		target.OffsetBy(frame.LeftTop() + BPoint(SLV_INSET, SLV_INSET));
 
 		owner->DrawBitmap(
 			fStation->Logo(), fStation->Logo()->Bounds(), target, B_FILTER_BITMAP_BILINEAR);
@@ -107,8 +185,9 @@ StationListViewItem::DrawItem(BView* owner, BRect frame, bool complete)
 		BString("") << fStation->BitRate() / 1000.0 << " kbps " << fStation->Mime()->Type(),
 		frame.LeftTop() + BPoint(SLV_HEIGHT - SLV_INSET + SLV_PADDING, baseline));
 
-	frame = ownerList->ItemFrame(ownerList->StationIndex(fStation));
-	if (ownerList->CanPlay() && fStation->Flags(STATION_URI_VALID)) {
+	DrawBufferFillBar(owner, frame);
+
+	if (canPlay && fStation->Flags(STATION_URI_VALID)) {
 		BBitmap* bnBitmap = _GetButtonBitmap(State());
 		if (bnBitmap != NULL) {
 			owner->SetDrawingMode(B_OP_ALPHA);
@@ -124,10 +203,7 @@ void
 StationListViewItem::DrawBufferFillBar(BView* owner, BRect frame)
 {
 	if (State() == StreamPlayer::Playing || State() == StreamPlayer::Buffering) {
-		frame.bottom -= SLV_INSET;
-		frame.left = SLV_HEIGHT - SLV_INSET + SLV_PADDING;
-		frame.top = frame.bottom - 5;
-		frame.right -= SLV_PADDING;
+		frame = FillBarFrame(frame);
 
 		owner->SetHighColor(tint_color(ui_color(B_MENU_BACKGROUND_COLOR), B_LIGHTEN_2_TINT));
 		owner->FillRect(frame);
@@ -149,10 +225,43 @@ StationListViewItem::Update(BView* owner, const BFont* font)
 void
 StationListViewItem::StateChanged(StreamPlayer::PlayState newState)
 {
-	if (fList != NULL && fList->LockLooperWithTimeout(0) == B_OK) {
-		fList->InvalidateItem(fList->IndexOf(this));
-		fList->UnlockLooper();
-	}
+	_MarkDirty(kDirtyItem);
+}
+
+
+/**
+ * Flags the item for the list's next refresh. Safe to call from any thread,
+ * as it neither locks the looper nor draws.
+ */
+void
+StationListViewItem::_MarkDirty(int32 what)
+{
+	atomic_or(&fDirty, what);
+	if (fHost != NULL)
+		atomic_set(&fHost->fHasDirtyItems, 1);
+}
+
+
+/**
+ * Returns the logo prescaled to the row size, or NULL if there is none yet or
+ * it could not be scaled. A stale or missing thumbnail is queued for
+ * rescaling in the background, and the item is invalidated once it is done.
+ */
+BBitmap*
+StationListViewItem::_Thumbnail()
+{
+	if (fStation == NULL || fStation->Logo() == NULL)
+		return NULL;
+
+	if ((fThumbnail != NULL || fThumbnailFailed)
+		&& fThumbnailRevision == fStation->LogoRevision())
+		return fThumbnail;
+
+	if (fThumbnailRequest == 0 && fHost != NULL)
+		fThumbnailRequest = fHost->_RequestThumbnail(this);
+
+	// Keep showing the previous logo until the new one is ready
+	return fThumbnail;
 }
 
 
@@ -174,19 +283,43 @@ StationListViewItem::_GetButtonBitmap(StreamPlayer::PlayState state)
 void
 StationListViewItem::SetFillRatio(float fillRatio)
 {
+	if (fillRatio < 0)
+		fillRatio = 0;
+	else if (fillRatio > 1)
+		fillRatio = 1;
+
+	// Skip changes too small to move the bar by a pixel
+	if (fabs(fillRatio - fFillRatio) < 0.002f)
+		return;
+
 	fFillRatio = fillRatio;
-	if (fList->LockLooperWithTimeout(0) == B_OK) {
-		BRect frame = fList->ItemFrame(fList->IndexOf(this));
-		DrawBufferFillBar(fList, frame);
-		fList->UnlockLooper();
-	}
+	_MarkDirty(kDirtyFillBar);
+}
+
+
+StationItemHost::StationItemHost()
+	: fHasDirtyItems(0),
+	  fThumbnailLock("thumbnails"),
+	  fThumbnailQueue(20),
+	  fThumbnailThread(-1),
+	  fThumbnailQuit(false),
+	  fThumbnailSerial(0)
+{
+}
+
+
+StationItemHost::~StationItemHost()
+{
+	_StopThumbnails();
 }
 
 
 StationListView::StationListView(bool canPlay)
 	: BListView("Stations", B_SINGLE_SELECTION_LIST),
+	  StationItemHost(),
 	  fPlayMsg(NULL),
-	  fCanPlay(canPlay)
+	  fCanPlay(canPlay),
+	  fRefreshRunner(NULL)
 {
 	SetResizingMode(B_FOLLOW_ALL_SIDES);
 	SetExplicitMinSize(BSize(300, 2 * SLV_HEIGHT));
@@ -195,15 +328,57 @@ StationListView::StationListView(bool canPlay)
 
 StationListView::~StationListView()
 {
+	_StopThumbnails();
+
 	delete fPlayMsg;
 	MakeEmpty();
 }
 
 
+void
+StationListView::AttachedToWindow()
+{
+	BListView::AttachedToWindow();
+	fThumbnailTarget = BMessenger(this);
+
+	BMessage refresh(MSG_REFRESH_ITEMS);
+	fRefreshRunner = new BMessageRunner(BMessenger(this), &refresh, SLV_REFRESH_INTERVAL);
+}
+
+
+void
+StationListView::DetachedFromWindow()
+{
+	delete fRefreshRunner;
+	fRefreshRunner = NULL;
+
+	BListView::DetachedFromWindow();
+}
+
+
+void
+StationListView::MessageReceived(BMessage* message)
+{
+	switch (message->what) {
+		case MSG_THUMBNAIL_READY:
+			_ThumbnailReady(message);
+			break;
+
+		case MSG_REFRESH_ITEMS:
+			_RefreshDirtyItems();
+			break;
+
+		default:
+			BListView::MessageReceived(message);
+			break;
+	}
+}
+
+
 bool
 StationListView::AddItem(StationListViewItem* item)
 {
-	item->fList = this;
+	item->SetHost(this);
 	return BListView::AddItem(item);
 }
 
@@ -317,6 +492,194 @@ StationListView::MouseDown(BPoint where)
 }
 
 
+/**
+ * Repaints what changed on the visible items since the last refresh, as a
+ * single invalidation. Items scrolled out of view are drawn completely once
+ * they come back, so their flags can be left alone.
+ */
+void
+StationListView::_RefreshDirtyItems()
+{
+	if (atomic_get_and_set(&fHasDirtyItems, 0) == 0)
+		return;
+
+	BRect bounds = Bounds();
+	int32 first = IndexOf(bounds.LeftTop());
+	int32 last = IndexOf(bounds.LeftBottom());
+	if (first < 0)
+		first = 0;
+	if (last < 0)
+		last = CountItems() - 1;
+
+	BRegion dirtyRegion;
+	for (int32 i = first; i <= last; i++) {
+		StationListViewItem* item = ItemAt(i);
+		int32 dirty = atomic_get_and_set(&item->fDirty, 0);
+		if (dirty == 0)
+			continue;
+
+		BRect frame = ItemFrame(i);
+		if ((dirty & kDirtyItem) != 0)
+			dirtyRegion.Include(frame);
+		else
+			dirtyRegion.Include(FillBarFrame(frame));
+	}
+
+	if (dirtyRegion.CountRects() > 0)
+		Invalidate(&dirtyRegion);
+}
+
+
+bool
+StationListView::_HasItem(StationListViewItem* item)
+{
+	return HasItem(item);
+}
+
+
+void
+StationListView::_InvalidateItem(StationListViewItem* item)
+{
+	InvalidateItem(IndexOf(item));
+}
+
+
+uint32
+StationItemHost::_RequestThumbnail(StationListViewItem* item)
+{
+	Station* station = item->GetStation();
+	BBitmap* logo = new (std::nothrow) BBitmap(station->Logo());
+	if (logo == NULL || logo->InitCheck() != B_OK) {
+		delete logo;
+		return 0;
+	}
+
+	BAutolock _(fThumbnailLock);
+
+	if (++fThumbnailSerial == 0)
+		fThumbnailSerial++;
+
+	LogoThumbnailRequest* request
+		= new LogoThumbnailRequest(item, logo, station->LogoRevision(), fThumbnailSerial);
+	fThumbnailQueue.AddItem(request);
+
+	if (fThumbnailThread < 0) {
+		fThumbnailThread
+			= spawn_thread(&_ThumbnailThreadFunc, "logo thumbnails", B_LOW_PRIORITY, this);
+		if (fThumbnailThread < 0) {
+			// Nobody would answer, the item asks again when drawn next
+			fThumbnailQueue.RemoveItem(request);
+			delete request;
+			return 0;
+		}
+		resume_thread(fThumbnailThread);
+	}
+
+	return fThumbnailSerial;
+}
+
+
+/**
+ * Hands a finished thumbnail to its item, unless the item is gone or has
+ * asked for a newer logo meanwhile. Without a thumbnail, scaling failed, and
+ * the item draws the logo itself rather than asking again.
+ */
+void
+StationItemHost::_ThumbnailReady(BMessage* message)
+{
+	StationListViewItem* item = NULL;
+	BBitmap* thumbnail = NULL;
+	message->FindPointer("item", (void**)&item);
+	message->FindPointer("thumbnail", (void**)&thumbnail);
+	uint32 serial = message->GetUInt32("serial", 0);
+
+	if (item == NULL || !_HasItem(item) || item->fThumbnailRequest != serial) {
+		delete thumbnail;
+		return;
+	}
+
+	delete item->fThumbnail;
+	item->fThumbnail = thumbnail;
+	item->fThumbnailRevision = message->GetUInt32("revision", 0);
+	item->fThumbnailFailed = thumbnail == NULL;
+	item->fThumbnailRequest = 0;
+	_InvalidateItem(item);
+}
+
+
+/**
+ * Waits for the scaler thread and drops pending requests. Views call this
+ * from their destructor, before their items are deleted.
+ */
+void
+StationItemHost::_StopThumbnails()
+{
+	fThumbnailLock.Lock();
+	fThumbnailQuit = true;
+	thread_id thumbnailThread = fThumbnailThread;
+	fThumbnailLock.Unlock();
+
+	if (thumbnailThread >= 0) {
+		status_t status;
+		wait_for_thread(thumbnailThread, &status);
+	}
+
+	BAutolock _(fThumbnailLock);
+	for (int32 i = fThumbnailQueue.CountItems() - 1; i >= 0; i--)
+		delete fThumbnailQueue.RemoveItemAt(i);
+}
+
+
+bool
+StationItemHost::_ThumbnailsStopping()
+{
+	BAutolock _(fThumbnailLock);
+	return fThumbnailQuit;
+}
+
+
+int32
+StationItemHost::_ThumbnailThreadFunc(void* data)
+{
+	StationItemHost* _this = (StationItemHost*)data;
+
+	while (true) {
+		_this->fThumbnailLock.Lock();
+		LogoThumbnailRequest* request = NULL;
+		if (!_this->fThumbnailQuit)
+			request = _this->fThumbnailQueue.RemoveItemAt(0);
+		if (request == NULL) {
+			_this->fThumbnailThread = -1;
+			_this->fThumbnailLock.Unlock();
+			break;
+		}
+		_this->fThumbnailLock.Unlock();
+
+		// Failures are replied to as well, or the item would wait for good
+		BBitmap* thumbnail = Utils::ScaledBitmap(request->fLogo, LogoBounds());
+		BMessage notification(MSG_THUMBNAIL_READY);
+		notification.AddPointer("item", request->fItem);
+		notification.AddPointer("thumbnail", thumbnail);
+		notification.AddUInt32("revision", request->fRevision);
+		notification.AddUInt32("serial", request->fSerial);
+		delete request;
+
+		// A busy window is waited for, one that is closing is not
+		status_t status;
+		do {
+			status = _this->fThumbnailTarget.SendMessage(&notification, (BHandler*)NULL, 1000000);
+		} while (status == B_TIMED_OUT && !_this->_ThumbnailsStopping());
+
+		if (status != B_OK) {
+			TRACE("Could not deliver logo thumbnail\n");
+			delete thumbnail;
+		}
+	}
+
+	return B_OK;
+}
+
+
 void
 StationListView::MouseUp(BPoint where)
 {
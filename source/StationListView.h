@@ -21,6 +21,10 @@
 #include <Button.h>
 #include <ListItem.h>
 #include <ListView.h>
+#include <Locker.h>
+#include <MessageRunner.h>
+#include <Messenger.h>
+#include <ObjectList.h>
 #include <Window.h>
 
 #include "RadioSettings.h"
@@ -29,12 +33,19 @@
 
 
 #define MSG_STATION_LIST 'STLS'
+#define MSG_THUMBNAIL_READY 'mTHR'
+#define MSG_REFRESH_ITEMS 'mRFI'
 
+#define SLV_HEIGHT 50
 
+
+class LogoThumbnailRequest;
+class StationItemHost;
 class StationListView;
 
 
 class StationListViewItem : public BListItem {
+	friend class StationItemHost;
 	friend class StationListView;
 
 public:
@@ -42,6 +53,7 @@ public:
 	virtual ~StationListViewItem();
 
 	virtual void DrawItem(BView* owner, BRect frame, bool complete);
+	void DrawStation(BView* owner, BRect frame, int32 index, bool canPlay);
 
 	void DrawBufferFillBar(BView* owner, BRect frame);
 	virtual void Update(BView* owner, const BFont* font);
@@ -54,21 +66,69 @@ public:
 	StreamPlayer::PlayState State();
 	void SetPlayer(StreamPlayer* player) { fPlayer = player; }
 
+	void SetHost(StationItemHost* host) { fHost = host; }
+
 private:
 	static BBitmap* _GetButtonBitmap(StreamPlayer::PlayState state);
+	BBitmap* _Thumbnail();
+	void _MarkDirty(int32 what);
 
 private:
 	static BBitmap* sButtonBitmap[3];
 
 	StreamPlayer* fPlayer;
 	class Station* fStation;
-	StationListView* fList;
+	StationItemHost* fHost;
 
 	float fFillRatio;
+	int32 fDirty;
+
+	BBitmap* fThumbnail;
+	uint32 fThumbnailRevision;
+	uint32 fThumbnailRequest;
+	// The logo of fThumbnailRevision could not be scaled
+	bool fThumbnailFailed;
 };
 
 
-class StationListView : public BListView {
+/**
+ * Services shared by the views showing StationListViewItems: background
+ * logo scaling and tracking of items that need repainting.
+ */
+class StationItemHost {
+public:
+	StationItemHost();
+	virtual ~StationItemHost();
+
+protected:
+	friend class StationListViewItem;
+
+	virtual bool _HasItem(StationListViewItem* item) = 0;
+	virtual void _InvalidateItem(StationListViewItem* item) = 0;
+
+	uint32 _RequestThumbnail(StationListViewItem* item);
+	void _ThumbnailReady(BMessage* message);
+	void _StopThumbnails();
+
+protected:
+	BMessenger fThumbnailTarget;
+	int32 fHasDirtyItems;
+
+private:
+	bool _ThumbnailsStopping();
+
+	static int32 _ThumbnailThreadFunc(void* data);
+
+private:
+	BLocker fThumbnailLock;
+	BObjectList<LogoThumbnailRequest> fThumbnailQueue;
+	thread_id fThumbnailThread;
+	bool fThumbnailQuit;
+	uint32 fThumbnailSerial;
+};
+
+
+class StationListView : public BListView, public StationItemHost {
 public:
 	StationListView(bool canPlay = false);
 	virtual ~StationListView();
@@ -88,14 +148,25 @@ public:
 	void SetPlayMessage(BMessage* playMsg);
 	bool CanPlay() { return fCanPlay; }
 
+	virtual void AttachedToWindow();
+	virtual void DetachedFromWindow();
+	virtual void MessageReceived(BMessage* message);
+
 private:
 	virtual void MouseDown(BPoint where);
 	virtual void MouseUp(BPoint where);
 
+	virtual bool _HasItem(StationListViewItem* item);
+	virtual void _InvalidateItem(StationListViewItem* item);
+
+	void _RefreshDirtyItems();
+
 private:
 	BPoint fWhereDown;
 	BMessage* fPlayMsg;
 	bool fCanPlay;
+
+	BMessageRunner* fRefreshRunner;
 };
 
 
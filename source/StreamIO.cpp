@@ -19,18 +19,22 @@
 
 #include "StreamIO.h"
 
-#define __USE_GNU
-#include <regex.h>
-
+#include <Autolock.h>
 #include <Catalog.h>
+#include <DataIO.h>
 #include <MediaIO.h>
 #include <NetworkAddressResolver.h>
 #include <Socket.h>
 #include <Url.h>
 
+#include "AudioHeader.h"
 #include "Debug.h"
+#include "HlsPlaylist.h"
 #include "HttpUtils.h"
 #include "Station.h"
+#include "StreamRecorder.h"
+#include "TimeShiftBuffer.h"
+#include "Utils.h"
 
 
 const char kMpegHeader1 = '\xff';
@@ -38,16 +42,42 @@ const char kMpegHeader2 = '\xe0';
 
 #define HTTP_TIMEOUT 30000000
 
+// Interval at which a stream with a full buffer checks whether it may go on
+const bigtime_t kBufferLimitWait = 20000;
+
+// Reconnect delays, doubled on every attempt up to the maximum
+const bigtime_t kReconnectDelay = 500000;
+const bigtime_t kMaxReconnectDelay = 30000000;
+const int32 kMaxReconnectAttempts = 10;
+
+// Playlists and segments of HLS streams are fetched with a shorter timeout, as
+// the next segment is due after a few seconds anyway.
+const bigtime_t kHlsTimeout = 10000000;
+
+// Segments before the end of a live HLS playlist to start with, which is the
+// minimum the specification asks for. They are fetched right away, so that
+// playback starts with a full buffer.
+const int32 kHlsLiveEdgeSegments = 3;
+
 
 #undef B_TRANSLATION_CONTEXT
 #define B_TRANSLATION_CONTEXT "StreamIO"
 
 
+bool StreamIO::sUseReactor = false;
+TokenBucket StreamIO::sBandwidth;
+
+
 StreamIO::StreamIO(Station* station, BLooper* metaListener)
 	: BAdapterIO(B_MEDIA_STREAMING | B_MEDIA_SEEKABLE, HTTP_TIMEOUT),
 	  fStation(station),
+	  fHls(station->IsHls()),
+	  fRequestLock("stream request"),
 	  fReq(NULL),
 	  fReqThread(-1),
+	  fUseReactor(sUseReactor && !fHls && station->StreamUrl().Protocol() == "http"),
+	  fConnection(NULL),
+	  fConnected(false),
 	  fUnsynched(0),
 	  fMetaInt(0),
 	  fMetaSize(0),
@@ -56,9 +86,93 @@ StreamIO::StreamIO(Station* station, BLooper* metaListener)
 	  fMetaListener(metaListener),
 	  fFrameSync(none),
 	  fLimit(0),
-	  fBuffered(0)
+	  fBuffered(0),
+	  fReadEnd(0),
+	  fHighWater(STREAM_BUFFER_LIMIT),
+	  fLowWater(STREAM_BUFFER_LIMIT / 2),
+	  fThrottled(false),
+	  fStopping(0),
+	  fReceived(false),
+	  fReconnecting(0),
+	  fReconnectAttempts(0),
+	  fReconnectThread(-1),
+	  fMirror(0),
+	  fSinkLock("stream sinks"),
+	  fTimeShift(NULL),
+	  fRecorder(NULL),
+	  fRecordOnly(false),
+	  fIsMutable(false)
+{
+	if (fHls)
+		fIsMutable = true;
+	else {
+		// Mirrors are ordered by their latency, the first one that responds is used
+		status_t status = _Connect();
+		while (status != B_OK && ++fMirror < fStation->Mirrors().CountStrings())
+			status = _Connect();
+
+		if (status != B_OK)
+			return;
+	}
+
+	fInputAdapter = BuildInputAdapter();
+	_ResetDataFuncs();
+}
+
+
+StreamIO::~StreamIO()
+{
+	atomic_set(&fStopping, 1);
+
+	if (fReconnectThread >= 0) {
+		status_t status;
+		wait_for_thread(fReconnectThread, &status);
+	}
+
+	if (fConnection != NULL) {
+		StreamReactor::Default()->Remove(fConnection);
+		delete fConnection;
+	}
+
+	if (fReqThread >= 0) {
+		{
+			BAutolock lock(fRequestLock);
+			if (fReq != NULL)
+				fReq->Stop();
+		}
+
+		status_t status;
+		wait_for_thread(fReqThread, &status);
+	}
+
+	delete fReq;
+	delete fRecorder;
+}
+
+
+/**
+ * Returns the URL of the mirror in use. The first mirror is the stream URL,
+ * which is followed when the stream moved permanently.
+ */
+BUrl
+StreamIO::_MirrorUrl()
 {
-	BUrl url = station->StreamUrl();
+	const BStringList& mirrors = fStation->Mirrors();
+	int32 count = mirrors.CountStrings();
+	if (count < 2 || fMirror % count == 0)
+		return fStation->StreamUrl();
+
+	return BUrl(mirrors.StringAt(fMirror % count));
+}
+
+
+BHttpRequest*
+StreamIO::_CreateRequest()
+{
+	BUrl url = _MirrorUrl();
+	BHttpRequest* request = NULL;
+
+	TRACE("Connecting to %s\n", url.UrlString().String());
 
 	// FIXME: UGLY HACK!
 	// Currently Haiku's HttpRequest is not able to check for connection on a
@@ -79,39 +193,106 @@ StreamIO::StreamIO(Station* station, BLooper* metaListener)
 	// IP's should be small, anyway.
 
 	if (url.Protocol() == "https") {
-		fReq = dynamic_cast<BHttpRequest*>(
+		request = dynamic_cast<BHttpRequest*>(
 			BUrlProtocolRoster::MakeRequest(url.UrlString().String(), this, this));
 	} else {
 		BUrl* newUrl = new BUrl();
 		if (newUrl == NULL)
-			return;
+			return NULL;
 
 		status_t portStatus = HttpUtils::CheckPort(url, newUrl);
-		if (portStatus != B_OK)
-			return;
+		if (portStatus != B_OK) {
+			delete newUrl;
+			return NULL;
+		}
 
-		fReq = dynamic_cast<BHttpRequest*>(
+		request = dynamic_cast<BHttpRequest*>(
 			BUrlProtocolRoster::MakeRequest(newUrl->UrlString().String(), this, this));
 		delete newUrl;
 	}
 
-	if (fReq == NULL)
-		return;
+	if (request == NULL)
+		return NULL;
 
 	BHttpHeaders* headers = new BHttpHeaders();
-	if (headers == NULL)
-		return;
+	if (headers == NULL) {
+		delete request;
+		return NULL;
+	}
 
 	headers->AddHeader("Icy-MetaData", 1);
 	headers->AddHeader("Icy-Reset", 1);
 	headers->AddHeader("Accept", "audio/*");
 
-	fReq->AdoptHeaders(headers);
-	fReq->SetFollowLocation(true);
-	fReq->SetMaxRedirections(3);
-	fReq->SetStopOnError(true);
+	request->AdoptHeaders(headers);
+	request->SetFollowLocation(true);
+	request->SetMaxRedirections(3);
+	request->SetStopOnError(true);
 
-	fInputAdapter = BuildInputAdapter();
+	return request;
+}
+
+
+/**
+ * Creates the request for the mirror in use, or the connection if the
+ * stream is received by the reactor.
+ */
+status_t
+StreamIO::_Connect()
+{
+	if (!fUseReactor) {
+		BHttpRequest* request = _CreateRequest();
+
+		BAutolock lock(fRequestLock);
+		fReq = request;
+		return fReq != NULL ? B_OK : B_ERROR;
+	}
+
+	StreamConnection* connection = new StreamConnection(_MirrorUrl(), this);
+	status_t status = connection->InitCheck();
+	if (status != B_OK) {
+		delete connection;
+		return status;
+	}
+
+	fConnection = connection;
+	return B_OK;
+}
+
+
+status_t
+StreamIO::_Start()
+{
+	if (fConnection == NULL) {
+		fReqThread = fReq->Run();
+		return fReqThread >= 0 ? B_OK : fReqThread;
+	}
+
+	// The connection may be closed before Add() returns
+	fConnected = true;
+	status_t status = StreamReactor::Default()->Add(fConnection);
+	if (status != B_OK)
+		fConnected = false;
+
+	return status;
+}
+
+
+/**
+ * Sets up the chain of data handlers for a new response. The ICY metadata
+ * handler is added once the headers tell the metadata interval, and MPEG
+ * streams are synchronized on the next frame header.
+ */
+void
+StreamIO::_ResetDataFuncs()
+{
+	fDataFuncs = DataFuncs();
+	fFrameSync = none;
+	fUnsynched = 0;
+	fMetaInt = 0;
+	fMetaSize = 0;
+	fUntilMetaStart = 0;
+	fUntilMetaEnd = 0;
 
 	const char* mime = fStation->Mime()->Type();
 	if (!strcmp(mime, "audio/mpeg") || !strcmp(mime, "audio/aacp"))
@@ -121,15 +302,83 @@ StreamIO::StreamIO(Station* station, BLooper* metaListener)
 }
 
 
-StreamIO::~StreamIO()
+/**
+ * Receives the stream into a time shift buffer instead of our own buffer, or
+ * back into our own one if buffer is NULL. What was buffered and not read yet
+ * is handed over, so that nothing is lost.
+ */
+void
+StreamIO::SetTimeShift(TimeShiftBuffer* buffer)
 {
-	if (fReqThread >= 0) {
-		fReq->Stop();
-		status_t status;
-		wait_for_thread(fReqThread, &status);
+	BAutolock lock(fSinkLock);
+
+	if (buffer != NULL) {
+		off_t size = 0;
+		GetSize(&size);
+
+		char data[4096];
+		for (off_t position = Position(); position < size;) {
+			ssize_t read = BAdapterIO::ReadAt(
+				position, data, min_c((off_t)sizeof(data), size - position));
+			if (read <= 0)
+				break;
+
+			buffer->Append(data, read);
+			position += read;
+		}
+
+		// What is left unread is not ours to hold back the stream with anymore
+		atomic_set64(&fBuffered, 0);
 	}
 
-	delete fReq;
+	fTimeShift = buffer;
+}
+
+
+/**
+ * Starts recording the stream to directory, from the data received next.
+ */
+status_t
+StreamIO::StartRecording(const BPath& directory)
+{
+	if (IsRecording())
+		return B_OK;
+
+	StreamRecorder* recorder = new StreamRecorder(fStation, directory);
+	status_t status = recorder->InitCheck();
+	if (status != B_OK) {
+		delete recorder;
+		return status;
+	}
+
+	BAutolock lock(fSinkLock);
+	fRecorder = recorder;
+	return B_OK;
+}
+
+
+void
+StreamIO::StopRecording()
+{
+	StreamRecorder* recorder;
+	{
+		BAutolock lock(fSinkLock);
+		recorder = fRecorder;
+		fRecorder = NULL;
+	}
+
+	// Waits for the recording to be written, which must not hold up the stream
+	delete recorder;
+}
+
+
+void
+StreamIO::GetRecordingStats(off_t* recorded, off_t* dropped)
+{
+	BAutolock lock(fSinkLock);
+
+	*recorded = fRecorder != NULL ? fRecorder->RecordedSize() : 0;
+	*dropped = fRecorder != NULL ? fRecorder->DroppedSize() : 0;
 }
 
 
@@ -153,10 +402,22 @@ StreamIO::ReadAt(off_t position, void* buffer, size_t size)
 	if (fLimit == 0 || position < fLimit) {
 		ssize_t read = BAdapterIO::ReadAt(position, buffer, size);
 		if (read > 0) {
+			// Data may be read more than once, while sniffing the format
+			if (position + read > fReadEnd) {
+				int64 consumed = position + read - max_c(position, fReadEnd);
+				int64 buffered = atomic_get64(&fBuffered);
+				int64 previous;
+				while ((previous = atomic_test_and_set64(&fBuffered,
+							buffered - min_c(consumed, buffered), buffered))
+					!= buffered) {
+					buffered = previous;
+				}
+				fReadEnd = position + read;
+			}
+
 			TRACE("Read %" B_PRIdSSIZE " of %" B_PRIuSIZE " bytes from position %" B_PRIdOFF
-				  ", %" B_PRIuSIZE " remaining\n",
-				read, size, position, fBuffered);
-			fBuffered -= read;
+				  ", %" B_PRId64 " remaining\n",
+				read, size, position, atomic_get64(&fBuffered));
 		} else {
 			TRACE("Reading %" B_PRIuSIZE " bytes from position %" B_PRIdOFF " failed - %s\n", size,
 				position, strerror(read));
@@ -182,11 +443,19 @@ StreamIO::SetSize(off_t size)
 status_t
 StreamIO::Open()
 {
-	if (fReq == NULL)
+	if (fHls) {
+		fReqThread = spawn_thread(&_HlsThreadFunc, "hls stream", B_NORMAL_PRIORITY, this);
+		if (fReqThread < B_OK)
+			return B_ERROR;
+
+		resume_thread(fReqThread);
+		return BAdapterIO::Open();
+	}
+
+	if (fReq == NULL && fConnection == NULL)
 		return B_ERROR;
 
-	fReqThread = fReq->Run();
-	if (fReqThread < B_OK)
+	if (_Start() != B_OK)
 		return B_ERROR;
 
 	return BAdapterIO::Open();
@@ -196,7 +465,21 @@ StreamIO::Open()
 bool
 StreamIO::IsRunning() const
 {
-	return fReqThread >= 0;
+	return fReqThread >= 0 || fConnected
+		|| atomic_get(const_cast<int32*>(&fReconnecting)) != 0;
+}
+
+
+/**
+ * Stops receiving once highWater bytes are buffered and unread, until they
+ * are down to lowWater, or half of highWater if that is 0. The server is held
+ * back by TCP meanwhile. A highWater of 0 receives without limit.
+ */
+void
+StreamIO::SetBufferLimit(size_t highWater, size_t lowWater)
+{
+	fLowWater = lowWater > 0 ? min_c(lowWater, highWater) : highWater / 2;
+	fHighWater = highWater;
 }
 
 
@@ -207,30 +490,69 @@ StreamIO::SetLimiter(size_t limit)
 }
 
 
+size_t
+StreamIO::BufferedSize()
+{
+	return max_c(atomic_get64(&fBuffered), 0);
+}
+
+
 void
 StreamIO::HeadersReceived(BUrlRequest* request)
 {
-	BHttpRequest* httpReq = dynamic_cast<BHttpRequest*>(request);
 	const BHttpResult* httpResult = dynamic_cast<const BHttpResult*>(&request->Result());
+	_HeadersReceived(httpResult->StatusCode(), httpResult->Headers(), httpResult->Length());
+}
 
-	if (httpReq->IsRedirectionStatusCode(httpResult->StatusCode())) {
-		if (httpResult->StatusCode() == 301) {	// Permanent redirect
-			fStation->SetStreamUrl(httpResult->Headers()["location"]);
-			TRACE("Permanently redirected to %s\n", httpResult->Headers()["location"]);
+
+void
+StreamIO::ConnectionHeaders(int32 status, const BHttpHeaders& headers, off_t length)
+{
+	_HeadersReceived(status, headers, length);
+}
+
+
+bool
+StreamIO::ConnectionCanReceive()
+{
+	return _CanReceive() && fBandwidth.IsAvailable() && sBandwidth.IsAvailable();
+}
+
+
+ssize_t
+StreamIO::ConnectionData(const void* data, size_t size)
+{
+	return Write(data, size);
+}
+
+
+void
+StreamIO::ConnectionClosed(status_t status)
+{
+	_Completed();
+}
+
+
+void
+StreamIO::_HeadersReceived(int32 status, const BHttpHeaders& headers, off_t length)
+{
+	if (BHttpRequest::IsRedirectionStatusCode(status)) {
+		if (status == 301) {	// Permanent redirect
+			fStation->SetStreamUrl(headers["location"]);
+			TRACE("Permanently redirected to %s\n", headers["location"]);
 		} else
-			TRACE("Redirected to %s\n", httpResult->Headers()["location"]);
+			TRACE("Redirected to %s\n", headers["location"]);
 
 		return;
 	}
 
-	off_t size = httpResult->Length();
-	if (size > 0)
-		BAdapterIO::SetSize(size);
+	if (length > 0)
+		BAdapterIO::SetSize(length);
 	else
 		fIsMutable = true;
 
-	const char* sMetaInt = httpResult->Headers()["icy-metaint"];
-	fIcyName = httpResult->Headers()["icy-name"];
+	const char* sMetaInt = headers["icy-metaint"];
+	fIcyName = headers["icy-name"];
 	if (sMetaInt != NULL) {
 		fMetaInt = atoi(sMetaInt);
 		fUntilMetaStart = fMetaInt;
@@ -242,8 +564,19 @@ StreamIO::HeadersReceived(BUrlRequest* request)
 ssize_t
 StreamIO::_DataSyncedReceived(const char* data, size_t size, int next)
 {
+	BAutolock lock(fSinkLock);
+	if (fRecorder != NULL)
+		fRecorder->Append(data, size);
+
+	if (fRecordOnly)
+		return size;
+
+	if (fTimeShift != NULL)
+		return fTimeShift->Append(data, size);
+
 	ssize_t written = fInputAdapter->Write(data, size);
-	fBuffered += written;
+	if (written > 0)
+		atomic_add64(&fBuffered, written);
 	return written;
 }
 
@@ -357,6 +690,22 @@ StreamIO::_DataUnsyncedReceived(const char* data, size_t size, int next)
 ssize_t
 StreamIO::Write(const void* buffer, size_t size)
 {
+	// Holding up the request thread also holds up the transfer, so a stream
+	// on standby costs no more bandwidth than memory once its buffer is full.
+	// Streams received by the reactor are held back by it instead.
+	bool mayWait = fConnection == NULL;
+	while (mayWait && !_CanReceive())
+		snooze(kBufferLimitWait);
+
+	if (size > 0) {
+		fReceived = true;
+		fReconnectAttempts = 0;
+	}
+
+	bigtime_t delay = max_c(fBandwidth.Consume(size), sBandwidth.Consume(size));
+	if (mayWait && delay > 0)
+		_Wait(delay);
+
 	DataFunc f = fDataFuncs.First();
 	if (f)
 		return (*this.*f)((const char*)buffer, size, 1);
@@ -364,10 +713,364 @@ StreamIO::Write(const void* buffer, size_t size)
 }
 
 
+/**
+ * Returns whether there is room for more data, between the water marks.
+ */
+bool
+StreamIO::_CanReceive()
+{
+	if (atomic_get(&fStopping) != 0 || fHighWater == 0)
+		return true;
+
+	size_t buffered = BufferedSize();
+	if (buffered >= fHighWater)
+		fThrottled = true;
+	else if (buffered <= fLowWater)
+		fThrottled = false;
+
+	return !fThrottled;
+}
+
+
+/**
+ * Live streams that dropped after having sent data are reconnected, while the
+ * buffered data keeps playing. Anything else ends the stream.
+ */
 void
 StreamIO::RequestCompleted(BUrlRequest* request, bool success)
 {
-	fReqThread = -1;
+	_Completed();
+}
+
+
+void
+StreamIO::_Completed()
+{
+	// The reactor and Failover() may both report the same connection closed
+	if (atomic_test_and_set(&fReconnecting, 1, 0) != 0)
+		return;
+
+	if (atomic_get(&fStopping) != 0 || !fIsMutable || !fReceived
+		|| fReconnectAttempts >= kMaxReconnectAttempts) {
+		fReqThread = -1;
+		fConnected = false;
+		atomic_set(&fReconnecting, 0);
+		return;
+	}
+
+	_StartReconnect();
+}
+
+
+/**
+ * Spawns the reconnect thread, once the caller set fReconnecting.
+ */
+void
+StreamIO::_StartReconnect()
+{
+	fReconnectThread
+		= spawn_thread(&_ReconnectThreadFunc, "stream reconnect", B_NORMAL_PRIORITY, this);
+	if (fReconnectThread < 0) {
+		fReqThread = -1;
+		fConnected = false;
+		atomic_set(&fReconnecting, 0);
+		return;
+	}
+
+	resume_thread(fReconnectThread);
+}
+
+
+/**
+ * Drops the connection in use for the next mirror, for stations that are
+ * connected but send nothing worth playing. Stations without mirrors are
+ * connected to again. HLS streams are not: their segments come from the one
+ * playlist whatever connection fetches them, and their variants are encoded
+ * from the same source.
+ */
+status_t
+StreamIO::Failover()
+{
+	if (fHls)
+		return B_NOT_SUPPORTED;
+
+	if (atomic_get(&fStopping) != 0 || !fIsMutable || !fReceived)
+		return B_NOT_ALLOWED;
+
+	if (fUseReactor) {
+		// Claiming the reconnect keeps the reactor from starting its own
+		if (atomic_test_and_set(&fReconnecting, 1, 0) != 0)
+			return B_NOT_ALLOWED;
+
+		if (fConnection == NULL || !fConnected) {
+			atomic_set(&fReconnecting, 0);
+			return B_NOT_ALLOWED;
+		}
+
+		// The reconnect starts with the mirror in use
+		fMirror++;
+
+		// The reactor does not report a connection closed once it is removed
+		StreamReactor::Default()->Remove(fConnection);
+		_StartReconnect();
+	} else {
+		// The reconnect thread deletes the request with the lock held
+		BAutolock lock(fRequestLock);
+		if (fReq == NULL || atomic_get(&fReconnecting) != 0)
+			return B_NOT_ALLOWED;
+
+		fMirror++;
+
+		// Completing the request reconnects
+		fReq->Stop();
+	}
+
+	MSG("Failing over %s\n", fStation->Name()->String());
+	return B_OK;
+}
+
+
+/**
+ * Waits with exponential backoff before connecting again. The jitter keeps
+ * the listeners of a station that went down from all coming back at once.
+ * Every attempt resolves the host again, so that another address is used if
+ * the one in use went down, and stations with mirrors move on to the next one.
+ */
+int32
+StreamIO::_ReconnectThreadFunc(void* data)
+{
+	StreamIO* _this = (StreamIO*)data;
+
+	if (_this->fConnection != NULL) {
+		StreamReactor::Default()->Remove(_this->fConnection);
+		delete _this->fConnection;
+		_this->fConnection = NULL;
+		_this->fConnected = false;
+	} else {
+		// The completed request finishes right after notifying us
+		status_t status;
+		wait_for_thread(_this->fReqThread, &status);
+
+		BAutolock lock(_this->fRequestLock);
+		delete _this->fReq;
+		_this->fReq = NULL;
+	}
+
+	status_t status = B_ERROR;
+	while (status != B_OK && atomic_get(&_this->fStopping) == 0
+		&& _this->fReconnectAttempts < kMaxReconnectAttempts) {
+		// The mirror in use gets one more chance, then the next ones are tried
+		if (_this->fReconnectAttempts > 0)
+			_this->fMirror++;
+
+		bigtime_t delay = kReconnectDelay << min_c(_this->fReconnectAttempts, 6);
+		delay = min_c(delay, kMaxReconnectDelay);
+		delay += system_time() % (delay / 2);
+		_this->fReconnectAttempts++;
+
+		MSG("Reconnecting to %s in %" B_PRIdBIGTIME " ms (attempt %" B_PRId32 ")\n",
+			_this->fStation->Name()->String(), delay / 1000, _this->fReconnectAttempts);
+
+		_this->_Wait(delay);
+		if (atomic_get(&_this->fStopping) == 0)
+			status = _this->_Connect();
+	}
+
+	if (status != B_OK) {
+		_this->fReqThread = -1;
+		atomic_set(&_this->fReconnecting, 0);
+		return B_ERROR;
+	}
+
+	_this->_ResetDataFuncs();
+	atomic_set(&_this->fReconnecting, 0);
+
+	return _this->_Start();
+}
+
+
+/**
+ * Waits for delay, or until the stream is closed.
+ */
+void
+StreamIO::_Wait(bigtime_t delay)
+{
+	for (bigtime_t waited = 0; waited < delay && atomic_get(&fStopping) == 0;
+			waited += kBufferLimitWait)
+		snooze(kBufferLimitWait);
+}
+
+
+/**
+ * Fetches url into the buffer given. The request may be stopped by closing
+ * the stream.
+ */
+status_t
+StreamIO::_Fetch(const BUrl& url, BMallocIO* into)
+{
+	BHttpRequest* request = dynamic_cast<BHttpRequest*>(
+		BUrlProtocolRoster::MakeRequest(url.UrlString().String(), into, NULL));
+	if (request == NULL)
+		return B_ERROR;
+
+	request->SetFollowLocation(true);
+	request->SetMaxRedirections(3);
+	request->SetTimeout(kHlsTimeout);
+	request->SetUserAgent(Utils::UserAgent());
+
+	{
+		BAutolock lock(fRequestLock);
+		if (atomic_get(&fStopping) != 0) {
+			delete request;
+			return B_CANCELED;
+		}
+
+		fReq = request;
+	}
+
+	thread_id thread = request->Run();
+	if (thread >= 0) {
+		status_t status;
+		wait_for_thread(thread, &status);
+	}
+
+	{
+		BAutolock lock(fRequestLock);
+		fReq = NULL;
+	}
+
+	const BHttpResult& result = (const BHttpResult&)request->Result();
+	bool success = thread >= 0 && request->IsSuccessStatusCode(result.StatusCode());
+	delete request;
+
+	if (!success || into->BufferLength() == 0)
+		return B_ERROR;
+
+	return B_OK;
+}
+
+
+/**
+ * Loads the media playlist at url, or the one of the variant that fits best
+ * if url is a master playlist.
+ */
+status_t
+StreamIO::_LoadPlaylist(const BUrl& url, HlsPlaylist* playlist)
+{
+	BUrl playlistUrl = url;
+	for (int32 level = 0; level < 2; level++) {
+		BMallocIO data;
+		status_t status = _Fetch(playlistUrl, &data);
+		if (status != B_OK)
+			return status;
+
+		data.Write("", 1);
+		status = playlist->Parse((const char*)data.Buffer(), playlistUrl);
+		if (status != B_OK || !playlist->IsMaster())
+			return status;
+
+		playlistUrl = playlist->SelectVariant();
+		TRACE("Selected HLS variant %s\n", playlistUrl.UrlString().String());
+	}
+
+	return B_BAD_DATA;
+}
+
+
+/**
+ * Appends a segment to the stream. Packed audio segments start with an ID3
+ * tag holding their timestamp, which is dropped, so that the frames of all
+ * segments join up without a gap.
+ */
+status_t
+StreamIO::_ReadSegment(const BUrl& url)
+{
+	BMallocIO segment;
+	status_t status = _Fetch(url, &segment);
+	if (status != B_OK) {
+		MSG("Could not fetch segment %s\n", url.UrlString().String());
+		return status;
+	}
+
+	const uint8* data = (const uint8*)segment.Buffer();
+	size_t size = segment.BufferLength();
+	size_t tagSize = AudioHeader::TagSize(data, size);
+	if (tagSize >= size)
+		return B_OK;
+
+	Write(data + tagSize, size - tagSize);
+	return B_OK;
+}
+
+
+/**
+ * Follows an HLS stream. The media playlist is reloaded once per target
+ * duration, or twice as often while it does not change, and the segments
+ * new to it are fetched right away, ahead of playback. Failing to load the
+ * playlist is retried like a dropped connection, while the buffer keeps
+ * playing.
+ */
+int32
+StreamIO::_HlsThreadFunc(void* data)
+{
+	StreamIO* _this = (StreamIO*)data;
+
+	BUrl url = _this->fStation->StreamUrl();
+	int64 nextSequence = -1;
+	int32 failures = 0;
+
+	while (atomic_get(&_this->fStopping) == 0) {
+		bigtime_t loaded = system_time();
+
+		HlsPlaylist playlist;
+		status_t status = _this->_LoadPlaylist(url, &playlist);
+		if (status != B_OK) {
+			if (status == B_NOT_SUPPORTED || ++failures > kMaxReconnectAttempts)
+				break;
+
+			atomic_set(&_this->fReconnecting, _this->fReceived ? 1 : 0);
+
+			bigtime_t delay = kReconnectDelay << min_c(failures - 1, 6);
+			delay = min_c(delay, kMaxReconnectDelay);
+			MSG("Reloading HLS playlist of %s in %" B_PRIdBIGTIME " ms (attempt %" B_PRId32 ")\n",
+				_this->fStation->Name()->String(), delay / 1000, failures);
+
+			_this->_Wait(delay);
+			continue;
+		}
+
+		// The variant is picked once, and its media playlist reloaded from then on
+		failures = 0;
+		url = playlist.Url();
+
+		int64 first = playlist.MediaSequence();
+		int64 end = first + playlist.CountSegments();
+		if (nextSequence < 0 || nextSequence > end)
+			nextSequence = max_c(first, end - kHlsLiveEdgeSegments);
+		else if (nextSequence < first) {
+			MSG("Skipping %" B_PRId64 " HLS segments that expired\n", first - nextSequence);
+			nextSequence = first;
+		}
+
+		bool changed = nextSequence < end;
+		for (; nextSequence < end && atomic_get(&_this->fStopping) == 0; nextSequence++)
+			_this->_ReadSegment(playlist.SegmentAt(nextSequence - first));
+
+		atomic_set(&_this->fReconnecting, 0);
+		if (playlist.IsEnded())
+			break;
+
+		bigtime_t interval = playlist.TargetDuration();
+		if (!changed)
+			interval /= 2;
+
+		_this->_Wait(loaded + interval - system_time());
+	}
+
+	atomic_set(&_this->fReconnecting, 0);
+	_this->fReqThread = -1;
+
+	return B_OK;
 }
 
 
@@ -378,37 +1081,51 @@ StreamIO::DebugMessage(BUrlRequest* caller, BUrlProtocolDebugMessage type, const
 }
 
 
+/**
+ * Splits the metadata block into its key='value'; pairs. Values may contain
+ * quotes, only a quote followed by a semicolon ends them.
+ */
 void
 StreamIO::_ProcessMeta()
 {
 	TRACE("Meta: %s\n", fMetaBuffer);
 
-	if (fMetaListener == NULL)
-		return;
-
-	regmatch_t matches[4];
-	regex_t regex;
-
 	BMessage* msg = new BMessage(MSG_META_CHANGE);
 	msg->AddString("station", fStation->Name()->String());
 
-	int res = regcomp(&regex, "([^=]*)='(([^']|'[^;])*)';",
-		RE_ICASE | RE_DOT_NEWLINE | RE_DOT_NOT_NULL | RE_NO_BK_PARENS | RE_NO_BK_VBAR
-			| RE_BACKSLASH_ESCAPE_IN_LISTS);
-
 	char* text = fMetaBuffer;
-	while ((res = regexec(&regex, text, 3, matches, 0)) == 0) {
-		text[matches[1].rm_eo] = 0;
-		text[matches[2].rm_eo] = 0;
-
-		if (text + matches[2].rm_so && !(text + matches[2].rm_so)[0])
-			msg->AddString(strlwr(text + matches[1].rm_so), fIcyName);
+	char* equals;
+	while ((equals = strstr(text, "='")) != NULL) {
+		char* value = equals + 2;
+		char* valueEnd = strstr(value, "';");
+		if (valueEnd == NULL)
+			valueEnd = strrchr(value, '\'');
+		if (valueEnd == NULL)
+			break;
+
+		*equals = 0;
+		*valueEnd = 0;
+
+		if (value[0] == 0 && !fIcyName.IsEmpty())
+			msg->AddString(strlwr(text), fIcyName);
 		else
-			msg->AddString(strlwr(text + matches[1].rm_so), text + matches[2].rm_so);
+			msg->AddString(strlwr(text), value);
+
+		text = valueEnd + 1;
+		if (*text == ';')
+			text++;
+	}
 
-		text += matches[0].rm_eo;
+	{
+		BAutolock lock(fSinkLock);
+		if (fTimeShift != NULL)
+			fTimeShift->AddMarker(msg->GetString("streamtitle", ""));
+		if (fRecorder != NULL)
+			fRecorder->NewTrack(msg->GetString("streamtitle", ""));
 	}
-	regfree(&regex);
 
-	fMetaListener->PostMessage(msg);
+	if (fMetaListener != NULL)
+		fMetaListener->PostMessage(msg);
+
+	delete msg;
 }
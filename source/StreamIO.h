@@ -19,10 +19,13 @@
 
 
 #include <HttpRequest.h>
+#include <Locker.h>
 #include <Looper.h>
 #include <UrlProtocolRoster.h>
 
 #include "AdapterIO.h"
+#include "StreamReactor.h"
+#include "TokenBucket.h"
 
 #include "override.h"
 
@@ -30,9 +33,17 @@ using namespace BPrivate::Network;
 
 #define MSG_META_CHANGE 'META'
 
+// Unread data at which a stream stops receiving, unless set otherwise
+#define STREAM_BUFFER_LIMIT 0x400000
 
+
+class BMallocIO;
+class HlsPlaylist;
 class Station;
+class BPath;
 class StreamIO;
+class StreamRecorder;
+class TimeShiftBuffer;
 
 
 typedef ssize_t (StreamIO::*DataFunc)(const char* data, size_t size, int next);
@@ -79,12 +90,38 @@ private:
 };
 
 
-class StreamIO : public BAdapterIO, BUrlProtocolListener {
+class StreamIO : public BAdapterIO, BUrlProtocolListener, StreamConnectionListener {
 public:
 	StreamIO(Station* station, BLooper* metaListener = NULL);
 	~StreamIO();
 
 	void SetLimiter(size_t limit = 0);
+	size_t BufferedSize();
+
+	void SetBufferLimit(size_t highWater = STREAM_BUFFER_LIMIT, size_t lowWater = 0);
+	void SetBandwidthLimit(size_t rate) { fBandwidth.SetRate(rate); }
+	static void SetGlobalBandwidthLimit(size_t rate) { sBandwidth.SetRate(rate); }
+	bool IsConnected() const { return fReqThread >= 0 || fConnected; }
+
+	bool IsReconnecting() { return atomic_get(&fReconnecting) != 0; }
+	status_t Failover();
+
+	void SetStation(Station* station) { fStation = station; }
+	void SetMetaListener(BLooper* metaListener) { fMetaListener = metaListener; }
+
+	void SetTimeShift(TimeShiftBuffer* buffer);
+
+	status_t StartRecording(const BPath& directory);
+	void StopRecording();
+	bool IsRecording() const { return fRecorder != NULL; }
+	void GetRecordingStats(off_t* recorded, off_t* dropped);
+
+	// Drops the data once it is recorded, for streams that are not played
+	void SetRecordOnly(bool recordOnly) { fRecordOnly = recordOnly; }
+
+	// Receives streams on the threads of the StreamReactor instead of a
+	// thread per stream, for streams created from now on
+	static void SetUseReactor(bool useReactor) { sUseReactor = useReactor; }
 
 	// BAdapterIO
 	status_t Open() override;
@@ -107,7 +144,30 @@ private:
 	void DebugMessage(
 		BUrlRequest* caller, BUrlProtocolDebugMessage type, const char* text) override;
 
+	// StreamConnectionListener
+	void ConnectionHeaders(int32 status, const BHttpHeaders& headers, off_t length) override;
+	bool ConnectionCanReceive() override;
+	ssize_t ConnectionData(const void* data, size_t size) override;
+	void ConnectionClosed(status_t status) override;
+
 	//
+	BUrl _MirrorUrl();
+	BHttpRequest* _CreateRequest();
+	status_t _Connect();
+	status_t _Start();
+	void _HeadersReceived(int32 status, const BHttpHeaders& headers, off_t length);
+	void _Completed();
+	void _StartReconnect();
+	bool _CanReceive();
+	void _ResetDataFuncs();
+	void _Wait(bigtime_t delay);
+	static int32 _ReconnectThreadFunc(void* data);
+
+	status_t _Fetch(const BUrl& url, BMallocIO* into);
+	status_t _LoadPlaylist(const BUrl& url, HlsPlaylist* playlist);
+	status_t _ReadSegment(const BUrl& url);
+	static int32 _HlsThreadFunc(void* data);
+
 	ssize_t _DataWithMetaReceived(const char* data, size_t size, int next);
 	ssize_t _DataUnsyncedReceived(const char* data, size_t size, int next);
 	ssize_t _DataSyncedReceived(const char* data, size_t size, int next);
@@ -121,8 +181,13 @@ private:
 	};
 
 	Station* fStation;
+	bool fHls;
+	BLocker fRequestLock;
 	BHttpRequest* fReq;
 	thread_id fReqThread;
+	bool fUseReactor;
+	StreamConnection* fConnection;
+	bool fConnected;
 	size_t fUnsynched;
 	size_t fMetaInt;
 	size_t fMetaSize;
@@ -131,14 +196,33 @@ private:
 	BLooper* fMetaListener;
 	FrameSync fFrameSync;
 	size_t fLimit;
-	size_t fBuffered;
+	// Received and not read yet, written by the network and the decoder thread
+	int64 fBuffered;
+	off_t fReadEnd;
+	size_t fHighWater;
+	size_t fLowWater;
+	bool fThrottled;
+	TokenBucket fBandwidth;
+	int32 fStopping;
+	bool fReceived;
+	int32 fReconnecting;
+	int32 fReconnectAttempts;
+	thread_id fReconnectThread;
+	int32 fMirror;
+	BLocker fSinkLock;
+	TimeShiftBuffer* fTimeShift;
+	StreamRecorder* fRecorder;
+	bool fRecordOnly;
 
 	DataFuncs fDataFuncs;
 	BInputAdapter* fInputAdapter;
 
-	const char* fIcyName;
+	BString fIcyName;
 	bool fIsMutable;
 	char fMetaBuffer[512];
+
+	static bool sUseReactor;
+	static TokenBucket sBandwidth;
 };
 
 
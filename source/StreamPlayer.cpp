@@ -16,28 +16,192 @@
  */
 
 
+#include <Autolock.h>
 #include <Catalog.h>
 #include <MediaDecoder.h>
 #include <MediaFile.h>
 #include <MediaTrack.h>
 
+#include <stdlib.h>
+
+#include "AudioHeader.h"
+#include "AudioMixer.h"
+#include "DeadAirDetector.h"
 #include "Debug.h"
 #include "StreamIO.h"
 #include "StreamPlayer.h"
+#include "TimeShiftBuffer.h"
 
 
 #undef B_TRANSLATION_CONTEXT
 #define B_TRANSLATION_CONTEXT "StreamPlayer"
 
 
+// Amount of data buffered before the media extractor is created; the buffer
+// fill bar shows the level relative to it.
+const size_t kPrebufferSize = 0x40000;
+
+// Minimal interval between two MSG_PLAYER_BUFFER_LEVEL notifications
+const bigtime_t kBufferLevelInterval = 250000;
+
+// Amount of buffered data below which a reconnecting stream is not read from
+const size_t kReconnectSilenceLevel = 0x4000;
+
+// Amount of data a player on standby keeps buffered, about 8 s at 128 kbit/s
+const size_t kStandbyBufferSize = 0x20000;
+
+// Amount of data checked against the stored format before starting fast
+const size_t kFastStartProbeSize = 4096;
+
+
+bool StreamPlayer::sUseMixer = false;
+bool StreamPlayer::sNormalizeLoudness = false;
+
+
+/**
+ * Decodes an MPEG audio or ADTS stream, reading it frame by frame without a
+ * media extractor.
+ */
+class FrameDecoder : public BMediaDecoder {
+public:
+	FrameDecoder(BPositionIO* stream, audio_header_codec codec, const media_format* format)
+		: BMediaDecoder(format),
+		  fStream(stream),
+		  fCodec(codec),
+		  fFrame(NULL),
+		  fFrameAllocated(0),
+		  fDecoded(NULL),
+		  fDecodedOffset(0),
+		  fDecodedLength(0),
+		  fFrameSize(0)
+	{
+	}
+
+	virtual ~FrameDecoder()
+	{
+		free(fFrame);
+		free(fDecoded);
+	}
+
+	status_t SetOutput(media_format* format)
+	{
+		status_t status = SetOutputFormat(format);
+		if (status != B_OK)
+			return status;
+
+		const media_raw_audio_format& raw = format->u.raw_audio;
+		fFrameSize = raw.channel_count * (raw.format & media_raw_audio_format::B_AUDIO_SIZE_MASK);
+		fDecoded = (uint8*)malloc(raw.buffer_size);
+		if (fFrameSize == 0 || fDecoded == NULL)
+			return B_NO_MEMORY;
+
+		return B_OK;
+	}
+
+	/**
+	 * Fills buffer with decoded audio, keeping the rest of a decoded chunk for
+	 * the next call. Returns the number of bytes filled.
+	 */
+	size_t Fill(uint8* buffer, size_t size)
+	{
+		size_t filled = 0;
+		while (filled < size) {
+			if (fDecodedOffset == fDecodedLength) {
+				int64 frames = 0;
+				media_header header;
+				media_decode_info info;
+				if (Decode(fDecoded, &frames, &header, &info) != B_OK || frames <= 0)
+					break;
+
+				fDecodedOffset = 0;
+				fDecodedLength = frames * fFrameSize;
+			}
+
+			size_t count = min_c(size - filled, fDecodedLength - fDecodedOffset);
+			memcpy(buffer + filled, fDecoded + fDecodedOffset, count);
+			fDecodedOffset += count;
+			filled += count;
+		}
+
+		return filled;
+	}
+
+	// Drops what is left of the last frame, after seeking the stream
+	void Reset()
+	{
+		fDecodedOffset = 0;
+		fDecodedLength = 0;
+	}
+
+protected:
+	virtual status_t GetNextChunk(const void** chunkData, size_t* chunkLen, media_header* mh)
+	{
+		size_t headerSize = AudioHeader::FrameHeaderSize(fCodec);
+		uint8 header[16];
+		if (fStream->Read(header, headerSize) != (ssize_t)headerSize)
+			return B_LAST_BUFFER_ERROR;
+
+		// Skip anything that is not a frame, like the rest of a partial one
+		audio_header_info info;
+		size_t length;
+		while ((length = AudioHeader::FrameLength(fCodec, header, &info)) < headerSize) {
+			memmove(header, header + 1, headerSize - 1);
+			if (fStream->Read(header + headerSize - 1, 1) != 1)
+				return B_LAST_BUFFER_ERROR;
+		}
+
+		if (length > fFrameAllocated) {
+			uint8* frame = (uint8*)realloc(fFrame, length);
+			if (frame == NULL)
+				return B_NO_MEMORY;
+
+			fFrame = frame;
+			fFrameAllocated = length;
+		}
+
+		memcpy(fFrame, header, headerSize);
+		size_t rest = length - headerSize;
+		if (fStream->Read(fFrame + headerSize, rest) != (ssize_t)rest)
+			return B_LAST_BUFFER_ERROR;
+
+		*chunkData = fFrame;
+		*chunkLen = length;
+
+		return B_OK;
+	}
+
+private:
+	BPositionIO* fStream;
+	audio_header_codec fCodec;
+	uint8* fFrame;
+	size_t fFrameAllocated;
+	uint8* fDecoded;
+	size_t fDecodedOffset;
+	size_t fDecodedLength;
+	size_t fFrameSize;
+};
+
+
 StreamPlayer::StreamPlayer(Station* station, BLooper* notify)
 	: BLocker("StreamPlayer"),
 	  fStation(station),
+	  fStationCopy(NULL),
 	  fNotify(notify),
 	  fMediaFile(NULL),
+	  fDecoder(NULL),
+	  fTimeShift(NULL),
+	  fTimeShiftWindow(0),
+	  fPaused(false),
+	  fPendingSeek(-1),
 	  fPlayer(NULL),
+	  fMixerInput(NULL),
+	  fFadeIn(0),
+	  fLoudness(0),
+	  fDeadAir(NULL),
+	  fDeadAirReset(0),
 	  fState(StreamPlayer::Stopped),
-	  fFlushCount(0)
+	  fFlushCount(0),
+	  fLastLevelReport(0)
 {
 	TRACE("Trying to set player for stream %s\n", station->StreamUrl().UrlString().String());
 
@@ -54,12 +218,12 @@ StreamPlayer::StreamPlayer(Station* station, BLooper* notify)
 StreamPlayer::~StreamPlayer()
 {
 	//_SetState(StreamPlayer::Stopped);
-	if (fInitStatus == B_OK && fPlayer != NULL)
-		fPlayer->Stop(true, false);
-
-	delete fPlayer;
+	_DeleteOutput();
+	delete fDecoder;
 	delete fStream;
+	delete fTimeShift;
 	delete fMediaFile;
+	delete fStationCopy;
 }
 
 
@@ -98,10 +262,16 @@ StreamPlayer::Stop()
 		{
 			Lock();
 
-			if (fPlayer) {
-				fPlayer->Stop(false, true);
-				delete fPlayer;
-				fPlayer = NULL;
+			_DeleteOutput();
+
+			delete fDecoder;
+			fDecoder = NULL;
+
+			if (fTimeShift != NULL) {
+				fStream->SetTimeShift(NULL);
+				delete fTimeShift;
+				fTimeShift = NULL;
+				fPaused = false;
 			}
 
 			if (fMediaFile) {
@@ -124,9 +294,168 @@ StreamPlayer::Stop()
 }
 
 
+/**
+ * Drops the connection for the next mirror. What was found to be dead air is
+ * forgotten, so that a mirror sending dead air, too, is detected again.
+ */
+status_t
+StreamPlayer::Failover()
+{
+	if (fStream == NULL)
+		return B_NO_INIT;
+
+	status_t status = fStream->Failover();
+	if (status == B_OK)
+		atomic_set(&fDeadAirReset, 1);
+
+	return status;
+}
+
+
+/**
+ * Keeps the stream of a stopped player connected with a small buffer, so that
+ * it can start playing right away. Bandwidth is only used while the buffer is
+ * not full.
+ */
+void
+StreamPlayer::SetStandby(bool standby)
+{
+	// The stream is gone once starting the player failed
+	if (fStream == NULL)
+		return;
+
+	if (standby)
+		fStream->SetBufferLimit(kStandbyBufferSize, kStandbyBufferSize);
+	else
+		fStream->SetBufferLimit();
+}
+
+
+/**
+ * Hands a player that was connected with a copy of station over to station
+ * itself. The copy stays alive with the player, as the stream may still be
+ * using it.
+ */
+void
+StreamPlayer::Attach(Station* station, BLooper* notify)
+{
+	BAutolock lock(this);
+
+	delete fStationCopy;
+	fStationCopy = fStation;
+	fStation = station;
+	fNotify = notify;
+
+	fStream->SetStation(station);
+	fStream->SetMetaListener(notify);
+}
+
+
+bool
+StreamPlayer::IsConnected()
+{
+	return fInitStatus == B_OK && fStream != NULL && fStream->IsConnected();
+}
+
+
+/**
+ * Keeps window of the stream for pausing and rewinding, from the next time
+ * the player starts.
+ */
+void
+StreamPlayer::SetTimeShift(bigtime_t window)
+{
+	fTimeShiftWindow = window;
+}
+
+
+/**
+ * Pausing plays silence while the stream keeps being received.
+ */
+void
+StreamPlayer::SetPaused(bool paused)
+{
+	fPaused = paused && fTimeShift != NULL;
+}
+
+
+void
+StreamPlayer::Rewind(bigtime_t delay)
+{
+	if (fTimeShift != NULL)
+		atomic_set64(&fPendingSeek, fTimeShift->PositionBefore(delay));
+}
+
+
+void
+StreamPlayer::RewindToTrackStart()
+{
+	if (fTimeShift != NULL)
+		atomic_set64(&fPendingSeek, fTimeShift->TrackStart());
+}
+
+
+void
+StreamPlayer::GoLive()
+{
+	if (fTimeShift != NULL)
+		atomic_set64(&fPendingSeek, fTimeShift->LivePosition());
+
+	fPaused = false;
+}
+
+
+/**
+ * Returns how far playback is behind the live stream.
+ */
+bigtime_t
+StreamPlayer::Delay()
+{
+	return fTimeShift != NULL ? fTimeShift->Delay() : 0;
+}
+
+
+status_t
+StreamPlayer::StartRecording(const BPath& directory)
+{
+	if (fStream == NULL)
+		return B_NO_INIT;
+
+	return fStream->StartRecording(directory);
+}
+
+
+void
+StreamPlayer::StopRecording()
+{
+	if (fStream != NULL)
+		fStream->StopRecording();
+}
+
+
+bool
+StreamPlayer::IsRecording()
+{
+	return fStream != NULL && fStream->IsRecording();
+}
+
+
+size_t
+StreamPlayer::_BufferedSize()
+{
+	if (fTimeShift != NULL)
+		return fTimeShift->BufferedSize();
+
+	return fStream->BufferedSize();
+}
+
+
 float
 StreamPlayer::Volume()
 {
+	if (fMixerInput != NULL)
+		return fMixerInput->Gain();
+
 	if (fPlayer != NULL) {
 		media_node node;
 		int32 paramID;
@@ -142,7 +471,9 @@ StreamPlayer::Volume()
 void
 StreamPlayer::SetVolume(float volume)
 {
-	if (fPlayer != NULL) {
+	if (fMixerInput != NULL)
+		fMixerInput->SetGain(volume);
+	else if (fPlayer != NULL) {
 		media_node node;
 		int32 paramID;
 		float minDB, maxDB;
@@ -152,6 +483,93 @@ StreamPlayer::SetVolume(float volume)
 }
 
 
+void
+StreamPlayer::FadeTo(float volume, bigtime_t duration)
+{
+	if (fMixerInput != NULL)
+		fMixerInput->FadeTo(volume, duration);
+}
+
+
+/**
+ * Creates what the decoded audio is played with: an input of the shared mixer
+ * when mixing, or a sound player of our own.
+ */
+status_t
+StreamPlayer::_CreateOutput(const media_raw_audio_format& format)
+{
+	if (sUseMixer) {
+		fMixerInput = AudioMixer::Default()->AddInput(
+			format, fStation->Name()->String(), &StreamPlayer::_GetDecodedChunk, this);
+		if (fMixerInput == NULL)
+			return B_ERROR;
+
+		if (sNormalizeLoudness)
+			fMixerInput->SetNormalization(fStation->Loudness());
+	} else {
+		fPlayer = new BSoundPlayer(
+			&format, fStation->Name()->String(), &StreamPlayer::_GetDecodedChunk, NULL, this);
+		status_t status = fPlayer->InitCheck();
+		if (status != B_OK) {
+			delete fPlayer;
+			fPlayer = NULL;
+			return status;
+		}
+	}
+
+	fDeadAir = new DeadAirDetector(format.frame_rate, format.channel_count);
+	return B_OK;
+}
+
+
+media_raw_audio_format
+StreamPlayer::_OutputFormat()
+{
+	return fMixerInput != NULL ? fMixerInput->Format() : fPlayer->Format();
+}
+
+
+status_t
+StreamPlayer::_StartOutput()
+{
+	if (fMixerInput != NULL) {
+		if (fFadeIn > 0) {
+			fMixerInput->SetGain(0.0f);
+			fMixerInput->FadeTo(1.0f, fFadeIn);
+			fFadeIn = 0;
+		}
+		return fMixerInput->Start();
+	}
+
+	fPlayer->Preroll();
+	return fPlayer->Start();
+}
+
+
+void
+StreamPlayer::_DeleteOutput()
+{
+	if (fMixerInput != NULL) {
+		// Kept for the station, which is saved by whoever owns it
+		float loudness = fMixerInput->Loudness();
+		if (loudness != 0)
+			fLoudness = loudness;
+
+		AudioMixer::Default()->RemoveInput(fMixerInput);
+		fMixerInput = NULL;
+	}
+
+	if (fPlayer != NULL) {
+		fPlayer->Stop(true, false);
+		delete fPlayer;
+		fPlayer = NULL;
+	}
+
+	delete fDeadAir;
+	fDeadAir = NULL;
+}
+
+
 void
 StreamPlayer::_SetState(StreamPlayer::PlayState state)
 {
@@ -168,21 +586,195 @@ StreamPlayer::_SetState(StreamPlayer::PlayState state)
 }
 
 
+/**
+ * Looks for dead air in what the station sent, which leaves out the silence
+ * played while paused or reconnecting.
+ */
+void
+StreamPlayer::_CheckDeadAir(const void* buffer, size_t size, const media_raw_audio_format& format)
+{
+	if (fDeadAir == NULL)
+		return;
+
+	if (atomic_get_and_set(&fDeadAirReset, 0) != 0)
+		fDeadAir->Reset();
+
+	if (!fDeadAir->Process(buffer, size, format) || fNotify == NULL)
+		return;
+
+	BMessage notification(MSG_PLAYER_DEAD_AIR);
+	notification.AddPointer("player", this);
+	notification.AddInt32("state", fDeadAir->GetState());
+	fNotify->PostMessage(&notification);
+}
+
+
 void
 StreamPlayer::_GetDecodedChunk(
 	void* cookie, void* buffer, size_t size, const media_raw_audio_format& format)
 {
 	StreamPlayer* player = (StreamPlayer*)cookie;
-	BMediaFile* fMediaFile = player->fMediaFile;
 
-	int64 reqFrames
-		= size / format.channel_count / (format.format & media_raw_audio_format::B_AUDIO_SIZE_MASK);
-	fMediaFile->TrackAt(0)->ReadFrames(buffer, &reqFrames, &player->fHeader, &player->fInfo);
+	// Once the buffer runs dry while the stream reconnects, play silence
+	// rather than holding up the sound player waiting for data.
+	if (player->fPaused
+		|| (player->fStream->IsReconnecting()
+			&& player->_BufferedSize() < kReconnectSilenceLevel)) {
+		memset(buffer, 0, size);
+	} else if (player->fDecoder != NULL) {
+		// Seeking is done here, as the stream is read from here only
+		int64 seek = atomic_get_and_set64(&player->fPendingSeek, -1);
+		if (seek >= 0 && player->fTimeShift != NULL) {
+			player->fTimeShift->Seek(seek, SEEK_SET);
+			player->fDecoder->Reset();
+		}
+
+		// Play silence rather than stale data when the stream falls behind
+		size_t filled = player->fDecoder->Fill((uint8*)buffer, size);
+		memset((uint8*)buffer + filled, 0, size - filled);
+		player->_CheckDeadAir(buffer, filled, format);
+	} else {
+		BMediaFile* fMediaFile = player->fMediaFile;
+
+		size_t frameSize = format.channel_count
+			* (format.format & media_raw_audio_format::B_AUDIO_SIZE_MASK);
+		int64 frames = size / frameSize;
+		if (fMediaFile->TrackAt(0)->ReadFrames(buffer, &frames, &player->fHeader, &player->fInfo)
+				!= B_OK) {
+			frames = 0;
+		}
 
-	if (player->fFlushCount++ > 1000) {
+		// Only what was read is checked, the rest of the buffer is silence
+		size_t filled = frames * frameSize;
+		memset((uint8*)buffer + filled, 0, size - filled);
+		player->_CheckDeadAir(buffer, filled, format);
+	}
+
+	if (player->fTimeShift == NULL && player->fFlushCount++ > 1000) {
 		player->fFlushCount = 0;
 		player->fStream->FlushRead();
 	}
+
+	bigtime_t now = system_time();
+	if (player->fNotify != NULL && now - player->fLastLevelReport >= kBufferLevelInterval) {
+		player->fLastLevelReport = now;
+
+		BMessage notification(MSG_PLAYER_BUFFER_LEVEL);
+		notification.AddPointer("player", player);
+		notification.AddFloat(
+			"level", (float)player->_BufferedSize() / (float)kPrebufferSize);
+		player->fNotify->PostMessage(&notification);
+	}
+}
+
+
+/**
+ * Starts playing MPEG audio streams with the format stored with the station,
+ * instead of waiting for enough data to set up a media extractor. Fails if the
+ * stream does not match the stored format, leaving the stream untouched for
+ * the regular start.
+ */
+status_t
+StreamPlayer::_FastStart()
+{
+	if (!fStation->Flags(STATION_HAS_FORMAT))
+		return B_NOT_SUPPORTED;
+
+	// Setting up the sound player takes a while, so it is done before waiting
+	// for the first frames.
+	media_raw_audio_format rawFormat = media_raw_audio_format::wildcard;
+	rawFormat.frame_rate = fStation->SampleRate();
+	rawFormat.channel_count = fStation->Channels();
+	rawFormat.format = media_raw_audio_format::B_AUDIO_FLOAT;
+	rawFormat.byte_order = B_MEDIA_HOST_ENDIAN;
+
+	status_t status = _CreateOutput(rawFormat);
+	if (status != B_OK)
+		return status;
+
+	BPositionIO* stream = fStream;
+	uint8 data[kFastStartProbeSize];
+	ssize_t size = stream->ReadAt(0, data, sizeof(data));
+
+	audio_header_info info;
+	if (size <= 0 || fStopRequested || AudioHeader::Identify(data, size, &info) != B_OK
+		|| info.codec != AUDIO_CODEC_MPEG || info.sampleRate != rawFormat.frame_rate
+		|| info.channels != rawFormat.channel_count) {
+		TRACE("Stream does not match the stored format, starting the regular way\n");
+		_DeleteOutput();
+		return B_MISMATCHED_VALUES;
+	}
+
+	media_format encodedFormat;
+	encodedFormat.type = B_MEDIA_ENCODED_AUDIO;
+	encodedFormat.u.encoded_audio = media_encoded_audio_format::wildcard;
+	encodedFormat.u.encoded_audio.encoding = (media_encoded_audio_format::audio_encoding)
+		Station::MpegEncoding(info.mpegVersion, info.mpegLayer);
+	encodedFormat.u.encoded_audio.bit_rate = info.bitRate;
+	encodedFormat.u.encoded_audio.frame_size = info.frameSize;
+	encodedFormat.u.encoded_audio.output.frame_rate = info.sampleRate;
+	encodedFormat.u.encoded_audio.output.channel_count = info.channels;
+
+	// The decoder reads from the time shift buffer, once the stream is
+	// received into it.
+	TimeShiftBuffer* timeShift = NULL;
+	if (fTimeShiftWindow > 0) {
+		timeShift = new TimeShiftBuffer(fTimeShiftWindow, info);
+		if (timeShift->InitCheck() != B_OK) {
+			MSG("No time shift for %s - %s\n", fStation->Name()->String(),
+				strerror(timeShift->InitCheck()));
+			delete timeShift;
+			timeShift = NULL;
+		}
+	}
+
+	FrameDecoder* decoder = new FrameDecoder(
+		timeShift != NULL ? timeShift : stream, info.codec, &encodedFormat);
+	status = decoder->InitCheck();
+
+	media_format decodedFormat;
+	decodedFormat.type = B_MEDIA_RAW_AUDIO;
+	decodedFormat.u.raw_audio = _OutputFormat();
+	if (status == B_OK)
+		status = decoder->SetOutput(&decodedFormat);
+
+	const media_raw_audio_format& playerFormat = _OutputFormat();
+	if (status == B_OK
+		&& (decodedFormat.u.raw_audio.format != playerFormat.format
+			|| decodedFormat.u.raw_audio.frame_rate != playerFormat.frame_rate
+			|| decodedFormat.u.raw_audio.channel_count != playerFormat.channel_count))
+		status = B_MISMATCHED_VALUES;
+
+	if (status == B_OK) {
+		fDecoder = decoder;
+		fDecodedFormat = decodedFormat;
+
+		if (timeShift != NULL) {
+			fStream->SetTimeShift(timeShift);
+			fTimeShift = timeShift;
+			timeShift = NULL;
+		}
+
+		status = _StartOutput();
+	}
+
+	if (status != B_OK) {
+		MSG("Fast start failed (%s), starting the regular way\n", strerror(status));
+		_DeleteOutput();
+		delete decoder;
+		fDecoder = NULL;
+
+		if (fTimeShift != NULL) {
+			fStream->SetTimeShift(NULL);
+			delete fTimeShift;
+			fTimeShift = NULL;
+		}
+
+		stream->Seek(0, SEEK_SET);
+	}
+
+	delete timeShift;
+	return status;
 }
 
 
@@ -193,7 +785,15 @@ StreamPlayer::_StartPlayThreadFunc(StreamPlayer* _this)
 
 	_this->_SetState(StreamPlayer::Buffering);
 	_this->fStopRequested = false;
-	_this->fStream->SetLimiter(0x40000);
+
+	if (_this->_FastStart() == B_OK) {
+		_this->_SetState(StreamPlayer::Playing);
+		_this->Unlock();
+
+		return B_OK;
+	}
+
+	_this->fStream->SetLimiter(kPrebufferSize);
 	_this->fMediaFile = new (std::nothrow) BMediaFile(_this->fStream);
 
 	_this->fInitStatus = _this->fMediaFile->InitCheck();
@@ -266,18 +866,13 @@ StreamPlayer::_StartPlayThreadFunc(StreamPlayer* _this)
 		_this->fDecodedFormat.u.raw_audio.channel_count,
 		_this->fDecodedFormat.u.raw_audio.frame_rate);
 
-	_this->fPlayer = new BSoundPlayer(&_this->fDecodedFormat.u.raw_audio,
-		_this->fStation->Name()->String(), &StreamPlayer::_GetDecodedChunk, NULL, _this);
-
-	_this->fInitStatus = _this->fPlayer->InitCheck();
+	_this->fInitStatus = _this->_CreateOutput(_this->fDecodedFormat.u.raw_audio);
 	if (_this->fInitStatus != B_OK) {
 		MSG("Sound Player failed to initialize (%s)\r\n", strerror(_this->fInitStatus));
 	}
 
 	if (_this->fInitStatus != B_OK || _this->fStopRequested) {
-		_this->fPlayer->Stop(true, true);
-		delete _this->fPlayer;
-		_this->fPlayer = NULL;
+		_this->_DeleteOutput();
 
 		_this->Unlock();
 		_this->_SetState(StreamPlayer::Stopped);
@@ -285,16 +880,13 @@ StreamPlayer::_StartPlayThreadFunc(StreamPlayer* _this)
 		return _this->fInitStatus;
 	}
 
-	_this->fPlayer->Preroll();
-
-	_this->fInitStatus = _this->fPlayer->Start();
+	_this->fInitStatus = _this->_StartOutput();
 	if (_this->fInitStatus != B_OK) {
 		MSG("Sound Player failed to start (%s)\r\n", strerror(_this->fInitStatus));
 	}
 
 	if (_this->fInitStatus != B_OK || _this->fStopRequested) {
-		delete _this->fPlayer;
-		_this->fPlayer = NULL;
+		_this->_DeleteOutput();
 
 		_this->Unlock();
 		_this->_SetState(StreamPlayer::Stopped);
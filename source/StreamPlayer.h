@@ -31,9 +31,15 @@
 #define MSG_PLAYER_STATE_CHANGED 'mPSC'	 // "player" = StreamPlayer*, "state" = int32(playState)
 #define MSG_PLAYER_BUFFER_LEVEL \
 	'mPBL'	// "player" = StreamPlayer*, "level" = float percent buffer filled
+#define MSG_PLAYER_DEAD_AIR \
+	'mPDA'	// "player" = StreamPlayer*, "state" = int32(DeadAirDetector::State)
 
 
+class DeadAirDetector;
+class FrameDecoder;
+class MixerInput;
 class Station;
+class TimeShiftBuffer;
 
 
 class StreamPlayer : private BLocker {
@@ -48,6 +54,33 @@ public:
 	float Volume();
 	void SetVolume(float volume);
 
+	// Fading needs the output to be an input of the AudioMixer
+	inline bool CanFade() { return fMixerInput != NULL; }
+	void FadeTo(float volume, bigtime_t duration);
+	inline void SetFadeIn(bigtime_t duration) { fFadeIn = duration; }
+
+	void SetStandby(bool standby);
+	void Attach(Station* station, BLooper* notify);
+	bool IsConnected();
+
+	// Connects to the next mirror, for stations found sending dead air
+	status_t Failover();
+
+	// Time shift, available while playing a stream decoded frame by frame
+	void SetTimeShift(bigtime_t window);
+	inline bool CanTimeShift() { return fTimeShift != NULL; }
+	void SetPaused(bool paused);
+	inline bool IsPaused() { return fPaused; }
+	void Rewind(bigtime_t delay);
+	void RewindToTrackStart();
+	void GoLive();
+	bigtime_t Delay();
+
+	// Records the stream as it is received, into a file per title
+	status_t StartRecording(const BPath& directory);
+	void StopRecording();
+	bool IsRecording();
+
 	enum PlayState {
 		InActive = -1,
 		Stopped,
@@ -56,8 +89,25 @@ public:
 	};
 	inline PlayState State() { return fState; }
 
+	// Plays through the shared AudioMixer, for players started from now on
+	static void SetUseMixer(bool useMixer) { sUseMixer = useMixer; }
+
+	// Plays stations through the mixer at the same loudness, measuring it
+	// while they play
+	static void SetNormalizeLoudness(bool normalize) { sNormalizeLoudness = normalize; }
+	inline float Loudness() { return fLoudness; }
+
 private:
 	void _SetState(PlayState state);
+	status_t _FastStart();
+	size_t _BufferedSize();
+
+	status_t _CreateOutput(const media_raw_audio_format& format);
+	media_raw_audio_format _OutputFormat();
+	status_t _StartOutput();
+	void _DeleteOutput();
+
+	void _CheckDeadAir(const void* buffer, size_t size, const media_raw_audio_format& format);
 
 	static status_t _StartPlayThreadFunc(StreamPlayer* _this);
 	static void _GetDecodedChunk(
@@ -65,10 +115,21 @@ private:
 
 private:
 	Station* fStation;
+	Station* fStationCopy;
 	BLooper* fNotify;
 	BMediaFile* fMediaFile;
+	FrameDecoder* fDecoder;
 	StreamIO* fStream;
+	TimeShiftBuffer* fTimeShift;
+	bigtime_t fTimeShiftWindow;
+	bool fPaused;
+	int64 fPendingSeek;
 	BSoundPlayer* fPlayer;
+	MixerInput* fMixerInput;
+	bigtime_t fFadeIn;
+	float fLoudness;
+	DeadAirDetector* fDeadAir;
+	int32 fDeadAirReset;
 	PlayState fState;
 
 	status_t fInitStatus;
@@ -79,6 +140,10 @@ private:
 	media_header fHeader;
 	media_decode_info fInfo;
 	int32 fFlushCount;
+	bigtime_t fLastLevelReport;
+
+	static bool sUseMixer;
+	static bool sNormalizeLoudness;
 };
 
 
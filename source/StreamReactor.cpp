@@ -0,0 +1,550 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "StreamReactor.h"
+
+#include <Autolock.h>
+#include <NetworkAddress.h>
+
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+#include "Debug.h"
+#include "Playlist.h"
+#include "Utils.h"
+
+
+// Connections that receive nothing for this long are closed
+static const bigtime_t kConnectionTimeout = 30000000;
+
+// Interval at which connections held back by their listener are checked again
+static const int kThrottleWait = 20;
+
+// Interval at which connections are checked for timeouts otherwise
+static const int kPollTimeout = 1000;
+
+static const size_t kReceiveSize = 0x4000;
+static const int32 kMaxHeaderSize = 0x4000;
+static const int32 kMaxRedirects = 3;
+
+
+BLocker StreamReactor::sDefaultLock("stream reactor");
+StreamReactor* StreamReactor::sDefault = NULL;
+
+
+class ReactorWorker {
+public:
+	ReactorWorker();
+	~ReactorWorker();
+
+	status_t Add(StreamConnection* connection);
+	void Remove(StreamConnection* connection);
+	int32 CountConnections();
+
+private:
+	bool _Has(StreamConnection* connection);
+	void _Close(StreamConnection* connection, status_t status);
+	void _Wake();
+	void _Run();
+
+	static int32 _WorkerThreadFunc(void* data);
+
+private:
+	BLocker fLock;
+	std::vector<StreamConnection*> fConnections;
+	int fWakeFds[2];
+	thread_id fThread;
+	bool fQuit;
+};
+
+
+StreamConnection::StreamConnection(const BUrl& url, StreamConnectionListener* listener)
+	: fInitStatus(B_NO_INIT),
+	  fListener(listener),
+	  fSocket(-1),
+	  fState(SENDING),
+	  fConnected(false),
+	  fSent(0),
+	  fRedirects(0),
+	  fLastActivity(0),
+	  fWorker(NULL)
+{
+	fInitStatus = _Connect(url);
+}
+
+
+StreamConnection::~StreamConnection()
+{
+	_Close();
+}
+
+
+/**
+ * Starts connecting to url. Resolving its host blocks, which happens before
+ * the connection is added to the reactor, and on redirects only.
+ */
+status_t
+StreamConnection::_Connect(const BUrl& url)
+{
+	_Close();
+
+	if (url.Protocol() != "http")
+		return B_NOT_SUPPORTED;
+
+	uint16 port = url.HasPort() ? url.Port() : 80;
+	BNetworkAddress address(url.Host(), port);
+	status_t status = address.InitCheck();
+	if (status != B_OK)
+		return status;
+
+	fSocket = socket(address.Family(), SOCK_STREAM, 0);
+	if (fSocket < 0)
+		return errno;
+
+	fcntl(fSocket, F_SETFL, fcntl(fSocket, F_GETFL) | O_NONBLOCK);
+	if (connect(fSocket, address, address.Length()) < 0 && errno != EINPROGRESS) {
+		status = errno;
+		_Close();
+		return status;
+	}
+
+	BString path = url.HasPath() && !url.Path().IsEmpty() ? url.Path() : BString("/");
+	if (url.HasRequest())
+		path << "?" << url.Request();
+
+	BString host(url.Host());
+	if (url.HasPort())
+		host << ":" << url.Port();
+
+	// HTTP/1.0 keeps servers from sending the stream chunked
+	fRequest.SetToFormat("GET %s HTTP/1.0\r\n"
+						 "Host: %s\r\n"
+						 "User-Agent: %s\r\n"
+						 "Accept: audio/*\r\n"
+						 "Icy-MetaData: 1\r\n"
+						 "Icy-Reset: 1\r\n"
+						 "Connection: close\r\n\r\n",
+		path.String(), host.String(), Utils::UserAgent());
+
+	TRACE("Connecting to %s\n", url.UrlString().String());
+
+	fUrl = url;
+	fState = SENDING;
+	fConnected = false;
+	fSent = 0;
+	fHeaderData.SetSize(0);
+	fHeaderData.Seek(0, SEEK_SET);
+	fLastActivity = system_time();
+
+	return B_OK;
+}
+
+
+void
+StreamConnection::_Close()
+{
+	if (fSocket >= 0) {
+		close(fSocket);
+		fSocket = -1;
+	}
+}
+
+
+/**
+ * Handles the events poll() returned for the socket. Returns false when the
+ * connection is done, with the reason in status.
+ */
+bool
+StreamConnection::_Process(short events, uint8* buffer, size_t size, status_t* status)
+{
+	if (fState == SENDING) {
+		if (!fConnected) {
+			int error = 0;
+			socklen_t length = sizeof(error);
+			getsockopt(fSocket, SOL_SOCKET, SO_ERROR, &error, &length);
+			if (error != 0 || (events & (POLLERR | POLLHUP)) != 0) {
+				*status = error != 0 ? error : B_IO_ERROR;
+				return false;
+			}
+
+			fConnected = true;
+		}
+
+		ssize_t sent = send(fSocket, fRequest.String() + fSent, fRequest.Length() - fSent, 0);
+		if (sent < 0) {
+			if (errno == EAGAIN || errno == EINTR)
+				return true;
+
+			*status = errno;
+			return false;
+		}
+
+		fSent += sent;
+		if (fSent == fRequest.Length())
+			fState = HEADERS;
+
+		return true;
+	}
+
+	ssize_t received = recv(fSocket, buffer, size, 0);
+	if (received < 0) {
+		if (errno == EAGAIN || errno == EINTR)
+			return true;
+
+		*status = errno;
+		return false;
+	}
+
+	if (received == 0) {
+		*status = fState == BODY ? B_OK : B_IO_ERROR;
+		return false;
+	}
+
+	if (fState == HEADERS)
+		return _ReceiveHeaders(buffer, received, status);
+
+	fListener->ConnectionData(buffer, received);
+	return true;
+}
+
+
+/**
+ * Collects the response headers. Redirects are followed right away, anything
+ * but success ends the connection.
+ */
+bool
+StreamConnection::_ReceiveHeaders(const uint8* data, size_t size, status_t* status)
+{
+	fHeaderData.Write(data, size);
+
+	// The headers end with an empty line
+	const char* buffer = (const char*)fHeaderData.Buffer();
+	size_t length = fHeaderData.BufferLength();
+	size_t end = 0;
+	size_t bodyStart = 0;
+	for (size_t i = 0; i + 1 < length && bodyStart == 0; i++) {
+		if (buffer[i] != '\n')
+			continue;
+
+		end = i;
+		if (buffer[i + 1] == '\n')
+			bodyStart = i + 2;
+		else if (buffer[i + 1] == '\r' && i + 2 < length && buffer[i + 2] == '\n')
+			bodyStart = i + 3;
+	}
+
+	if (bodyStart == 0) {
+		if (length <= kMaxHeaderSize)
+			return true;
+
+		*status = B_BAD_DATA;
+		return false;
+	}
+
+	// Shoutcast servers answer with "ICY 200 OK" instead of an HTTP status line
+	BString text(buffer, end);
+	BString line;
+	const char* next = Playlist::NextLine(text.String(), &line);
+	int32 separator = line.FindFirst(' ');
+	int32 statusCode = separator > 0 ? atoi(line.String() + separator + 1) : 0;
+
+	BHttpHeaders headers;
+	while (next != NULL && (next = Playlist::NextLine(next, &line)) != NULL) {
+		if (!line.IsEmpty())
+			headers.AddHeader(line.String());
+	}
+
+	const char* location = headers["location"];
+	if (statusCode >= 300 && statusCode < 400 && location != NULL) {
+		fListener->ConnectionHeaders(statusCode, headers, -1);
+		if (++fRedirects > kMaxRedirects) {
+			*status = B_ERROR;
+			return false;
+		}
+
+		*status = _Connect(BUrl(fUrl, BString(location)));
+		return *status == B_OK;
+	}
+
+	if (statusCode < 200 || statusCode >= 300) {
+		*status = B_ERROR;
+		return false;
+	}
+
+	const char* contentLength = headers["content-length"];
+	fListener->ConnectionHeaders(
+		statusCode, headers, contentLength != NULL ? atoll(contentLength) : -1);
+	fState = BODY;
+
+	// Whatever came with the headers is the start of the body
+	if (bodyStart < length)
+		fListener->ConnectionData(buffer + bodyStart, length - bodyStart);
+
+	fHeaderData.SetSize(0);
+	fHeaderData.Seek(0, SEEK_SET);
+	return true;
+}
+
+
+ReactorWorker::ReactorWorker()
+	: fLock("reactor worker"),
+	  fThread(-1),
+	  fQuit(false)
+{
+	if (pipe(fWakeFds) != 0) {
+		fWakeFds[0] = fWakeFds[1] = -1;
+		return;
+	}
+
+	fcntl(fWakeFds[0], F_SETFL, fcntl(fWakeFds[0], F_GETFL) | O_NONBLOCK);
+
+	fThread = spawn_thread(&_WorkerThreadFunc, "stream reactor", B_NORMAL_PRIORITY, this);
+	if (fThread >= 0)
+		resume_thread(fThread);
+}
+
+
+ReactorWorker::~ReactorWorker()
+{
+	{
+		BAutolock lock(fLock);
+		fQuit = true;
+		_Wake();
+	}
+
+	if (fThread >= 0) {
+		status_t status;
+		wait_for_thread(fThread, &status);
+	}
+
+	if (fWakeFds[0] >= 0) {
+		close(fWakeFds[0]);
+		close(fWakeFds[1]);
+	}
+}
+
+
+status_t
+ReactorWorker::Add(StreamConnection* connection)
+{
+	if (fThread < 0)
+		return B_NO_INIT;
+
+	BAutolock lock(fLock);
+	connection->fWorker = this;
+	connection->fLastActivity = system_time();
+	fConnections.push_back(connection);
+	_Wake();
+
+	return B_OK;
+}
+
+
+/**
+ * Takes the connection out, after which it is not touched anymore. Must not
+ * be called from a listener.
+ */
+void
+ReactorWorker::Remove(StreamConnection* connection)
+{
+	BAutolock lock(fLock);
+
+	std::vector<StreamConnection*>::iterator found
+		= std::find(fConnections.begin(), fConnections.end(), connection);
+	if (found != fConnections.end())
+		fConnections.erase(found);
+
+	_Wake();
+}
+
+
+int32
+ReactorWorker::CountConnections()
+{
+	BAutolock lock(fLock);
+	return fConnections.size();
+}
+
+
+bool
+ReactorWorker::_Has(StreamConnection* connection)
+{
+	return std::find(fConnections.begin(), fConnections.end(), connection)
+		!= fConnections.end();
+}
+
+
+void
+ReactorWorker::_Close(StreamConnection* connection, status_t status)
+{
+	TRACE("Connection to %s closed - %s\n", connection->fUrl.UrlString().String(),
+		strerror(status));
+
+	fConnections.erase(std::find(fConnections.begin(), fConnections.end(), connection));
+	connection->_Close();
+	connection->fListener->ConnectionClosed(status);
+}
+
+
+void
+ReactorWorker::_Wake()
+{
+	char wake = 0;
+	write(fWakeFds[1], &wake, 1);
+}
+
+
+void
+ReactorWorker::_Run()
+{
+	std::vector<pollfd> fds;
+	std::vector<StreamConnection*> polled;
+	uint8 buffer[kReceiveSize];
+
+	while (true) {
+		bool throttled = false;
+		fds.clear();
+		polled.clear();
+
+		{
+			BAutolock lock(fLock);
+			if (fQuit)
+				break;
+
+			pollfd wake = {fWakeFds[0], POLLIN, 0};
+			fds.push_back(wake);
+
+			bigtime_t now = system_time();
+			for (size_t i = 0; i < fConnections.size(); i++) {
+				StreamConnection* connection = fConnections[i];
+				if (connection->fState == StreamConnection::BODY
+					&& !connection->fListener->ConnectionCanReceive()) {
+					// Waiting on the listener does not count as being idle
+					connection->fLastActivity = now;
+					throttled = true;
+					continue;
+				}
+
+				short events = connection->fState == StreamConnection::SENDING ? POLLOUT : POLLIN;
+				pollfd fd = {connection->fSocket, events, 0};
+				fds.push_back(fd);
+				polled.push_back(connection);
+			}
+		}
+
+		if (poll(&fds[0], fds.size(), throttled ? kThrottleWait : kPollTimeout) < 0
+			&& errno != EINTR) {
+			MSG("Polling streams failed - %s\n", strerror(errno));
+			snooze(kThrottleWait * 1000);
+		}
+
+		BAutolock lock(fLock);
+
+		char drain[64];
+		if ((fds[0].revents & POLLIN) != 0)
+			while (read(fWakeFds[0], drain, sizeof(drain)) > 0)
+				;
+
+		bigtime_t now = system_time();
+		for (size_t i = 0; i < polled.size(); i++) {
+			StreamConnection* connection = polled[i];
+			if (!_Has(connection))
+				continue;
+
+			status_t status = B_OK;
+			short events = fds[i + 1].revents;
+			if (events != 0) {
+				connection->fLastActivity = now;
+				if (!connection->_Process(events, buffer, sizeof(buffer), &status))
+					_Close(connection, status);
+			} else if (now - connection->fLastActivity > kConnectionTimeout)
+				_Close(connection, B_TIMED_OUT);
+		}
+	}
+}
+
+
+int32
+ReactorWorker::_WorkerThreadFunc(void* data)
+{
+	((ReactorWorker*)data)->_Run();
+	return B_OK;
+}
+
+
+StreamReactor::StreamReactor()
+{
+	for (int32 i = 0; i < REACTOR_THREADS; i++)
+		fWorkers[i] = new ReactorWorker();
+}
+
+
+StreamReactor::~StreamReactor()
+{
+	for (int32 i = 0; i < REACTOR_THREADS; i++)
+		delete fWorkers[i];
+}
+
+
+/**
+ * Returns the reactor shared by all streams, which is started on first use.
+ */
+StreamReactor*
+StreamReactor::Default()
+{
+	BAutolock lock(sDefaultLock);
+
+	if (sDefault == NULL)
+		sDefault = new StreamReactor();
+
+	return sDefault;
+}
+
+
+/**
+ * Starts servicing the connection, on the thread with the fewest connections.
+ */
+status_t
+StreamReactor::Add(StreamConnection* connection)
+{
+	if (connection->InitCheck() != B_OK)
+		return connection->InitCheck();
+
+	ReactorWorker* worker = fWorkers[0];
+	for (int32 i = 1; i < REACTOR_THREADS; i++) {
+		if (fWorkers[i]->CountConnections() < worker->CountConnections())
+			worker = fWorkers[i];
+	}
+
+	return worker->Add(connection);
+}
+
+
+void
+StreamReactor::Remove(StreamConnection* connection)
+{
+	if (connection->fWorker != NULL)
+		connection->fWorker->Remove(connection);
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef _STREAM_REACTOR_H
+#define _STREAM_REACTOR_H
+
+
+#include <DataIO.h>
+#include <HttpHeaders.h>
+#include <Locker.h>
+#include <String.h>
+#include <Url.h>
+
+using namespace BPrivate::Network;
+
+
+// Threads that all connections are spread over
+#define REACTOR_THREADS 2
+
+
+class ReactorWorker;
+
+
+/**
+ * Receives what a StreamConnection gets. All calls are made from a reactor
+ * thread, which all other connections of it wait for, so they must not block.
+ */
+class StreamConnectionListener {
+public:
+	virtual ~StreamConnectionListener() {}
+
+	virtual void ConnectionHeaders(int32 status, const BHttpHeaders& headers, off_t length) = 0;
+	// Returning false holds the connection back until it returns true again
+	virtual bool ConnectionCanReceive() = 0;
+	virtual ssize_t ConnectionData(const void* data, size_t size) = 0;
+	virtual void ConnectionClosed(status_t status) = 0;
+};
+
+
+/**
+ * An HTTP request for a stream on a non-blocking socket, which is serviced by
+ * the StreamReactor. Only plain HTTP is supported; the response body is passed
+ * on as it is, so that it must not be chunked.
+ */
+class StreamConnection {
+public:
+	StreamConnection(const BUrl& url, StreamConnectionListener* listener);
+	~StreamConnection();
+
+	status_t InitCheck() const { return fInitStatus; }
+
+private:
+	friend class ReactorWorker;
+	friend class StreamReactor;
+
+	status_t _Connect(const BUrl& url);
+	void _Close();
+	bool _Process(short events, uint8* buffer, size_t size, status_t* status);
+	bool _ReceiveHeaders(const uint8* data, size_t size, status_t* status);
+
+private:
+	enum State {
+		SENDING,
+		HEADERS,
+		BODY
+	};
+
+	status_t fInitStatus;
+	StreamConnectionListener* fListener;
+	BUrl fUrl;
+	int fSocket;
+	State fState;
+	bool fConnected;
+	BString fRequest;
+	int32 fSent;
+	BMallocIO fHeaderData;
+	int32 fRedirects;
+	bigtime_t fLastActivity;
+	ReactorWorker* fWorker;
+};
+
+
+/**
+ * Services the sockets of many streams from a few threads, instead of a
+ * thread per stream. Each thread waits for all of its sockets at once with
+ * poll(), and only reads from those whose listener can take more data.
+ */
+class StreamReactor {
+public:
+	static StreamReactor* Default();
+
+	status_t Add(StreamConnection* connection);
+	void Remove(StreamConnection* connection);
+
+private:
+	StreamReactor();
+	~StreamReactor();
+
+private:
+	ReactorWorker* fWorkers[REACTOR_THREADS];
+
+	static BLocker sDefaultLock;
+	static StreamReactor* sDefault;
+};
+
+
+#endif	// _STREAM_REACTOR_H
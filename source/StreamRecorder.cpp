@@ -0,0 +1,413 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "StreamRecorder.h"
+
+#include <Autolock.h>
+#include <Directory.h>
+#include <File.h>
+#include <NodeInfo.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Debug.h"
+#include "Station.h"
+
+
+// Buffers waiting to be written at most; anything beyond is dropped
+static const size_t kMaxQueuedBuffers = 16;
+
+
+/**
+ * A file of the recording, which is created by the writer thread once there
+ * is data for it.
+ */
+class RecordingTrack {
+public:
+	RecordingTrack(const BPath& directory, const BString& name)
+		: fDirectory(directory),
+		  fName(name),
+		  fFile(NULL),
+		  fStatus(B_NO_INIT)
+	{
+	}
+
+	~RecordingTrack() { delete fFile; }
+
+	/**
+	 * Creates the file, named uniquely in the directory, and tags it.
+	 */
+	status_t Open()
+	{
+		if (fStatus != B_NO_INIT)
+			return fStatus;
+
+		BDirectory directory(fDirectory.Path());
+		BString name(fName);
+		name.ReplaceAll('/', '-');
+
+		fFile = new BFile();
+		fStatus = B_FILE_EXISTS;
+		for (int32 i = 1; i < 100 && fStatus == B_FILE_EXISTS; i++) {
+			BString fileName(name);
+			if (i > 1)
+				fileName << " (" << i << ")";
+			fileName << "." << fExtension;
+
+			fStatus = directory.CreateFile(fileName, fFile, true);
+		}
+
+		if (fStatus != B_OK) {
+			MSG("Could not create recording %s - %s\n", fName.String(), strerror(fStatus));
+			return fStatus;
+		}
+
+		BNodeInfo(fFile).SetType(fMime);
+
+		// Stream titles are mostly "artist - title"
+		int32 separator = fTitle.FindFirst(" - ");
+		if (separator > 0) {
+			BString artist;
+			BString title;
+			fTitle.CopyInto(artist, 0, separator);
+			fTitle.CopyInto(title, separator + 3, fTitle.Length() - separator - 3);
+			fFile->WriteAttrString("Audio:Artist", &artist);
+			fFile->WriteAttrString("Audio:Title", &title);
+		} else if (!fTitle.IsEmpty())
+			fFile->WriteAttrString("Audio:Title", &fTitle);
+
+		if (!fStation.IsEmpty())
+			fFile->WriteAttrString("Audio:Album", &fStation);
+		if (!fGenre.IsEmpty())
+			fFile->WriteAttrString("Audio:Genre", &fGenre);
+
+		return B_OK;
+	}
+
+	ssize_t Write(const void* buffer, size_t size)
+	{
+		if (Open() != B_OK)
+			return fStatus;
+
+		return fFile->Write(buffer, size);
+	}
+
+	BPath fDirectory;
+	BString fName;
+	BString fExtension;
+	BString fMime;
+	BString fTitle;
+	BString fStation;
+	BString fGenre;
+
+private:
+	BFile* fFile;
+	status_t fStatus;
+};
+
+
+StreamRecorder::StreamRecorder(Station* station, const BPath& directory)
+	: fInitStatus(B_NO_INIT),
+	  fDirectory(directory),
+	  fStationName(*station->Name()),
+	  fGenre(station->Genre()),
+	  fMime(station->Mime()->Type()),
+	  fCodec(AUDIO_CODEC_UNKNOWN),
+	  fHeaderLength(0),
+	  fFrameRemaining(0),
+	  fTrack(NULL),
+	  fSplitPending(false),
+	  fBuffer(NULL),
+	  fBufferUsed(0),
+	  fDropped(0),
+	  fRecorded(0),
+	  fDroppedSize(0),
+	  fQueueLock("stream recorder"),
+	  fQueued(-1),
+	  fWriterThread(-1),
+	  fQuit(false)
+{
+	// Splitting at frames is only possible for the formats that have them
+	if (fMime == "audio/mpeg") {
+		fCodec = AUDIO_CODEC_MPEG;
+		fExtension = "mp3";
+	} else if (fMime == "audio/aac" || fMime == "audio/aacp") {
+		fCodec = AUDIO_CODEC_AAC;
+		fExtension = "aac";
+	} else if (fMime == "audio/ogg" || fMime == "application/ogg")
+		fExtension = "ogg";
+	else if (fMime == "audio/flac")
+		fExtension = "flac";
+	else
+		fExtension = "audio";
+
+	fInitStatus = create_directory(fDirectory.Path(), 0755);
+	if (fInitStatus != B_OK)
+		return;
+
+	fQueued = create_sem(0, "stream recorder");
+	fWriterThread = spawn_thread(&_WriterThreadFunc, "stream recorder", B_NORMAL_PRIORITY, this);
+	if (fWriterThread < 0) {
+		fInitStatus = fWriterThread;
+		return;
+	}
+
+	resume_thread(fWriterThread);
+	_StartTrack();
+}
+
+
+StreamRecorder::~StreamRecorder()
+{
+	if (fWriterThread >= 0) {
+		_Flush();
+		_Queue(fTrack, NULL, 0);
+
+		{
+			BAutolock lock(fQueueLock);
+			fQuit = true;
+		}
+
+		release_sem(fQueued);
+		status_t status;
+		wait_for_thread(fWriterThread, &status);
+	} else
+		delete fTrack;
+
+	delete_sem(fQueued);
+
+	free(fBuffer);
+	for (size_t i = 0; i < fFreeBuffers.size(); i++)
+		free(fFreeBuffers[i]);
+}
+
+
+/**
+ * Adds data received from the stream, after its metadata was removed. A title
+ * change that is pending starts a new file at the next frame.
+ */
+void
+StreamRecorder::Append(const void* data, size_t size)
+{
+	if (fInitStatus != B_OK)
+		return;
+
+	const uint8* bytes = (const uint8*)data;
+	if (fCodec == AUDIO_CODEC_UNKNOWN) {
+		if (fSplitPending)
+			_StartTrack();
+
+		_Write(bytes, size);
+		return;
+	}
+
+	size_t headerSize = AudioHeader::FrameHeaderSize(fCodec);
+	while (size > 0) {
+		if (fFrameRemaining > 0) {
+			size_t count = min_c(fFrameRemaining, size);
+			_Write(bytes, count);
+			fFrameRemaining -= count;
+			bytes += count;
+			size -= count;
+			continue;
+		}
+
+		if (fSplitPending && fHeaderLength == 0)
+			_StartTrack();
+
+		size_t count = min_c(headerSize - fHeaderLength, size);
+		memcpy(fHeader + fHeaderLength, bytes, count);
+		fHeaderLength += count;
+		bytes += count;
+		size -= count;
+		if (fHeaderLength < headerSize)
+			break;
+
+		// Anything that is not a frame is recorded as it is
+		audio_header_info info;
+		size_t length = AudioHeader::FrameLength(fCodec, fHeader, &info);
+		if (length < headerSize) {
+			_Write(fHeader, 1);
+			memmove(fHeader, fHeader + 1, --fHeaderLength);
+			continue;
+		}
+
+		_Write(fHeader, headerSize);
+		fHeaderLength = 0;
+		fFrameRemaining = length - headerSize;
+	}
+}
+
+
+void
+StreamRecorder::NewTrack(const char* title)
+{
+	if (fTitle == title)
+		return;
+
+	fTitle = title;
+	fSplitPending = true;
+}
+
+
+void
+StreamRecorder::_Write(const uint8* data, size_t size)
+{
+	while (size > 0) {
+		if (fBuffer == NULL) {
+			{
+				BAutolock lock(fQueueLock);
+				if (!fFreeBuffers.empty()) {
+					fBuffer = fFreeBuffers.back();
+					fFreeBuffers.pop_back();
+				}
+			}
+
+			// Aligned to pages, as that is what the disk is written in
+			if (fBuffer == NULL
+				&& posix_memalign((void**)&fBuffer, B_PAGE_SIZE, SR_BUFFER_SIZE) != 0) {
+				fBuffer = NULL;
+				return;
+			}
+		}
+
+		size_t count = min_c(size, SR_BUFFER_SIZE - fBufferUsed);
+		memcpy(fBuffer + fBufferUsed, data, count);
+		fBufferUsed += count;
+		atomic_add64(&fRecorded, count);
+		data += count;
+		size -= count;
+
+		if (fBufferUsed == SR_BUFFER_SIZE)
+			_Flush();
+	}
+}
+
+
+/**
+ * Closes the file being recorded to and starts a new one, named after the
+ * current title, or the time it starts at if there is none.
+ */
+void
+StreamRecorder::_StartTrack()
+{
+	_Flush();
+	if (fTrack != NULL)
+		_Queue(fTrack, NULL, 0);
+
+	BString name(fStationName);
+	if (fTitle.IsEmpty()) {
+		char date[32];
+		time_t now = time(NULL);
+		strftime(date, sizeof(date), "%Y-%m-%d %H-%M-%S", localtime(&now));
+		name << " " << date;
+	} else
+		name << " - " << fTitle;
+
+	fTrack = new RecordingTrack(fDirectory, name);
+	fTrack->fExtension = fExtension;
+	fTrack->fMime = fMime;
+	fTrack->fTitle = fTitle;
+	fTrack->fStation = fStationName;
+	fTrack->fGenre = fGenre;
+
+	fSplitPending = false;
+	TRACE("Recording %s\n", name.String());
+}
+
+
+void
+StreamRecorder::_Flush()
+{
+	if (fBuffer == NULL || fBufferUsed == 0)
+		return;
+
+	_Queue(fTrack, fBuffer, fBufferUsed);
+	fBuffer = NULL;
+	fBufferUsed = 0;
+}
+
+
+/**
+ * Hands a buffer over to the writer thread, or closes track if buffer is
+ * NULL. When the disk cannot keep up, data is dropped rather than holding up
+ * the stream. Every run of drops is logged when it starts and when it ends.
+ */
+void
+StreamRecorder::_Queue(RecordingTrack* track, uint8* buffer, size_t size)
+{
+	BAutolock lock(fQueueLock);
+
+	if (buffer != NULL && fQueue.size() >= kMaxQueuedBuffers) {
+		fFreeBuffers.push_back(buffer);
+		atomic_add64(&fDroppedSize, size);
+		if (fDropped++ == 0)
+			MSG("Recording of %s cannot keep up, dropping data\n", fStationName.String());
+		return;
+	}
+
+	if (buffer != NULL && fDropped > 0) {
+		MSG("Recording of %s dropped %" B_PRId32 " buffers, %" B_PRId64 " bytes in all\n",
+			fStationName.String(), fDropped, atomic_get64(&fDroppedSize));
+		fDropped = 0;
+	}
+
+	recording_job job;
+	job.track = track;
+	job.buffer = buffer;
+	job.size = size;
+	fQueue.push_back(job);
+
+	release_sem(fQueued);
+}
+
+
+int32
+StreamRecorder::_WriterThreadFunc(void* data)
+{
+	StreamRecorder* _this = (StreamRecorder*)data;
+
+	while (acquire_sem(_this->fQueued) == B_OK) {
+		recording_job job;
+		{
+			BAutolock lock(_this->fQueueLock);
+			if (_this->fQueue.empty()) {
+				if (_this->fQuit)
+					break;
+				continue;
+			}
+
+			job = _this->fQueue.front();
+			_this->fQueue.pop_front();
+		}
+
+		if (job.buffer == NULL) {
+			delete job.track;
+			continue;
+		}
+
+		job.track->Write(job.buffer, job.size);
+
+		BAutolock lock(_this->fQueueLock);
+		_this->fFreeBuffers.push_back(job.buffer);
+	}
+
+	return B_OK;
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef _STREAM_RECORDER_H
+#define _STREAM_RECORDER_H
+
+
+#include <Locker.h>
+#include <OS.h>
+#include <Path.h>
+#include <String.h>
+
+#include <deque>
+#include <vector>
+
+#include "AudioHeader.h"
+
+
+// Size of the buffers written to disk at once
+#define SR_BUFFER_SIZE 0x40000
+
+
+class Station;
+class RecordingTrack;
+
+
+struct recording_job {
+	RecordingTrack* track;
+	uint8* buffer;	// NULL to close the track
+	size_t size;
+};
+
+
+/**
+ * Records a stream as it is received, without decoding it. The recording is
+ * split into a file per title, at the first frame after the title changed,
+ * and each file is tagged with its title.
+ *
+ * Data is collected in large buffers that a thread of its own writes to disk,
+ * so that receiving the stream never waits for the disk.
+ */
+class StreamRecorder {
+public:
+	StreamRecorder(Station* station, const BPath& directory);
+	~StreamRecorder();
+
+	status_t InitCheck() const { return fInitStatus; }
+
+	void Append(const void* data, size_t size);
+	void NewTrack(const char* title);
+
+	// Read while the stream appends
+	off_t RecordedSize() { return atomic_get64(&fRecorded); }
+	off_t DroppedSize() { return atomic_get64(&fDroppedSize); }
+
+private:
+	void _Write(const uint8* data, size_t size);
+	void _StartTrack();
+	void _Flush();
+	void _Queue(RecordingTrack* track, uint8* buffer, size_t size);
+
+	static int32 _WriterThreadFunc(void* data);
+
+private:
+	status_t fInitStatus;
+	BPath fDirectory;
+	BString fStationName;
+	BString fGenre;
+	BString fMime;
+	BString fExtension;
+
+	audio_header_codec fCodec;
+	uint8 fHeader[16];
+	size_t fHeaderLength;
+	size_t fFrameRemaining;
+
+	RecordingTrack* fTrack;
+	BString fTitle;
+	bool fSplitPending;
+
+	uint8* fBuffer;
+	size_t fBufferUsed;
+	// Buffers dropped since the queue last had room, guarded by fQueueLock
+	int32 fDropped;
+	int64 fRecorded;
+	int64 fDroppedSize;
+
+	BLocker fQueueLock;
+	std::deque<recording_job> fQueue;
+	std::vector<uint8*> fFreeBuffers;
+	sem_id fQueued;
+	thread_id fWriterThread;
+	bool fQuit;
+};
+
+
+#endif	// _STREAM_RECORDER_H
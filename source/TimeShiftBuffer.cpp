@@ -0,0 +1,495 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "TimeShiftBuffer.h"
+
+#include <Autolock.h>
+#include <FindDirectory.h>
+#include <Path.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "Debug.h"
+
+
+// Size of the segments the store is mapped in
+static const off_t kSegmentSize = 0x100000;
+
+// Assumed for streams that do not tell their bit rate
+static const uint32 kDefaultBitRate = 320000;
+
+// Time a read waits for the stream to catch up
+static const bigtime_t kReadTimeout = 1000000;
+static const bigtime_t kReadWait = 10000;
+
+// Going back to the live stream keeps a little buffered
+static const bigtime_t kLiveDelay = 2000000;
+
+// Going back to the start of a track shortly after it started goes back to the
+// one before
+static const bigtime_t kTrackStartTolerance = 3000000;
+
+
+TimeShiftBuffer::TimeShiftBuffer(bigtime_t window, const audio_header_info& format)
+	: fInitStatus(B_NO_INIT),
+	  fLock("time shift"),
+	  fFile(-1),
+	  fCapacity(0),
+	  fUseCount(0),
+	  fCodec(format.codec),
+	  fFrameSamples(AudioHeader::FrameSamples(format)),
+	  fSampleRate(format.sampleRate),
+	  fWritten(0),
+	  fScanned(0),
+	  fReadPosition(0),
+	  fFirstFrame(0)
+{
+	for (int32 i = 0; i < TSB_MAPPED_SEGMENTS; i++) {
+		fMapped[i].index = -1;
+		fMapped[i].data = NULL;
+		fMapped[i].used = 0;
+	}
+
+	if (fFrameSamples == 0 || fSampleRate == 0) {
+		fInitStatus = B_NOT_SUPPORTED;
+		return;
+	}
+
+	// Leaves room for variable bit rates to go above the average
+	uint32 bitRate = format.bitRate != 0 ? format.bitRate : kDefaultBitRate;
+	off_t capacity = window / 1000000 * bitRate / 8 * 5 / 4;
+	fCapacity = (capacity / kSegmentSize + 1) * kSegmentSize;
+
+	BPath path;
+	if (find_directory(B_SYSTEM_TEMP_DIRECTORY, &path) != B_OK
+		|| path.Append("StreamRadio-timeshift-XXXXXX") != B_OK) {
+		fInitStatus = B_ERROR;
+		return;
+	}
+
+	char name[B_PATH_NAME_LENGTH];
+	strlcpy(name, path.Path(), sizeof(name));
+	fFile = mkstemp(name);
+	if (fFile < 0) {
+		fInitStatus = errno;
+		return;
+	}
+
+	// The store goes away with the last reference to it
+	unlink(name);
+
+	if (ftruncate(fFile, fCapacity) != 0) {
+		fInitStatus = errno;
+		return;
+	}
+
+	TRACE("Time shift store of %" B_PRIdOFF " bytes created\n", fCapacity);
+	fInitStatus = B_OK;
+}
+
+
+TimeShiftBuffer::~TimeShiftBuffer()
+{
+	for (int32 i = 0; i < TSB_MAPPED_SEGMENTS; i++) {
+		if (fMapped[i].data != NULL)
+			munmap(fMapped[i].data, kSegmentSize);
+	}
+
+	if (fFile >= 0)
+		close(fFile);
+}
+
+
+/**
+ * Adds data received from the stream, and indexes the frames it completes.
+ * Once the store is full, the oldest data is overwritten.
+ */
+ssize_t
+TimeShiftBuffer::Append(const void* data, size_t size)
+{
+	BAutolock lock(fLock);
+
+	if (fInitStatus != B_OK)
+		return fInitStatus;
+
+	// Only the end of data larger than the store would be kept
+	if ((off_t)size > fCapacity) {
+		fWritten += size - fCapacity;
+		data = (const uint8*)data + size - fCapacity;
+		size = fCapacity;
+	}
+
+	status_t status = _Copy(fWritten, (void*)data, size, true);
+	if (status != B_OK)
+		return status;
+
+	fWritten += size;
+	_IndexFrames();
+	_Evict();
+
+	return size;
+}
+
+
+/**
+ * Marks the start of a new stream title at the data appended next.
+ */
+void
+TimeShiftBuffer::AddMarker(const char* title)
+{
+	BAutolock lock(fLock);
+
+	time_shift_marker marker;
+	marker.frame = fFirstFrame + fFrames.size();
+	marker.title = title;
+	fMarkers.push_back(marker);
+}
+
+
+off_t
+TimeShiftBuffer::PositionBefore(bigtime_t delay)
+{
+	BAutolock lock(fLock);
+
+	return _FrameStart(_FrameAt(fReadPosition) - _Frames(delay));
+}
+
+
+/**
+ * Returns the start of the track being read, or of the oldest data kept if
+ * it started before that.
+ */
+off_t
+TimeShiftBuffer::TrackStart()
+{
+	BAutolock lock(fLock);
+
+	int64 frame = _FrameAt(fReadPosition) - _Frames(kTrackStartTolerance);
+	int64 start = fFirstFrame;
+	for (size_t i = 0; i < fMarkers.size() && fMarkers[i].frame <= frame; i++)
+		start = fMarkers[i].frame;
+
+	return _FrameStart(start);
+}
+
+
+off_t
+TimeShiftBuffer::LivePosition()
+{
+	BAutolock lock(fLock);
+
+	return _FrameStart(_FrameAt(fWritten) - _Frames(kLiveDelay));
+}
+
+
+/**
+ * Returns how far reading is behind the stream.
+ */
+bigtime_t
+TimeShiftBuffer::Delay()
+{
+	BAutolock lock(fLock);
+
+	int64 frames = _FrameAt(fWritten) - _FrameAt(fReadPosition);
+	return frames * fFrameSamples * 1000000 / fSampleRate;
+}
+
+
+size_t
+TimeShiftBuffer::BufferedSize()
+{
+	BAutolock lock(fLock);
+
+	return fWritten > fReadPosition ? fWritten - fReadPosition : 0;
+}
+
+
+/**
+ * Reads at the reading position, waiting a little for data that has not been
+ * received yet. Data is only read when all of it is there. A reader that fell
+ * out of the window, as it was paused for too long, goes on with the oldest
+ * frame.
+ */
+ssize_t
+TimeShiftBuffer::Read(void* buffer, size_t size)
+{
+	status_t status = _WaitForData(fReadPosition, size);
+	if (status != B_OK)
+		return status;
+
+	BAutolock lock(fLock);
+
+	if (fReadPosition < fWritten - fCapacity)
+		fReadPosition = _FrameStart(fFirstFrame);
+
+	if (fReadPosition + (off_t)size > fWritten)
+		return B_WOULD_BLOCK;
+
+	status = _Copy(fReadPosition, buffer, size, false);
+	if (status != B_OK)
+		return status;
+
+	fReadPosition += size;
+	return size;
+}
+
+
+ssize_t
+TimeShiftBuffer::ReadAt(off_t position, void* buffer, size_t size)
+{
+	status_t status = _WaitForData(position, size);
+	if (status != B_OK)
+		return status;
+
+	BAutolock lock(fLock);
+
+	if (position < fWritten - fCapacity)
+		return B_RESOURCE_UNAVAILABLE;
+
+	status = _Copy(position, buffer, size, false);
+	return status == B_OK ? (ssize_t)size : status;
+}
+
+
+ssize_t
+TimeShiftBuffer::WriteAt(off_t position, const void* buffer, size_t size)
+{
+	return B_NOT_SUPPORTED;
+}
+
+
+off_t
+TimeShiftBuffer::Seek(off_t position, uint32 seekMode)
+{
+	BAutolock lock(fLock);
+
+	if (seekMode == SEEK_CUR)
+		position += fReadPosition;
+	else if (seekMode == SEEK_END)
+		position += fWritten;
+
+	off_t oldest = std::max(fWritten - fCapacity, off_t(0));
+	fReadPosition = std::max(std::min(position, fWritten), oldest);
+	return fReadPosition;
+}
+
+
+off_t
+TimeShiftBuffer::Position() const
+{
+	BAutolock lock(fLock);
+
+	return fReadPosition;
+}
+
+
+status_t
+TimeShiftBuffer::SetSize(off_t size)
+{
+	return B_NOT_SUPPORTED;
+}
+
+
+status_t
+TimeShiftBuffer::GetSize(off_t* size) const
+{
+	BAutolock lock(fLock);
+
+	*size = fWritten;
+	return B_OK;
+}
+
+
+/**
+ * Copies between buffer and the store at the stream position given, which
+ * wraps around at the end of the store.
+ */
+status_t
+TimeShiftBuffer::_Copy(off_t position, void* buffer, size_t size, bool write)
+{
+	uint8* data = (uint8*)buffer;
+	while (size > 0) {
+		off_t offset = position % fCapacity;
+		size_t segmentOffset = offset % kSegmentSize;
+		size_t count = std::min(size, size_t(kSegmentSize - segmentOffset));
+
+		uint8* segment = _Segment(offset / kSegmentSize);
+		if (segment == NULL)
+			return B_NO_MEMORY;
+
+		if (write)
+			memcpy(segment + segmentOffset, data, count);
+		else
+			memcpy(data, segment + segmentOffset, count);
+
+		position += count;
+		data += count;
+		size -= count;
+	}
+
+	return B_OK;
+}
+
+
+/**
+ * Returns the mapping of a segment of the store, replacing the one used least
+ * recently if it is not mapped yet.
+ */
+uint8*
+TimeShiftBuffer::_Segment(int32 index)
+{
+	MappedSegment* victim = &fMapped[0];
+	for (int32 i = 0; i < TSB_MAPPED_SEGMENTS; i++) {
+		if (fMapped[i].index == index) {
+			fMapped[i].used = ++fUseCount;
+			return fMapped[i].data;
+		}
+
+		if (fMapped[i].used < victim->used)
+			victim = &fMapped[i];
+	}
+
+	if (victim->data != NULL)
+		munmap(victim->data, kSegmentSize);
+
+	void* data = mmap(NULL, kSegmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, fFile,
+		(off_t)index * kSegmentSize);
+	if (data == MAP_FAILED) {
+		victim->index = -1;
+		victim->data = NULL;
+		victim->used = 0;
+		return NULL;
+	}
+
+	victim->index = index;
+	victim->data = (uint8*)data;
+	victim->used = ++fUseCount;
+
+	return victim->data;
+}
+
+
+/**
+ * Indexes the frames that were completely received, skipping anything between
+ * them that is not a frame.
+ */
+void
+TimeShiftBuffer::_IndexFrames()
+{
+	size_t headerSize = AudioHeader::FrameHeaderSize(fCodec);
+	uint8 header[16];
+
+	while (fScanned + (off_t)headerSize <= fWritten) {
+		if (_Copy(fScanned, header, headerSize, false) != B_OK)
+			break;
+
+		audio_header_info info;
+		size_t length = AudioHeader::FrameLength(fCodec, header, &info);
+		if (length < headerSize) {
+			fScanned++;
+			continue;
+		}
+
+		if (fScanned + (off_t)length > fWritten)
+			break;
+
+		fFrames.push_back(fScanned);
+		fScanned += length;
+	}
+}
+
+
+/**
+ * Drops the frames that were overwritten from the index. The marker of the
+ * track the oldest frame belongs to is kept.
+ */
+void
+TimeShiftBuffer::_Evict()
+{
+	off_t oldest = fWritten - fCapacity;
+	while (!fFrames.empty() && fFrames.front() < oldest) {
+		fFrames.pop_front();
+		fFirstFrame++;
+	}
+
+	while (fMarkers.size() > 1 && fMarkers[1].frame <= fFirstFrame)
+		fMarkers.pop_front();
+
+	if (fScanned < oldest)
+		fScanned = oldest;
+}
+
+
+/**
+ * Returns the frame that contains position.
+ */
+int64
+TimeShiftBuffer::_FrameAt(off_t position) const
+{
+	std::deque<off_t>::const_iterator found
+		= std::upper_bound(fFrames.begin(), fFrames.end(), position);
+	if (found == fFrames.begin())
+		return fFirstFrame;
+
+	return fFirstFrame + (found - fFrames.begin()) - 1;
+}
+
+
+/**
+ * Returns the start of a frame, or of the closest one that is still kept.
+ */
+off_t
+TimeShiftBuffer::_FrameStart(int64 frame) const
+{
+	if (fFrames.empty())
+		return fScanned;
+
+	int64 index = std::max(std::min(frame - fFirstFrame, int64(fFrames.size() - 1)), int64(0));
+	return fFrames[index];
+}
+
+
+int64
+TimeShiftBuffer::_Frames(bigtime_t duration) const
+{
+	return duration * fSampleRate / (1000000LL * fFrameSamples);
+}
+
+
+status_t
+TimeShiftBuffer::_WaitForData(off_t position, size_t size)
+{
+	for (bigtime_t waited = 0;; waited += kReadWait) {
+		{
+			BAutolock lock(fLock);
+			if (position + (off_t)size <= fWritten)
+				return B_OK;
+		}
+
+		if (waited >= kReadTimeout)
+			return B_TIMED_OUT;
+
+		snooze(kReadWait);
+	}
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef _TIME_SHIFT_BUFFER_H
+#define _TIME_SHIFT_BUFFER_H
+
+
+#include <DataIO.h>
+#include <Locker.h>
+#include <String.h>
+
+#include <deque>
+
+#include "AudioHeader.h"
+
+
+// Segments of the store mapped into memory at most
+#define TSB_MAPPED_SEGMENTS 3
+
+
+struct time_shift_marker {
+	int64 frame;
+	BString title;
+};
+
+
+/**
+ * Keeps a window of the compressed audio of a live stream in a file, so that
+ * it can be paused and rewound without fetching it again. The file is a ring
+ * of segments, of which only the few in use are mapped into memory. Each
+ * frame is indexed, so that seeking always lands on a frame, and the stream
+ * titles are marked at the frames they start with.
+ *
+ * Data is appended by the stream, and read as a stream by the decoder.
+ */
+class TimeShiftBuffer : public BPositionIO {
+public:
+	TimeShiftBuffer(bigtime_t window, const audio_header_info& format);
+	virtual ~TimeShiftBuffer();
+
+	status_t InitCheck() const { return fInitStatus; }
+
+	ssize_t Append(const void* data, size_t size);
+	void AddMarker(const char* title);
+
+	// Positions to seek to from the reading position, always at a frame
+	off_t PositionBefore(bigtime_t delay);
+	off_t TrackStart();
+	off_t LivePosition();
+
+	bigtime_t Delay();
+	size_t BufferedSize();
+
+	// BPositionIO
+	virtual ssize_t Read(void* buffer, size_t size);
+	virtual ssize_t ReadAt(off_t position, void* buffer, size_t size);
+	virtual ssize_t WriteAt(off_t position, const void* buffer, size_t size);
+
+	virtual off_t Seek(off_t position, uint32 seekMode);
+	virtual off_t Position() const;
+
+	virtual status_t SetSize(off_t size);
+	virtual status_t GetSize(off_t* size) const;
+
+private:
+	struct MappedSegment {
+		int32 index;
+		uint8* data;
+		uint32 used;
+	};
+
+	status_t _Copy(off_t position, void* buffer, size_t size, bool write);
+	uint8* _Segment(int32 index);
+
+	void _IndexFrames();
+	void _Evict();
+	int64 _FrameAt(off_t position) const;
+	off_t _FrameStart(int64 frame) const;
+	int64 _Frames(bigtime_t duration) const;
+	status_t _WaitForData(off_t position, size_t size);
+
+private:
+	status_t fInitStatus;
+	mutable BLocker fLock;
+	int fFile;
+	off_t fCapacity;
+	MappedSegment fMapped[TSB_MAPPED_SEGMENTS];
+	uint32 fUseCount;
+
+	audio_header_codec fCodec;
+	uint32 fFrameSamples;
+	uint32 fSampleRate;
+
+	off_t fWritten;
+	off_t fScanned;
+	off_t fReadPosition;
+
+	// Start of every frame in the window, the first one being fFirstFrame
+	std::deque<off_t> fFrames;
+	int64 fFirstFrame;
+	std::deque<time_shift_marker> fMarkers;
+};
+
+
+#endif	// _TIME_SHIFT_BUFFER_H
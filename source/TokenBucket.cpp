@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "TokenBucket.h"
+
+#include <Autolock.h>
+
+
+TokenBucket::TokenBucket(size_t rate)
+	: fLock("token bucket"),
+	  fRate(0),
+	  fTokens(0),
+	  fLastRefill(0)
+{
+	SetRate(rate);
+}
+
+
+void
+TokenBucket::SetRate(size_t rate)
+{
+	BAutolock lock(fLock);
+
+	fRate = rate;
+	fTokens = rate;
+	fLastRefill = system_time();
+}
+
+
+/**
+ * Takes size tokens, and returns how long to wait until there are tokens
+ * again.
+ */
+bigtime_t
+TokenBucket::Consume(size_t size)
+{
+	BAutolock lock(fLock);
+
+	if (fRate == 0)
+		return 0;
+
+	_Refill();
+	fTokens -= size;
+
+	return fTokens >= 0 ? 0 : -fTokens * 1000000 / (int64)fRate;
+}
+
+
+bool
+TokenBucket::IsAvailable()
+{
+	BAutolock lock(fLock);
+
+	if (fRate == 0)
+		return true;
+
+	_Refill();
+	return fTokens > 0;
+}
+
+
+void
+TokenBucket::_Refill()
+{
+	bigtime_t now = system_time();
+	int64 added = (now - fLastRefill) * (int64)fRate / 1000000;
+
+	if (added == 0)
+		return;
+
+	// Fractions of a token are kept for the next time, unless the bucket is full
+	fTokens += added;
+	if (fTokens >= (int64)fRate) {
+		fTokens = fRate;
+		fLastRefill = now;
+	} else
+		fLastRefill += added * 1000000 / (int64)fRate;
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef _TOKEN_BUCKET_H
+#define _TOKEN_BUCKET_H
+
+
+#include <Locker.h>
+#include <OS.h>
+
+
+/**
+ * Limits a data rate. Every byte takes a token, and tokens are added at the
+ * rate up to a burst. Taking more than there are leaves a debt, which has to
+ * be paid off before anything more may be taken.
+ */
+class TokenBucket {
+public:
+	TokenBucket(size_t rate = 0);
+
+	// Bytes per second, 0 for no limit. The burst is a second's worth.
+	void SetRate(size_t rate);
+	size_t Rate() const { return fRate; }
+
+	bigtime_t Consume(size_t size);
+	bool IsAvailable();
+
+private:
+	void _Refill();
+
+private:
+	BLocker fLock;
+	size_t fRate;
+	int64 fTokens;
+	bigtime_t fLastRefill;
+};
+
+
+#endif	// _TOKEN_BUCKET_H
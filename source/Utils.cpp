@@ -20,12 +20,16 @@
 
 #include <AppFileInfo.h>
 #include <Application.h>
+#include <Autolock.h>
 #include <Bitmap.h>
 #include <Message.h>
 #include <Resources.h>
 #include <Roster.h>
+#include <View.h>
 
+#include <new>
 #include <stdio.h>
+#include <string.h>
 
 
 static char sUserAgent[32] = {0};
@@ -46,6 +50,37 @@ Utils::ResourceBitmap(int32 id)
 }
 
 
+/**
+ * Renders source into a new bitmap of the given bounds, using bilinear
+ * filtering. Does not need a window, so it can be used off the UI thread.
+ */
+BBitmap*
+Utils::ScaledBitmap(BBitmap* source, BRect bounds)
+{
+	BBitmap* scaled = new (std::nothrow) BBitmap(bounds, B_BITMAP_ACCEPTS_VIEWS, B_RGBA32);
+	if (scaled == NULL || scaled->InitCheck() != B_OK) {
+		delete scaled;
+		return NULL;
+	}
+
+	memset(scaled->Bits(), 0, scaled->BitsLength());
+
+	BView* canvas = new BView(scaled->Bounds(), "canvas", B_FOLLOW_NONE, 0);
+	scaled->AddChild(canvas);
+	if (canvas->LockLooper()) {
+		canvas->SetDrawingMode(B_OP_ALPHA);
+		canvas->SetBlendingMode(B_PIXEL_ALPHA, B_ALPHA_COMPOSITE);
+		canvas->DrawBitmap(source, source->Bounds(), canvas->Bounds(), B_FILTER_BITMAP_BILINEAR);
+		canvas->Sync();
+		canvas->UnlockLooper();
+	}
+	scaled->RemoveChild(canvas);
+	delete canvas;
+
+	return scaled;
+}
+
+
 const char*
 Utils::UserAgent()
 {
@@ -71,3 +106,21 @@ Utils::UserAgent()
 
 	return sUserAgent;
 }
+
+
+BLocker StringPool::sLock("string pool");
+std::set<BString> StringPool::sStrings;
+
+
+/**
+ * Returns the pooled copy of value, adding it to the pool first if needed.
+ */
+BString
+StringPool::Intern(const BString& value)
+{
+	if (value.IsEmpty())
+		return value;
+
+	BAutolock lock(sLock);
+	return *sStrings.insert(value).first;
+}
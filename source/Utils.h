@@ -19,6 +19,10 @@
 
 
 #include <Bitmap.h>
+#include <Locker.h>
+#include <String.h>
+
+#include <set>
 
 
 #define RES_BANNER 100
@@ -34,8 +38,24 @@ public:
 	virtual ~Utils(){};
 
 	static BBitmap* ResourceBitmap(int32 id);
+	static BBitmap* ScaledBitmap(BBitmap* source, BRect bounds);
 	static const char* UserAgent();
 };
 
 
+/**
+ * Process wide pool for metadata strings that repeat across many stations,
+ * like genres, countries and languages. Interned strings share their buffer
+ * with the pooled copy, BString being reference counted.
+ */
+class StringPool {
+public:
+	static BString Intern(const BString& value);
+
+private:
+	static BLocker sLock;
+	static std::set<BString> sStrings;
+};
+
+
 #endif	// _UTILS_H
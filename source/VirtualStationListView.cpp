@@ -0,0 +1,504 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "VirtualStationListView.h"
+
+#include <ScrollBar.h>
+#include <Window.h>
+
+
+// Rows kept materialized above and below the visible area
+#define VSLV_ROW_MARGIN 4
+
+// Rows kept for scrolling back to them, a few pages' worth
+#define VSLV_PARKED_ROWS 200
+
+
+VirtualStationListView::VirtualStationListView()
+	: BView("Stations", B_WILL_DRAW | B_FRAME_EVENTS | B_NAVIGABLE),
+	  BInvoker(),
+	  StationItemHost(),
+	  fStations(NULL),
+	  fRows(2 * VSLV_ROW_MARGIN + 16),
+	  fFirstRow(0),
+	  fParkedRows(VSLV_PARKED_ROWS),
+	  fSelected(-1),
+	  fSelectionMessage(NULL)
+{
+	SetViewUIColor(B_LIST_BACKGROUND_COLOR);
+	SetExplicitMinSize(BSize(300, 2 * SLV_HEIGHT));
+}
+
+
+VirtualStationListView::~VirtualStationListView()
+{
+	_StopThumbnails();
+	MakeEmpty();
+
+	delete fSelectionMessage;
+}
+
+
+/**
+ * Takes ownership of stations and the Station objects in it.
+ */
+void
+VirtualStationListView::SetStations(StationList* stations)
+{
+	MakeEmpty();
+
+	fStations = stations;
+	ScrollTo(BPoint(0, 0));
+	_UpdateScrollBar();
+	Invalidate();
+}
+
+
+void
+VirtualStationListView::MakeEmpty()
+{
+	_DeleteRows();
+
+	if (fStations != NULL) {
+		for (int32 i = fStations->CountItems() - 1; i >= 0; i--)
+			delete fStations->RemoveItemAt(i);
+
+		delete fStations;
+		fStations = NULL;
+	}
+
+	fSelected = -1;
+	_UpdateScrollBar();
+	Invalidate();
+}
+
+
+int32
+VirtualStationListView::CountStations() const
+{
+	return (fStations != NULL) ? fStations->CountItems() : 0;
+}
+
+
+Station*
+VirtualStationListView::StationAt(int32 index) const
+{
+	return (fStations != NULL) ? fStations->ItemAt(index) : NULL;
+}
+
+
+/**
+ * Removes the station at index from the list and passes its ownership to
+ * the caller.
+ */
+Station*
+VirtualStationListView::RemoveStation(int32 index)
+{
+	if (index < 0 || index >= CountStations())
+		return NULL;
+
+	// Rows below the removed one all move up, rebuild them on the next draw
+	_ClearRows();
+	Station* station = fStations->RemoveItemAt(index);
+
+	for (int32 i = 0; i < fParkedRows.CountItems(); i++) {
+		if (fParkedRows.ItemAt(i)->GetStation() == station) {
+			StationListViewItem* row = fParkedRows.RemoveItemAt(i);
+			row->ClearStation();
+			delete row;
+			break;
+		}
+	}
+
+	if (fSelected == index) {
+		fSelected = -1;
+		_Notify(fSelectionMessage);
+	} else if (fSelected > index)
+		fSelected--;
+
+	_UpdateScrollBar();
+	Invalidate();
+
+	return station;
+}
+
+
+void
+VirtualStationListView::InvalidateStation(Station* station)
+{
+	for (int32 i = 0; i < fRows.CountItems(); i++) {
+		if (fRows.ItemAt(i)->GetStation() == station) {
+			Invalidate(_RowFrame(fFirstRow + i));
+			break;
+		}
+	}
+}
+
+
+void
+VirtualStationListView::Select(int32 index)
+{
+	if (index >= CountStations())
+		index = CountStations() - 1;
+	if (index < 0 || index == fSelected)
+		return;
+
+	StationListViewItem* row = _Row(fSelected);
+	if (row != NULL) {
+		row->Deselect();
+		Invalidate(_RowFrame(fSelected));
+	}
+
+	fSelected = index;
+
+	row = _Row(fSelected);
+	if (row != NULL)
+		row->Select();
+	Invalidate(_RowFrame(fSelected));
+
+	_Notify(fSelectionMessage);
+}
+
+
+void
+VirtualStationListView::ScrollToSelection()
+{
+	if (fSelected < 0)
+		return;
+
+	BRect frame = _RowFrame(fSelected);
+	BRect bounds = Bounds();
+	if (frame.top < bounds.top)
+		ScrollTo(BPoint(0, frame.top));
+	else if (frame.bottom > bounds.bottom)
+		ScrollTo(BPoint(0, frame.bottom - bounds.Height()));
+}
+
+
+void
+VirtualStationListView::SetSelectionMessage(BMessage* message)
+{
+	delete fSelectionMessage;
+	fSelectionMessage = message;
+}
+
+
+void
+VirtualStationListView::AttachedToWindow()
+{
+	BView::AttachedToWindow();
+
+	fThumbnailTarget = BMessenger(this);
+	if (!Messenger().IsValid())
+		SetTarget(Window());
+
+	_UpdateScrollBar();
+}
+
+
+void
+VirtualStationListView::Draw(BRect updateRect)
+{
+	_UpdateRows();
+
+	int32 first = (int32)(updateRect.top / SLV_HEIGHT);
+	int32 last = (int32)(updateRect.bottom / SLV_HEIGHT);
+	if (last >= CountStations())
+		last = CountStations() - 1;
+
+	for (int32 i = first; i <= last; i++) {
+		StationListViewItem* row = _Row(i);
+		if (row != NULL)
+			row->DrawStation(this, _RowFrame(i), i, false);
+	}
+}
+
+
+void
+VirtualStationListView::FrameResized(float width, float height)
+{
+	BView::FrameResized(width, height);
+	_UpdateScrollBar();
+}
+
+
+void
+VirtualStationListView::KeyDown(const char* bytes, int32 numBytes)
+{
+	int32 pageRows = (int32)(Bounds().Height() / SLV_HEIGHT);
+	if (pageRows < 1)
+		pageRows = 1;
+
+	switch (bytes[0]) {
+		case B_UP_ARROW:
+			Select(fSelected > 0 ? fSelected - 1 : 0);
+			break;
+
+		case B_DOWN_ARROW:
+			Select(fSelected + 1);
+			break;
+
+		case B_PAGE_UP:
+			Select(fSelected > pageRows ? fSelected - pageRows : 0);
+			break;
+
+		case B_PAGE_DOWN:
+			Select(fSelected + pageRows);
+			break;
+
+		case B_HOME:
+			Select(0);
+			break;
+
+		case B_END:
+			Select(CountStations() - 1);
+			break;
+
+		case B_ENTER:
+		case B_SPACE:
+			if (fSelected >= 0)
+				_Notify(Message());
+			return;
+
+		default:
+			BView::KeyDown(bytes, numBytes);
+			return;
+	}
+
+	ScrollToSelection();
+}
+
+
+void
+VirtualStationListView::MessageReceived(BMessage* message)
+{
+	switch (message->what) {
+		case MSG_THUMBNAIL_READY:
+			_ThumbnailReady(message);
+			break;
+
+		default:
+			BView::MessageReceived(message);
+			break;
+	}
+}
+
+
+void
+VirtualStationListView::MouseDown(BPoint where)
+{
+	if (!IsFocus())
+		MakeFocus(true);
+
+	int32 index = (int32)(where.y / SLV_HEIGHT);
+	if (index >= CountStations())
+		return;
+
+	Select(index);
+
+	int32 clicks = 1;
+	if (Window()->CurrentMessage() != NULL)
+		Window()->CurrentMessage()->FindInt32("clicks", &clicks);
+	if (clicks > 1)
+		_Notify(Message());
+}
+
+
+void
+VirtualStationListView::ScrollTo(BPoint where)
+{
+	BView::ScrollTo(where);
+	_UpdateRows();
+}
+
+
+bool
+VirtualStationListView::_HasItem(StationListViewItem* item)
+{
+	// Parked rows still take their thumbnails
+	return fRows.HasItem(item) || fParkedRows.HasItem(item);
+}
+
+
+void
+VirtualStationListView::_InvalidateItem(StationListViewItem* item)
+{
+	int32 index = fRows.IndexOf(item);
+	if (index >= 0)
+		Invalidate(_RowFrame(fFirstRow + index));
+}
+
+
+BRect
+VirtualStationListView::_RowFrame(int32 index) const
+{
+	return BRect(0, index * SLV_HEIGHT, Bounds().right, (index + 1) * SLV_HEIGHT - 1);
+}
+
+
+StationListViewItem*
+VirtualStationListView::_Row(int32 index) const
+{
+	if (index < fFirstRow)
+		return NULL;
+
+	return fRows.ItemAt(index - fFirstRow);
+}
+
+
+/**
+ * Returns the row for the station at index, a parked one if there is one, so
+ * that its thumbnail need not be scaled again.
+ */
+StationListViewItem*
+VirtualStationListView::_TakeRow(int32 index)
+{
+	Station* station = fStations->ItemAt(index);
+
+	StationListViewItem* row = NULL;
+	for (int32 i = fParkedRows.CountItems() - 1; i >= 0; i--) {
+		if (fParkedRows.ItemAt(i)->GetStation() == station) {
+			row = fParkedRows.RemoveItemAt(i);
+			break;
+		}
+	}
+
+	if (row == NULL) {
+		row = new StationListViewItem(station);
+		row->SetHost(this);
+	}
+
+	if (index == fSelected)
+		row->Select();
+	else
+		row->Deselect();
+
+	return row;
+}
+
+
+void
+VirtualStationListView::_ParkRow(StationListViewItem* row)
+{
+	fParkedRows.AddItem(row);
+
+	if (fParkedRows.CountItems() > VSLV_PARKED_ROWS) {
+		StationListViewItem* oldest = fParkedRows.RemoveItemAt(0);
+		oldest->ClearStation();
+		delete oldest;
+	}
+}
+
+
+/**
+ * Makes the materialized rows cover the visible area plus a margin,
+ * recycling the ones that are still in range.
+ */
+void
+VirtualStationListView::_UpdateRows()
+{
+	BRect bounds = Bounds();
+	int32 first = (int32)(bounds.top / SLV_HEIGHT) - VSLV_ROW_MARGIN;
+	int32 last = (int32)(bounds.bottom / SLV_HEIGHT) + VSLV_ROW_MARGIN;
+	if (first < 0)
+		first = 0;
+	if (last >= CountStations())
+		last = CountStations() - 1;
+
+	if (last < first) {
+		_ClearRows();
+		return;
+	}
+
+	int32 lastRow = fFirstRow + fRows.CountItems() - 1;
+	if (fRows.IsEmpty() || first > lastRow || last < fFirstRow) {
+		_ClearRows();
+		fFirstRow = first;
+	} else {
+		while (fFirstRow < first) {
+			_ParkRow(fRows.RemoveItemAt(0));
+			fFirstRow++;
+		}
+
+		while (fFirstRow + fRows.CountItems() - 1 > last)
+			_ParkRow(fRows.RemoveItemAt(fRows.CountItems() - 1));
+	}
+
+	while (fFirstRow > first) {
+		fFirstRow--;
+		fRows.AddItem(_TakeRow(fFirstRow), 0);
+	}
+
+	while (fFirstRow + fRows.CountItems() <= last)
+		fRows.AddItem(_TakeRow(fFirstRow + fRows.CountItems()));
+}
+
+
+void
+VirtualStationListView::_ClearRows()
+{
+	while (!fRows.IsEmpty())
+		_ParkRow(fRows.RemoveItemAt(0));
+
+	fFirstRow = 0;
+}
+
+
+void
+VirtualStationListView::_DeleteRows()
+{
+	_ClearRows();
+
+	// The rows only borrow their stations from fStations
+	for (int32 i = fParkedRows.CountItems() - 1; i >= 0; i--) {
+		StationListViewItem* row = fParkedRows.RemoveItemAt(i);
+		row->ClearStation();
+		delete row;
+	}
+}
+
+
+void
+VirtualStationListView::_UpdateScrollBar()
+{
+	BScrollBar* scrollBar = ScrollBar(B_VERTICAL);
+	if (scrollBar == NULL)
+		return;
+
+	float dataHeight = CountStations() * SLV_HEIGHT;
+	float viewHeight = Bounds().Height();
+	float maxScroll = dataHeight - viewHeight;
+	if (maxScroll < 0)
+		maxScroll = 0;
+
+	scrollBar->SetRange(0, maxScroll);
+	scrollBar->SetProportion(dataHeight > viewHeight ? viewHeight / dataHeight : 1);
+	scrollBar->SetSteps(SLV_HEIGHT / 2, viewHeight);
+}
+
+
+void
+VirtualStationListView::_Notify(BMessage* message)
+{
+	if (message == NULL)
+		return;
+
+	BMessage notification(*message);
+	notification.AddInt32("index", fSelected);
+	Invoke(&notification);
+}
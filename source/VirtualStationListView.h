@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef _VIRTUAL_STATION_LIST_VIEW_H
+#define _VIRTUAL_STATION_LIST_VIEW_H
+
+
+#include <Invoker.h>
+#include <ObjectList.h>
+#include <View.h>
+
+#include "StationFinder.h"
+#include "StationListView.h"
+
+
+/**
+ * A station list for large, read-only result sets. Rows all have the same
+ * height, so only the items around the visible area are materialized; all
+ * other stations are read from the backing StationList on demand. Items that
+ * scroll out of range are parked for a while, so that scrolling back finds
+ * their logos already scaled.
+ */
+class VirtualStationListView : public BView, public BInvoker, public StationItemHost {
+public:
+	VirtualStationListView();
+	virtual ~VirtualStationListView();
+
+	void SetStations(StationList* stations);
+	void MakeEmpty();
+
+	int32 CountStations() const;
+	Station* StationAt(int32 index) const;
+	Station* RemoveStation(int32 index);
+	void InvalidateStation(Station* station);
+
+	int32 CurrentSelection() const { return fSelected; }
+	void Select(int32 index);
+	void ScrollToSelection();
+
+	void SetInvocationMessage(BMessage* message) { SetMessage(message); }
+	void SetSelectionMessage(BMessage* message);
+
+	virtual void AttachedToWindow();
+	virtual void Draw(BRect updateRect);
+	virtual void FrameResized(float width, float height);
+	virtual void KeyDown(const char* bytes, int32 numBytes);
+	virtual void MessageReceived(BMessage* message);
+	virtual void MouseDown(BPoint where);
+	virtual void ScrollTo(BPoint where);
+
+private:
+	virtual bool _HasItem(StationListViewItem* item);
+	virtual void _InvalidateItem(StationListViewItem* item);
+
+	BRect _RowFrame(int32 index) const;
+	StationListViewItem* _Row(int32 index) const;
+	StationListViewItem* _TakeRow(int32 index);
+	void _ParkRow(StationListViewItem* row);
+	void _UpdateRows();
+	void _ClearRows();
+	void _DeleteRows();
+	void _UpdateScrollBar();
+	void _Notify(BMessage* message);
+
+private:
+	StationList* fStations;
+	BObjectList<StationListViewItem> fRows;
+	int32 fFirstRow;
+	// Rows scrolled out of range, kept with their thumbnails, oldest first
+	BObjectList<StationListViewItem> fParkedRows;
+	int32 fSelected;
+	BMessage* fSelectionMessage;
+};
+
+
+#endif	// _VIRTUAL_STATION_LIST_VIEW_H
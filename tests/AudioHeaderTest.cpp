@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+// Identifies the fixture streams, and every prefix of them, as they would
+// arrive from a station.
+
+
+#include <string.h>
+
+#include "AudioHeader.h"
+#include "TestUtils.h"
+
+
+struct Expectation {
+	const char* fixture;
+	audio_header_codec codec;
+	uint32 sampleRate;
+	uint32 channels;
+	uint32 bitRate;
+	uint32 mpegVersion;
+	uint32 mpegLayer;
+};
+
+
+static const Expectation kExpectations[] = {
+	{"mpeg1-layer3-44100-stereo.mp3", AUDIO_CODEC_MPEG, 44100, 2, 128000, 1, 3},
+	{"mpeg1-layer2-48000-stereo.mp2", AUDIO_CODEC_MPEG, 48000, 2, 192000, 1, 2},
+	{"mpeg2-layer3-22050-mono.mp3", AUDIO_CODEC_MPEG, 22050, 1, 64000, 2, 3},
+	{"mpeg25-layer3-11025-stereo.mp3", AUDIO_CODEC_MPEG, 11025, 2, 32000, 25, 3},
+	{"mpeg1-layer3-vbr.mp3", AUDIO_CODEC_MPEG, 44100, 2, 152000, 1, 3},
+	{"mpeg1-layer3-joined.mp3", AUDIO_CODEC_MPEG, 44100, 2, 128000, 1, 3},
+	{"id3v2-mpeg1-layer3.mp3", AUDIO_CODEC_MPEG, 44100, 2, 128000, 1, 3},
+	{"adts-aac-44100-stereo.aac", AUDIO_CODEC_AAC, 44100, 2, 129129, 0, 0},
+	{"adts-aac-24000-mono.aac", AUDIO_CODEC_AAC, 24000, 1, 24468, 0, 0},
+	{"ogg-vorbis-44100-stereo.ogg", AUDIO_CODEC_VORBIS, 44100, 2, 128000, 0, 0},
+	{"ogg-vorbis-chained.ogg", AUDIO_CODEC_VORBIS, 44100, 2, 128000, 0, 0},
+	{"ogg-opus-stereo.ogg", AUDIO_CODEC_OPUS, 48000, 2, 0, 0, 0},
+	{"flac-44100-stereo.flac", AUDIO_CODEC_FLAC, 44100, 2, 0, 0, 0},
+	{"flac-96000-surround.flac", AUDIO_CODEC_FLAC, 96000, 6, 0, 0, 0},
+};
+
+static const char* kNotAudio[] = {"html-error-page.html", "m3u-playlist.m3u"};
+
+
+static void
+TestIdentify(const Expectation& expected)
+{
+	size_t size;
+	uint8* data = ReadFixture(expected.fixture, &size);
+
+	audio_header_info info;
+	status_t status = AudioHeader::Identify(data, size, &info);
+	if (status != B_OK) {
+		fprintf(stderr, "%s: not identified\n", expected.fixture);
+		sTestFailures++;
+		free(data);
+		return;
+	}
+
+	CHECK_EQUAL(info.codec, expected.codec);
+	CHECK_EQUAL(info.sampleRate, expected.sampleRate);
+	CHECK_EQUAL(info.channels, expected.channels);
+	CHECK_EQUAL(info.bitRate, expected.bitRate);
+	CHECK_EQUAL(info.mpegVersion, expected.mpegVersion);
+	CHECK_EQUAL(info.mpegLayer, expected.mpegLayer);
+
+	// Only the codecs with frame headers have a frame size
+	bool framed = expected.codec == AUDIO_CODEC_MPEG || expected.codec == AUDIO_CODEC_AAC;
+	CHECK(framed ? info.frameSize != 0 : info.frameSize == 0);
+
+	free(data);
+}
+
+
+/**
+ * Feeds every prefix of a fixture in a buffer of its own size. A prefix is
+ * either not identified, or identified as what the whole stream is.
+ */
+static void
+TestTruncated(const Expectation& expected)
+{
+	size_t size;
+	uint8* data = ReadFixture(expected.fixture, &size);
+
+	for (size_t length = 0; length <= size; length++) {
+		uint8* prefix = (uint8*)malloc(length > 0 ? length : 1);
+		memcpy(prefix, data, length);
+
+		audio_header_info info;
+		status_t status = AudioHeader::Identify(prefix, length, &info);
+		if (status == B_OK) {
+			CHECK_EQUAL(info.codec, expected.codec);
+			CHECK_EQUAL(info.sampleRate, expected.sampleRate);
+			CHECK_EQUAL(info.channels, expected.channels);
+		} else
+			CHECK_EQUAL(info.codec, AUDIO_CODEC_UNKNOWN);
+
+		free(prefix);
+	}
+
+	free(data);
+}
+
+
+static void
+TestNotAudio(const char* fixture)
+{
+	size_t size;
+	uint8* data = ReadFixture(fixture, &size);
+
+	audio_header_info info;
+	CHECK(AudioHeader::Identify(data, size, &info) == B_ERROR);
+	CHECK_EQUAL(info.codec, AUDIO_CODEC_UNKNOWN);
+
+	free(data);
+}
+
+
+/**
+ * MPEG audio is only trusted once the header of the following frame
+ * confirms the first one.
+ */
+static void
+TestMpegNeedsTwoFrames()
+{
+	size_t size;
+	uint8* data = ReadFixture("mpeg1-layer3-44100-stereo.mp3", &size);
+
+	audio_header_info info;
+	CHECK(AudioHeader::Identify(data, 417 + 3, &info) == B_ERROR);
+	CHECK(AudioHeader::Identify(data, 417 + 4, &info) == B_OK);
+	CHECK_EQUAL(info.frameSize, 417);
+
+	free(data);
+}
+
+
+static void
+TestId3Tag()
+{
+	size_t size;
+	uint8* data = ReadFixture("id3v2-mpeg1-layer3.mp3", &size);
+
+	size_t tagSize = AudioHeader::TagSize(data, size);
+	CHECK_EQUAL(tagSize, size - 2506);
+	CHECK_EQUAL(data[tagSize], 0xff);
+
+	// The tag alone, and the tag header alone, cannot be identified
+	audio_header_info info;
+	CHECK(AudioHeader::Identify(data, tagSize, &info) == B_ERROR);
+	CHECK(AudioHeader::Identify(data, 10, &info) == B_ERROR);
+	CHECK_EQUAL(AudioHeader::TagSize(data, 9), 0);
+
+	free(data);
+}
+
+
+/**
+ * Walks the frames of a stream the way the fast start path does, which has
+ * to end exactly at the end of the fixture.
+ */
+static void
+TestFrameWalk(const char* fixture, audio_header_codec codec, uint32 frames, uint32 samples)
+{
+	size_t size;
+	uint8* data = ReadFixture(fixture, &size);
+
+	size_t headerSize = AudioHeader::FrameHeaderSize(codec);
+	CHECK(headerSize > 0);
+
+	size_t position = 0;
+	uint32 count = 0;
+	audio_header_info info;
+	while (position + headerSize <= size) {
+		size_t length = AudioHeader::FrameLength(codec, data + position, &info);
+		if (length == 0)
+			break;
+
+		CHECK_EQUAL(AudioHeader::FrameSamples(info), samples);
+		position += length;
+		count++;
+	}
+
+	CHECK_EQUAL(position, size);
+	CHECK_EQUAL(count, frames);
+
+	free(data);
+}
+
+
+int
+main()
+{
+	for (size_t i = 0; i < sizeof(kExpectations) / sizeof(kExpectations[0]); i++) {
+		TestIdentify(kExpectations[i]);
+		TestTruncated(kExpectations[i]);
+	}
+
+	for (size_t i = 0; i < sizeof(kNotAudio) / sizeof(kNotAudio[0]); i++)
+		TestNotAudio(kNotAudio[i]);
+
+	TestMpegNeedsTwoFrames();
+	TestId3Tag();
+
+	TestFrameWalk("mpeg1-layer3-44100-stereo.mp3", AUDIO_CODEC_MPEG, 6, 1152);
+	TestFrameWalk("mpeg1-layer2-48000-stereo.mp2", AUDIO_CODEC_MPEG, 4, 1152);
+	TestFrameWalk("mpeg2-layer3-22050-mono.mp3", AUDIO_CODEC_MPEG, 4, 576);
+	TestFrameWalk("mpeg25-layer3-11025-stereo.mp3", AUDIO_CODEC_MPEG, 4, 576);
+	TestFrameWalk("adts-aac-44100-stereo.aac", AUDIO_CODEC_AAC, 5, 1024);
+
+	CHECK_EQUAL(AudioHeader::FrameHeaderSize(AUDIO_CODEC_FLAC), 0);
+
+	return TestResult("AudioHeaderTest");
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+// Checks the integrated loudness of sines against the levels BS.1770 gives
+// them, including the gating of EBU Tech 3341 and mono upmixed to stereo.
+
+
+#include <math.h>
+
+#include "LoudnessMeter.h"
+#include "TestUtils.h"
+
+
+static const float kFrameRate = 48000;
+
+// Frames handed to the meter at a time, as the mixer does
+static const size_t kChunkFrames = 1024;
+
+
+#define CHECK_LOUDNESS(meter, expected) \
+	do { \
+		float _loudness = (meter).IntegratedLoudness(); \
+		if (fabsf(_loudness - (expected)) > 0.1f) { \
+			fprintf(stderr, "%s:%d: loudness is %.2f LUFS, expected %.1f\n", __FILE__, \
+				__LINE__, _loudness, (double)(expected)); \
+			sTestFailures++; \
+		} \
+	} while (0)
+
+
+/**
+ * Feeds seconds of a 1 kHz sine with a peak at level dBFS to meter, into the
+ * first channels of every frameSamples samples.
+ */
+static void
+FeedSine(LoudnessMeter& meter, uint32 channels, uint32 frameSamples, double level,
+	double seconds)
+{
+	float buffer[kChunkFrames * 2];
+	double amplitude = pow(10, level / 20);
+	size_t frames = size_t(seconds * kFrameRate);
+
+	for (size_t start = 0; start < frames; start += kChunkFrames) {
+		size_t count = min_c(kChunkFrames, frames - start);
+		for (size_t i = 0; i < count; i++) {
+			float sample = amplitude * sin(2 * M_PI * 1000 * (start + i) / kFrameRate);
+			for (uint32 c = 0; c < frameSamples; c++)
+				buffer[i * frameSamples + c] = c < channels ? sample : 0;
+		}
+		meter.Process(buffer, count);
+	}
+}
+
+
+static void
+TestMono()
+{
+	LoudnessMeter meter(kFrameRate, 1);
+	CHECK_EQUAL(meter.InitCheck(), B_OK);
+
+	FeedSine(meter, 1, 1, -20, 10);
+	CHECK_LOUDNESS(meter, -23.0);
+	CHECK(meter.MeasuredTime() > 9000000);
+}
+
+
+static void
+TestUpmixedMono()
+{
+	// One channel of two, as the mixer measures upmixed mono
+	LoudnessMeter meter(kFrameRate, 1, 2);
+	CHECK_EQUAL(meter.InitCheck(), B_OK);
+
+	FeedSine(meter, 2, 2, -20, 10);
+	CHECK_LOUDNESS(meter, -23.0);
+}
+
+
+static void
+TestStereo()
+{
+	LoudnessMeter meter(kFrameRate, 2);
+	CHECK_EQUAL(meter.InitCheck(), B_OK);
+
+	FeedSine(meter, 2, 2, -23, 20);
+	CHECK_LOUDNESS(meter, -23.0);
+
+	// Quiet parts are gated, silence does not even count as measured
+	meter.Reset();
+	FeedSine(meter, 2, 2, -36, 10);
+	FeedSine(meter, 2, 2, -23, 60);
+	FeedSine(meter, 2, 2, -36, 10);
+	FeedSine(meter, 2, 2, -100, 10);
+	CHECK_LOUDNESS(meter, -23.0);
+	CHECK(meter.MeasuredTime() < 81000000);
+}
+
+
+static void
+TestSilence()
+{
+	LoudnessMeter meter(kFrameRate, 2);
+	FeedSine(meter, 2, 2, -100, 5);
+	CHECK_EQUAL(meter.IntegratedLoudness(), 0);
+	CHECK_EQUAL(meter.MeasuredTime(), 0);
+
+	LoudnessMeter invalid(kFrameRate, 2, 1);
+	CHECK_EQUAL(invalid.InitCheck(), B_BAD_VALUE);
+}
+
+
+int
+main()
+{
+	TestMono();
+	TestUpmixedMono();
+	TestStereo();
+	TestSilence();
+
+	return TestResult("LoudnessMeterTest");
+}
@@ -0,0 +1,258 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+// Compares the scanners of Markup and Playlist with the regular expressions
+// they replaced, on what they are used for: a station home page, searched for
+// its title and icon when a station is added by URL, a result page of the
+// listenlive.eu finder, and the PLS and M3U playlists stations are listed by.
+// The regular expressions are those of the baseline, compiled as often as it
+// did.
+
+
+#include <regex.h>
+#include <string.h>
+#include <time.h>
+
+#include "HlsPlaylist.h"
+#include "Markup.h"
+#include "Playlist.h"
+#include "TestUtils.h"
+
+
+// Each case runs for at least this long
+static const double kMinSeconds = 0.5;
+
+
+/**
+ * Playlist::Parse() asks HlsPlaylist whether the body is an HLS playlist,
+ * which would link in the network code. None of the playlists here is one.
+ */
+bool
+HlsPlaylist::IsHls(const char* body)
+{
+	return false;
+}
+
+
+static double
+Now()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+
+/**
+ * Station::RegFind() as it was: compiled for every match.
+ */
+static char*
+RegFind(const char* text, const char* pattern)
+{
+	regex_t regex;
+	regmatch_t matches[20];
+	char* match = NULL;
+
+	if (regcomp(&regex, pattern, REG_EXTENDED | REG_NEWLINE | REG_ICASE) != 0)
+		return NULL;
+
+	if (regexec(&regex, text, 20, matches, 0) == 0 && matches[1].rm_so >= 0)
+		match = strndup(text + matches[1].rm_so, matches[1].rm_eo - matches[1].rm_so);
+
+	regfree(&regex);
+	return match;
+}
+
+
+static int32
+RegexHomePage(const char* body)
+{
+	char* title = RegFind(body, "<title[^>]*>(.*?)</title[^>]*>");
+	char* icon = RegFind(body, "<link\\s*rel=\"shortcut icon\"\\s*href=\"([^\"]*?)\".*?");
+
+	int32 found = (title != NULL) + (icon != NULL);
+	free(title);
+	free(icon);
+	return found;
+}
+
+
+/**
+ * What Station::LoadIndirectUrl() does with the page now.
+ */
+static int32
+MarkupHomePage(const char* body)
+{
+	BString title = Markup::Decode(Markup::Element(body, "title"));
+
+	BString icon;
+	for (const char* tag = Markup::FindTag(body, "link"); tag != NULL;
+		 tag = Markup::FindTag(tag + 1, "link")) {
+		BString rel = Markup::Attribute(tag, "rel");
+		if (rel.ICompare("shortcut icon") == 0) {
+			icon = Markup::Attribute(tag, "href");
+			break;
+		}
+		if (icon.IsEmpty() && rel.ICompare("icon") == 0)
+			icon = Markup::Attribute(tag, "href");
+	}
+
+	return !title.IsEmpty() + !icon.IsEmpty();
+}
+
+
+static int32
+RegexListenLive(const char* body)
+{
+	regex_t regex;
+	if (regcomp(&regex,
+			"<tr>\\s*<td>\\s*<a\\s+href=\"([^\"]*)\"><b>([^<]*)</b>\\s*</a>\\s*</td>\\s*"
+			"<td>([^<]*)</td>\\s*"
+			"<td>([^<]|<[^/]|</[^t]|</t[^d])*</td>\\s*"
+			"<td>\\s*<a\\s+href=\"([^\"]*)\">([^<]*)</a>([^<]|<[^/]|</[^t]|</t[^d])*</td>\\s*"
+			"<td>([^<]*)</td>\\s*</tr>",
+			REG_EXTENDED | REG_ICASE)
+		!= 0) {
+		return 0;
+	}
+
+	int32 rows = 0;
+	regmatch_t matches[10];
+	while (regexec(&regex, body, 10, matches, 0) == 0) {
+		rows++;
+		body += matches[0].rm_eo;
+	}
+
+	regfree(&regex);
+	return rows;
+}
+
+
+/**
+ * What StationFinderListenLive::ParseCountryReturn() does with the page, up
+ * to the station fields.
+ */
+static int32
+MarkupListenLive(const char* body)
+{
+	int32 rows = 0;
+	BString cells[6];
+	int32 count;
+	while ((body = Markup::NextRow(body, cells, 6, &count)) != NULL) {
+		if (count != 5 || Markup::FindTag(cells[0].String(), "b") == NULL)
+			continue;
+
+		BString name = Markup::Decode(Markup::Element(cells[0].String(), "b"));
+		const char* link = Markup::FindTag(cells[3].String(), "a");
+		BString source = link != NULL ? Markup::Attribute(link, "href") : BString();
+		if (!name.IsEmpty() && !source.IsEmpty())
+			rows++;
+	}
+
+	return rows;
+}
+
+
+/**
+ * Station::ParseUrlReference() as it was: the first pattern that matches gives
+ * the stream URL, the title is looked for in any case.
+ */
+static int32
+RegexPlaylist(const char* body)
+{
+	const char* patterns[3] = {"^file[0-9]+=([^\r\n]*)[\r\n$]+", "^(http://[^\r\n]*)[\r\n]+$",
+		"^([^#]+[^\r\n]*)[\r\n]+$"};
+
+	char* url = NULL;
+	for (int32 i = 0; i < 3 && url == NULL; i++)
+		url = RegFind(body, patterns[i]);
+	char* title = url != NULL ? RegFind(body, "^title[0-9]+=([^\r\n]*)[\r\n$]+") : NULL;
+
+	int32 found = (url != NULL) + (title != NULL);
+	free(url);
+	free(title);
+	return found;
+}
+
+
+static int32
+ParsePlaylist(const char* body)
+{
+	BStringList urls;
+	BString title;
+	if (Playlist::Parse(body, BUrl("http://radio.example.org/listen"), &urls, &title) != B_OK)
+		return 0;
+
+	return 1 + !title.IsEmpty();
+}
+
+
+/**
+ * Returns the time per call of scan on body in microseconds, after checking
+ * that it finds what it should.
+ */
+static double
+Measure(int32 (*scan)(const char*), const char* body, int32 expected, const char* name)
+{
+	int32 found = scan(body);
+	if (found != expected) {
+		fprintf(stderr, "%s found %" PRId32 ", expected %" PRId32 "\n", name, found, expected);
+		sTestFailures++;
+	}
+
+	int32 calls = 0;
+	double start = Now();
+	double elapsed;
+	do {
+		scan(body);
+		calls++;
+		elapsed = Now() - start;
+	} while (elapsed < kMinSeconds);
+
+	return elapsed / calls * 1e6;
+}
+
+
+static void
+Compare(const char* fixture, int32 (*regex)(const char*), int32 (*markup)(const char*),
+	int32 expected)
+{
+	size_t size;
+	uint8* data = ReadFixture(fixture, &size);
+	char* body = (char*)realloc(data, size + 1);
+	body[size] = '\0';
+
+	double regexTime = Measure(regex, body, expected, "regex");
+	double markupTime = Measure(markup, body, expected, "scanner");
+	printf("%-26s %7zu bytes  regex %9.1f us  scanner %7.1f us  %6.1fx\n", fixture, size,
+		regexTime, markupTime, regexTime / markupTime);
+
+	free(body);
+}
+
+
+int
+main()
+{
+	Compare("homepage-station.html", &RegexHomePage, &MarkupHomePage, 2);
+	Compare("listenlive-country.html", &RegexListenLive, &MarkupListenLive, 300);
+	Compare("pls-mirrors.pls", &RegexPlaylist, &ParsePlaylist, 2);
+	Compare("m3u-mirrors.m3u", &RegexPlaylist, &ParsePlaylist, 1);
+
+	return TestResult("MarkupBenchmark");
+}
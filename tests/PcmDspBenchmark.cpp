@@ -0,0 +1,312 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+// Measures the PcmDsp kernels against the plain loops, on a buffer of the
+// size the mixer handles. The plain loops are built without automatic
+// vectorization, as they would be without the kernels.
+
+
+#include <string.h>
+#include <time.h>
+
+#include "PcmDsp.h"
+#include "PcmDspReference.h"
+#include "TestUtils.h"
+
+
+// Stereo frames of a buffer, and how long each case runs at least
+static const size_t kFrames = 4096;
+static const size_t kSamples = kFrames * 2;
+static const double kMinSeconds = 0.2;
+
+
+struct Buffers {
+	float* source;
+	float* work;
+	float* output;
+	int16* shorts;
+	int32* ints;
+};
+
+typedef void (*Kernel)(Buffers& buffers);
+
+struct Case {
+	const char* name;
+	Kernel kernel;
+	Kernel reference;
+};
+
+
+static double
+Now()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+
+// The kernels that change samples in place start from a copy of the source
+// each time, so that repeated gain does not run into denormals.
+
+static void
+Refresh(Buffers& buffers)
+{
+	memcpy(buffers.work, buffers.source, kSamples * sizeof(float));
+}
+
+
+static void
+Copy(Buffers& buffers)
+{
+	Refresh(buffers);
+}
+
+
+static void
+FromInt16(Buffers& buffers)
+{
+	PcmDsp::ConvertToFloat(buffers.shorts, buffers.output, kSamples);
+}
+
+
+static void
+FromInt16Plain(Buffers& buffers)
+{
+	PcmDspReference::ConvertToFloat(buffers.shorts, buffers.output, kSamples);
+}
+
+
+static void
+ToInt16(Buffers& buffers)
+{
+	PcmDsp::ConvertFromFloat(buffers.source, buffers.shorts, kSamples);
+}
+
+
+static void
+ToInt16Plain(Buffers& buffers)
+{
+	PcmDspReference::ConvertFromFloat(buffers.source, buffers.shorts, kSamples);
+}
+
+
+static void
+FromInt32(Buffers& buffers)
+{
+	PcmDsp::ConvertToFloat(buffers.ints, buffers.output, kSamples);
+}
+
+
+static void
+FromInt32Plain(Buffers& buffers)
+{
+	PcmDspReference::ConvertToFloat(buffers.ints, buffers.output, kSamples);
+}
+
+
+static void
+Gain(Buffers& buffers)
+{
+	Refresh(buffers);
+	PcmDsp::Gain(buffers.work, kSamples, 0.7f);
+}
+
+
+static void
+GainPlain(Buffers& buffers)
+{
+	Refresh(buffers);
+	PcmDspReference::Gain(buffers.work, kSamples, 0.7f);
+}
+
+
+static void
+GainRamp(Buffers& buffers)
+{
+	Refresh(buffers);
+	PcmDsp::GainRamp(buffers.work, kFrames, 2, 0.2f, 0.9f);
+}
+
+
+static void
+GainRampPlain(Buffers& buffers)
+{
+	Refresh(buffers);
+	PcmDspReference::GainRamp(buffers.work, kFrames, 2, 0.2f, 0.9f);
+}
+
+
+static void
+Mix(Buffers& buffers)
+{
+	PcmDsp::Mix(buffers.source, buffers.output, kSamples, 0.5f);
+}
+
+
+static void
+MixPlain(Buffers& buffers)
+{
+	PcmDspReference::Mix(buffers.source, buffers.output, kSamples, 0.5f);
+}
+
+
+static void
+DotProduct(Buffers& buffers)
+{
+	buffers.output[0] = PcmDsp::DotProduct(buffers.source, buffers.work, kSamples);
+}
+
+
+static void
+DotProductPlain(Buffers& buffers)
+{
+	buffers.output[0] = PcmDspReference::DotProduct(buffers.source, buffers.work, kSamples);
+}
+
+
+static void
+Peak(Buffers& buffers)
+{
+	buffers.output[0] = PcmDsp::Peak(buffers.source, kSamples);
+}
+
+
+static void
+PeakPlain(Buffers& buffers)
+{
+	buffers.output[0] = PcmDspReference::Peak(buffers.source, kSamples);
+}
+
+
+static void
+UpMix(Buffers& buffers)
+{
+	PcmDsp::UpMix(buffers.source, buffers.output, kFrames);
+}
+
+
+static void
+UpMixPlain(Buffers& buffers)
+{
+	PcmDspReference::UpMix(buffers.source, buffers.output, kFrames);
+}
+
+
+static void
+DownMix(Buffers& buffers)
+{
+	PcmDsp::DownMix(buffers.source, buffers.output, kFrames);
+}
+
+
+static void
+DownMixPlain(Buffers& buffers)
+{
+	PcmDspReference::DownMix(buffers.source, buffers.output, kFrames);
+}
+
+
+static void
+SoftClip(Buffers& buffers)
+{
+	Refresh(buffers);
+	PcmDsp::SoftClip(buffers.work, kSamples);
+}
+
+
+static void
+SoftClipPlain(Buffers& buffers)
+{
+	Refresh(buffers);
+	PcmDspReference::SoftClip(buffers.work, kSamples);
+}
+
+
+static const Case kCases[] = {
+	{"copy (part of in place)", &Copy, &Copy},
+	{"int16 to float", &FromInt16, &FromInt16Plain},
+	{"float to int16", &ToInt16, &ToInt16Plain},
+	{"int32 to float", &FromInt32, &FromInt32Plain},
+	{"Gain", &Gain, &GainPlain},
+	{"GainRamp", &GainRamp, &GainRampPlain},
+	{"Mix", &Mix, &MixPlain},
+	{"DotProduct", &DotProduct, &DotProductPlain},
+	{"Peak", &Peak, &PeakPlain},
+	{"UpMix", &UpMix, &UpMixPlain},
+	{"DownMix", &DownMix, &DownMixPlain},
+	{"SoftClip", &SoftClip, &SoftClipPlain},
+};
+
+
+/**
+ * Returns the time kernel takes per sample of the buffer in nanoseconds.
+ */
+static double
+Measure(Kernel kernel, Buffers& buffers)
+{
+	int32 calls = 0;
+	double start = Now();
+	double elapsed;
+	do {
+		kernel(buffers);
+		calls++;
+		elapsed = Now() - start;
+	} while (elapsed < kMinSeconds);
+
+	return elapsed / calls / kSamples * 1e9;
+}
+
+
+int
+main()
+{
+	Buffers buffers;
+	buffers.source = new float[kSamples];
+	buffers.work = new float[kSamples];
+	buffers.output = new float[kSamples];
+	buffers.shorts = new int16[kSamples];
+	buffers.ints = new int32[kSamples];
+
+	// Music that goes past full scale now and then, as a mix of two stations
+	uint32 random = 1;
+	for (size_t i = 0; i < kSamples; i++) {
+		random = random * 1664525 + 1013904223;
+		buffers.source[i] = ((random >> 8) / 16777216.0f * 2 - 1) * 1.2f;
+		buffers.work[i] = buffers.source[i];
+		buffers.output[i] = 0;
+		buffers.shorts[i] = (int16)(random >> 16);
+		buffers.ints[i] = (int32)random;
+	}
+
+	printf("%-24s %10s %10s %8s\n", "ns per sample", "PcmDsp", "plain", "speedup");
+	for (size_t i = 0; i < sizeof(kCases) / sizeof(kCases[0]); i++) {
+		double kernelTime = Measure(kCases[i].kernel, buffers);
+		double referenceTime = Measure(kCases[i].reference, buffers);
+		printf("%-24s %10.3f %10.3f %7.1fx\n", kCases[i].name, kernelTime, referenceTime,
+			referenceTime / kernelTime);
+	}
+
+	delete[] buffers.source;
+	delete[] buffers.work;
+	delete[] buffers.output;
+	delete[] buffers.shorts;
+	delete[] buffers.ints;
+
+	return TestResult("PcmDspBenchmark");
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef _PCM_DSP_REFERENCE_H
+#define _PCM_DSP_REFERENCE_H
+
+
+// The plain loops PcmDsp falls back to, which the vector kernels must match
+// and are measured against.
+
+
+#include <math.h>
+
+#include <SupportDefs.h>
+
+
+class PcmDspReference {
+public:
+	static float Clamp(float value, float low, float high)
+	{
+		value = value < high ? value : high;
+		return value > low ? value : low;
+	}
+
+	static void ConvertToFloat(const int16* input, float* output, size_t samples)
+	{
+		for (size_t i = 0; i < samples; i++)
+			output[i] = input[i] * (1.0f / 32768.0f);
+	}
+
+	static void ConvertToFloat(const int32* input, float* output, size_t samples)
+	{
+		for (size_t i = 0; i < samples; i++)
+			output[i] = (float)input[i] * (1.0f / 2147483648.0f);
+	}
+
+	static void ConvertFromFloat(const float* input, int16* output, size_t samples)
+	{
+		for (size_t i = 0; i < samples; i++)
+			output[i] = (int16)lrintf(Clamp(input[i] * 32768.0f, -32768.0f, 32767.0f));
+	}
+
+	static void ConvertFromFloat(const float* input, int32* output, size_t samples)
+	{
+		for (size_t i = 0; i < samples; i++) {
+			output[i] = (int32)lrintf(
+				Clamp(input[i] * 2147483648.0f, -2147483648.0f, 2147483520.0f));
+		}
+	}
+
+	static void Gain(float* samples, size_t count, float gain)
+	{
+		for (size_t i = 0; i < count; i++)
+			samples[i] *= gain;
+	}
+
+	static void GainRamp(
+		float* samples, size_t frames, uint32 channels, float fromGain, float toGain)
+	{
+		if (fromGain == toGain) {
+			Gain(samples, frames * channels, toGain);
+			return;
+		}
+
+		float step = (toGain - fromGain) / frames;
+		for (size_t i = 0; i < frames; i++) {
+			float gain = fromGain + step * i;
+			for (uint32 c = 0; c < channels; c++)
+				samples[i * channels + c] *= gain;
+		}
+	}
+
+	static void Mix(const float* input, float* output, size_t samples, float gain)
+	{
+		for (size_t i = 0; i < samples; i++)
+			output[i] += input[i] * gain;
+	}
+
+	static float DotProduct(const float* first, const float* second, size_t count)
+	{
+		float sum = 0.0f;
+		for (size_t i = 0; i < count; i++)
+			sum += first[i] * second[i];
+
+		return sum;
+	}
+
+	static float Peak(const float* samples, size_t count)
+	{
+		float peak = 0.0f;
+		for (size_t i = 0; i < count; i++) {
+			float magnitude = fabsf(samples[i]);
+			peak = magnitude > peak ? magnitude : peak;
+		}
+
+		return peak;
+	}
+
+	static void UpMix(const float* mono, float* stereo, size_t frames)
+	{
+		for (size_t i = 0; i < frames; i++)
+			stereo[i * 2] = stereo[i * 2 + 1] = mono[i];
+	}
+
+	static void DownMix(const float* stereo, float* mono, size_t frames)
+	{
+		for (size_t i = 0; i < frames; i++)
+			mono[i] = (stereo[i * 2] + stereo[i * 2 + 1]) * 0.5f;
+	}
+
+	static void SoftClip(float* samples, size_t count)
+	{
+		for (size_t i = 0; i < count; i++) {
+			float magnitude = fabsf(samples[i]);
+			if (!(magnitude > 0.75f))
+				continue;
+
+			float u = (magnitude - 0.75f) * 4.0f;
+			u = u < 3.0f ? u : 3.0f;
+			float square = u * u;
+			float curve = u * (27.0f + square) / (27.0f + 9.0f * square);
+			samples[i] = copysignf(0.75f + 0.25f * curve, samples[i]);
+		}
+	}
+
+};
+
+
+#endif	// _PCM_DSP_REFERENCE_H
@@ -0,0 +1,331 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+// Checks that the vector kernels of PcmDsp give the results of the plain
+// loops bit for bit, for every length up to a few vectors and at unaligned
+// addresses, so that the tails and the AVX2, SSE2 and NEON paths all run.
+
+
+#include <math.h>
+#include <string.h>
+
+#include "PcmDsp.h"
+#include "PcmDspReference.h"
+#include "TestUtils.h"
+
+
+// Lengths up to and past two AVX2 vectors, and offsets from an aligned start
+static const size_t kMaxLength = 70;
+static const size_t kMaxOffset = 3;
+static const size_t kBufferSize = kMaxLength * 3 + kMaxOffset;
+
+static const float kSpecials[] = {0.0f, -0.0f, 1.0f, -1.0f, 0.75f, -0.75f, 0.7500001f, 1.5f,
+	-1.5f, 4.0f, -4.0f, 1e10f, -1e10f, 1.0f / 65536, -1.0f / 65536, 0.99999994f, INFINITY,
+	-INFINITY, NAN};
+
+static uint32 sRandom = 1;
+
+
+static float
+RandomSample(float range)
+{
+	sRandom = sRandom * 1664525 + 1013904223;
+	return ((sRandom >> 8) / 16777216.0f * 2 - 1) * range;
+}
+
+
+/**
+ * Fills count samples at random in [-range, range], with the special values
+ * mixed in if asked for.
+ */
+static void
+Fill(float* samples, size_t count, float range, bool specials)
+{
+	const size_t specialCount = sizeof(kSpecials) / sizeof(kSpecials[0]);
+
+	for (size_t i = 0; i < count; i++) {
+		samples[i] = RandomSample(range);
+		if (specials && i % 3 == 0)
+			samples[i] = kSpecials[(i / 3 + count) % specialCount];
+	}
+}
+
+
+#define CHECK_SAME(actual, expected, count, what) \
+	do { \
+		if (memcmp(actual, expected, (count) * sizeof((actual)[0])) != 0) { \
+			fprintf(stderr, "%s:%d: %s differs for %zu samples at offset %zu\n", __FILE__, \
+				__LINE__, what, (size_t)(count), offset); \
+			sTestFailures++; \
+		} \
+	} while (0)
+
+
+static void
+TestConvert()
+{
+	float* input = new float[kBufferSize];
+	float* actual = new float[kBufferSize];
+	float* expected = new float[kBufferSize];
+	int16* shorts = new int16[kBufferSize];
+	int16* expectedShorts = new int16[kBufferSize];
+	int32* ints = new int32[kBufferSize];
+	int32* expectedInts = new int32[kBufferSize];
+
+	for (size_t length = 0; length <= kMaxLength; length++) {
+		for (size_t offset = 0; offset <= kMaxOffset; offset++) {
+			Fill(input + offset, length, 1.5f, true);
+
+			PcmDsp::ConvertFromFloat(input + offset, shorts + offset, length);
+			PcmDspReference::ConvertFromFloat(input + offset, expectedShorts + offset, length);
+			CHECK_SAME(shorts + offset, expectedShorts + offset, length, "float to int16");
+
+			PcmDsp::ConvertFromFloat(input + offset, ints + offset, length);
+			PcmDspReference::ConvertFromFloat(input + offset, expectedInts + offset, length);
+			CHECK_SAME(ints + offset, expectedInts + offset, length, "float to int32");
+
+			PcmDsp::ConvertToFloat(shorts + offset, actual + offset, length);
+			PcmDspReference::ConvertToFloat(shorts + offset, expected + offset, length);
+			CHECK_SAME(actual + offset, expected + offset, length, "int16 to float");
+
+			for (size_t i = 0; i < length; i++)
+				ints[offset + i] = (int32)(RandomSample(1.0f) * 2147483520.0f);
+			if (length > 1) {
+				ints[offset] = INT32_MIN;
+				ints[offset + length - 1] = INT32_MAX;
+			}
+
+			PcmDsp::ConvertToFloat(ints + offset, actual + offset, length);
+			PcmDspReference::ConvertToFloat(ints + offset, expected + offset, length);
+			CHECK_SAME(actual + offset, expected + offset, length, "int32 to float");
+		}
+	}
+
+	delete[] input;
+	delete[] actual;
+	delete[] expected;
+	delete[] shorts;
+	delete[] expectedShorts;
+	delete[] ints;
+	delete[] expectedInts;
+}
+
+
+/**
+ * Every int16 value must come back unchanged from float.
+ */
+static void
+TestInt16RoundTrip()
+{
+	const size_t count = 65536;
+	int16* input = new int16[count];
+	float* converted = new float[count];
+	int16* output = new int16[count];
+
+	for (size_t i = 0; i < count; i++)
+		input[i] = (int16)(i - 32768);
+
+	PcmDsp::ConvertToFloat(input, converted, count);
+	PcmDsp::ConvertFromFloat(converted, output, count);
+	CHECK(memcmp(input, output, count * sizeof(int16)) == 0);
+
+	CHECK_EQUAL(converted[0], -1);
+	CHECK(converted[32768] == 0.0f);
+
+	// Full scale is clipped to the largest positive value
+	float fullScale[] = {1.0f, -1.0f};
+	int16 clipped[2];
+	PcmDsp::ConvertFromFloat(fullScale, clipped, 2);
+	CHECK_EQUAL(clipped[0], 32767);
+	CHECK_EQUAL(clipped[1], -32768);
+
+	delete[] input;
+	delete[] converted;
+	delete[] output;
+}
+
+
+static void
+TestGain()
+{
+	float* input = new float[kBufferSize];
+	float* actual = new float[kBufferSize];
+	float* expected = new float[kBufferSize];
+
+	for (size_t length = 0; length <= kMaxLength; length++) {
+		for (size_t offset = 0; offset <= kMaxOffset; offset++) {
+			float gain = RandomSample(2.0f);
+
+			Fill(actual + offset, length, 1.0f, false);
+			memcpy(expected + offset, actual + offset, length * sizeof(float));
+			PcmDsp::Gain(actual + offset, length, gain);
+			PcmDspReference::Gain(expected + offset, length, gain);
+			CHECK_SAME(actual + offset, expected + offset, length, "Gain()");
+
+			Fill(input + offset, length, 1.0f, false);
+			Fill(actual + offset, length, 1.0f, false);
+			memcpy(expected + offset, actual + offset, length * sizeof(float));
+			PcmDsp::Mix(input + offset, actual + offset, length, gain);
+			PcmDspReference::Mix(input + offset, expected + offset, length, gain);
+			CHECK_SAME(actual + offset, expected + offset, length, "Mix()");
+		}
+	}
+
+	delete[] input;
+	delete[] actual;
+	delete[] expected;
+}
+
+
+static void
+TestGainRamp()
+{
+	float* actual = new float[kBufferSize];
+	float* expected = new float[kBufferSize];
+
+	for (uint32 channels = 1; channels <= 3; channels++) {
+		for (size_t frames = 0; frames <= kMaxLength; frames++) {
+			for (size_t offset = 0; offset <= kMaxOffset; offset++) {
+				float from = RandomSample(1.0f);
+				float to = offset == kMaxOffset ? from : RandomSample(1.0f);
+				size_t samples = frames * channels;
+
+				Fill(actual + offset, samples, 1.0f, false);
+				memcpy(expected + offset, actual + offset, samples * sizeof(float));
+				PcmDsp::GainRamp(actual + offset, frames, channels, from, to);
+				PcmDspReference::GainRamp(expected + offset, frames, channels, from, to);
+				CHECK_SAME(actual + offset, expected + offset, samples, "GainRamp()");
+			}
+		}
+	}
+
+	// The whole length of a mixer buffer
+	const size_t frames = 4096;
+	float* ramp = new float[frames * 2];
+	float* expectedRamp = new float[frames * 2];
+	const size_t offset = 0;
+	Fill(ramp, frames * 2, 1.0f, false);
+	memcpy(expectedRamp, ramp, frames * 2 * sizeof(float));
+	PcmDsp::GainRamp(ramp, frames, 2, 0.0f, 1.0f);
+	PcmDspReference::GainRamp(expectedRamp, frames, 2, 0.0f, 1.0f);
+	CHECK_SAME(ramp, expectedRamp, frames * 2, "GainRamp() of a buffer");
+
+	delete[] actual;
+	delete[] expected;
+	delete[] ramp;
+	delete[] expectedRamp;
+}
+
+
+static void
+TestChannels()
+{
+	float* input = new float[kBufferSize];
+	float* actual = new float[kBufferSize];
+	float* expected = new float[kBufferSize];
+
+	for (size_t frames = 0; frames <= kMaxLength; frames++) {
+		for (size_t offset = 0; offset <= kMaxOffset; offset++) {
+			Fill(input + offset, frames * 2, 1.0f, false);
+
+			PcmDsp::UpMix(input + offset, actual + offset, frames);
+			PcmDspReference::UpMix(input + offset, expected + offset, frames);
+			CHECK_SAME(actual + offset, expected + offset, frames * 2, "UpMix()");
+
+			PcmDsp::DownMix(input + offset, actual + offset, frames);
+			PcmDspReference::DownMix(input + offset, expected + offset, frames);
+			CHECK_SAME(actual + offset, expected + offset, frames, "DownMix()");
+		}
+	}
+
+	delete[] input;
+	delete[] actual;
+	delete[] expected;
+}
+
+
+static void
+TestSoftClip()
+{
+	float* actual = new float[kBufferSize];
+	float* expected = new float[kBufferSize];
+
+	for (size_t length = 0; length <= kMaxLength; length++) {
+		for (size_t offset = 0; offset <= kMaxOffset; offset++) {
+			Fill(actual + offset, length, 2.0f, true);
+			memcpy(expected + offset, actual + offset, length * sizeof(float));
+			PcmDsp::SoftClip(actual + offset, length);
+			PcmDspReference::SoftClip(expected + offset, length);
+			CHECK_SAME(actual + offset, expected + offset, length, "SoftClip()");
+
+			for (size_t i = 0; i < length; i++)
+				CHECK(!(fabsf(actual[offset + i]) > 1.0f));
+		}
+	}
+
+	delete[] actual;
+	delete[] expected;
+}
+
+
+/**
+ * Peak() finds the same maximum in any order, DotProduct() adds in another
+ * one and is only close to the plain loop.
+ */
+static void
+TestReductions()
+{
+	float* first = new float[kBufferSize];
+	float* second = new float[kBufferSize];
+
+	for (size_t length = 0; length <= kMaxLength; length++) {
+		for (size_t offset = 0; offset <= kMaxOffset; offset++) {
+			Fill(first + offset, length, 1.0f, false);
+			Fill(second + offset, length, 1.0f, false);
+
+			CHECK(PcmDsp::Peak(first + offset, length)
+				== PcmDspReference::Peak(first + offset, length));
+
+			float magnitude = 0;
+			for (size_t i = 0; i < length; i++)
+				magnitude += fabsf(first[offset + i] * second[offset + i]);
+
+			float difference = PcmDsp::DotProduct(first + offset, second + offset, length)
+				- PcmDspReference::DotProduct(first + offset, second + offset, length);
+			CHECK(fabsf(difference) <= magnitude * 1e-6f);
+		}
+	}
+
+	delete[] first;
+	delete[] second;
+}
+
+
+int
+main()
+{
+	TestConvert();
+	TestInt16RoundTrip();
+	TestGain();
+	TestGainRamp();
+	TestChannels();
+	TestSoftClip();
+	TestReductions();
+
+	return TestResult("PcmDspTest");
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+// Checks that a sine converted from 44.1 to 48 kHz comes out clean, and that
+// equal rates pass the input through unchanged.
+
+
+#include <math.h>
+#include <string.h>
+
+#include "Resampler.h"
+#include "TestUtils.h"
+
+
+// Frames handed to the resampler at a time, as the mixer does
+static const size_t kChunkFrames = 1024;
+static const uint32 kChannels = 2;
+
+// Tones in the pass band measure at 90 dB and above
+static const double kMinSnr = 80.0;
+
+
+/**
+ * Returns the ratio of a sine at frequency to the difference from it of the
+ * same sine resampled from inputRate to outputRate, in dB.
+ */
+static double
+MeasureSnr(uint32 inputRate, uint32 outputRate, double frequency)
+{
+	Resampler resampler(inputRate, outputRate, kChannels, kChunkFrames);
+	CHECK_EQUAL(resampler.InitCheck(), B_OK);
+	if (resampler.InitCheck() != B_OK)
+		return 0;
+
+	size_t inputFrames = inputRate;
+	float* input = new float[inputFrames * kChannels];
+	for (size_t i = 0; i < inputFrames; i++) {
+		for (uint32 c = 0; c < kChannels; c++)
+			input[i * kChannels + c] = 0.5 * sin(2 * M_PI * frequency * i / inputRate);
+	}
+
+	size_t maxOutputFrames = (uint64)inputFrames * outputRate / inputRate + kChunkFrames;
+	float* output = new float[maxOutputFrames * kChannels];
+	size_t outputFrames = 0;
+	for (size_t start = 0; start < inputFrames; start += kChunkFrames) {
+		size_t frames = min_c(kChunkFrames, inputFrames - start);
+		outputFrames += resampler.Process(input + start * kChannels, frames,
+			output + outputFrames * kChannels);
+	}
+
+	// Output frame n is centred on input frame n * inputRate / outputRate. The
+	// frames the filter still reaches past the start or end of the input are
+	// left out.
+	double signal = 0;
+	double noise = 0;
+	for (size_t n = RESAMPLER_TAPS; n + RESAMPLER_TAPS < outputFrames; n++) {
+		double expected = 0.5 * sin(2 * M_PI * frequency * n / outputRate);
+		for (uint32 c = 0; c < kChannels; c++) {
+			double error = output[n * kChannels + c] - expected;
+			signal += expected * expected;
+			noise += error * error;
+		}
+	}
+
+	CHECK(outputFrames + RESAMPLER_TAPS >= (uint64)inputFrames * outputRate / inputRate);
+
+	delete[] input;
+	delete[] output;
+	return noise > 0 ? 10 * log10(signal / noise) : INFINITY;
+}
+
+
+static void
+TestSnr()
+{
+	const double frequencies[] = {440, 1000, 6000, 15000};
+	for (size_t i = 0; i < sizeof(frequencies) / sizeof(frequencies[0]); i++) {
+		double snr = MeasureSnr(44100, 48000, frequencies[i]);
+		if (snr < kMinSnr) {
+			fprintf(stderr, "%s:%d: SNR of %g Hz is %.1f dB, expected %.1f dB at least\n",
+				__FILE__, __LINE__, frequencies[i], snr, kMinSnr);
+			sTestFailures++;
+		}
+	}
+}
+
+
+static void
+TestPassthrough()
+{
+	Resampler resampler(48000, 48000, kChannels, kChunkFrames);
+	CHECK_EQUAL(resampler.InitCheck(), B_OK);
+	CHECK_EQUAL(resampler.MaxOutputFrames(), kChunkFrames + 2);
+
+	float input[kChunkFrames * kChannels];
+	float output[(kChunkFrames + 2) * kChannels];
+	uint32 random = 1;
+	for (size_t frames = 1; frames <= kChunkFrames; frames *= 3) {
+		for (size_t i = 0; i < frames * kChannels; i++) {
+			random = random * 1664525 + 1013904223;
+			input[i] = (random >> 8) / 16777216.0f * 2 - 1;
+		}
+
+		CHECK_EQUAL(resampler.Process(input, frames, output), frames);
+		CHECK(memcmp(input, output, frames * kChannels * sizeof(float)) == 0);
+	}
+}
+
+
+int
+main()
+{
+	TestSnr();
+	TestPassthrough();
+
+	return TestResult("ResamplerTest");
+}
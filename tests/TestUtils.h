@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef _TEST_UTILS_H
+#define _TEST_UTILS_H
+
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <SupportDefs.h>
+
+
+// Checks report the failing expression and go on, so that one run lists all
+// failures; main() returns TestResult().
+
+static int32 sTestFailures = 0;
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			fprintf(stderr, "%s:%d: %s failed\n", __FILE__, __LINE__, #condition); \
+			sTestFailures++; \
+		} \
+	} while (0)
+
+#define CHECK_EQUAL(actual, expected) \
+	do { \
+		long long _actual = (long long)(actual); \
+		long long _expected = (long long)(expected); \
+		if (_actual != _expected) { \
+			fprintf(stderr, "%s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__, \
+				#actual, _actual, _expected); \
+			sTestFailures++; \
+		} \
+	} while (0)
+
+
+static inline int
+TestResult(const char* name)
+{
+	if (sTestFailures != 0) {
+		fprintf(stderr, "%s: %" PRId32 " checks failed\n", name, sTestFailures);
+		return 1;
+	}
+
+	printf("%s: passed\n", name);
+	return 0;
+}
+
+
+/**
+ * Reads a file of the fixtures directory into a buffer of exactly its size,
+ * so that the sanitizers catch any read past it. Exits if it is missing.
+ */
+static inline uint8*
+ReadFixture(const char* name, size_t* size)
+{
+	char path[1024];
+	snprintf(path, sizeof(path), "%s/%s", FIXTURES_DIR, name);
+
+	FILE* file = fopen(path, "rb");
+	if (file == NULL) {
+		fprintf(stderr, "Missing fixture %s\n", path);
+		exit(2);
+	}
+
+	fseek(file, 0, SEEK_END);
+	*size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	uint8* data = (uint8*)malloc(*size > 0 ? *size : 1);
+	if (data == NULL || fread(data, 1, *size, file) != *size) {
+		fprintf(stderr, "Could not read fixture %s\n", path);
+		exit(2);
+	}
+
+	fclose(file);
+	return data;
+}
+
+
+#endif	// _TEST_UTILS_H
@@ -0,0 +1,262 @@
+#!/usr/bin/env python3
+#
+# Writes the stream fixtures of AudioHeaderTest. The headers follow the
+# layouts encoders write: MPEG audio frames as from LAME, ADTS as from FAAC,
+# Ogg pages with valid checksums, and a FLAC STREAMINFO with further metadata
+# blocks after it. Frame payloads are filler that never contains a sync word,
+# so that only the headers decide what is found.
+#
+# Run from this directory; the fixtures are checked in, this is only needed
+# to add or change them.
+
+import struct
+
+
+def filler(length, seed):
+	out = bytearray()
+	state = seed
+	while len(out) < length:
+		state = (state * 1103515245 + 12345) & 0x7fffffff
+		byte = (state >> 16) & 0xff
+		out.append(0xfe if byte == 0xff else byte)
+	return bytes(out)
+
+
+def write(name, data):
+	with open(name, "wb") as f:
+		f.write(data)
+
+
+# MPEG audio
+
+def mpeg_frames(header, lengths, seed):
+	# Frames one byte longer than the shortest one are padded
+	out = bytearray()
+	for i, length in enumerate(lengths):
+		h = bytearray(header)
+		if length > min(lengths):
+			h[2] |= 2
+		out += h + filler(length - 4, seed + i)
+	return bytes(out)
+
+
+# MPEG 1 layer 3, 128 kbit/s, 44.1 kHz, joint stereo: 417 or 418 bytes
+mpeg1_l3 = mpeg_frames(b"\xff\xfb\x90\x64", [417, 418, 418, 417, 418, 418], 1)
+write("mpeg1-layer3-44100-stereo.mp3", mpeg1_l3)
+
+# MPEG 1 layer 2, 192 kbit/s, 48 kHz, stereo: 576 bytes
+write("mpeg1-layer2-48000-stereo.mp2", mpeg_frames(b"\xff\xfd\xa4\x04", [576] * 4, 2))
+
+# MPEG 2 layer 3, 64 kbit/s, 22.05 kHz, mono: 208 or 209 bytes
+write("mpeg2-layer3-22050-mono.mp3", mpeg_frames(b"\xff\xf3\x80\xc4", [208, 209, 208, 209], 3))
+
+# MPEG 2.5 layer 3, 32 kbit/s, 11.025 kHz, stereo: 208 or 209 bytes
+write("mpeg25-layer3-11025-stereo.mp3", mpeg_frames(b"\xff\xe3\x40\x44", [208, 209, 209, 208], 4))
+
+# MPEG 1 layer 3 with variable bit rate: 128, 192, 160 and 128 kbit/s at 44.1 kHz
+vbr = bytearray()
+for i, (index, length) in enumerate([(9, 417), (11, 626), (10, 522), (9, 417)]):
+	vbr += bytes([0xff, 0xfb, index << 4, 0x64]) + filler(length - 4, 20 + i)
+write("mpeg1-layer3-vbr.mp3", bytes(vbr))
+
+# An ID3v2.4 tag with a title, a picture frame of 2000 bytes and padding
+def id3_frame(frame_id, body):
+	size = len(body)
+	synchsafe = bytes([(size >> 21) & 0x7f, (size >> 14) & 0x7f, (size >> 7) & 0x7f, size & 0x7f])
+	return frame_id + synchsafe + b"\x00\x00" + body
+
+
+frames = id3_frame(b"TIT2", b"\x03Station Identification\x00")
+frames += id3_frame(b"APIC", b"\x00image/png\x00\x03\x00" + filler(2000, 5))
+frames += bytes(512)
+size = len(frames)
+tag = b"ID3\x04\x00\x00" + bytes([(size >> 21) & 0x7f, (size >> 14) & 0x7f,
+	(size >> 7) & 0x7f, size & 0x7f]) + frames
+write("id3v2-mpeg1-layer3.mp3", tag + mpeg1_l3)
+
+# A stream joined in the middle of a frame
+write("mpeg1-layer3-joined.mp3", filler(300, 6) + mpeg1_l3)
+
+
+# ADTS
+
+def adts_frame(profile, rate_index, channels, payload_length, seed):
+	length = 7 + payload_length
+	fullness = 0x7ff
+	header = bytes([
+		0xff, 0xf1,
+		(profile << 6) | (rate_index << 2) | (channels >> 2),
+		((channels & 3) << 6) | (length >> 11),
+		(length >> 3) & 0xff,
+		((length & 7) << 5) | (fullness >> 6),
+		((fullness & 0x3f) << 2) | 0])
+	return header + filler(payload_length, seed)
+
+
+# AAC LC, 44.1 kHz, stereo
+aac = b"".join(adts_frame(1, 4, 2, n, 30 + i) for i, n in enumerate([364, 371, 380, 358, 366]))
+write("adts-aac-44100-stereo.aac", aac)
+
+# HE-AAC as streamed, signalled as AAC LC at half the rate: 24 kHz, mono
+write("adts-aac-24000-mono.aac",
+	b"".join(adts_frame(1, 6, 1, n, 40 + i) for i, n in enumerate([120, 131, 118, 125])))
+
+
+# Ogg
+
+def ogg_crc(data):
+	crc = 0
+	for byte in data:
+		crc ^= byte << 24
+		for _ in range(8):
+			crc = ((crc << 1) ^ 0x04c11db7) if crc & 0x80000000 else crc << 1
+			crc &= 0xffffffff
+	return crc
+
+
+def ogg_page(packets, flags, granule, serial, sequence):
+	lacing = bytearray()
+	for packet in packets:
+		length = len(packet)
+		while length >= 255:
+			lacing.append(255)
+			length -= 255
+		lacing.append(length)
+	header = struct.pack("<4sBBqIIIB", b"OggS", 0, flags, granule, serial, sequence, 0,
+		len(lacing))
+	page = bytearray(header + lacing + b"".join(packets))
+	struct.pack_into("<I", page, 22, ogg_crc(page))
+	return bytes(page)
+
+
+vorbis_id = struct.pack("<B6sIBIiiiBB", 1, b"vorbis", 0, 2, 44100, 0, 128000, 0, 0xb8, 1)
+vorbis_comment = b"\x03vorbis" + struct.pack("<I", 13) + b"Xiph.Org test" + struct.pack("<I", 0)
+vorbis_comment += b"\x01"
+vorbis_setup = b"\x05vorbis" + filler(3000, 7)
+vorbis = ogg_page([vorbis_id], 2, 0, 0x1234, 0)
+vorbis += ogg_page([vorbis_comment, vorbis_setup], 0, 0, 0x1234, 1)
+write("ogg-vorbis-44100-stereo.ogg", vorbis)
+
+opus_head = struct.pack("<8sBBHIhB", b"OpusHead", 1, 2, 312, 44100, 0, 0)
+opus_tags = b"OpusTags" + struct.pack("<I", 8) + b"libopus " + struct.pack("<I", 0)
+opus = ogg_page([opus_head], 2, 0, 0x5678, 0) + ogg_page([opus_tags], 0, 0, 0x5678, 1)
+write("ogg-opus-stereo.ogg", opus)
+
+# A Vorbis stream joined after its headers, followed by the next track's
+# headers as Icecast sends them when a chained stream moves on
+audio_page = ogg_page([filler(800, 8), filler(700, 9)], 0, 88200, 0x1234, 5)
+write("ogg-vorbis-chained.ogg", filler(100, 10) + audio_page
+	+ ogg_page([vorbis_id], 2, 0, 0x9abc, 0))
+
+
+# FLAC
+
+def flac_streaminfo(rate, channels, bits, samples):
+	info = struct.pack(">HH", 4096, 4096) + (1234).to_bytes(3, "big") + (5678).to_bytes(3, "big")
+	packed = (rate << 44) | ((channels - 1) << 41) | ((bits - 1) << 36) | samples
+	return info + packed.to_bytes(8, "big") + filler(16, 11)
+
+
+streaminfo = flac_streaminfo(44100, 2, 16, 441000)
+flac = b"fLaC" + b"\x00" + len(streaminfo).to_bytes(3, "big") + streaminfo
+comment = struct.pack("<I", 9) + b"reference" + struct.pack("<I", 0)
+flac += bytes([0x84]) + len(comment).to_bytes(3, "big") + comment
+flac += b"\xff\xf8\x69\x18" + filler(400, 12)
+write("flac-44100-stereo.flac", flac)
+
+streaminfo = flac_streaminfo(96000, 6, 24, 0)
+write("flac-96000-surround.flac",
+	b"fLaC" + b"\x80" + len(streaminfo).to_bytes(3, "big") + streaminfo)
+
+
+# Other content
+
+write("html-error-page.html", b"<!DOCTYPE html>\n<html><head><title>503 Service Unavailable"
+	b"</title></head>\n<body><h1>Service Unavailable</h1>\n<p>The stream is offline.</p>"
+	b"</body></html>\n")
+write("m3u-playlist.m3u", b"#EXTM3U\n#EXTINF:-1,Station\nhttp://example.org:8000/stream\n")
+
+
+# Pages and playlists for MarkupBenchmark
+
+def home_page():
+	# Laid out like the WordPress sites many stations have: a long head with
+	# style sheets and scripts before the icon, and a body full of markup
+	head = ["<!DOCTYPE html>", "<html lang=\"de-AT\">", "<head>",
+		"<meta charset=\"UTF-8\">",
+		"<meta name=\"viewport\" content=\"width=device-width, initial-scale=1\">"]
+	for i in range(40):
+		head.append("<link rel='stylesheet' id='style-%d-css' href='https://radio.example.org/"
+			"wp-content/themes/station/css/part-%d.css?ver=6.4.%d' media='all' />" % (i, i, i))
+	for i in range(25):
+		head.append("<script type=\"text/javascript\">var config%d = {\"ajax\":\"https:\\/\\/"
+			"radio.example.org\\/wp-admin\\/admin-ajax.php\",\"limit\":%d,\"less\":%d < %d};"
+			"</script>" % (i, i * 7, i, i + 1))
+	head.append("<title>Radio Example &amp; Friends &#8211; Live aus Wien</title>")
+	head.append("<link rel=\"preconnect\" href=\"https://fonts.example.net\" crossorigin>")
+	head.append("<link rel=\"icon\" href=\"https://radio.example.org/icon-32.png\" "
+		"sizes=\"32x32\" />")
+	head.append("<link rel=\"shortcut icon\" href=\"/favicon.ico\" />")
+	head.append("<link rel=\"apple-touch-icon\" href=\"/icon-180.png\" />")
+	head.append("</head>")
+
+	body = ["<body class=\"home page-template-default page page-id-2\">",
+		"<nav><ul class=\"menu\">"]
+	for i in range(30):
+		body.append("<li id=\"menu-item-%d\" class=\"menu-item\"><a href=\"/sendung-%d/\">"
+			"Sendung %d</a></li>" % (i, i, i))
+	body.append("</ul></nav><main>")
+	for i in range(120):
+		body.append("<article class=\"post-%d post type-post\"><h2><a href=\"/%d/\">Beitrag "
+			"Nummer %d &ndash; Programmhinweis</a></h2><div class=\"entry\"><p>Heute um %d "
+			"Uhr: Musik, Gespr&auml;che und <em>Neuigkeiten</em> aus der Stadt.</p>"
+			"<img src=\"/wp-content/uploads/%d.jpg\" alt=\"\" width=\"300\" height=\"200\">"
+			"</div></article>" % (i, i, i, i % 24, i))
+	body.append("</main><footer>&copy; Radio Example</footer></body></html>")
+	return "\n".join(head + body).encode("utf-8")
+
+
+write("homepage-station.html", home_page())
+
+
+def listenlive_page():
+	# The result table of a country search, in the layout the baseline regular
+	# expression was written for
+	rows = ["<html><head><title>listenlive.eu - Austria</title></head><body>",
+		"<table class=\"stations\">",
+		"<tr><th>Station</th><th>Location</th><th>Format</th><th>Stream</th>"
+		"<th>Genre</th></tr>"]
+	formats = ["<img src=\"mp3.gif\" width=\"12\" height=\"12\" alt=\"MP3\">",
+		"<img src=\"aacplus.gif\" width=\"12\" height=\"12\" alt=\"AAC+\"><br>"
+		"<img src=\"mp3.gif\" width=\"12\" height=\"12\" alt=\"MP3\">"]
+	genres = ["Information/Culture", "Pop/Rock", "Classical", "Community", "Jazz"]
+	cities = ["Vienna", "Graz", "Linz", "Salzburg", "Innsbruck", "Klagenfurt"]
+	for i in range(300):
+		stream = "http://stream%d.example.at:8000/live%d.%s" % (i % 9, i, ["mp3", "m3u",
+			"pls"][i % 3])
+		rows.append("<tr>\n<td><a href=\"http://station%d.example.at/\"><b>Radio Station %d"
+			"</b></a></td>\n<td>%s</td>\n<td>%s</td>\n<td><a href=\"%s\">%d Kbps</a><br>"
+			"<a href=\"http://backup.example.at/live%d.pls\">%d Kbps</a></td>\n"
+			"<td>%s</td>\n</tr>" % (i, i, cities[i % len(cities)], formats[i % 2], stream,
+				[64, 128, 192][i % 3], i, [32, 64][i % 2], genres[i % len(genres)]))
+	rows.append("</table></body></html>")
+	return "\n".join(rows).encode("utf-8")
+
+
+write("listenlive-country.html", listenlive_page())
+
+
+def pls_mirrors():
+	# What SHOUTcast and Icecast servers list for a station with relays, with
+	# the DOS line ends they use
+	lines = ["[playlist]", "NumberOfEntries=8"]
+	for i in range(1, 9):
+		lines += ["File%d=http://relay%d.example.net:8000/live" % (i, i),
+			"Title%d=(#%d - 312/5000) Radio Example: Live aus Wien" % (i, i), "Length%d=-1" % i]
+	lines.append("Version=2")
+	return ("\r\n".join(lines) + "\r\n").encode("utf-8")
+
+
+write("pls-mirrors.pls", pls_mirrors())
+write("m3u-mirrors.m3u", ("#EXTM3U\n" + "".join("#EXTINF:-1,Radio Example (relay %d)\n"
+	"http://relay%d.example.net:8000/live\n" % (i, i) for i in range(1, 9))).encode("utf-8"))
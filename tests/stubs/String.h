@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef _B_STRING_H
+#define _B_STRING_H
+
+
+// The parts of Haiku's BString the sources under test use, backed by
+// std::string. Only for building those on other systems.
+
+
+#include <ctype.h>
+#include <string.h>
+#include <strings.h>
+
+#include <string>
+
+#include <SupportDefs.h>
+
+
+class BString {
+public:
+	BString() {}
+	BString(const char* string) : fString(string != NULL ? string : "") {}
+	BString(const char* string, int32 length) : fString(string, strnlen(string, length)) {}
+
+	const char* String() const { return fString.c_str(); }
+	int32 Length() const { return fString.length(); }
+	bool IsEmpty() const { return fString.empty(); }
+
+	int ICompare(const char* string) const { return strcasecmp(String(), string); }
+	bool StartsWith(const char* prefix) const
+	{
+		return fString.compare(0, strlen(prefix), prefix) == 0;
+	}
+
+	int32 FindFirst(char c) const
+	{
+		size_t position = fString.find(c);
+		return position == std::string::npos ? -1 : (int32)position;
+	}
+
+	BString& ReplaceAll(const char* replace, const char* with)
+	{
+		size_t length = strlen(replace);
+		size_t withLength = strlen(with);
+		for (size_t position = fString.find(replace); position != std::string::npos;
+			 position = fString.find(replace, position + withLength))
+			fString.replace(position, length, with);
+		return *this;
+	}
+
+	BString& SetTo(const char* string)
+	{
+		fString = string != NULL ? string : "";
+		return *this;
+	}
+
+	BString& SetTo(const char* string, int32 length)
+	{
+		fString.assign(string, strnlen(string, length));
+		return *this;
+	}
+
+	BString& SetTo(const BString& string)
+	{
+		fString = string.fString;
+		return *this;
+	}
+
+	BString& Truncate(int32 length)
+	{
+		if (length < Length())
+			fString.resize(length);
+		return *this;
+	}
+
+	BString& CopyInto(BString& into, int32 from, int32 length) const
+	{
+		into.fString = fString.substr(from, length);
+		return into;
+	}
+
+	BString& Trim()
+	{
+		size_t start = 0;
+		while (start < fString.length() && isspace((uint8)fString[start]))
+			start++;
+		size_t end = fString.length();
+		while (end > start && isspace((uint8)fString[end - 1]))
+			end--;
+		fString = fString.substr(start, end - start);
+		return *this;
+	}
+
+	BString& operator<<(const char* string)
+	{
+		fString += string;
+		return *this;
+	}
+
+	bool operator==(const char* string) const { return fString == string; }
+	bool operator==(const BString& string) const { return fString == string.fString; }
+
+private:
+	std::string fString;
+};
+
+
+#endif	// _B_STRING_H
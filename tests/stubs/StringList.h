@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef _STRING_LIST_H
+#define _STRING_LIST_H
+
+
+// The parts of Haiku's BStringList the sources under test use, backed by
+// std::vector. Only for building those on other systems.
+
+
+#include <vector>
+
+#include <String.h>
+
+
+class BStringList {
+public:
+	int32 CountStrings() const { return fStrings.size(); }
+	bool IsEmpty() const { return fStrings.empty(); }
+	BString StringAt(int32 index) const
+	{
+		return index >= 0 && index < CountStrings() ? fStrings[index] : BString();
+	}
+
+	bool HasString(const BString& string) const
+	{
+		for (size_t i = 0; i < fStrings.size(); i++) {
+			if (fStrings[i] == string)
+				return true;
+		}
+		return false;
+	}
+
+	bool Add(const BString& string)
+	{
+		fStrings.push_back(string);
+		return true;
+	}
+
+	void MakeEmpty() { fStrings.clear(); }
+
+private:
+	std::vector<BString> fStrings;
+};
+
+
+#endif	// _STRING_LIST_H
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef _SUPPORT_DEFS_H
+#define _SUPPORT_DEFS_H
+
+
+// The parts of Haiku's SupportDefs.h the sources under test use, so that they
+// build on other systems.
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+typedef int8_t int8;
+typedef uint8_t uint8;
+typedef int16_t int16;
+typedef uint16_t uint16;
+typedef int32_t int32;
+typedef uint32_t uint32;
+typedef int64_t int64;
+typedef uint64_t uint64;
+
+typedef int32 status_t;
+typedef int64 bigtime_t;
+
+
+#define B_OK 0
+#define B_ERROR (-1)
+#define B_NO_MEMORY (-2147483647 - 1)
+#define B_BAD_VALUE (B_NO_MEMORY + 5)
+#define B_NO_INIT (B_NO_MEMORY + 13)
+#define B_NOT_SUPPORTED (B_NO_MEMORY + 0x6009)
+
+#define min_c(a, b) ((a) > (b) ? (b) : (a))
+#define max_c(a, b) ((a) > (b) ? (a) : (b))
+
+
+#endif	// _SUPPORT_DEFS_H
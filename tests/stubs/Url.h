@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2017 Kai Niessen <kai.niessen@online.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef _B_URL_H
+#define _B_URL_H
+
+
+// The parts of Haiku's BUrl the sources under test use. Relative references
+// are resolved against the scheme, the authority or the directory of the base,
+// without normalizing dot segments. Only for building those on other systems.
+
+
+#include <String.h>
+
+
+class BUrl {
+public:
+	BUrl() {}
+	BUrl(const char* url) : fUrl(url) {}
+	BUrl(const BString& url) : fUrl(url) {}
+
+	BUrl(const BUrl& base, const BString& relative)
+	{
+		const char* url = relative.String();
+		const char* baseUrl = base.fUrl.String();
+		const char* authority = strstr(baseUrl, "://");
+		if (strstr(url, "://") != NULL || authority == NULL) {
+			fUrl = relative;
+			return;
+		}
+
+		const char* path = strchr(authority + 3, '/');
+		if (url[0] == '/' && url[1] == '/')
+			fUrl.SetTo(baseUrl, authority + 1 - baseUrl);
+		else if (url[0] == '/' || path == NULL)
+			fUrl.SetTo(baseUrl, path != NULL ? path - baseUrl : base.fUrl.Length());
+		else
+			fUrl.SetTo(baseUrl, strrchr(path, '/') + 1 - baseUrl);
+		if (url[0] != '/' && path == NULL)
+			fUrl << "/";
+		fUrl << url;
+	}
+
+	bool IsValid() const
+	{
+		const char* authority = strstr(fUrl.String(), "://");
+		return authority != NULL && authority != fUrl.String() && authority[3] != '\0';
+	}
+
+	const BString& UrlString() const { return fUrl; }
+
+private:
+	BString fUrl;
+};
+
+
+#endif	// _B_URL_H